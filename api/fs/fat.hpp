@@ -26,6 +26,7 @@
 #include <cstdint>
 #include <memory>
 #include <map>
+#include <vector>
 
 namespace fs
 {
@@ -94,20 +95,29 @@ namespace fs
         return lba_base + data_index + (cl - 2) * sectors_per_cluster;
     }
 
-    uint16_t cl_to_entry_offset(uint32_t cl) const
+    // byte offset of the FAT entry for @cl from the start of the FAT
+    uint64_t cl_to_entry_pos(uint32_t cl) const
     {
-      if (fat_type == T_FAT16)
-        return (cl * 2) % sector_size;
+      if (fat_type == T_FAT12)
+        return cl + cl / 2;
+      else if (fat_type == T_FAT16)
+        return cl * 2ull;
       else // T_FAT32
-        return (cl * 4) % sector_size;
+        return cl * 4ull;
     }
-    uint16_t cl_to_entry_sector(uint32_t cl) const
+    uint16_t cl_to_entry_offset(uint32_t cl) const
     {
-      if (fat_type == T_FAT16)
-        return reserved + (cl * 2 / sector_size);
-      else // T_FAT32
-        return reserved + (cl * 4 / sector_size);
+      return cl_to_entry_pos(cl) % sector_size;
     }
+    uint32_t cl_to_entry_sector(uint32_t cl) const
+    {
+      return reserved + cl_to_entry_pos(cl) / sector_size;
+    }
+    // FAT12 entries can straddle two sectors
+    uint32_t fat_read_sectors() const noexcept
+    { return (fat_type == T_FAT12) ? 2 : 1; }
+    uint32_t cluster_size() const noexcept
+    { return sectors_per_cluster * sector_size; }
 
     // initialize filesystem by providing base sector
     void init(const void* base_sector);
@@ -124,6 +134,40 @@ namespace fs
     error_t traverse(Path path, dirvector&, const Dirent* const = nullptr) const;
     error_t int_ls(uint32_t sector, dirvector&) const;
 
+    // a run of physically contiguous clusters in a cluster chain
+    struct Extent {
+      uint32_t index;   // position in the file, in clusters
+      uint32_t cluster; // first cluster of the run
+      uint32_t count;   // number of clusters in the run
+    };
+    using Extent_map = std::vector<Extent>;
+    using Extent_ptr = std::shared_ptr<const Extent_map>;
+    // list of (first sector, sector count) device reads
+    using Sector_runs = std::vector<std::pair<uint64_t, uint32_t>>;
+
+    // partially walked cluster chain
+    struct Chain {
+      Extent_map extents;
+      uint32_t   cluster; // last cluster added to the chain
+      uint32_t   length;  // clusters in the chain so far
+      uint32_t   total;   // clusters needed to cover the file
+    };
+    // follow @chain using the FAT sector(s) read from @sector, returns true
+    // when the chain is complete and false when another FAT sector is needed
+    bool chain_step(Chain&, uint64_t sector, const uint8_t* data) const;
+    uint32_t fat_entry(const uint8_t* data, uint32_t cl) const;
+    bool is_chain_end(uint32_t entry) const noexcept;
+    Chain new_chain(const Dirent&) const;
+    // returns extents for a file from cache, or nullptr
+    Extent_ptr cached_extents(const Dirent&) const;
+    Extent_ptr store_extents(uint32_t first_cluster, Extent_map) const;
+    // map sectors relative to the start of a file to device sectors
+    Sector_runs map_sectors(const Extent_map&, uint32_t sector, uint32_t nsect) const;
+
+    typedef delegate<void(error_t, Extent_ptr)> on_extents_func;
+    void    extents(const Dirent&, on_extents_func) const;
+    error_t extents(const Dirent&, Extent_ptr&) const;
+
     // device we can read and write sectors to
     hw::Block_device& device;
 
@@ -150,6 +194,9 @@ namespace fs
 
     // simplistic cache for stat results
     std::map<std::string, Dirent> stat_cache;
+    // extent maps of recently read files, keyed by first cluster
+    static const size_t EXTENT_CACHE_MAX = 256;
+    mutable std::map<uint32_t, Extent_ptr> extent_cache;
   };
 
 } // fs
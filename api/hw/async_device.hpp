@@ -36,10 +36,7 @@ public:
   {
     this->event_id = Events::get().subscribe(
       [this] {
-        while(! queue.empty()) {
-          this->driver_receive(std::move(queue.front()));
-          queue.pop_front();
-        }
+        this->m_nic.receive_round(queue);
         this->m_nic.signal_tqa();
       });
   }
@@ -58,9 +55,6 @@ public:
   }
 
 private:
-  inline void driver_receive(net::Packet_ptr packet) {
-    this->m_nic.receive(std::move(packet));
-  }
   Driver& m_nic;
   int event_id = 0;
   std::deque<net::Packet_ptr> queue;
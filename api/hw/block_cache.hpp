@@ -0,0 +1,205 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef HW_BLOCK_CACHE_HPP
+#define HW_BLOCK_CACHE_HPP
+
+#include "writable_blkdev.hpp"
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+namespace hw {
+
+/**
+ * A block cache that can be layered on top of any block device.
+ *
+ * The cache is itself a block device, so it can be handed to fs::Disk,
+ * fs::FAT or VFS::mount in place of the device it wraps:
+ *
+ *   hw::Block_cache cache { device };
+ *   fs::Disk disk { cache };
+ *
+ * - Blocks are evicted in LRU order. Blocks brought in by read-ahead are
+ *   inserted cold, so a long sequential scan does not push out hot
+ *   metadata blocks (FAT sectors, directories).
+ * - Sequential reads are detected per cache and grow a read-ahead window
+ *   up to read_ahead_max() blocks.
+ * - Writes are write-back: they are absorbed by the cache and only reach
+ *   the device on flush(), on eviction, on deactivate() or when the cache
+ *   is destroyed. A dirty block stays cached until it has been written
+ *   back, so a failed write-back is retried rather than lost; while the
+ *   device fails, the cache may hold more than capacity() blocks.
+ *
+ * Device completions that arrive after the cache is destroyed are ignored,
+ * except that a read still hands the device data to its reader.
+ *
+ * Hits, misses, read-ahead blocks, evictions and write-backs are exposed
+ * through Statman under the name of the underlying device.
+ */
+class Block_cache : public Writable_Block_device {
+public:
+  static constexpr size_t DEFAULT_CAPACITY   = 1024; // blocks
+  static constexpr size_t DEFAULT_READ_AHEAD = 32;   // blocks
+
+  /** Read-only cache, writes will fail */
+  explicit Block_cache(Block_device& dev,
+                       size_t capacity = DEFAULT_CAPACITY);
+  /** Read/write cache with write-back to @dev */
+  explicit Block_cache(Writable_Block_device& dev,
+                       size_t capacity = DEFAULT_CAPACITY);
+
+  /** Writes back dirty blocks */
+  ~Block_cache() override;
+
+  std::string device_name() const override {
+    return dev_.device_name() + ".cache";
+  }
+
+  const char* driver_name() const noexcept override
+  { return "Block_cache"; }
+
+  block_t size() const noexcept override
+  { return dev_.size(); }
+
+  block_t block_size() const noexcept override
+  { return dev_.block_size(); }
+
+  void read(block_t blk, size_t count, on_read_func reader) override;
+  buffer_t read_sync(block_t blk, size_t count=1) override;
+
+  /**
+   * Write-back: the blocks are stored in the cache and marked dirty.
+   * The callback is called immediately, error is true when the underlying
+   * device is not writable or the write is out of bounds.
+   */
+  void write(block_t blk, buffer_t, on_write_func) override;
+  bool write_sync(block_t blk, buffer_t) override;
+
+  /** Synchronously write all dirty blocks back to the device */
+  void flush() override;
+  /** Asynchronously write all dirty blocks back to the device */
+  void flush(on_write_func on_done);
+
+  /** Flushes dirty blocks and deactivates the underlying device */
+  void deactivate() override;
+
+  /** Drop all clean blocks from the cache */
+  void invalidate();
+
+  /** Change the maximum read-ahead window (0 disables read-ahead) */
+  void set_read_ahead_max(size_t blocks) noexcept
+  { ra_max_ = blocks; }
+
+  size_t read_ahead_max() const noexcept
+  { return ra_max_; }
+
+  // cache statistics
+  size_t capacity() const noexcept { return capacity_; }
+  size_t cached() const noexcept   { return index_.size(); }
+  size_t dirty() const noexcept    { return dirty_; }
+  uint64_t hits() const noexcept   { return stat_hits; }
+  uint64_t misses() const noexcept { return stat_misses; }
+  float hit_rate() const noexcept {
+    const uint64_t total = stat_hits + stat_misses;
+    return total ? float(stat_hits) / total : 0.0f;
+  }
+
+  bool is_writable() const noexcept
+  { return wdev_ != nullptr; }
+
+  Block_device& device() noexcept
+  { return dev_; }
+
+private:
+  struct Entry {
+    block_t  blk;
+    bool     dirty   = false;
+    // an eviction write-back is in flight
+    bool     writing = false;
+    // changes with every write, so a write-back only cleans what it wrote
+    uint64_t gen     = 0;
+    std::vector<uint8_t> data;
+  };
+  using lru_list = std::list<Entry>;
+
+  Block_device&          dev_;
+  Writable_Block_device* wdev_;
+  const size_t           capacity_;
+  size_t                 ra_max_ = DEFAULT_READ_AHEAD;
+  size_t                 ra_window_ = 0;
+  size_t                 dirty_ = 0;
+  uint64_t               gen_ = 0;
+  // next block expected by a sequential reader
+  block_t                next_seq_ = 0;
+  // end of the last read-ahead request sent to the device
+  block_t                ra_end_ = 0;
+
+  // expires with the cache, checked by device completions
+  std::shared_ptr<bool> alive_ = std::make_shared<bool>(true);
+
+  // most recently used at the front
+  lru_list lru_;
+  std::unordered_map<block_t, lru_list::iterator> index_;
+
+  uint64_t& stat_hits;
+  uint64_t& stat_misses;
+  uint64_t& stat_read_ahead;
+  uint64_t& stat_evictions;
+  uint64_t& stat_writebacks;
+  uint64_t& stat_write_errors;
+
+  Block_cache(Block_device&, Writable_Block_device*, size_t capacity);
+
+  // contiguous dirty blocks, and their generations when collected
+  struct Run {
+    block_t               blk;
+    buffer_t              data;
+    std::vector<uint64_t> gens;
+  };
+
+  Entry* lookup(block_t blk);
+  Entry& insert(block_t blk, const uint8_t* data, bool hot, bool sync);
+  void   retire(Entry&);
+  // the least recently used entry that is clean, writing back dirty
+  // ones on the way, or lru_.end() when none is
+  lru_list::iterator victim(bool sync);
+  bool   evict_one(bool sync);
+  // returns true when the entry is clean after the call
+  bool   write_back(Entry&, bool sync);
+  bool   write_blocks(block_t blk, const buffer_t& data, bool sync);
+  // collect dirty blocks into contiguous runs, they stay dirty
+  // until written
+  std::vector<Run> dirty_runs();
+  void   mark_clean(block_t blk, uint64_t gen);
+  void   written(const Run&);
+
+  // returns true when every block in the range is cached
+  bool   all_cached(block_t blk, size_t count);
+  // assemble a buffer from cache, filling holes from @dev_data at @dev_blk
+  buffer_t assemble(block_t blk, size_t count,
+                    const buffer_t& dev_data = nullptr, block_t dev_blk = 0);
+  // insert blocks read from device, never overwriting dirty ones
+  void   fill(block_t blk, const buffer_t& data, block_t hot_begin, block_t hot_end);
+  // returns number of blocks to read ahead after a request at @blk
+  size_t update_sequential(block_t blk, size_t count);
+  void   read_ahead(block_t blk, size_t count);
+}; //< class Block_cache
+
+} //< namespace hw
+
+#endif //< HW_BLOCK_CACHE_HPP
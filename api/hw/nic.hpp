@@ -22,6 +22,8 @@
 #include <net/inet_common.hpp>
 #include "device.hpp"
 
+class Stat_histogram;
+
 #define NIC_SENDQ_LIMIT_DEFAULT  4096
 #define NIC_BUFFER_LIMIT_DEFAULT 4096
 
@@ -89,6 +91,11 @@ namespace hw {
 
     virtual size_t transmit_queue_available() = 0;
 
+    /** Subscribe to event for when a round of received packets
+        has been handed up the stack */
+    virtual void on_rx_batch_done(delegate<void()> del)
+    { rx_batch_events_.push_back(del); }
+
     virtual void deactivate() override = 0;
 
     /** Stats getters **/
@@ -166,8 +173,20 @@ namespace hw {
       return this->sendq_limit() == 0 || size < this->sendq_limit();
     }
 
+    /** Record the number of packets taken in one round of RX processing */
+    void record_rx_batch(uint32_t packets);
+
+    /** Signal that the packets of a round of RX processing are handed up */
+    void rx_batch_done()
+    {
+      for (auto& del : rx_batch_events_)
+        del();
+    }
+
   private:
     int N;
+    Stat_histogram* stat_rx_batch_ = nullptr;
+    std::vector<delegate<void()>> rx_batch_events_;
     uint32_t m_buffer_limit = buffer_limit_default;
     uint32_t m_sendq_limit = sendq_limit_default;
     friend class Devices;
@@ -21,6 +21,7 @@
 #include <net/link_layer.hpp>
 #include <net/ethernet/ethernet.hpp>
 #include <delegate>
+#include <deque>
 
 class UserNet : public net::Link_layer<net::Ethernet> {
 public:
@@ -62,6 +63,8 @@ public:
   void receive(void*, net::BufferStore* = nullptr);
   void receive(net::Packet_ptr);
   void receive(const void* data, int len);
+  /** a round of packets coming in, as a driver takes them off its ring **/
+  void receive_round(std::deque<net::Packet_ptr>&);
 
   /** Space available in the transmit queue, in packets */
   size_t transmit_queue_available() override;
@@ -0,0 +1,83 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef KERNEL_BOOT_TRACE_HPP
+#define KERNEL_BOOT_TRACE_HPP
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Records a TSC timestamp at the start of each phase of the boot sequence,
+ * from kernel_start until Service::ready() has returned.
+ *
+ * The phases are contiguous: starting a phase ends the previous one.
+ * When the boot sequence is over the timeline is printed as one line of
+ * JSON prefixed with BOOT_TIMELINE, so that it can be picked up from the
+ * serial log, eg. by test scripts tracking cold-start time.
+ *
+ * No memory is allocated while recording, so phases can be recorded
+ * before the heap is ready.
+ */
+class Boot_trace {
+public:
+  static const int MAX_PHASES = 32;
+
+  struct Phase {
+    // must be a string literal
+    const char* name;
+    // TSC values, end is 0 while the phase is running
+    uint64_t    begin;
+    uint64_t    end;
+
+    uint64_t cycles() const noexcept
+    { return end - begin; }
+  };
+
+  /** Begin the trace with a phase that started at @tsc */
+  static void start(const char* name, uint64_t tsc) noexcept;
+
+  /** End the current phase and begin a new one */
+  static void phase(const char* name) noexcept;
+
+  /** End the current phase, which completes the trace */
+  static void finish() noexcept;
+
+  /** True when the boot sequence is over */
+  static bool finished() noexcept;
+
+  static const Phase* phases() noexcept;
+  static int size() noexcept;
+
+  /** Cycles from the beginning of the first phase to the end of the last */
+  static uint64_t total_cycles() noexcept;
+
+  /** Converts cycles to microseconds, or 0 if the CPU frequency is unknown */
+  static uint64_t to_micros(uint64_t cycles) noexcept;
+
+  /** The timeline as one line of JSON:
+      {"tsc_khz":N,"total_us":N,"phases":[{"name":"...","start_us":N,"us":N},...]} */
+  static std::string to_json();
+
+  /** Print the timeline to stdout */
+  static void print();
+
+  /** Forget all recorded phases */
+  static void reset() noexcept;
+};
+
+#endif
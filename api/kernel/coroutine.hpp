@@ -0,0 +1,506 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef KERNEL_COROUTINE_HPP
+#define KERNEL_COROUTINE_HPP
+
+/**
+ * Awaitable wrappers around the callback APIs, for services built with
+ * coroutine support (-fcoroutines-ts, see test/stl/integration/coroutines).
+ *
+ *   coro::Task<> echo(coro::Arena& arena, net::Stream& stream)
+ *   {
+ *     while (auto buf = co_await coro::read(stream))
+ *       co_await coro::write(stream, std::move(buf));
+ *   }
+ *   coro::spawn(echo(conn_arena, stream));
+ *
+ * A coroutine that takes an Arena& as its first parameter (or second, for
+ * member functions) gets its frame from that arena instead of the heap.
+ * Give each connection an arena big enough for the frames it has alive
+ * at once, and nothing is allocated per call.
+ *
+ * Everything here is for the CPU the coroutine runs on. Awaiting a callback
+ * resumes the coroutine from the deferred queue in Events, so it is never
+ * resumed from inside the callback of the stream it is waiting on.
+ */
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+namespace coro { namespace stdco = std; }
+#else
+#include <experimental/coroutine>
+namespace coro { namespace stdco = std::experimental; }
+#endif
+
+#include <kernel/events.hpp>
+#include <kernel/timers.hpp>
+#include <net/inet.hpp>
+#include <net/stream.hpp>
+#include <net/tcp/tcp.hpp>
+#include <exception>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace coro {
+
+/**
+ * Allocator for coroutine frames. Frames are bumped off a fixed buffer and
+ * the space is reclaimed as they are freed from the top, or all at once
+ * when the last one is gone. Frames that don't fit go to the heap.
+ */
+class Arena {
+public:
+  static const size_t ALIGN = alignof(std::max_align_t);
+
+  Arena(char* buffer, size_t size) noexcept
+    : buffer_{buffer}, size_{size} {}
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  void* allocate(size_t n)
+  {
+    n = round_up(n);
+    if (top_ + n > size_) {
+      heap_allocs_++;
+      return ::operator new(n);
+    }
+    void* ptr = buffer_ + top_;
+    top_ += n;
+    live_++;
+    return ptr;
+  }
+
+  void deallocate(void* ptr, size_t n) noexcept
+  {
+    if (not owns(ptr)) {
+      ::operator delete(ptr);
+      return;
+    }
+    n = round_up(n);
+    if ((char*) ptr + n == buffer_ + top_) top_ -= n;
+    if (--live_ == 0) top_ = 0;
+  }
+
+  bool owns(const void* ptr) const noexcept
+  { return ptr >= buffer_ && ptr < buffer_ + size_; }
+
+  /** Bytes in use, including holes left by frames freed out of order */
+  size_t in_use() const noexcept
+  { return top_; }
+
+  size_t capacity() const noexcept
+  { return size_; }
+
+  /** Frames that didn't fit and were allocated on the heap */
+  size_t heap_allocs() const noexcept
+  { return heap_allocs_; }
+
+private:
+  static size_t round_up(size_t n) noexcept
+  { return (n + ALIGN - 1) & ~(ALIGN - 1); }
+
+  char*  buffer_;
+  size_t size_;
+  size_t top_  = 0;
+  size_t live_ = 0;
+  size_t heap_allocs_ = 0;
+};
+
+/** Arena with its buffer inline, eg. as a member of a connection */
+template <size_t N>
+class Static_arena : public Arena {
+public:
+  Static_arena() noexcept : Arena(storage_, N) {}
+private:
+  alignas(Arena::ALIGN) char storage_[N];
+};
+
+/** Resume @h from the event loop of this CPU */
+inline void resume_later(stdco::coroutine_handle<> h)
+{
+  Events::get().defer([h] { h.resume(); });
+}
+
+template <typename T = void> class Task;
+
+namespace detail {
+
+  struct Promise_base
+  {
+    // the frame is prefixed by the arena it came from, or nullptr
+    static const size_t HEADER = Arena::ALIGN;
+
+    static void* allocate(size_t n, Arena* arena)
+    {
+      char* ptr = (char*) (arena ? arena->allocate(n + HEADER)
+                                 : ::operator new(n + HEADER));
+      *(Arena**) ptr = arena;
+      return ptr + HEADER;
+    }
+
+    template <typename... Args>
+    static void* operator new(size_t n, Arena& arena, Args&&...)
+    { return allocate(n, &arena); }
+
+    template <typename Obj, typename... Args>
+    static void* operator new(size_t n, Obj&, Arena& arena, Args&&...)
+    { return allocate(n, &arena); }
+
+    static void* operator new(size_t n)
+    { return allocate(n, nullptr); }
+
+    static void operator delete(void* frame, size_t n) noexcept
+    {
+      char* ptr = (char*) frame - HEADER;
+      Arena* arena = *(Arena**) ptr;
+      if (arena) arena->deallocate(ptr, n + HEADER);
+      else ::operator delete(ptr);
+    }
+
+    struct Final_awaiter
+    {
+      bool await_ready() const noexcept { return false; }
+
+      template <typename Promise>
+      void await_suspend(stdco::coroutine_handle<Promise> h) noexcept
+      {
+        auto& promise = h.promise();
+        if (promise.continuation) promise.continuation.resume();
+        else if (promise.detached) h.destroy();
+      }
+
+      void await_resume() const noexcept {}
+    };
+
+    stdco::suspend_always initial_suspend() const noexcept { return {}; }
+    Final_awaiter final_suspend() const noexcept { return {}; }
+
+    void unhandled_exception()
+    {
+      // nobody to hand it to, let it out of the event loop like a callback would
+      if (detached) throw;
+      error = std::current_exception();
+    }
+
+    stdco::coroutine_handle<> continuation = nullptr;
+    std::exception_ptr error = nullptr;
+    bool detached = false;
+  };
+
+  template <typename T>
+  struct Promise : Promise_base
+  {
+    Task<T> get_return_object() noexcept;
+
+    template <typename V>
+    void return_value(V&& v)
+    { value.emplace(std::forward<V>(v)); }
+
+    std::optional<T> value;
+  };
+
+  template <>
+  struct Promise<void> : Promise_base
+  {
+    Task<void> get_return_object() noexcept;
+
+    void return_void() const noexcept {}
+  };
+
+} // detail
+
+/**
+ * A lazily started coroutine returning T. It runs when awaited, or when
+ * handed to spawn(), and the frame lives as long as the Task.
+ */
+template <typename T>
+class Task {
+public:
+  using promise_type = detail::Promise<T>;
+  using handle_type  = stdco::coroutine_handle<promise_type>;
+
+  Task(Task&& other) noexcept
+    : coro_{std::exchange(other.coro_, nullptr)} {}
+
+  Task& operator=(Task&& other) noexcept
+  {
+    if (this != &other) {
+      if (coro_) coro_.destroy();
+      coro_ = std::exchange(other.coro_, nullptr);
+    }
+    return *this;
+  }
+
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+
+  ~Task()
+  {
+    if (coro_) coro_.destroy();
+  }
+
+  bool done() const noexcept
+  { return coro_ == nullptr || coro_.done(); }
+
+  bool await_ready() const noexcept
+  { return false; }
+
+  void await_suspend(stdco::coroutine_handle<> awaiting) noexcept
+  {
+    coro_.promise().continuation = awaiting;
+    coro_.resume();
+  }
+
+  T await_resume()
+  {
+    auto& promise = coro_.promise();
+    if (promise.error) std::rethrow_exception(promise.error);
+    if constexpr (not std::is_void<T>::value) {
+      return std::move(*promise.value);
+    }
+  }
+
+private:
+  explicit Task(handle_type h) noexcept : coro_{h} {}
+
+  handle_type release() noexcept
+  { return std::exchange(coro_, nullptr); }
+
+  handle_type coro_;
+
+  friend promise_type;
+  friend void spawn(Task<void>&&);
+};
+
+template <typename T>
+inline Task<T> detail::Promise<T>::get_return_object() noexcept
+{ return Task<T>{Task<T>::handle_type::from_promise(*this)}; }
+
+inline Task<void> detail::Promise<void>::get_return_object() noexcept
+{ return Task<void>{Task<void>::handle_type::from_promise(*this)}; }
+
+/**
+ * Start @task and let it run to completion on its own. The frame is freed
+ * when it returns.
+ */
+inline void spawn(Task<void>&& task)
+{
+  auto h = task.release();
+  h.promise().detached = true;
+  h.resume();
+}
+
+/** Awaitable for a single callback, resumes the coroutine once */
+class Waiter {
+protected:
+  void wait(stdco::coroutine_handle<> h) noexcept
+  { waiting_ = h; }
+
+  void wake()
+  {
+    if (waiting_) resume_later(std::exchange(waiting_, nullptr));
+  }
+
+private:
+  stdco::coroutine_handle<> waiting_ = nullptr;
+};
+
+class Sleep {
+public:
+  explicit Sleep(Timers::duration_t time) noexcept : time_{time} {}
+
+  bool await_ready() const noexcept
+  { return time_.count() <= 0; }
+
+  void await_suspend(stdco::coroutine_handle<> h)
+  { Timers::oneshot(time_, [h] (int) { resume_later(h); }); }
+
+  void await_resume() const noexcept {}
+
+private:
+  Timers::duration_t time_;
+};
+
+class Read : Waiter {
+public:
+  explicit Read(net::Stream& stream) noexcept : stream_{stream} {}
+
+  bool await_ready()
+  { return stream_.next_size() > 0 or not stream_.is_readable(); }
+
+  void await_suspend(stdco::coroutine_handle<> h)
+  {
+    wait(h);
+    suspended_ = true;
+    stream_.on_data([this] { wake(); });
+    stream_.on_close([this] { wake(); });
+  }
+
+  net::Stream::buffer_t await_resume()
+  {
+    if (suspended_) {
+      stream_.on_data([] {});
+      stream_.on_close([] {});
+    }
+    if (stream_.next_size() == 0) return nullptr;
+    return stream_.read_next();
+  }
+
+private:
+  net::Stream& stream_;
+  bool suspended_ = false;
+};
+
+class Write : Waiter {
+public:
+  Write(net::Stream& stream, net::Stream::buffer_t buffer) noexcept
+    : stream_{stream}, buffer_{std::move(buffer)} {}
+
+  bool await_ready()
+  { return buffer_ == nullptr or buffer_->empty() or not stream_.is_writable(); }
+
+  void await_suspend(stdco::coroutine_handle<> h)
+  {
+    wait(h);
+    total_ = left_ = buffer_->size();
+    stream_.on_write({this, &Write::written});
+    stream_.on_close([this] { wake(); });
+    stream_.write(std::move(buffer_));
+  }
+
+  size_t await_resume()
+  {
+    if (total_ > 0) {
+      stream_.on_write([] (size_t) {});
+      stream_.on_close([] {});
+    }
+    return total_ - left_;
+  }
+
+private:
+  void written(size_t n)
+  {
+    left_ -= std::min(n, left_);
+    if (left_ == 0) wake();
+  }
+
+  net::Stream& stream_;
+  net::Stream::buffer_t buffer_;
+  size_t total_ = 0;
+  size_t left_  = 0;
+};
+
+class Connect : Waiter {
+public:
+  Connect(net::TCP& tcp, net::Socket remote) noexcept
+    : tcp_{tcp}, remote_{remote} {}
+
+  bool await_ready() const noexcept
+  { return false; }
+
+  void await_suspend(stdco::coroutine_handle<> h)
+  {
+    wait(h);
+    tcp_.connect(remote_, {this, &Connect::connected});
+  }
+
+  net::tcp::Connection_ptr await_resume() noexcept
+  { return std::move(conn_); }
+
+private:
+  void connected(net::tcp::Connection_ptr conn)
+  {
+    conn_ = std::move(conn);
+    wake();
+  }
+
+  net::TCP& tcp_;
+  net::Socket remote_;
+  net::tcp::Connection_ptr conn_ = nullptr;
+};
+
+/** The outcome of resolve() */
+struct Resolved {
+  net::dns::Response_ptr response;
+  std::string error;
+
+  /** The first IPv4 address, or 0 if there was none */
+  net::ip4::Addr address() const
+  { return response ? response->get_first_ipv4() : net::ip4::Addr{}; }
+
+  explicit operator bool() const noexcept
+  { return error.empty() and response != nullptr; }
+};
+
+class Resolve : Waiter {
+public:
+  Resolve(net::Inet& stack, std::string hostname, bool force) noexcept
+    : stack_{stack}, hostname_{std::move(hostname)}, force_{force} {}
+
+  bool await_ready() const noexcept
+  { return false; }
+
+  void await_suspend(stdco::coroutine_handle<> h)
+  {
+    wait(h);
+    stack_.resolve(hostname_, {this, &Resolve::resolved}, force_);
+  }
+
+  Resolved await_resume() noexcept
+  { return std::move(result_); }
+
+private:
+  void resolved(net::dns::Response_ptr response, const net::Error& err)
+  {
+    result_.response = std::move(response);
+    if (err) result_.error = err.to_string();
+    wake();
+  }
+
+  net::Inet&  stack_;
+  std::string hostname_;
+  bool        force_;
+  Resolved    result_;
+};
+
+/** Resume after @time */
+inline Sleep sleep(Timers::duration_t time)
+{ return Sleep{time}; }
+
+/** The next buffer from @stream, or nullptr when it can't be read anymore */
+inline Read read(net::Stream& stream)
+{ return Read{stream}; }
+
+/** Write @buffer to @stream, resumes with the number of bytes written */
+inline Write write(net::Stream& stream, net::Stream::buffer_t buffer)
+{ return Write{stream, std::move(buffer)}; }
+
+/** Connect to @remote, resumes with the connection or nullptr */
+inline Connect connect(net::TCP& tcp, net::Socket remote)
+{ return Connect{tcp, remote}; }
+
+/** Resolve @hostname with the DNS client of @stack */
+inline Resolve resolve(net::Inet& stack, std::string hostname, bool force = false)
+{ return Resolve{stack, std::move(hostname), force}; }
+
+} // coro
+
+#endif
@@ -19,6 +19,7 @@
 #ifndef KERNEL_CPUID_HPP
 #define KERNEL_CPUID_HPP
 
+#include <cstdint>
 #include <unordered_map>
 #include <vector>
 
@@ -123,6 +124,15 @@ namespace CPUID
   bool has_feature(Feature f);
 
   bool kvm_feature(unsigned mask) noexcept;
+
+  /** TSC frequency enumerated by leaf 0x15 or the hypervisor timing leaf
+      (0x40000010), or 0 if the CPU does not report it */
+  uint32_t tsc_khz() noexcept;
+  /** Processor base frequency from leaf 0x16, or 0 if not reported */
+  uint32_t base_khz() noexcept;
+  /** Frequency of the local APIC timer before its divider, from leaf 0x15
+      or the hypervisor timing leaf, or 0 if the CPU does not report it */
+  uint32_t lapic_khz() noexcept;
 } //< CPUID
 
 
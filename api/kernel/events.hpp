@@ -23,16 +23,35 @@
 #include <common>
 #include <deque>
 #include <smp>
+#include <util/mpsc_ring.hpp>
 
 #define IRQ_BASE    32
 //#define DEBUG_ALL_INTERRUPTS
 
+class Stat_histogram;
+
 class alignas(SMP_ALIGN) Events {
 public:
   typedef void (*intr_func) ();
   using event_callback = delegate<void()>;
 
   static const int  NUM_EVENTS = 128;
+  // deferred calls that fit without allocating an overflow node
+  static const int  DEFER_RING_SIZE = 256;
+  // deferred calls run per process_events(), by default
+  static const int  DEFER_BUDGET = 256;
+
+  struct Defer_stats {
+    // deferred calls that have been run
+    uint64_t run = 0;
+    // calls that did not fit in the ring, counted atomically by any CPU
+    uint64_t overflowed = 0;
+    // highest number of queued calls seen when processing
+    uint64_t max_depth = 0;
+    // cycles from defer() until the call was run
+    uint64_t latency_total = 0;
+    uint64_t latency_max = 0;
+  };
 
   uint8_t subscribe(event_callback);
   void subscribe(uint8_t evt, event_callback);
@@ -41,8 +60,30 @@ public:
   // register event for deferred processing
   inline void trigger_event(uint8_t evt);
 
-  // call event once, at a later time
-  void defer(event_callback);
+  /**
+   * Call @func once, at a later time, on the CPU owning this instance.
+   * Does not consume an event, and may be called from any CPU:
+   * the owning CPU is woken up if it is not the caller.
+  **/
+  void defer(event_callback func);
+
+  /**
+   * Limit how many times the handler for @evt is called per
+   * process_events(), so that a busy source (eg. RX) can't starve the rest.
+   * An event left over stays pending until the next round. 0 is unlimited.
+  **/
+  void set_budget(uint8_t evt, uint16_t budget);
+
+  /** Limit how many deferred calls are run per process_events(). 0 is unlimited */
+  void set_defer_budget(int budget) noexcept
+  { defer_budget = budget; }
+
+  /** Number of deferred calls waiting to be run */
+  size_t deferred_pending() const noexcept
+  { return defer_ring.size() + overflow_size; }
+
+  const Defer_stats& defer_stats() const noexcept
+  { return dstats; }
 
   /**
    * Get per-cpu instance
@@ -50,8 +91,12 @@ public:
   static Events& get();
   static Events& get(int cpu);
 
-  /** process all pending events */
-  void process_events();
+  /**
+   * Process pending events and deferred calls within their budgets.
+   * Returns true if work is left over, in which case the caller
+   * should not halt before calling again.
+  **/
+  bool process_events();
 
   /** array of received events */
   auto& get_received_array() const noexcept
@@ -76,9 +121,42 @@ private:
 
   std::array<bool, NUM_EVENTS>  event_subs;
   std::array<bool, NUM_EVENTS>  event_pend;
+  // cycle count when each pending event was first raised
+  std::array<uint64_t, NUM_EVENTS> raised_at {};
   // using deque because vector resize causes invalidation of ranged for
   // when something subscribes during processing of events
   std::deque<uint8_t> sublist;
+  std::array<uint16_t, NUM_EVENTS> budgets {};
+
+  struct deferred_t {
+    event_callback func;
+    uint64_t       posted = 0;
+  };
+  void run_deferred(int& budget);
+  void update_stats();
+  util::MPSC_ring<deferred_t, DEFER_RING_SIZE> defer_ring;
+  // used when the ring is full: an intrusive MPSC queue (Vyukov), so that
+  // pushing takes no lock and is safe from IRQ handlers on any CPU
+  struct overflow_node {
+    deferred_t                  entry;
+    std::atomic<overflow_node*> next {nullptr};
+  };
+  void push_overflow(overflow_node*) noexcept;
+  overflow_node* pop_overflow() noexcept;
+  overflow_node overflow_stub;
+  std::atomic<overflow_node*> overflow_head {&overflow_stub};
+  overflow_node* overflow_tail = &overflow_stub;
+  std::atomic<size_t> overflow_size {0};
+  int defer_budget = DEFER_BUDGET;
+  int cpu = 0;
+
+  Defer_stats dstats;
+  // statman mirrors, created by init_local()
+  uint64_t* stat_run     = nullptr;
+  uint64_t* stat_depth   = nullptr;
+  uint64_t* stat_latency = nullptr;
+  // cycles from an event being raised until its handler is called
+  Stat_histogram* stat_irq_latency = nullptr;
 };
 
 inline void Events::trigger_event(const uint8_t evt)
@@ -93,6 +171,8 @@ inline void Events::trigger_event(const uint8_t evt)
   }
 #endif
   if (LIKELY(evt < NUM_EVENTS)) {
+    if (event_pend[evt] == false)
+        raised_at[evt] = os::Arch::cpu_cycles();
     event_pend[evt] = true;
     // increment events received
     received_array[evt]++;
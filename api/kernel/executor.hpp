@@ -0,0 +1,129 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef KERNEL_EXECUTOR_HPP
+#define KERNEL_EXECUTOR_HPP
+
+#include <delegate>
+#include <memory>
+#include <stdexcept>
+
+template <typename T> class Future;
+
+/**
+ * Runs tasks on all CPUs without locks.
+ *
+ * Each CPU has a work-stealing deque for tasks that may run anywhere,
+ * and an inbox for tasks that must run on that CPU. Workers run from the
+ * deferred queue in Events, so they share the event loop with everything
+ * else, and idle CPUs steal from busy ones.
+ * Completions are always called on the submitting CPU.
+ */
+class Executor {
+public:
+  using task_func  = delegate<void()>;
+  using done_func  = delegate<void()>;
+  using range_func = delegate<void(size_t begin, size_t end)>;
+
+  // tasks each CPU can queue before falling back to Events::defer
+  static const int DEQUE_SIZE = 512;
+  static const int INBOX_SIZE = 256;
+  // tasks run before giving the event loop a turn
+  static const int RUN_BUDGET = 64;
+
+  struct Stats {
+    // tasks run on this CPU
+    uint64_t run = 0;
+    // of which were stolen from other CPUs
+    uint64_t stolen = 0;
+    // tasks that did not fit in a queue
+    uint64_t overflowed = 0;
+  };
+
+  /** Run @task on any CPU, and call @done on this CPU when it has returned */
+  static void submit(task_func task, done_func done = nullptr);
+
+  /** Run @task on @cpu, and call @done on this CPU when it has returned */
+  static void submit_to(int cpu, task_func task, done_func done = nullptr);
+
+  /**
+   * Split [begin, end) into chunks of at least @grain and run them on
+   * all CPUs. @done is called on this CPU when every chunk has returned.
+  **/
+  static void parallel_for(size_t begin, size_t end, range_func func,
+                           done_func done, size_t grain = 1);
+
+  /** Run @func on any CPU, and deliver its result on this CPU */
+  template <typename T>
+  static Future<T> async(delegate<T()> func);
+
+  static const Stats& stats(int cpu);
+};
+
+/**
+ * The result of Executor::async(), only to be used on the submitting CPU
+ */
+template <typename T>
+class Future {
+public:
+  using ready_func = delegate<void(T&)>;
+
+  bool ready() const noexcept
+  { return state_->ready; }
+
+  /** The result, throws std::logic_error if not ready */
+  T& get()
+  {
+    if (not ready()) throw std::logic_error("Future is not ready");
+    return state_->value;
+  }
+
+  /** Call @func with the result when ready, or now if it already is */
+  void then(ready_func func)
+  {
+    if (ready()) func(state_->value);
+    else state_->on_ready = std::move(func);
+  }
+
+private:
+  struct State {
+    delegate<T()> func;
+    T          value {};
+    bool       ready = false;
+    ready_func on_ready = nullptr;
+  };
+  std::shared_ptr<State> state_;
+  friend class Executor;
+};
+
+template <typename T>
+inline Future<T> Executor::async(delegate<T()> func)
+{
+  Future<T> future;
+  future.state_ = std::make_shared<typename Future<T>::State>();
+  future.state_->func = std::move(func);
+  auto state = future.state_;
+  submit(
+    [state] { state->value = state->func(); },
+    [state] {
+      state->ready = true;
+      if (state->on_ready) state->on_ready(state->value);
+    });
+  return future;
+}
+
+#endif
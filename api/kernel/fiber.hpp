@@ -21,6 +21,7 @@
 
 #include <cstdio>
 #include <delegate>
+#include <memory>
 #include <smp>
 
 #ifdef INCLUDEOS_SMP_ENABLE
@@ -28,6 +29,35 @@
 #endif
 
 class Fiber;
+class Fiber_scheduler;
+
+/**
+ * Stack allocator for fibers. Freed stacks are kept in per-CPU free lists
+ * of each size, so that creating a fiber does not go through the heap.
+ * Where paging allows it, each stack has an inaccessible guard page below
+ * it, so that an overflow faults instead of corrupting the heap.
+ */
+struct Fiber_stack {
+  static constexpr int guard_size = 4096;
+  // free stacks kept per size and CPU
+  static constexpr size_t pool_max = 256;
+
+  /** A stack with room for @size bytes, 16-byte aligned at the top */
+  static char* alloc(int size);
+  static void  free(char* stack, int size) noexcept;
+
+  /** Free stacks pooled on this CPU */
+  static size_t pooled() noexcept;
+  /** Stacks handed out and not yet freed, on all CPUs */
+  static size_t in_use() noexcept;
+  static bool   guard_pages() noexcept;
+
+  struct Deleter {
+    int size;
+    void operator() (char* stack) const noexcept
+    { Fiber_stack::free(stack, size); }
+  };
+};
 
 /** Bottom C++ stack frame for all fibers */
 extern "C" void fiber_jumpstarter(Fiber* f);
@@ -50,7 +80,7 @@ public:
   using R_t = void*;
   using P_t = void*;
   using init_func = void*(*)(void*);
-  using Stack_ptr = std::unique_ptr<char[]>;
+  using Stack_ptr = std::unique_ptr<char[], Fiber_stack::Deleter>;
 
   static constexpr int default_stack_size = 0x10000;
 
@@ -62,7 +92,7 @@ public:
   Fiber(int stack_size, R(*func)(P), void* arg)
     : id_{next_id_++},
       stack_size_{stack_size},
-      stack_{Stack_ptr(new char[16 + stack_size_], std::default_delete<char[]> ())},
+      stack_{make_stack(stack_size_)},
       stack_loc_{(void*)(uintptr_t(stack_.get() + stack_size_ ) &  ~ (uintptr_t)0xf)},
       type_return_{typeid(R)},
       type_param_{typeid(P)},
@@ -94,7 +124,7 @@ public:
   Fiber(int stack_size, void(*func)())
     : id_{next_id_++},
       stack_size_{stack_size},
-      stack_{Stack_ptr(new char[16 + stack_size_], std::default_delete<char[]> ())},
+      stack_{make_stack(stack_size_)},
       stack_loc_{(void*)(uintptr_t(stack_.get() + stack_size_ ) &  ~ (uintptr_t)0xf)},
       type_return_{typeid(void)},
       type_param_{typeid(void)},
@@ -115,7 +145,7 @@ public:
   Fiber(int stack_size, void(*func)(P), P par)
     : id_{next_id_++},
       stack_size_{stack_size},
-      stack_{Stack_ptr(new char[16 + stack_size_], std::default_delete<char[]> ())},
+      stack_{make_stack(stack_size_)},
       stack_loc_{(void*)(uintptr_t(stack_.get() + stack_size_ ) &  ~ (uintptr_t)0xf)},
       type_return_{typeid(void)},
       type_param_{typeid(P)},
@@ -136,7 +166,7 @@ public:
   Fiber(int stack_size, R(*func)())
     : id_{next_id_++},
       stack_size_{stack_size},
-      stack_{Stack_ptr(new char[16 + stack_size_], std::default_delete<char[]> ())},
+      stack_{make_stack(stack_size_)},
       stack_loc_{(void*)(uintptr_t(stack_.get() + stack_size_ ) &  ~ (uintptr_t)0xf)},
       type_return_{typeid(R)},
       type_param_{typeid(void)},
@@ -252,7 +282,11 @@ private:
   bool done_ { false };
   bool running_ { false };
 
+  static Stack_ptr make_stack(int size)
+  { return Stack_ptr(Fiber_stack::alloc(size), Fiber_stack::Deleter{size}); }
+
   friend void ::fiber_jumpstarter(Fiber* f);
+  friend class Fiber_scheduler;
 };
 
 #endif
@@ -0,0 +1,114 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef KERNEL_FIBER_AWAIT_HPP
+#define KERNEL_FIBER_AWAIT_HPP
+
+#include <kernel/fiber_scheduler.hpp>
+#include <kernel/timers.hpp>
+#include <hw/block_device.hpp>
+#include <net/stream.hpp>
+#include <common>
+
+/**
+ * Blocking calls for fibers run by Fiber_scheduler. Each one parks the
+ * calling fiber until its callback arrives, and the event loop carries on
+ * in the meantime, unlike os::block().
+ *
+ * The stream calls take over the read, write and close callbacks of the
+ * stream while waiting, and leave them empty afterwards.
+ */
+namespace fiber {
+
+  inline Fiber_scheduler::Task* self()
+  {
+    auto* task = Fiber_scheduler::current();
+    Expects(task != nullptr && "Not in a scheduled fiber");
+    return task;
+  }
+
+  /** Sleep for @time */
+  inline void sleep(Timers::duration_t time)
+  {
+    auto* task = self();
+    bool fired = false;
+    Timers::oneshot(time,
+      [task, &fired] (int) {
+        fired = true;
+        Fiber_scheduler::wake(task);
+      });
+    while (not fired) Fiber_scheduler::park();
+  }
+
+  /** The next buffer from @stream, or nullptr when it can't be read anymore */
+  inline net::Stream::buffer_t read(net::Stream& stream)
+  {
+    auto* task = self();
+    while (stream.next_size() == 0 and stream.is_readable())
+    {
+      stream.on_data([task] { Fiber_scheduler::wake(task); });
+      stream.on_close([task] { Fiber_scheduler::wake(task); });
+      Fiber_scheduler::park();
+    }
+    // the task is gone once the fiber returns, so don't leave it behind
+    stream.on_data([] {});
+    stream.on_close([] {});
+    if (stream.next_size() == 0) return nullptr;
+    return stream.read_next();
+  }
+
+  /** Write @buffer to @stream, returns the number of bytes written */
+  inline size_t write(net::Stream& stream, net::Stream::buffer_t buffer)
+  {
+    auto* task = self();
+    const size_t total = buffer->size();
+    size_t left = total;
+    stream.on_write(
+      [task, &left] (size_t n) {
+        left -= std::min(n, left);
+        Fiber_scheduler::wake(task);
+      });
+    stream.on_close([task] { Fiber_scheduler::wake(task); });
+    stream.write(std::move(buffer));
+
+    while (left > 0 and stream.is_writable()) Fiber_scheduler::park();
+    stream.on_write([] (size_t) {});
+    stream.on_close([] {});
+    return total - left;
+  }
+
+  /** Read @count blocks from @device, starting at @blk */
+  inline hw::Block_device::buffer_t read(hw::Block_device& device,
+                                         hw::Block_device::block_t blk,
+                                         size_t count = 1)
+  {
+    auto* task = self();
+    hw::Block_device::buffer_t result = nullptr;
+    bool done = false;
+    device.read(blk, count,
+      [task, &result, &done] (auto buffer) {
+        result = std::move(buffer);
+        done = true;
+        Fiber_scheduler::wake(task);
+      });
+    while (not done) Fiber_scheduler::park();
+    return result;
+  }
+
+} // fiber
+
+#endif
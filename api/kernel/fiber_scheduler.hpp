@@ -0,0 +1,71 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef KERNEL_FIBER_SCHEDULER_HPP
+#define KERNEL_FIBER_SCHEDULER_HPP
+
+#include <kernel/fiber.hpp>
+#include <delegate>
+
+/**
+ * Per-CPU cooperative scheduler for fibers.
+ *
+ * Runnable fibers are run from the deferred queue in Events, a round at a
+ * time, so they share the event loop with everything else. A fiber that
+ * waits for something parks itself, and whatever it waits for wakes it up
+ * from a callback. See kernel/fiber_await.hpp for waiting on timers,
+ * streams and block devices this way.
+ *
+ * Fibers never move between CPUs, and park() / wake() must be called on
+ * the CPU the fiber was spawned on.
+ */
+class Fiber_scheduler {
+public:
+  using task_func = delegate<void()>;
+  struct Task;
+
+  /** Run @func in a new fiber on this CPU, starting with the next round */
+  static Task* spawn(task_func func, int stack_size = Fiber::default_stack_size);
+
+  /** The scheduled fiber running now, or nullptr if not in one */
+  static Task* current() noexcept;
+
+  /**
+   * Suspend the current fiber until wake() is called for it.
+   * A wake() that came first makes park() return at once, so callers
+   * should check what they wait for in a loop.
+   */
+  static void park();
+
+  /** Make a parked fiber runnable */
+  static void wake(Task*);
+
+  /** Let the other runnable fibers have a turn */
+  static void yield();
+
+  /** Fibers spawned on this CPU that have not returned */
+  static size_t alive() noexcept;
+
+  /** Fibers on this CPU waiting for their turn */
+  static size_t runnable() noexcept;
+
+private:
+  static void schedule();
+  static void run_round();
+};
+
+#endif
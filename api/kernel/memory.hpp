@@ -23,6 +23,7 @@
 #include <util/bitops.hpp>
 #include <util/units.hpp>
 #include <util/alloc_buddy.hpp>
+#include <util/alloc_slab.hpp>
 #include <util/allocator.hpp>
 #include <sstream>
 #include <kernel/memmap.hpp>
@@ -42,6 +43,10 @@ namespace os::mem {
   /** Get default allocator for untyped allocations */
   Raw_allocator& raw_allocator();
 
+  /** Per-CPU size classes in front of the raw allocator, for small operator new */
+  using Slab_allocator = slab::Alloc<Raw_allocator>;
+  Slab_allocator& slab_allocator();
+
   template <typename T>
   using Typed_allocator = Allocator<T, Raw_allocator>;
 
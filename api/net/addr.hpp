@@ -136,3 +136,13 @@ private:
 static_assert(sizeof(Addr) == sizeof(ip6::Addr));
 
 }
+
+// Allow an address of either version to be used as key in e.g. std::unordered_map
+namespace std {
+  template<>
+  struct hash<net::Addr> {
+    size_t operator()(const net::Addr& addr) const {
+      return std::hash<net::ip6::Addr>{}(addr.v6());
+    }
+  };
+} //< namespace std
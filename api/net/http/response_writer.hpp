@@ -25,6 +25,8 @@
 
 #include <stdexcept>
 
+class Stat_histogram;
+
 namespace http {
 
   class Response_writer_error : public std::runtime_error {
@@ -105,12 +107,22 @@ namespace http {
 
     void end();
 
+    /**
+     * @brief      Record the time from now until the response is ended,
+     *             in microseconds, in @histogram.
+     *
+     * @param      histogram  The histogram
+     */
+    void measure(Stat_histogram& histogram);
+
     ~Response_writer();
 
   private:
     Response_ptr  response_;
     Connection&   connection_;
     bool          header_sent_{false};
+    Stat_histogram* service_time_{nullptr};
+    uint64_t      started_{0};
 
     /**
      * @brief      Preprocessing of a write
@@ -144,6 +144,7 @@ namespace http {
     Stat& stat_req_rx_;
     Stat& stat_req_bad_;
     Stat& stat_timeouts_;
+    Stat_histogram& stat_service_time_;
 
     /**
      * @brief      Close the given Server_connection
@@ -69,8 +69,8 @@ namespace net {
     using slaac_timeout_func = delegate<void(bool complete)>;
 
     using Port_utils  = std::map<net::Addr, Port_util>;
-    using Vip4_list = std::vector<ip4::Addr>;
-    using Vip6_list = std::vector<ip6::Addr>;
+    using Vip4_list = std::unordered_set<ip4::Addr>;
+    using Vip6_list = std::unordered_set<ip6::Addr>;
 
     std::string ifname() const
     { return nic_.device_name(); }
@@ -140,6 +140,9 @@ namespace net {
     /** Get the ICMP-object belonging to this stack */
     ICMPv6& icmp6() { return icmp6_; }
 
+    /** Get the ARP-object belonging to this stack */
+    Arp& arp() { return arp_; }
+
     /** Get the NDP-object belonging to this stack */
     Ndp& ndp() { return ndp_; }
 
@@ -369,6 +372,11 @@ namespace net {
       return nic_.transmit_queue_available();
     }
 
+    // register a callback for when a round of received packets is handed up
+    void on_rx_batch_done(delegate<void()> del) {
+      nic_.on_rx_batch_done(del);
+    }
+
     void force_start_send_queues();
 
     void move_to_this_cpu();
@@ -385,48 +393,61 @@ namespace net {
 
     /** Check if IP4 address is virtual loopback */
     bool is_loopback(ip4::Addr a) const
-    {
-      return a.is_loopback()
-        or std::find( vip4s_.begin(), vip4s_.end(), a) != vip4s_.end();
-    }
+    { return a.is_loopback() or vip4s_.count(a) > 0; }
 
     /** Check if IP6 address is virtual loopback */
     bool is_loopback(ip6::Addr a) const
-    {
-      return a.is_loopback()
-        or std::find( vip6s_.begin(), vip6s_.end(), a) != vip6s_.end();
-    }
+    { return a.is_loopback() or vip6s_.count(a) > 0; }
 
     /** add ip address as virtual loopback */
     void add_vip(ip4::Addr a)
     {
-      if (not is_loopback(a)) {
+      if (not a.is_loopback() and vip4s_.insert(a).second) {
         INFO("inet", "adding virtual ip address %s", a.to_string().c_str());
-        vip4s_.emplace_back(a);
       }
     }
 
     void add_vip(ip6::Addr a)
     {
-      if (not is_loopback(a)) {
+      if (not a.is_loopback() and vip6s_.insert(a).second) {
         INFO("inet", "adding virtual ip6 address %s", a.to_string().c_str());
-        vip6s_.emplace_back(a);
       }
     }
 
+    /** add many ip addresses as virtual loopback at once */
+    void add_vips(const std::vector<ip4::Addr>& addrs)
+    {
+      vip4s_.reserve(vip4s_.size() + addrs.size());
+      for (const auto& a : addrs)
+        if (not a.is_loopback()) vip4s_.insert(a);
+      INFO("inet", "%zu virtual ip addresses", vip4s_.size());
+    }
+
+    void add_vips(const std::vector<ip6::Addr>& addrs)
+    {
+      vip6s_.reserve(vip6s_.size() + addrs.size());
+      for (const auto& a : addrs)
+        if (not a.is_loopback()) vip6s_.insert(a);
+      INFO("inet", "%zu virtual ip6 addresses", vip6s_.size());
+    }
+
     /** Remove IP address as virtual loopback */
     void remove_vip(ip4::Addr a)
+    { vip4s_.erase(a); }
+
+    void remove_vip(ip6::Addr a)
+    { vip6s_.erase(a); }
+
+    void remove_vips(const std::vector<ip4::Addr>& addrs)
     {
-      auto it = std::find(vip4s_.begin(), vip4s_.end(), a);
-      if (it != vip4s_.end())
-        vip4s_.erase(it);
+      for (const auto& a : addrs)
+        vip4s_.erase(a);
     }
 
-    void remove_vip(ip6::Addr a)
+    void remove_vips(const std::vector<ip6::Addr>& addrs)
     {
-      auto it = std::find(vip6s_.begin(), vip6s_.end(), a);
-      if (it != vip6s_.end())
-        vip6s_.erase(it);
+      for (const auto& a : addrs)
+        vip6s_.erase(a);
     }
 
     ip4::Addr get_source_addr(ip4::Addr dest)
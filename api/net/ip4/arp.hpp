@@ -22,6 +22,7 @@
 #include <rtc>
 #include <unordered_map>
 #include <util/timer.hpp>
+#include <net/neighbour_cache.hpp>
 #include "ip4.hpp"
 
 using namespace std::chrono_literals;
@@ -34,6 +35,7 @@ namespace net {
 
   public:
     using Stack   = IP4::Stack;
+    using Cache   = Neighbour_cache<ip4::Addr>;
     using Route_checker = delegate<bool(ip4::Addr)>;
     using Arp_resolver = delegate<void(ip4::Addr)>;
 
@@ -86,55 +88,30 @@ namespace net {
     /** Downstream transmission. */
     void transmit(Packet_ptr, ip4::Addr next_hop);
 
-    /** Cache IP resolution. */
+    /** Cache IP resolution, confirming @ip as reachable. */
     void cache(ip4::Addr, MAC::Addr);
 
+    /** The ARP cache */
+    const Cache& neighbours() const noexcept
+    { return cache_; }
+
     /** Flush the ARP cache. RFC-2.3.2.1 */
     void flush_cache()
     { cache_.clear(); };
 
-    /** Flush expired cache entries. RFC-2.3.2.1 */
+    /**
+     * Age the cache: probe the entries in use before they go stale,
+     * and flush the ones not answering or no longer used. RFC-2.3.2.1
+     */
     void flush_expired ();
 
+    /** Entries not used for this long are flushed */
     void set_cache_flush_interval(std::chrono::minutes m) {
-      flush_interval_ = m;
+      cache_.set_gc_time(std::chrono::seconds(m).count());
     }
 
   private:
 
-    /** ARP cache expires after cache_exp_sec_ seconds */
-    static constexpr uint16_t cache_exp_sec_ {60 * 5};
-
-    /** Cache entries are just MAC's and timestamps */
-    struct Cache_entry {
-      /** Map needs empty constructor (we have no emplace yet) */
-      Cache_entry() noexcept = default;
-
-      Cache_entry(MAC::Addr mac) noexcept
-      : mac_(mac), timestamp_(RTC::time_since_boot()) {}
-
-      Cache_entry(const Cache_entry& cpy) noexcept
-      : mac_(cpy.mac_), timestamp_(cpy.timestamp_) {}
-
-      void update() noexcept { timestamp_ = RTC::time_since_boot(); }
-
-      bool expired() const noexcept
-      { return RTC::time_since_boot() > timestamp_ + cache_exp_sec_; }
-
-      MAC::Addr mac() const noexcept
-      { return mac_; }
-
-      RTC::timestamp_t timestamp() const noexcept
-      { return timestamp_; }
-
-      RTC::timestamp_t expires() const noexcept
-      { return timestamp_ + cache_exp_sec_; }
-
-    private:
-      MAC::Addr mac_;
-      RTC::timestamp_t timestamp_;
-    }; //< struct Cache_entry
-
     struct Queue_entry {
       Packet_ptr pckt;
       int tries_remaining = arp_retries;
@@ -144,7 +121,6 @@ namespace net {
       {}
     };
 
-    using Cache       = std::unordered_map<ip4::Addr, Cache_entry>;
     using PacketQueue = std::unordered_map<ip4::Addr, Queue_entry>;
 
 
@@ -154,10 +130,10 @@ namespace net {
     uint32_t& replies_rx_;
     uint32_t& replies_tx_;
 
-    std::chrono::minutes flush_interval_ = 5min;
-
     Timer resolve_timer_ {{ *this, &Arp::resolve_waiting }};
     Timer flush_timer_ {{ *this, &Arp::flush_expired }};
+    // when flush_timer_ is set to go off, in seconds since boot
+    uint64_t flush_due_ = 0;
 
     Stack& inet_;
     Route_checker proxy_ = nullptr;
@@ -183,6 +159,12 @@ namespace net {
     /** Send an arp resolution request */
     void arp_resolve(ip4::Addr next_hop);
 
+    /** Age the cache at @due, unless it is already due before that */
+    void flush_at(uint64_t due, uint64_t now);
+
+    /** Send a unicast request to check that @ip is still at @mac */
+    void arp_probe(ip4::Addr ip, MAC::Addr mac);
+
     /**
      * Add a packet to waiting queue, to be sent when IP is resolved.
      *
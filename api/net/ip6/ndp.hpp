@@ -24,6 +24,7 @@
 #include <unordered_map>
 #include <deque>
 #include <util/timer.hpp>
+#include <net/neighbour_cache.hpp>
 #include "packet_icmp6.hpp"
 #include "packet_ndp.hpp"
 #include "stateful_addr.hpp"
@@ -67,14 +68,8 @@ namespace net {
     static const uint32_t NEIGH_UPDATE_ISROUTER          = 0x40000000;
     static const uint32_t NEIGH_UPDATE_ADMIN             = 0x80000000;
 
-    enum class NeighbourStates : uint8_t {
-      INCOMPLETE,
-      REACHABLE,
-      STALE,
-      DELAY,
-      PROBE,
-      FAIL
-    };
+    using NeighbourStates = Neighbour_state;
+    using Cache   = Neighbour_cache<ip6::Addr>;
     using Stack   = IP6::Stack;
     using Route_checker = delegate<bool(ip6::Addr)>;
     using Ndp_resolver = delegate<void(ip6::Addr)>;
@@ -94,7 +89,7 @@ namespace net {
     void receive_redirect(icmp6::Packet& req);
 
     /** Send out NDP packet */
-    void send_neighbour_solicitation(ip6::Addr target);
+    void send_neighbour_solicitation(ip6::Addr target, MAC::Addr mac = MAC::EMPTY);
     void send_neighbour_advertisement(icmp6::Packet& req);
     void send_router_solicitation();
     void send_router_solicitation(Autoconf_handler delg);
@@ -139,6 +134,10 @@ namespace net {
     /** Lookup for cache entry */
     bool lookup(ip6::Addr ip);
 
+    /** The neighbour cache */
+    const Cache& neighbours() const noexcept
+    { return neighbour_cache_; }
+
     /* Check for Neighbour Reachabilty periodically */
     void check_neighbour_reachability();
 
@@ -146,13 +145,17 @@ namespace net {
     void flush_cache()
     { neighbour_cache_.clear(); };
 
-    /** Flush expired entries */
+    /**
+     * Age the neighbour cache: probe the entries in use before they go
+     * stale, and flush the ones not answering or no longer used.
+     */
     void flush_expired_neighbours();
     void flush_expired_routers();
     void flush_expired_prefix();
 
     void set_neighbour_cache_flush_interval(std::chrono::minutes m) {
       flush_interval_ = m;
+      neighbour_cache_.set_gc_time(std::chrono::seconds(m).count());
     }
 
     // Delegate output to link layer
@@ -182,76 +185,6 @@ namespace net {
 
   private:
 
-    /** NDP cache expires after neighbour_cache_exp_sec_ seconds */
-    static constexpr uint16_t neighbour_cache_exp_sec_ {60 * 5};
-
-    /** Cache entries are just MAC's and timestamps */
-    struct Neighbour_Cache_entry {
-      /** Map needs empty constructor (we have no emplace yet) */
-      Neighbour_Cache_entry() noexcept = default;
-
-      Neighbour_Cache_entry(MAC::Addr mac, NeighbourStates state, uint32_t flags) noexcept
-      : mac_(mac), timestamp_(RTC::time_since_boot()), flags_(flags) {
-          set_state(state);
-      }
-
-      Neighbour_Cache_entry(const Neighbour_Cache_entry& cpy) noexcept
-      : mac_(cpy.mac_), state_(cpy.state_),
-        timestamp_(cpy.timestamp_), flags_(cpy.flags_) {}
-
-      void update() noexcept { timestamp_ = RTC::time_since_boot(); }
-
-      bool expired() const noexcept
-      { return RTC::time_since_boot() > timestamp_ + neighbour_cache_exp_sec_; }
-
-      MAC::Addr mac() const noexcept
-      { return mac_; }
-
-      RTC::timestamp_t timestamp() const noexcept
-      { return timestamp_; }
-
-      RTC::timestamp_t expires() const noexcept
-      { return timestamp_ + neighbour_cache_exp_sec_; }
-
-      void set_state(NeighbourStates state)
-      {
-         if (state <= NeighbourStates::FAIL) {
-           state_ = state;
-         }
-      }
-
-      void set_flags(uint32_t flags)
-      {
-          flags_ = flags;
-      }
-
-      std::string get_state_name()
-      {
-          switch(state_) {
-          case NeighbourStates::INCOMPLETE:
-              return "incomplete";
-          case NeighbourStates::REACHABLE:
-              return "reachable";
-          case NeighbourStates::STALE:
-              return "stale";
-          case  NeighbourStates::DELAY:
-              return "delay";
-          case NeighbourStates::PROBE:
-              return "probe";
-          case NeighbourStates::FAIL:
-              return "fail";
-          default:
-              return "uknown";
-          }
-      }
-
-    private:
-      MAC::Addr        mac_;
-      NeighbourStates  state_;
-      RTC::timestamp_t timestamp_;
-      uint32_t         flags_;
-    }; //< struct Neighbour_Cache_entry
-
     struct Destination_Cache_entry {
       Destination_Cache_entry(ip6::Addr next_hop)
         : next_hop_{next_hop} {}
@@ -277,7 +210,6 @@ namespace net {
       int tries_remaining = MAX_MULTICAST_SOLICIT;
     };
 
-    using Cache       = std::unordered_map<ip6::Addr, Neighbour_Cache_entry>;
     using DestCache   = std::unordered_map<ip6::Addr, Destination_Cache_entry>;
     using PacketQueue = std::unordered_map<ip6::Addr, Queue_entry>;
     using PrefixList  = std::deque<ip6::Stateful_addr>;
@@ -294,6 +226,8 @@ namespace net {
     Timer neighbour_reachability_timer_ {{ *this, &Ndp::check_neighbour_reachability }};
     Timer resolve_timer_ {{ *this, &Ndp::resolve_waiting }};
     Timer flush_neighbour_timer_ {{ *this, &Ndp::flush_expired_neighbours }};
+    // when flush_neighbour_timer_ is set to go off, in seconds since boot
+    uint64_t flush_neighbour_due_ = 0;
     Timer flush_prefix_timer_ {{ *this, &Ndp::flush_expired_prefix }};
     Timer flush_router_timer_ {{ *this, &Ndp::flush_expired_routers }};
 
@@ -335,6 +269,12 @@ namespace net {
     /** Send an ndp resolution request */
     void ndp_resolve(ip6::Addr next_hop);
 
+    /** Send a unicast solicitation to check that @ip is still at @mac */
+    void ndp_probe(ip6::Addr ip, MAC::Addr mac);
+
+    /** Age the neighbour cache at @due, unless it is already due before that */
+    void flush_neighbours_at(uint64_t due, uint64_t now);
+
     /**
      * Add a packet to waiting queue, to be sent when IP is resolved.
      */
@@ -0,0 +1,322 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef NET_NEIGHBOUR_CACHE_HPP
+#define NET_NEIGHBOUR_CACHE_HPP
+
+#include <hw/mac_addr.hpp>
+#include <util/delegate.hpp>
+#include <util/probe_table.hpp>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace net {
+
+/** Neighbour Unreachability Detection states [RFC 4861 7.3.2] */
+enum class Neighbour_state : uint8_t {
+  INCOMPLETE,
+  REACHABLE,
+  STALE,
+  PROBE
+};
+
+/**
+ * The link-layer addresses of the neighbours of an interface, shared by
+ * ARP and NDP.
+ *
+ * An entry is REACHABLE for reachable_time after it was last confirmed,
+ * and STALE after that; a stale entry is still used. Entries in use are
+ * probed with unicast requests before they go stale, so the next-hops
+ * in use are kept REACHABLE and never fall back to resolution while
+ * packets are flowing. An entry in PROBE is also still used, and is only
+ * dropped when it has been probed max_probes times without an answer.
+ * Entries not used for gc_time are dropped.
+ *
+ * A util::Probe_table over the entries themselves, so a lookup is a hash
+ * and a few adjacent slots. Marking an entry as used
+ * is a store on the entry; the time is taken when the table is aged, so
+ * there is no clock read on the transmit path. There is one table per
+ * interface, which lives on one CPU, so there is no locking.
+ *
+ * Time is in seconds.
+ */
+template <typename Addr>
+class Neighbour_cache {
+public:
+  using State         = Neighbour_state;
+  using Probe_handler = delegate<void(Addr, MAC::Addr)>;
+
+  // RFC 4861 10. Protocol Constants
+  static constexpr uint64_t reachable_time_default = 30;
+  static constexpr uint64_t retrans_time           = 1;
+  static constexpr uint8_t  max_probes             = 3;
+
+  struct Entry {
+    Addr      addr;
+    MAC::Addr mac;
+    State     state     = State::INCOMPLETE;
+    uint8_t   probes    = 0;
+    // used since last aged, and ever
+    bool      in_use    = false;
+    bool      was_used  = false;
+    // for the protocol, eg. the NDP router flag
+    uint32_t  flags     = 0;
+    uint64_t  confirmed = 0;
+    uint64_t  updated   = 0;
+    uint64_t  used      = 0;
+    uint64_t  probed    = 0;
+  };
+
+  explicit Neighbour_cache(const size_t capacity = 16)
+    : table_{capacity}
+  {}
+
+  /** The entry for @addr, or nullptr */
+  const Entry* find(const Addr& addr) const noexcept
+  {
+    const Slot* slot = lookup(addr, hash(addr));
+    return (slot != nullptr) ? &slot->value : nullptr;
+  }
+
+  /**
+   * @brief      The entry to transmit to @addr with, marked as in use,
+   *             or nullptr when @addr has to be resolved
+   */
+  const Entry* use(const Addr& addr) noexcept
+  {
+    Slot* slot = const_cast<Slot*>(lookup(addr, hash(addr)));
+    if (slot == nullptr or slot->value.state == State::INCOMPLETE)
+      return nullptr;
+    slot->value.in_use = true;
+    return &slot->value;
+  }
+
+  /**
+   * @brief      Record that @addr is at @mac, and in @state
+   *
+   *             A REACHABLE state confirms the entry. A STALE one from
+   *             a message that does not confirm reachability leaves an
+   *             entry with the same address as it is [RFC 4861 7.2.5].
+   *
+   * @return     The entry
+   */
+  Entry& set(const Addr& addr, const MAC::Addr mac, const State state,
+             const uint64_t now)
+  {
+    const auto h = hash(addr);
+    Slot* slot = const_cast<Slot*>(lookup(addr, h));
+    if (slot == nullptr)
+    {
+      slot = &table_.insert(h);
+      slot->value = Entry{};
+      slot->value.addr = addr;
+      slot->value.mac  = mac;
+    }
+    auto& entry = slot->value;
+    entry.updated = now;
+
+    if (state == State::REACHABLE)
+    {
+      entry.mac       = mac;
+      entry.state     = State::REACHABLE;
+      entry.confirmed = now;
+      entry.probes    = 0;
+    }
+    else if (entry.mac != mac or entry.state == State::INCOMPLETE)
+    {
+      entry.mac    = mac;
+      entry.state  = state;
+      entry.probes = 0;
+    }
+    return entry;
+  }
+
+  /**
+   * @brief      Move the entries along in time: mark the ones used since
+   *             last time, probe the ones in use that are about to go
+   *             stale or have gone stale, and drop the ones that did not
+   *             answer or are no longer used. Meant to be called again
+   *             at the time it returns, or when a STALE entry is used.
+   *
+   *             @probe is called once the table is done, so it may
+   *             update the table.
+   *
+   * @return     When the next entry is due, or 0 if the table is empty
+   */
+  uint64_t age(const uint64_t now, Probe_handler probe)
+  {
+    expired_.clear();
+    probing_.clear();
+    uint64_t next = 0;
+    for (auto& slot : table_)
+    {
+      if (not slot.occupied)
+        continue;
+      auto& entry = slot.value;
+      if (entry.in_use) {
+        entry.used     = now;
+        entry.in_use   = false;
+        entry.was_used = true;
+      }
+      const bool active  = entry.was_used and now - entry.used < reachable_time_;
+      const auto last    = std::max(entry.used, entry.updated);
+      const auto dropped = expired_.size();
+
+      switch (entry.state)
+      {
+      case State::INCOMPLETE:
+        if (now - entry.updated >= max_probes * retrans_time)
+          expired_.push_back(entry.addr);
+        break;
+
+      case State::REACHABLE:
+        // start early enough to have every probe out before it goes stale
+        if (active and now - entry.confirmed + max_probes * retrans_time >= reachable_time_)
+          send_probe(entry, now);
+        else if (now - entry.confirmed >= reachable_time_)
+          entry.state = State::STALE;
+        break;
+
+      case State::STALE:
+        if (active)
+          send_probe(entry, now);
+        else if (now - last >= gc_time_)
+          expired_.push_back(entry.addr);
+        break;
+
+      case State::PROBE:
+        if (now - entry.probed < retrans_time)
+          break;
+        if (entry.probes < max_probes)
+          send_probe(entry, now);
+        else
+          expired_.push_back(entry.addr);
+        break;
+      }
+      if (expired_.size() == dropped) {
+        const auto when = due(entry, now);
+        next = (next == 0) ? when : std::min(next, when);
+      }
+    }
+    for (const auto& addr : expired_)
+      erase(addr);
+    for (const auto& p : probing_)
+      probe(p.first, p.second);
+    return next;
+  }
+
+  /**
+   * @brief      When @entry is next due to be aged: the time to start
+   *             probing it, for it to go stale, to be probed again or
+   *             to be dropped. Always after @now.
+   */
+  uint64_t due(const Entry& entry, const uint64_t now) const noexcept
+  {
+    uint64_t when = 0;
+    switch (entry.state)
+    {
+    case State::INCOMPLETE:
+      when = entry.updated + max_probes * retrans_time;
+      break;
+    case State::REACHABLE: {
+      const auto stale = entry.confirmed + reachable_time_;
+      const auto probe = stale - std::min(stale, max_probes * retrans_time);
+      when = (probe > now) ? probe : stale;
+      break;
+    }
+    case State::STALE:
+      when = std::max(entry.used, entry.updated) + gc_time_;
+      break;
+    case State::PROBE:
+      when = entry.probed + retrans_time;
+      break;
+    }
+    return std::max(when, now + retrans_time);
+  }
+
+  /**
+   * @brief      Erase the entry for @addr
+   *
+   * @return     The number of entries erased
+   */
+  size_t erase(const Addr& addr)
+  {
+    Slot* slot = const_cast<Slot*>(lookup(addr, hash(addr)));
+    if (slot == nullptr)
+      return 0;
+    table_.erase(slot);
+    return 1;
+  }
+
+  void clear()
+  { table_.clear(); }
+
+  size_t size() const noexcept
+  { return table_.size(); }
+
+  bool empty() const noexcept
+  { return table_.size() == 0; }
+
+  uint64_t reachable_time() const noexcept
+  { return reachable_time_; }
+
+  void set_reachable_time(const uint64_t secs) noexcept
+  { reachable_time_ = secs; }
+
+  /** How long an entry is kept after it was last used */
+  uint64_t gc_time() const noexcept
+  { return gc_time_; }
+
+  void set_gc_time(const uint64_t secs) noexcept
+  { gc_time_ = secs; }
+
+private:
+  using Table = util::Probe_table<Entry>;
+  using Slot  = typename Table::Slot;
+
+  Table    table_;
+  uint64_t reachable_time_ = reachable_time_default;
+  uint64_t gc_time_        = 60 * 5;
+  std::vector<Addr> expired_;
+  std::vector<std::pair<Addr, MAC::Addr>> probing_;
+
+  static uint32_t hash(const Addr& addr) noexcept
+  {
+    uint64_t h = std::hash<Addr>{}(addr) * 0x9e3779b97f4a7c15ull;
+    return static_cast<uint32_t>(h >> 32);
+  }
+
+  void send_probe(Entry& entry, const uint64_t now)
+  {
+    entry.state  = State::PROBE;
+    entry.probed = now;
+    entry.probes++;
+    probing_.emplace_back(entry.addr, entry.mac);
+  }
+
+  const Slot* lookup(const Addr& addr, const uint32_t h) const noexcept
+  {
+    return table_.lookup(h,
+      [&addr] (const Entry& entry) { return entry.addr == addr; });
+  }
+};
+
+} // < namespace net
+
+#endif // < NET_NEIGHBOUR_CACHE_HPP
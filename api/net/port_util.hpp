@@ -113,11 +113,37 @@ public:
   bool has_free_ephemeral() const noexcept
   { return eph_count < size(); }
 
+  /**
+   * @brief      Only generate ephemeral ports where
+   *             (port - DYNAMIC_START) % count == index, so that several
+   *             Port_util can hand out ports without overlapping,
+   *             and the owner of a port can be found from the port alone.
+   *
+   * @param[in]  index  The index of this partition
+   * @param[in]  count  The number of partitions
+   */
+  void set_ephemeral_partition(const uint16_t index, const uint16_t count)
+  {
+    Expects(count > 0 and index < count);
+    eph_stride = count;
+    eph_offset = index;
+    const int first = (ephemeral_ - port_ranges::DYNAMIC_START) / count * count + index;
+    ephemeral_ = port_ranges::DYNAMIC_START + ((first < size()) ? first : index);
+  }
+
+  /**
+   * @brief      The partition an ephemeral port belongs to
+   */
+  static uint16_t ephemeral_partition(const uint16_t port, const uint16_t count) noexcept
+  { return (port - port_ranges::DYNAMIC_START) % count; }
+
 private:
   Fixed_bitmap<65536> ports;
   MemBitmap           eph_view;
   uint16_t            ephemeral_;
   uint16_t            eph_count;
+  uint16_t            eph_stride = 1;
+  uint16_t            eph_offset = 0;
 
   /**
    * @brief      Increment the ephemeral port by one.
@@ -128,6 +154,11 @@ private:
     if(UNLIKELY( not has_free_ephemeral() ))
       throw Port_error{"All ephemeral ports are taken"};
 
+    if (eph_stride > 1) {
+      increment_partitioned();
+      return;
+    }
+
     ephemeral_++;
 
     // wrap around to dynamic start if end
@@ -143,6 +174,20 @@ private:
 
     Expects(not is_bound(ephemeral_) && "Generated ephemeral port is already bound. Please fix me!");
   }
+
+  void increment_partitioned()
+  {
+    // visit every port in the partition once before giving up
+    for (int i = 0; i < size() / eph_stride + 1; i++)
+    {
+      const int next = ephemeral_ + eph_stride;
+      ephemeral_ = (next > port_ranges::DYNAMIC_END)
+        ? port_ranges::DYNAMIC_START + eph_offset : next;
+
+      if (not is_bound(ephemeral_)) return;
+    }
+    throw Port_error{"All ephemeral ports in partition are taken"};
+  }
 }; // < class Port_util
 static_assert((port_ranges::DYNAMIC_START / 8) % sizeof(MemBitmap::word) == 0, "Must be word-sized multiple");
 static_assert(Port_util::size() % sizeof(MemBitmap::word) == 0, "Must be word-sized multiple");
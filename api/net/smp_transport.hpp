@@ -0,0 +1,123 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef NET_SMP_TRANSPORT_HPP
+#define NET_SMP_TRANSPORT_HPP
+
+#include <net/inet.hpp>
+#include <util/fixed_bitmap.hpp>
+#include <smp>
+#include <memory>
+
+namespace net {
+
+/**
+ * Runs a TCP and UDP instance on every CPU for one Inet, all sharing
+ * the address of the interface.
+ *
+ * Incoming IPv4 flows are steered by hash to the CPU owning them, so a
+ * connection lives its whole life on one CPU, and listeners are replicated
+ * on every CPU, like SO_REUSEPORT. Ephemeral ports are partitioned between
+ * the CPUs, so the replies to outgoing connections find their way back to
+ * the CPU that opened them. Other ports, eg. listeners made directly on the
+ * TCP of the Inet, stay on the CPU of the Inet. Outgoing packets are handed back to the CPU of
+ * the Inet, which owns the NIC.
+ *
+ * The stack should be configured before start(), since the ephemeral port
+ * partitions are set up for its current address. IPv6 stays on the CPU
+ * of the Inet.
+ */
+class Smp_transport {
+public:
+  using ready_func = delegate<void()>;
+
+  explicit Smp_transport(Inet& stack);
+
+  /**
+   * Create the per-CPU instances and begin steering.
+   * Must be called on the CPU of the Inet, and @ready is called there
+   * once every CPU is set up.
+   */
+  void start(ready_func ready);
+
+  bool is_ready() const noexcept
+  { return ready_; }
+
+  /** The TCP and UDP instances of the current CPU */
+  TCP& tcp();
+  UDP& udp();
+
+  TCP& tcp(int cpu);
+  UDP& udp(int cpu);
+
+  /**
+   * Listen on @port on every CPU. @cb is called on the CPU owning each
+   * new connection.
+   */
+  void listen(uint16_t port, TCP::ConnectCallback cb);
+
+  /**
+   * Bind @port on every CPU, and steer datagrams for it by flow.
+   * @on_bound is called on each CPU with the socket bound there.
+   */
+  void udp_bind(uint16_t port, delegate<void(udp::Socket&)> on_bound);
+
+  /** The index of the CPU owning a flow, among the active CPUs */
+  static int flow_index(ip4::Addr remote, uint16_t remote_port,
+                        uint16_t local_port, int count) noexcept;
+
+  /** Packets steered to @cpu */
+  uint64_t steered(int cpu) const
+  { return slots.at(cpu).steered; }
+
+private:
+  struct alignas(SMP_ALIGN) Slot {
+    TCP* tcp = nullptr;
+    UDP* udp = nullptr;
+    std::unique_ptr<TCP> own_tcp;
+    std::unique_ptr<UDP> own_udp;
+    TCP::Port_utils tcp_ports;
+    UDP::Port_utils udp_ports;
+    uint64_t steered = 0;
+    // datagrams were steered here in this round from the NIC
+    bool udp_round = false;
+  };
+
+  int  cpu_for(const PacketIP4& packet, bool is_udp) const noexcept;
+  void steer_tcp4(Packet_ptr);
+  void steer_udp4(Packet_ptr);
+  void transmit4(Packet_ptr);
+  void process_sendq(size_t packets);
+  void rx_batch_done();
+  void setup_cpu(int index);
+
+  Inet& stack_;
+  int   stack_cpu;
+  bool  ready_ = false;
+  // the active CPUs, in order of their index
+  std::vector<int> cpus;
+  SMP::Array<Slot> slots;
+  // the CPUs to deliver UDP batches on at the end of the round
+  std::vector<int> udp_round;
+  // TCP ports listened on and UDP ports bound on every CPU
+  Fixed_bitmap<65536> tcp_replicated;
+  Fixed_bitmap<65536> udp_replicated;
+};
+
+} // net
+
+#endif
@@ -46,11 +46,27 @@ namespace net {
     static constexpr uint16_t default_mss_v6  {1220};
     // the maximum amount of half-open connections per port (listener)
     static constexpr size_t   default_max_syn_backlog {64};
+    // answer SYNs with cookies when the backlog is full
+    static constexpr bool     default_syn_cookies {true};
+    // TCP Fast Open, data in the SYN for clients with a cookie
+    static constexpr bool     default_fast_open {false};
+    // Fast Open connections per listener taken before their handshake is done
+    static constexpr uint16_t default_max_fast_open_pending {16};
+    // destinations a client keeps Fast Open cookies for
+    static constexpr size_t   default_fast_open_cache {256};
+    // pace connections at a rate from cwnd and RTT
+    static constexpr bool     default_pacing {true};
+    // packets a flow sends each turn in the write queue
+    static constexpr size_t   default_fq_quantum {2};
     // clock granularity of the timestamp value clock
     static constexpr float   clock_granularity {0.0001};
 
     static const std::chrono::seconds       default_msl {30};
     static const std::chrono::milliseconds  default_dack_timeout {40};
+    // a grown receive buffer goes back to the minimum after this long idle
+    static const std::chrono::seconds       default_rcvbuf_idle {1};
+    // how far ahead of its pacing rate a connection may send
+    static const std::chrono::microseconds  default_pacing_slack {1000};
 
     using namespace util::literals;
     static constexpr size_t default_min_bufsize   {4_KiB};
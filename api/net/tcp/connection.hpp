@@ -26,6 +26,8 @@
 #include "tcp_errors.hpp"
 #include "write_queue.hpp"
 #include "sack.hpp"
+#include "rack.hpp"
+#include "rcvbuf_tuner.hpp"
 
 #include <net/socket.hpp>
 #include <delegate>
@@ -351,6 +353,16 @@ public:
   bool is_connected() const noexcept
   { return state_->is_connected(); }
 
+  /**
+   * @brief      Whether data went with the SYN, by TCP Fast Open [RFC 7413].
+   *             A listener hands such connections over before the
+   *             handshake is complete.
+   *
+   * @return     True if data went with the SYN
+   */
+  bool fast_opened() const noexcept
+  { return fast_open_; }
+
   /**
    * @brief      Determines if writable. (write is allowed)
    *
@@ -449,6 +461,46 @@ public:
   auto bytes_sacked() const noexcept
   { return bytes_sacked_; }
 
+  /**
+   * @brief      The receive buffer size, tuned to how fast
+   *             the data is drained.
+   *
+   * @return     The receive buffer size in bytes
+   */
+  size_t rcvbuf_size() const noexcept
+  { return rcvbuf_.space(); }
+
+  /**
+   * @brief      The memory held by this connection: the connection itself,
+   *             the receive buffers, what is queued for sending and the
+   *             loss recovery state.
+   *
+   * @return     Bytes held
+   */
+  size_t memory_usage() const;
+
+  /**
+   * @brief      Cap the rate the connection sends at. When TCP is pacing,
+   *             the lower of this and the rate from the congestion window
+   *             is used.
+   *
+   * @param[in]  rate  Bytes per second, or 0 for no cap
+   */
+  void set_max_pacing_rate(uint64_t rate) noexcept
+  { max_pacing_rate_ = rate; }
+
+  uint64_t max_pacing_rate() const noexcept
+  { return max_pacing_rate_; }
+
+  /**
+   * @brief      The rate the connection is paced at right now:
+   *             twice cwnd per RTT in slow start, 1.2 times after,
+   *             capped by the max pacing rate.
+   *
+   * @return     Bytes per second, or 0 if not paced
+   */
+  uint64_t pacing_rate() const;
+
 
   /**
    * @brief      Interface for one of the many states a Connection can have.
@@ -679,6 +731,9 @@ private:
   /** Time Wait / DACK timeout timer */
   Timer timewait_dack_timer;
 
+  /** RACK reordering / tail loss probe timer */
+  Timer rack_timer;
+
   Recv_window_getter recv_wnd_getter;
 
   seq_t fin_seq_ = 0;
@@ -701,6 +756,29 @@ private:
   bool sack_perm = false;
   size_t bytes_sacked_ = 0;
 
+  /** Sender side SACK [RFC 6675] and RACK-TLP [RFC 8985], made on first data sent */
+  using Sack_scoreboard = sack::Scoreboard<sack::Scoreboard_list<default_sack_entries>>;
+  std::unique_ptr<Sack_scoreboard> scoreboard_;
+  std::unique_ptr<Rack> rack_;
+  // is SACK based loss recovery
+  bool sack_recovery_ = false;
+  // rack_timer is waiting out the reordering window, not a tail loss probe
+  bool rack_reo_ = false;
+  // a tail loss probe is sent and not yet acknowledged
+  bool tlp_sent_ = false;
+
+  /** Receive buffer autotuning */
+  Rcvbuf_tuner rcvbuf_;
+
+  /** Pacing, on the RACK clock */
+  uint64_t max_pacing_rate_ = 0;
+  uint64_t next_send_ = 0;
+
+  /** Data went with the SYN, by TCP Fast Open [RFC 7413] */
+  bool fast_open_ = false;
+  /** The listener has room for one more Fast Open connection */
+  bool fast_open_room_ = true;
+
   /** Congestion control */
   // is fast recovery state
   bool fast_recovery_ = false;
@@ -923,6 +1001,23 @@ private:
 
   void trigger_window_update(os::mem::Pmr_resource& res);
 
+  /*
+    Create the read request, with buffers of the tuned size.
+  */
+  void create_read_request();
+
+  /*
+    In order data is drained to the read buffers, tune the buffer size.
+  */
+  void rcvbuf_drained(const Packet_view&, size_t bytes);
+
+  /*
+    Called by TCP while the buffer is grown; shrinks it and gives the
+    memory back if the connection has been idle.
+    Returns whether the buffer is still grown.
+  */
+  bool rcvbuf_idle(uint64_t now, uint64_t timeout);
+
   /**
    * @brief      Receive data from an incoming packet containing data.
    *
@@ -932,6 +1027,31 @@ private:
 
   void recv_out_of_order(const Packet_view& in);
 
+  /*
+    [RFC 7413] Ask for a Fast Open cookie in the SYN, or with a cookie
+    for the remote, put the first data in it.
+    Returns the bytes put in the SYN.
+  */
+  size_t fast_open_syn(Packet_view& syn);
+
+  /*
+    Keep a cookie from the SYN-ACK, and take back whatever of the data
+    in the SYN was not acknowledged, to be sent after the handshake.
+  */
+  void fast_open_synack(const Packet_view& in);
+
+  /*
+    A SYN to a listening connection. With a valid cookie the data is
+    acknowledged in the SYN-ACK, otherwise a cookie asked for is added.
+    Returns whether the data was taken.
+  */
+  bool fast_open_listen(const Packet_view& syn, Packet_view& synack);
+
+  /*
+    Receive the data in a SYN taken by Fast Open.
+  */
+  void recv_syn_data(const Packet_view& syn);
+
   /**
    * @brief      Acknowledge incoming data. This is done by:
    *             - Trying to send data if possible (can send)
@@ -1093,6 +1213,49 @@ private:
   bool reno_full_ack(seq_t ACK)
   { return static_cast<int32_t>(ACK - cb.recover) > 1; }
 
+  // SACK / RACK-TLP specifics //
+
+  /*
+    The clock RACK keeps time by, in microseconds.
+  */
+  static uint64_t rack_clock();
+
+  /*
+    Record a sent segment on the RACK list.
+  */
+  void rack_sent(seq_t start, seq_t end);
+
+  /*
+    Update the scoreboard and RACK from an incoming ACK and its SACK blocks.
+  */
+  void sack_update(const Packet_view&);
+
+  /**
+   * @brief      Detect losses and do loss recovery [RFC 6675]
+   *             when SACK is in use.
+   *
+   * @param[in]  <unnamed>    Incoming TCP segment
+   * @param[in]  bytes_acked  Bytes newly acknowledged, 0 if duplicate
+   *
+   * @return     True if the ACK was taken care of by loss recovery.
+   */
+  bool sack_recovery(const Packet_view&, uint32_t bytes_acked);
+
+  void sack_enter_recovery();
+
+  /*
+    Send lost segments, then new data, while the congestion window
+    is above the pipe [RFC 6675 NextSeg].
+  */
+  void sack_send();
+
+  /*
+    Arm the rack_timer for the reordering window, or else a tail loss probe.
+  */
+  void rack_arm(uint64_t reo_timeout);
+
+  void rack_timeout();
+
 
 
   /// --- STATE HANDLING --- ///
@@ -1109,6 +1272,11 @@ private:
   */
   void retransmit();
 
+  /*
+    Retransmit (at most SMSS of) the data from @seq, returns the bytes sent.
+  */
+  size_t retransmit(seq_t seq, uint32_t len);
+
   /**
    * @brief      Take an RTT measurment from an incoming packet.
    *             Uses timestamp if timestamp options are in use,
@@ -1157,16 +1325,12 @@ private:
   */
   void rtx_timeout();
 
-  /** Start the timewait timeout for 2*MSL */
+  /**
+   * Hand the flow over to the TIME-WAIT table of the host for 2*MSL.
+   * The state must then return CLOSED, closing the connection.
+   */
   void timewait_start();
 
-  /** Restart the timewait timer if active */
-  void timewait_restart();
-
-  /** When timewait timer times out */
-  void timewait_timeout()
-  { signal_close(); }
-
   /** Whether to use Delayed ACK or not */
   bool use_dack() const noexcept;
 
@@ -157,6 +157,9 @@ public:
     return "SYN-RCV";
   };
 
+  virtual bool is_writable() const override
+  { return true; }
+
 private:
   inline SynReceived() {};
 };
@@ -0,0 +1,177 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef NET_TCP_DEMUX_TABLE_HPP
+#define NET_TCP_DEMUX_TABLE_HPP
+
+#include <net/socket.hpp>
+#include <util/probe_table.hpp>
+#include <memory>
+
+namespace net {
+namespace tcp {
+
+/**
+ * Connections by 4-tuple, for demultiplexing incoming segments.
+ *
+ * A util::Probe_table of slots holding the hash and the owning pointer,
+ * so a lookup touches the slots and then only the object it finds; the
+ * tuple is compared on the object itself, through T::local() and
+ * T::remote(). Lookups hand out plain pointers, without touching the
+ * reference count.
+ *
+ * There is one table per TCP instance, which lives on one CPU, so there
+ * is no locking.
+ */
+template <typename T>
+class Demux_table {
+public:
+  using Tuple   = std::pair<Socket, Socket>;
+  using Ptr     = std::shared_ptr<T>;
+  using Table   = util::Probe_table<Ptr>;
+  using Slot    = typename Table::Slot;
+
+  class const_iterator {
+  public:
+    const_iterator(const Slot* it, const Slot* end) noexcept
+      : it_{it}, end_{end}
+    { skip(); }
+
+    const Ptr& operator*() const noexcept
+    { return it_->value; }
+
+    const Ptr* operator->() const noexcept
+    { return &it_->value; }
+
+    const_iterator& operator++() noexcept
+    { ++it_; skip(); return *this; }
+
+    bool operator==(const const_iterator& other) const noexcept
+    { return it_ == other.it_; }
+
+    bool operator!=(const const_iterator& other) const noexcept
+    { return it_ != other.it_; }
+
+  private:
+    const Slot* it_;
+    const Slot* end_;
+
+    void skip() noexcept
+    { while (it_ != end_ and not it_->occupied) ++it_; }
+  };
+
+  explicit Demux_table(const uint64_t seed = 0, const size_t capacity = 16)
+    : table_{capacity}, seed_{seed}
+  {}
+
+  /**
+   * @brief      The hash of a 4-tuple, mixing both addresses and ports
+   *             with the seed of the table.
+   */
+  uint32_t hash(const Tuple& tuple) const noexcept
+  {
+    const auto& l = tuple.first.address().v6();
+    const auto& r = tuple.second.address().v6();
+    uint64_t h = seed_;
+    h ^= (l.i64[0] ^ rotl(l.i64[1], 17)) * 0x9e3779b97f4a7c15ull;
+    h ^= (r.i64[0] ^ rotl(r.i64[1], 31)) * 0xc2b2ae3d27d4eb4full;
+    h ^= (uint64_t(tuple.first.port()) << 16 | tuple.second.port()) * 0x165667b19e3779f9ull;
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 32;
+    return static_cast<uint32_t>(h);
+  }
+
+  /** The entry for @tuple, or nullptr */
+  T* find(const Tuple& tuple) const noexcept
+  {
+    const Slot* slot = lookup(tuple, hash(tuple));
+    return (slot != nullptr) ? slot->value.get() : nullptr;
+  }
+
+  /** The owning pointer of the entry for @tuple, or nullptr */
+  const Ptr* find_shared(const Tuple& tuple) const noexcept
+  {
+    const Slot* slot = lookup(tuple, hash(tuple));
+    return (slot != nullptr) ? &slot->value : nullptr;
+  }
+
+  /**
+   * @brief      Insert @ptr for @tuple, unless there is one already
+   *
+   * @return     The entry for @tuple, and whether it was inserted
+   */
+  std::pair<Ptr*, bool> insert(const Tuple& tuple, Ptr ptr)
+  {
+    const auto h = hash(tuple);
+    if (const Slot* slot = lookup(tuple, h))
+      return {const_cast<Ptr*>(&slot->value), false};
+    Slot& slot = table_.insert(h);
+    slot.value = std::move(ptr);
+    return {&slot.value, true};
+  }
+
+  /**
+   * @brief      Erase the entry for @tuple
+   *
+   * @return     The number of entries erased
+   */
+  size_t erase(const Tuple& tuple)
+  {
+    Slot* slot = const_cast<Slot*>(lookup(tuple, hash(tuple)));
+    if (slot == nullptr)
+      return 0;
+    // released when the table is consistent again
+    Ptr erased = table_.erase(slot);
+    return 1;
+  }
+
+  size_t size() const noexcept
+  { return table_.size(); }
+
+  bool empty() const noexcept
+  { return table_.size() == 0; }
+
+  size_t capacity() const noexcept
+  { return table_.capacity(); }
+
+  const_iterator begin() const noexcept
+  { return {table_.begin(), table_.end()}; }
+
+  const_iterator end() const noexcept
+  { return {table_.end(), table_.end()}; }
+
+private:
+  Table    table_;
+  uint64_t seed_;
+
+  static uint64_t rotl(const uint64_t x, const int b) noexcept
+  { return (x << b) | (x >> (64 - b)); }
+
+  const Slot* lookup(const Tuple& tuple, const uint32_t h) const noexcept
+  {
+    return table_.lookup(h,
+      [&tuple] (const Ptr& ptr) {
+        return ptr->local() == tuple.first and ptr->remote() == tuple.second;
+      });
+  }
+};
+
+} // < namespace tcp
+} // < namespace net
+
+#endif // < NET_TCP_DEMUX_TABLE_HPP
@@ -0,0 +1,131 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef NET_TCP_FAST_OPEN_CACHE_HPP
+#define NET_TCP_FAST_OPEN_CACHE_HPP
+
+#include <net/addr.hpp>
+#include <array>
+#include <cstring>
+#include <unordered_map>
+
+namespace net {
+namespace tcp {
+
+/**
+ * The TCP Fast Open cookies [RFC 7413] a client has been given, by the
+ * server IP address they were given for [RFC 7413 4.1], along with the
+ * MSS of the server, so the next connection there, to any port, can
+ * carry data in the SYN.
+ *
+ * A destination where a SYN with data had to be retransmitted is marked,
+ * and no more data goes in the SYN there, as something on the path may
+ * be dropping such SYNs [RFC 7413 4.1.3].
+ *
+ * When full, an entry is dropped to make room for a new one.
+ */
+class Fast_open_cache {
+public:
+  // larger cookies do not fit in a SYN with the other options
+  static constexpr uint8_t max_cookie = 12;
+
+  struct Entry {
+    std::array<uint8_t, max_cookie> cookie {};
+    uint8_t  length   = 0;
+    uint16_t mss      = 0;
+    bool     syn_loss = false;
+  };
+
+  explicit Fast_open_cache(const size_t limit) noexcept
+    : limit_{limit}
+  {}
+
+  /** The entry for @dst, or nullptr */
+  const Entry* get(const Addr& dst) const
+  {
+    auto it = entries_.find(dst);
+    return (it != entries_.end()) ? &it->second : nullptr;
+  }
+
+  /** Whether a SYN to @dst may carry data */
+  bool usable(const Addr& dst) const
+  {
+    const auto* entry = get(dst);
+    return entry != nullptr and entry->length > 0 and not entry->syn_loss;
+  }
+
+  /**
+   * @brief      Keep the cookie from @dst, unless it is too large.
+   *
+   * @return     Whether it was kept
+   */
+  bool put(const Addr& dst, const uint8_t* cookie, const uint8_t length,
+           const uint16_t mss)
+  {
+    if (length > max_cookie or limit_ == 0)
+      return false;
+
+    auto it = entries_.find(dst);
+    if (it == entries_.end())
+    {
+      if (entries_.size() >= limit_)
+        entries_.erase(entries_.begin());
+      it = entries_.emplace(dst, Entry{}).first;
+    }
+    auto& entry = it->second;
+    std::memcpy(entry.cookie.data(), cookie, length);
+    entry.length = length;
+    entry.mss    = mss;
+    return true;
+  }
+
+  /** A SYN with data to @dst had to be retransmitted */
+  void syn_lost(const Addr& dst)
+  {
+    auto it = entries_.find(dst);
+    if (it != entries_.end())
+      it->second.syn_loss = true;
+  }
+
+  void erase(const Addr& dst)
+  { entries_.erase(dst); }
+
+  size_t size() const noexcept
+  { return entries_.size(); }
+
+  size_t limit() const noexcept
+  { return limit_; }
+
+  void set_limit(const size_t limit)
+  {
+    limit_ = limit;
+    while (entries_.size() > limit_)
+      entries_.erase(entries_.begin());
+  }
+
+  void clear()
+  { entries_.clear(); }
+
+private:
+  std::unordered_map<Addr, Entry> entries_;
+  size_t limit_;
+};
+
+} // < namespace tcp
+} // < namespace net
+
+#endif // < NET_TCP_FAST_OPEN_CACHE_HPP
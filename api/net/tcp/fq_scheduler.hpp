@@ -0,0 +1,124 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef NET_TCP_FQ_SCHEDULER_HPP
+#define NET_TCP_FQ_SCHEDULER_HPP
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace net {
+namespace tcp {
+
+/**
+ * Flows waiting for a chance to transmit, in the manner of the fq and
+ * fq_codel qdiscs: flows that start sending after being quiet are sparse,
+ * and served before the bulk flows, which take turns. A flow served gets
+ * a quantum of packets, and goes to the back of the bulk flows if it has
+ * more to send.
+ *
+ * Paced flows are throttled until the time of their next packet, and then
+ * released to the back of the bulk flows.
+ *
+ * Time is in microseconds.
+ */
+template <typename T>
+class Fq_scheduler {
+public:
+  using Ptr = std::shared_ptr<T>;
+
+  struct Entry {
+    Ptr      flow;
+    // when it was queued
+    uint64_t since  = 0;
+    bool     sparse = false;
+  };
+
+  /** Queue @flow to be served */
+  void enqueue(Ptr flow, const bool sparse, const uint64_t now)
+  { (sparse ? sparse_ : bulk_).push_back({std::move(flow), now, sparse}); }
+
+  /** The next flow to serve, sparse flows first */
+  Entry dequeue()
+  {
+    auto& q = (not sparse_.empty()) ? sparse_ : bulk_;
+    Entry entry = std::move(q.front());
+    q.pop_front();
+    return entry;
+  }
+
+  /** @flow is paced, and may not send before @when */
+  void throttle(Ptr flow, const uint64_t when)
+  {
+    throttled_.push_back({std::move(flow), when, false});
+    std::push_heap(throttled_.begin(), throttled_.end(), later);
+  }
+
+  /**
+   * @brief      Move the throttled flows whose time has come
+   *             to the back of the bulk flows
+   *
+   * @return     When the next throttled flow is due, or 0 if none
+   */
+  uint64_t release(const uint64_t now)
+  {
+    while (not throttled_.empty() and throttled_.front().since <= now)
+    {
+      std::pop_heap(throttled_.begin(), throttled_.end(), later);
+      bulk_.push_back({std::move(throttled_.back().flow), now, false});
+      throttled_.pop_back();
+    }
+    return next_release();
+  }
+
+  /** When the next throttled flow is due, or 0 if none */
+  uint64_t next_release() const noexcept
+  { return throttled_.empty() ? 0 : throttled_.front().since; }
+
+  /** Flows ready to be served */
+  size_t size() const noexcept
+  { return sparse_.size() + bulk_.size(); }
+
+  bool empty() const noexcept
+  { return sparse_.empty() and bulk_.empty(); }
+
+  size_t throttled() const noexcept
+  { return throttled_.size(); }
+
+  void clear()
+  {
+    sparse_.clear();
+    bulk_.clear();
+    throttled_.clear();
+  }
+
+private:
+  std::deque<Entry>  sparse_;
+  std::deque<Entry>  bulk_;
+  // min-heap on when the flow may send again
+  std::vector<Entry> throttled_;
+
+  static bool later(const Entry& a, const Entry& b) noexcept
+  { return a.since > b.since; }
+};
+
+} // < namespace tcp
+} // < namespace net
+
+#endif // < NET_TCP_FQ_SCHEDULER_HPP
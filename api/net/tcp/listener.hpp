@@ -20,6 +20,8 @@
 #define NET_TCP_LISTENER_HPP
 
 #include <deque>
+#include <unordered_map>
+#include <vector>
 
 #include "common.hpp"
 #include "connection.hpp"
@@ -38,7 +40,8 @@ public:
   using CloseCallback        = delegate<void(Listener&)>;
   using CleanupCallback      = Connection::CleanupCallback;
 
-  using SynQueue = std::deque<Connection_ptr>;
+  // half-open connections by remote socket
+  using SynQueue = std::unordered_map<Socket, Connection_ptr>;
 
 public:
 
@@ -93,16 +96,36 @@ private:
   TCP&      host_;
   Socket    local_;
   SynQueue  syn_queue_;
+  // half-open connections oldest first, with entries that have since
+  // left the SYN queue skipped when popped
+  std::deque<std::pair<Socket, const Connection*>> syn_order_;
+  // connections taken with Fast Open, until their handshake is done
+  std::vector<std::weak_ptr<Connection>> fast_open_pending_;
 
   AcceptCallback  on_accept_;
   ConnectCallback on_connect_;
   CloseCallback   _on_close_;
   const bool      ipv6_only_;
+  // time slot of the last SYN answered with a cookie
+  uint32_t        cookie_slot_ = 0;
+  bool            cookies_sent_ = false;
 
   bool default_on_accept(Socket);
 
   void segment_arrived(Packet_view&);
 
+  void send_syn_cookie(const Packet_view& syn);
+
+  bool accept_syn_cookie(Packet_view& ack);
+
+  Connection_ptr& add_half_open(Connection_ptr conn);
+
+  bool is_half_open(const std::pair<Socket, const Connection*>& entry) const;
+
+  void drop_oldest();
+
+  bool fast_open_room();
+
   void remove(const Connection*);
 
   void connected(Connection_ptr);
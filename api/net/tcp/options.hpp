@@ -37,6 +37,7 @@ struct Option {
     SACK_PERM = 0x04, // Sack-Permitted [RFC 2018]
     SACK      = 0x05, // Selective ACK [RFC 2018]
     TS        = 0x08, // Timestamp [RFC 7323] p. 11
+    TFO       = 0x22, // Fast Open Cookie [RFC 7413]
   };
 
   const uint8_t kind    {END};
@@ -54,6 +55,7 @@ struct Option {
       case SACK_PERM: return {"SACK Permitted"};
       case SACK: return {"SACK"};
       case TS: return {"Timestamp"};
+      case TFO: return {"Fast Open"};
       case NOP: return {"No-Operation"};
       case END: return {"End of list"};
       default: return {"Unknown Option"};
@@ -168,6 +170,33 @@ struct Option {
 
   } __attribute__((packed));
 
+  /**
+   * @brief      Fast Open Cookie [RFC 7413] p. 5
+   *             Without a cookie, it is a request for one.
+   */
+  struct opt_tfo {
+    static constexpr uint8_t min_cookie {4};
+    static constexpr uint8_t max_cookie {16};
+
+    const uint8_t   kind    {TFO};
+    const uint8_t   length;
+    uint8_t         cookie[0];
+
+    opt_tfo()
+      : length{2} {}
+
+    opt_tfo(const uint8_t* data, const uint8_t len)
+      : length{static_cast<uint8_t>(sizeof(kind) + sizeof(length) + len)}
+    {
+      Expects(len <= max_cookie);
+      std::memcpy(&cookie[0], data, len);
+    }
+
+    uint8_t cookie_length() const noexcept
+    { return length - sizeof(kind) - sizeof(length); }
+
+  } __attribute__((packed));
+
   struct opt_sack_align {
     const uint8_t padding[2] {NOP, NOP};
     const opt_sack  sack;
@@ -180,6 +180,10 @@ public:
 
   inline const Option::opt_ts* parse_ts_option() const noexcept;
 
+  inline const Option::opt_sack* parse_sack_option() const noexcept;
+
+  inline const Option::opt_tfo* parse_tfo_option() const noexcept;
+
   void set_ts_option(const Option::opt_ts* opt)
   { this->ts_opt = opt; }
 
@@ -363,6 +367,75 @@ inline const Option::opt_ts* Packet_v<Ptr_type>::parse_ts_option() const noexcep
   return nullptr;
 }
 
+template <typename Ptr_type>
+inline const Option::opt_sack* Packet_v<Ptr_type>::parse_sack_option() const noexcept
+{
+  auto* opt = this->tcp_options();
+  while(opt < (uint8_t*)this->tcp_data())
+  {
+    auto* option = (Option*)opt;
+    // zero-length options cause infinite loops (and are invalid)
+    if (option->length == 0) break;
+
+    switch(option->kind)
+    {
+      case Option::NOP: {
+        opt++;
+        break;
+      }
+
+      case Option::SACK: {
+        return reinterpret_cast<Option::opt_sack*>(option);
+      }
+
+      case Option::END: {
+        return nullptr;
+      }
+
+      default:
+        opt += option->length;
+    }
+  }
+
+  return nullptr;
+}
+
+template <typename Ptr_type>
+inline const Option::opt_tfo* Packet_v<Ptr_type>::parse_tfo_option() const noexcept
+{
+  auto* opt = this->tcp_options();
+  while(opt < (uint8_t*)this->tcp_data())
+  {
+    auto* option = (Option*)opt;
+    // zero-length options cause infinite loops (and are invalid)
+    if (option->length == 0) break;
+
+    switch(option->kind)
+    {
+      case Option::NOP: {
+        opt++;
+        break;
+      }
+
+      case Option::TFO: {
+        // a cookie, if any, is 4 to 16 bytes
+        if(option->length > sizeof(Option::opt_tfo) + Option::opt_tfo::max_cookie)
+          return nullptr;
+        return reinterpret_cast<Option::opt_tfo*>(option);
+      }
+
+      case Option::END: {
+        return nullptr;
+      }
+
+      default:
+        opt += option->length;
+    }
+  }
+
+  return nullptr;
+}
+
 template <typename Ptr_type>
 inline size_t Packet_v<Ptr_type>::fill(const uint8_t* buffer, size_t length)
 {
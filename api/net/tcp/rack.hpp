@@ -0,0 +1,254 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef NET_TCP_RACK_HPP
+#define NET_TCP_RACK_HPP
+
+#include "common.hpp"
+#include "sack.hpp"
+#include <algorithm>
+#include <deque>
+
+namespace net {
+namespace tcp {
+
+/**
+ * The outstanding segments of a connection, with when they were last sent
+ * and whether they are SACKed, lost or retransmitted.
+ *
+ * Gives time based loss detection, RACK [RFC 8985]: a segment is lost
+ * when a segment sent sufficiently later has been delivered. Segments can
+ * also be marked lost from outside, by the SACK scoreboard [RFC 6675] or
+ * on a retransmission timeout, and the pipe is counted from the marks.
+ *
+ * Time is in microseconds, on the clock given.
+ */
+class Rack {
+public:
+  struct Segment {
+    seq_t    start;
+    seq_t    end;
+    uint64_t xmit_ts;
+    bool     sacked = false;
+    // lost and not yet retransmitted
+    bool     lost   = false;
+    bool     rtx    = false;
+
+    Segment(seq_t s, seq_t e, uint64_t ts) noexcept
+      : start{s}, end{e}, xmit_ts{ts} {}
+
+    uint32_t size() const noexcept
+    { return end - start; }
+  };
+
+  /**
+   * @brief      A segment is sent. A segment starting below the end of what
+   *             is already outstanding is a retransmission.
+   */
+  void on_transmit(const seq_t start, const seq_t end, const uint64_t now)
+  {
+    if (segs_.empty() or (int32_t) (start - segs_.back().end) >= 0)
+    {
+      segs_.emplace_back(start, end, now);
+      return;
+    }
+    for (auto it = find(start); it != segs_.end() and (int32_t) (it->start - end) < 0; ++it)
+    {
+      // only part of it was sent again, eg. capped at a smaller SMSS,
+      // the rest keeps its marks so it's still resent when lost
+      if ((int32_t) (it->end - end) > 0)
+        it = split(it, end);
+      it->xmit_ts = now;
+      it->lost    = false;
+      it->rtx     = true;
+    }
+  }
+
+  /** The cumulative ACK has moved to @una */
+  void on_ack(const seq_t una, const uint64_t now)
+  {
+    while (not segs_.empty() and (int32_t) (segs_.front().end - una) <= 0)
+    {
+      if (not segs_.front().sacked)
+        delivered(segs_.front(), now);
+      segs_.pop_front();
+    }
+  }
+
+  /** A SACK block is received */
+  void on_sack(const sack::Block& blk, const uint64_t now)
+  {
+    for (auto it = find(blk.start); it != segs_.end(); ++it)
+    {
+      if ((int32_t) (it->end - blk.end) > 0) break;
+      if ((int32_t) (it->start - blk.start) < 0 or it->sacked) continue;
+      it->sacked = true;
+      it->lost   = false;
+      delivered(*it, now);
+    }
+  }
+
+  /**
+   * @brief      Mark segments lost by the time they were sent [RFC 8985 6.2]
+   *
+   * @param[in]  now          The time right now
+   * @param[in]  in_recovery  Whether the connection is in loss recovery
+   *
+   * @return     How long until a segment not yet lost may be, or 0 if none
+   */
+  uint64_t detect_loss(const uint64_t now, const bool in_recovery)
+  {
+    if (not has_delivered_)
+      return 0;
+    const uint64_t reo_wnd = reordering_window(in_recovery);
+    uint64_t timeout = 0;
+    for (auto& seg : segs_)
+    {
+      if (seg.sacked or seg.lost) continue;
+      // only what was sent before the most recently delivered segment
+      if (not sent_before(seg, xmit_ts_, end_seq_)) continue;
+      const int64_t remaining = seg.xmit_ts + rtt_ + reo_wnd - now;
+      if (remaining <= 0)
+        seg.lost = true;
+      else
+        timeout = std::max(timeout, (uint64_t) remaining);
+    }
+    return timeout;
+  }
+
+  /** Mark every segment matching @pred lost */
+  template <typename Pred>
+  void mark_lost(Pred pred)
+  {
+    for (auto& seg : segs_)
+      if (not seg.sacked and not seg.lost and pred(seg))
+        seg.lost = true;
+  }
+
+  /** On retransmission timeout, everything not SACKed is lost */
+  void mark_all_lost()
+  { mark_lost([] (const Segment&) { return true; }); }
+
+  /** The first segment waiting to be retransmitted, if any */
+  const Segment* next_lost() const noexcept
+  {
+    for (auto& seg : segs_)
+      if (seg.lost) return &seg;
+    return nullptr;
+  }
+
+  /** The last segment sent, if any */
+  const Segment* last() const noexcept
+  { return segs_.empty() ? nullptr : &segs_.back(); }
+
+  /**
+   * The data estimated to be in the network [RFC 6675 SetPipe]:
+   * everything outstanding that is neither SACKed nor lost.
+   */
+  uint32_t pipe() const noexcept
+  {
+    uint32_t bytes = 0;
+    for (auto& seg : segs_)
+      if (not seg.sacked and not seg.lost)
+        bytes += seg.size();
+    return bytes;
+  }
+
+  bool reordering_seen() const noexcept
+  { return reordering_seen_; }
+
+  uint64_t rtt() const noexcept
+  { return rtt_; }
+
+  uint64_t min_rtt() const noexcept
+  { return min_rtt_; }
+
+  size_t size() const noexcept
+  { return segs_.size(); }
+
+  bool empty() const noexcept
+  { return segs_.empty(); }
+
+  void clear()
+  { segs_.clear(); }
+
+private:
+  std::deque<Segment> segs_;
+  // the most recently sent segment that has been delivered
+  uint64_t xmit_ts_ = 0;
+  seq_t    end_seq_ = 0;
+  uint64_t rtt_     = 0;
+  uint64_t min_rtt_ = UINT64_MAX;
+  // the highest sequence delivered
+  seq_t    fack_    = 0;
+  bool     has_delivered_   = false;
+  bool     reordering_seen_ = false;
+
+  static bool sent_before(const Segment& seg, const uint64_t ts, const seq_t end) noexcept
+  { return seg.xmit_ts < ts or (seg.xmit_ts == ts and (int32_t) (seg.end - end) < 0); }
+
+  // split the segment at @it in two at @seq, returns the first part
+  std::deque<Segment>::iterator split(std::deque<Segment>::iterator it, const seq_t seq)
+  {
+    Segment first = *it;
+    first.end = seq;
+    it->start = seq;
+    return segs_.insert(it, first);
+  }
+
+  // the first segment ending above @seq
+  std::deque<Segment>::iterator find(const seq_t seq)
+  {
+    return std::partition_point(segs_.begin(), segs_.end(),
+      [seq] (const Segment& seg) { return (int32_t) (seg.end - seq) <= 0; });
+  }
+
+  uint64_t reordering_window(const bool in_recovery) const noexcept
+  {
+    if (not reordering_seen_ and in_recovery)
+      return 0;
+    return (min_rtt_ == UINT64_MAX) ? 0 : min_rtt_ / 4;
+  }
+
+  // [RFC 8985 6.2] Step 2 and 3
+  void delivered(const Segment& seg, const uint64_t now)
+  {
+    const uint64_t rtt = now - seg.xmit_ts;
+    // a retransmission acked too early is the original being acked
+    if (seg.rtx and rtt < min_rtt_)
+      return;
+    min_rtt_ = std::min(min_rtt_, rtt);
+
+    if (not has_delivered_ or not sent_before(seg, xmit_ts_, end_seq_))
+    {
+      rtt_     = rtt;
+      xmit_ts_ = seg.xmit_ts;
+      end_seq_ = seg.end;
+    }
+
+    if (not has_delivered_ or (int32_t) (seg.end - fack_) > 0)
+      fack_ = seg.end;
+    else if (not seg.rtx)
+      reordering_seen_ = true;
+    has_delivered_ = true;
+  }
+};
+
+} // < namespace tcp
+} // < namespace net
+
+#endif // < NET_TCP_RACK_HPP
@@ -0,0 +1,119 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef NET_TCP_RCVBUF_TUNER_HPP
+#define NET_TCP_RCVBUF_TUNER_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace net {
+namespace tcp {
+
+/**
+ * Receive buffer autotuning by dynamic right-sizing: the receive buffer,
+ * and with it the window offered, is sized to twice what was drained in
+ * the last round trip, so a sender still doubling its rate is not held
+ * back by the window. The size grows by powers of two between min and max,
+ * and goes back to min when the connection has been idle.
+ *
+ * Time is in microseconds.
+ */
+class Rcvbuf_tuner {
+public:
+  // round trips shorter than this are not told apart
+  static constexpr uint64_t min_rtt = 1000;
+
+  Rcvbuf_tuner(const size_t min, const size_t max) noexcept
+    : min_{min}, max_{std::max(min, max)}, space_{min}
+  {}
+
+  /** The buffer size for the connection right now */
+  size_t space() const noexcept
+  { return space_; }
+
+  /** Whether the buffer is grown above the minimum */
+  bool grown() const noexcept
+  { return space_ > min_; }
+
+  /** The receive side round trip time, or 0 if not yet known */
+  uint64_t rtt() const noexcept
+  { return rtt_; }
+
+  /**
+   * @brief      A round trip time sample. Samples taken while the sender
+   *             has been quiet say more about the sender than the path,
+   *             and are left out.
+   */
+  void rtt_sample(const uint64_t rtt, const uint64_t now) noexcept
+  {
+    if (rtt_ != 0 and now - last_ > rtt_)
+      return;
+    rtt_ = (rtt_ == 0) ? rtt : (rtt_ * 7 + rtt) / 8;
+  }
+
+  /**
+   * @brief      @bytes were drained from the buffer at @now
+   *
+   * @return     Whether the buffer grew
+   */
+  bool on_drain(const size_t bytes, const uint64_t now) noexcept
+  {
+    last_    = now;
+    copied_ += bytes;
+    if (now - start_ < std::max(rtt_, min_rtt))
+      return false;
+
+    const size_t target = 2 * copied_;
+    start_  = now;
+    copied_ = 0;
+    if (target <= space_ or space_ >= max_)
+      return false;
+    while (space_ < target and space_ < max_)
+      space_ <<= 1;
+    space_ = std::min(space_, max_);
+    return true;
+  }
+
+  /** Whether nothing has been drained for @timeout */
+  bool idle(const uint64_t now, const uint64_t timeout) const noexcept
+  { return now - last_ >= timeout; }
+
+  /** Go back to the minimum size */
+  void shrink(const uint64_t now) noexcept
+  {
+    space_  = min_;
+    start_  = now;
+    copied_ = 0;
+  }
+
+private:
+  size_t   min_;
+  size_t   max_;
+  size_t   space_;
+  size_t   copied_ = 0;
+  // start of the current measurement, and the last drain
+  uint64_t start_  = 0;
+  uint64_t last_   = 0;
+  uint64_t rtt_    = 0;
+};
+
+} // < namespace tcp
+} // < namespace net
+
+#endif // < NET_TCP_RCVBUF_TUNER_HPP
@@ -168,6 +168,21 @@ public:
   void set_start(const seq_t seq)
   { start = seq; }
 
+  /**
+   * @brief      Give the memory of the internal buffer back to the
+   *             allocator, when it is empty and only ours.
+   *             It is allocated again by the next insert.
+   */
+  void release();
+
+  /**
+   * @brief      The memory held by the internal buffer
+   *
+   * @return     Bytes allocated for the internal buffer
+   */
+  size_t memory_usage() const noexcept
+  { return buf->capacity(); }
+
   seq_t start_seq() const
   { return start; }
 
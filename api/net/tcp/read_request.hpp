@@ -21,7 +21,7 @@
 
 #include "read_buffer.hpp"
 #include <delegate>
-#include <deque>
+#include <vector>
 
 namespace net {
 namespace tcp {
@@ -29,8 +29,9 @@ namespace tcp {
 class Read_request {
 public:
   using Buffer_ptr = std::unique_ptr<Read_buffer>;
-  using Buffer_queue = std::deque<Buffer_ptr>;
-  using Ready_queue  = std::deque<buffer_t>;
+  // a few entries at most, and no memory when empty
+  using Buffer_queue = std::vector<Buffer_ptr>;
+  using Ready_queue  = std::vector<buffer_t>;
   using ReadCallback = delegate<void(buffer_t)>;
   using DataCallback = delegate<void()>;
   using Alloc        = os::mem::buffer::allocator_type;
@@ -53,6 +54,27 @@ public:
   size_t next_size();
   buffer_t read_next();
 
+  /**
+   * @brief      Set the capacity of the buffers to come, used for buffers
+   *             created or reset from now on. Must be a power of 2.
+   */
+  void set_bufsize(const size_t size);
+
+  size_t bufsize() const noexcept
+  { return bufsize_; }
+
+  /**
+   * @brief      The sequence space the buffers can take from @seq,
+   *             counting the buffers that can still be created.
+   */
+  size_t window(const seq_t seq) const;
+
+  /** Give the memory of empty buffers back to the allocator */
+  void release();
+
+  /** The memory held, including buffers ready but not yet read */
+  size_t memory_usage() const;
+
   const Read_buffer& front() const
   { return *buffers.front(); }
 
@@ -68,6 +90,7 @@ private:
   Buffer_queue buffers;
   Ready_queue complete_buffers;
   Alloc        alloc;
+  size_t       bufsize_;
 
   Read_buffer* get_buffer(const seq_t seq);
 
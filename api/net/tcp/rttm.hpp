@@ -84,12 +84,16 @@ struct RTTM {
    *             Expects the RTTM to be active (a measurment is started).
    *
    * @param[in]  ts    A timestamp in milliseconds
+   *
+   * @return     The RTT sample taken
    */
-  void stop(milliseconds ts)
+  milliseconds stop(milliseconds ts)
   {
     Expects(active());
-    rtt_measurement(time - ts);
+    const auto R = ts - time;
+    rtt_measurement(R);
     time = milliseconds::zero();
+    return R;
   }
 
   /**
@@ -321,6 +321,15 @@ public:
   void new_valid_ack(const seq_t seq)
   { return impl.new_valid_ack(seq); }
 
+  uint32_t sacked_bytes() const noexcept
+  { return impl.sacked_bytes(); }
+
+  bool is_lost(const seq_t seq, const uint32_t smss, const int dupthresh = 3) const noexcept
+  { return impl.is_lost(seq, smss, dupthresh); }
+
+  size_t size() const noexcept
+  { return impl.blocks.size(); }
+
   void clear()
   { impl.clear(); }
 
@@ -336,27 +345,24 @@ public:
 
   void recv_sack(const seq_t current, Block blk)
   {
-    auto connected = connects_to(blocks.begin(), blocks.end(), blk);
-
-    if (connected.end != blocks.end()) // Connectes to an end
+    // the same block is reported over and over, growing as more arrives,
+    // so merge with every block it overlaps or connects to
+    for (auto it = blocks.begin(); it != blocks.end(); )
     {
-      connected.end->end = blk.end;
-
-      // It also connects to a start, e.g. fills a hole
-      if (connected.start != blocks.end())
+      if ((blk.start - current) <= (it->end - current) and
+          (it->start - current) <= (blk.end - current))
       {
-        connected.end->end = connected.start->end;
-        blocks.erase(connected.start);
+        if ((it->start - current) < (blk.start - current))
+          blk.start = it->start;
+        if ((it->end - current) > (blk.end - current))
+          blk.end = it->end;
+        it = blocks.erase(it);
+      }
+      else {
+        ++it;
       }
     }
-    else if (connected.start != blocks.end()) // Connected only to an start
-    {
-      connected.start->start = blk.start;
-    }
-    else // No connection - new entry
-    {
-      insert(current, blk);
-    }
+    insert(current, blk);
   }
 
   void new_valid_ack(const seq_t seq)
@@ -370,6 +376,32 @@ public:
     }
   }
 
+  uint32_t sacked_bytes() const noexcept
+  {
+    uint32_t bytes = 0;
+    for (auto& block : blocks)
+      bytes += block.size();
+    return bytes;
+  }
+
+  /**
+   * IsLost [RFC 6675]: either DupThresh discontiguous blocks, or more
+   * than (DupThresh - 1) * SMSS bytes, have been SACKed above seq.
+   */
+  bool is_lost(const seq_t seq, const uint32_t smss, const int dupthresh) const noexcept
+  {
+    int      count = 0;
+    uint32_t bytes = 0;
+    for (auto& block : blocks)
+    {
+      if (static_cast<int32_t>(block.start - seq) <= 0)
+        continue;
+      count++;
+      bytes += block.size();
+    }
+    return count >= dupthresh or bytes > (dupthresh - 1) * smss;
+  }
+
   void clear()
   { blocks.clear(); }
 
@@ -0,0 +1,130 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef NET_TCP_SYN_COOKIES_HPP
+#define NET_TCP_SYN_COOKIES_HPP
+
+#include "common.hpp"
+#include <net/socket.hpp>
+#include <array>
+#include <optional>
+
+namespace net {
+namespace tcp {
+
+/**
+ * Stateless SYN cookies, used to answer SYNs when the SYN queue of a
+ * listener is full.
+ *
+ * The cookie is sent as the ISS of the SYN-ACK and comes back in the ACK
+ * completing the handshake, carrying what the connection needs from the
+ * SYN: the MSS rounded down to a table of common values, the window scale
+ * and whether SACK is permitted. It is authenticated with SipHash-2-4 over
+ * the flow, the sequence number of the SYN and a time slot, and is
+ * accepted in the slot it was made and the one after.
+ *
+ *   31-30 slot | 29-27 MSS | 26-23 window scale | 22 SACK | 21-0 MAC
+ *
+ * The same secret makes the TCP Fast Open cookies [RFC 7413], a MAC over
+ * the client address and a longer time period, which a client may present
+ * on any connection in the period it got it and the one after. Cookies
+ * expire with their period, as if the secret was rotated.
+ */
+class Syn_cookies {
+public:
+  static constexpr uint8_t  NO_WSCALE = 0xf;
+  static constexpr uint32_t SLOT_SECONDS = 64;
+  static constexpr uint32_t FAST_OPEN_SECONDS = 3600;
+  static constexpr std::array<uint16_t, 8> mss_table {{
+    536, 1220, 1300, 1360, 1400, 1440, 1460, 8960
+  }};
+
+  /** What a cookie remembers about the SYN */
+  struct Params {
+    uint16_t mss    = default_mss;
+    uint8_t  wscale = NO_WSCALE;
+    bool     sack   = false;
+  };
+
+  /** With a random secret */
+  Syn_cookies();
+
+  Syn_cookies(uint64_t key0, uint64_t key1) noexcept
+    : key0_{key0}, key1_{key1} {}
+
+  /**
+   * @brief      Make the cookie for a SYN
+   *
+   * @param[in]  local   The local socket (destination of the SYN)
+   * @param[in]  remote  The remote socket (source of the SYN)
+   * @param[in]  irs     The sequence number of the SYN
+   * @param[in]  params  The options of the SYN
+   * @param[in]  slot    The current time slot
+   *
+   * @return     The ISS to answer with
+   */
+  seq_t make(const Socket& local, const Socket& remote, seq_t irs,
+             Params params, uint32_t slot) const noexcept;
+
+  /**
+   * @brief      Check the cookie acknowledged by a handshake ACK,
+   *             that is ACK - 1, where IRS is SEQ - 1.
+   *
+   * @return     The options of the SYN, if the cookie is valid
+   */
+  std::optional<Params> check(const Socket& local, const Socket& remote,
+                              seq_t irs, seq_t cookie, uint32_t slot) const noexcept;
+
+  /**
+   * @brief      The Fast Open cookie for a client
+   *
+   * @param[in]  remote  The client address
+   * @param[in]  period  The current Fast Open period
+   *
+   * @return     The cookie, sent as it is in memory
+   */
+  uint64_t fast_open(const Address& remote, uint32_t period) const noexcept;
+
+  /**
+   * @brief      Check a Fast Open cookie presented by a client
+   *
+   * @return     Whether it was made for @remote, in @period or the one before
+   */
+  bool check_fast_open(const Address& remote, uint64_t cookie,
+                       uint32_t period) const noexcept;
+
+  /** The time slot right now */
+  static uint32_t current_slot();
+
+  /** The Fast Open period right now */
+  static uint32_t current_period();
+
+  /** The index in mss_table of the largest MSS not above @mss */
+  static int mss_index(uint16_t mss) noexcept;
+
+private:
+  uint32_t mac(const Socket& local, const Socket& remote,
+               seq_t irs, uint32_t slot, uint32_t fields) const noexcept;
+
+  uint64_t key0_;
+  uint64_t key1_;
+};
+
+} // < namespace tcp
+} // < namespace net
+
+#endif // < NET_TCP_SYN_COOKIES_HPP
@@ -21,18 +21,25 @@
 
 #include "common.hpp"
 #include "connection.hpp"
+#include "demux_table.hpp"
+#include "fast_open_cache.hpp"
+#include "fq_scheduler.hpp"
 #include "headers.hpp"
 #include "listener.hpp"
 #include "packet_view.hpp"
 #include "packet.hpp" // remove me, temp for NaCl
+#include "syn_cookies.hpp"
+#include "time_wait.hpp"
 
-#include <map>  // connections, listeners
-#include <deque>  // writeq
+#include <map>  // listeners
 #include <net/socket.hpp>
 #include <net/ip4/ip4.hpp>
 #include <util/bitops.hpp>
 #include <util/alloc_pmr.hpp>
 
+class Stat_counter;
+class Stat_histogram;
+
 namespace net {
 
   class Inet;
@@ -59,7 +66,7 @@ namespace net {
 
   private:
     using Listeners       = std::map<Socket, std::shared_ptr<tcp::Listener>>;
-    using Connections     = std::unordered_map<tcp::Connection::Tuple, tcp::Connection_ptr>;
+    using Connections     = tcp::Demux_table<tcp::Connection>;
 
   public:
     /////// TCP Stuff - Relevant to the protocol /////
@@ -73,6 +80,16 @@ namespace net {
      */
     TCP(IPStack&, bool smp = false);
 
+    /**
+     * @brief      Construct a TCP instance with its own port bookkeeping,
+     *             eg. one of several instances sharing an IPStack.
+     *
+     * @param      <unnamed>  The IPStack used by TCP
+     * @param      ports      The ports bound by this instance
+     * @param[in]  smp        True if not on the CPU of the IPStack
+     */
+    TCP(IPStack&, Port_utils& ports, bool smp);
+
     /**
      * @brief      Bind to a port to start listening for new connections
      *             Throws if unable to bind
@@ -169,6 +186,18 @@ namespace net {
      */
     tcp::Connection_ptr connect(Socket local, Socket remote);
 
+    /**
+     * @brief      Make an outgoing connection to a TCP remote (IP:port),
+     *             with the first data to send. With Fast Open in use and
+     *             a cookie from the remote, the data goes in the SYN.
+     *             May throw if no available ephemeral ports.
+     *
+     * @param[in]  remote    The remote socket
+     * @param[in]  data      The data to send
+     * @param[in]  callback  The connect callback
+     */
+    void connect(Socket remote, tcp::buffer_t data, ConnectCallback callback);
+
     /**
      * @brief      Insert a connection ptr into the TCP (used for restoring)
      *
@@ -371,6 +400,88 @@ namespace net {
     uint16_t max_syn_backlog() const
     { return max_syn_backlog_; }
 
+    /**
+     * @brief      Sets if SYNs are answered with SYN cookies when the
+     *             SYN queue of a listener is full. Otherwise the oldest
+     *             half-open connection is dropped to make room.
+     *
+     * @param[in]  active  Whether SYN cookies are in use
+     */
+    void set_syn_cookies(bool active) noexcept
+    { syn_cookies_enabled_ = active; }
+
+    /**
+     * @brief      Whether SYN cookies are in use
+     *
+     * @return     Whether SYN cookies are in use
+     */
+    bool uses_syn_cookies() const noexcept
+    { return syn_cookies_enabled_; }
+
+    /**
+     * @brief      Sets if TCP Fast Open [RFC 7413] is in use: listeners
+     *             hand out cookies and take data in the SYN from clients
+     *             with one, and connections ask for cookies, and send
+     *             data in the SYN to where they have one.
+     *
+     * @param[in]  active  Whether Fast Open is in use
+     */
+    void set_fast_open(bool active) noexcept
+    { fast_open_ = active; }
+
+    bool uses_fast_open() const noexcept
+    { return fast_open_; }
+
+    /**
+     * @brief      Sets how many connections a listener may have taken
+     *             data from with the SYN, and not yet completed the
+     *             handshake for [RFC 7413 5.1]. SYNs with data beyond
+     *             that go through a normal handshake.
+     *
+     * @param[in]  limit  The limit
+     */
+    void set_max_fast_open_pending(const uint16_t limit) noexcept
+    { max_fast_open_pending_ = limit; }
+
+    uint16_t max_fast_open_pending() const noexcept
+    { return max_fast_open_pending_; }
+
+    /**
+     * @brief      The Fast Open cookies this TCP has as a client
+     *
+     * @return     The cookie cache
+     */
+    tcp::Fast_open_cache& fast_open_cache() noexcept
+    { return fast_open_cache_; }
+
+    /**
+     * @brief      Sets if connections are paced at a rate from their
+     *             congestion window and RTT. A rate set on a connection
+     *             applies either way.
+     *
+     * @param[in]  active  Whether pacing is in use
+     */
+    void set_pacing(bool active) noexcept
+    { pacing_ = active; }
+
+    bool uses_pacing() const noexcept
+    { return pacing_; }
+
+    /**
+     * @brief      Sets how many packets a connection may send
+     *             each turn in the write queue.
+     *
+     * @param[in]  packets  The number of packets
+     */
+    void set_fq_quantum(size_t packets)
+    {
+      Expects(packets > 0);
+      fq_quantum_ = packets;
+    }
+
+    size_t fq_quantum() const noexcept
+    { return fq_quantum_; }
+
     /**
      * @brief      Set the maximum allowed memory
      *             to be used by this TCP.
@@ -458,6 +569,22 @@ namespace net {
     size_t writeq_size() const
     { return writeq.size(); }
 
+    /**
+     * @brief      Number of closed connections waiting out TIME-WAIT.
+     *
+     * @return     Number of flows in TIME-WAIT
+     */
+    size_t time_wait_size() const noexcept
+    { return time_wait_.size(); }
+
+    /**
+     * @brief      The memory held by the connections, and by the
+     *             table finding them.
+     *
+     * @return     Bytes held
+     */
+    size_t memory_usage() const;
+
     /**
      * @brief      The IP address for which the TCP instance is "connected".
      *
@@ -504,11 +631,10 @@ namespace net {
     **/
     tcp::Connection_ptr retrieve_shared(tcp::Connection* self)
     {
-      auto i = connections_.find(self->tuple());
-      if (i != connections_.end())
+      if (auto* ptr = connections_.find_shared(self->tuple()))
       {
-        //printf("Found connection: %p\n", i->second.get());
-        return i->second;
+        //printf("Found connection: %p\n", ptr->get());
+        return *ptr;
       }
 
       auto j = find_listener(self->local());
@@ -516,11 +642,10 @@ namespace net {
       {
         //printf("Found listener\n");
         auto& q = j->second->syn_queue_;
-        for (auto& conn : q) {
-          if (conn.get() == self) {
-            //printf("Found connection: %p\n", conn.get());
-            return conn;
-          }
+        auto it = q.find(self->remote());
+        if (it != q.end() and it->second.get() == self) {
+          //printf("Found connection: %p\n", it->second.get());
+          return it->second;
         }
       }
       throw std::out_of_range("Missing connection");
@@ -551,7 +676,10 @@ namespace net {
     downstream  network_layer_out6_;
 
     /** Internal writeq - connections gets queued in the wait for packets and recvs offer */
-    std::deque<tcp::Connection_ptr> writeq;
+    tcp::Fq_scheduler<tcp::Connection> writeq;
+    /** Releases paced connections from the writeq */
+    Timer pacing_timer_;
+    uint64_t pacing_due_ = 0;
 
     /* Settings */
 
@@ -569,16 +697,42 @@ namespace net {
     std::chrono::milliseconds dack_timeout_;
     /** Maximum SYN queue backlog */
     uint16_t                  max_syn_backlog_;
+    /** SYN cookies when the backlog is full */
+    bool                      syn_cookies_enabled_ = tcp::default_syn_cookies;
+    tcp::Syn_cookies          syn_cookies_;
+    /** TCP Fast Open, and the cookies as a client */
+    bool                      fast_open_  = tcp::default_fast_open;
+    uint16_t                  max_fast_open_pending_ = tcp::default_max_fast_open_pending;
+    tcp::Fast_open_cache      fast_open_cache_ {tcp::default_fast_open_cache};
+    /** Pacing, and the quantum of the writeq */
+    bool                      pacing_     = tcp::default_pacing;
+    size_t                    fq_quantum_ = tcp::default_fq_quantum;
+    /** Closed connections waiting out 2*MSL */
+    tcp::Time_wait_table      time_wait_;
+    Timer                     time_wait_timer_;
+    /** Looks for idle connections with grown receive buffers */
+    Timer                     rcvbuf_timer_;
 
     /** Stats */
-    uint64_t* bytes_rx_ = nullptr;
-    uint64_t* bytes_tx_ = nullptr;
-    uint64_t* packets_rx_ = nullptr;
-    uint64_t* packets_tx_ = nullptr;
-    uint64_t* incoming_connections_ = nullptr;
-    uint64_t* outgoing_connections_ = nullptr;
-    uint64_t* connection_attempts_ = nullptr;
-    uint32_t* packets_dropped_ = nullptr;
+    Stat_counter* bytes_rx_ = nullptr;
+    Stat_counter* bytes_tx_ = nullptr;
+    Stat_counter* packets_rx_ = nullptr;
+    Stat_counter* packets_tx_ = nullptr;
+    Stat_counter* incoming_connections_ = nullptr;
+    Stat_counter* outgoing_connections_ = nullptr;
+    Stat_counter* connection_attempts_ = nullptr;
+    Stat_counter* packets_dropped_ = nullptr;
+    Stat_counter* rto_timeouts_ = nullptr;
+    Stat_histogram* rtt_ms_ = nullptr;
+    Stat_counter* syn_cookies_sent_ = nullptr;
+    Stat_counter* syn_cookies_accepted_ = nullptr;
+    Stat_counter* fast_open_sent_ = nullptr;
+    Stat_counter* fast_open_accepted_ = nullptr;
+    Stat_counter* fast_open_failed_ = nullptr;
+    Stat_histogram* fq_delay_us_ = nullptr;
+    Stat_counter* fq_sparse_packets_ = nullptr;
+    Stat_counter* fq_bulk_packets_ = nullptr;
+    Stat_counter* fq_throttled_ = nullptr;
 
     bool smp_enabled = false;
     int  cpu_id = 0;
@@ -628,6 +782,14 @@ namespace net {
      */
     uint32_t get_ts_value() const;
 
+    /**
+     * @brief      Milliseconds since the timestamp value @ecr, negative
+     *             when the echo is ahead of the current timestamp value,
+     *             which is then no RTT measurement.
+     */
+    int32_t ts_elapsed(const uint32_t ecr) const
+    { return static_cast<int32_t>(get_ts_value() - ecr); }
+
     /**
      * @brief      The IP4 object bound to the IPStack
      *
@@ -732,10 +894,42 @@ namespace net {
      */
     void close_connection(const tcp::Connection* conn)
     {
-      unbind(conn->local());
+      // a flow in TIME-WAIT keeps the port until it expires
+      if (time_wait_.find(conn->tuple()) == nullptr)
+        unbind(conn->local());
       connections_.erase(conn->tuple());
     }
 
+    // TIME-WAIT HANDLING
+
+    /**
+     * @brief      Keep what is needed of a connection entering TIME-WAIT,
+     *             so that the connection itself can be closed right away.
+     *
+     * @param[in]  conn  The connection
+     */
+    void add_time_wait(const tcp::Connection& conn);
+
+    /**
+     * @brief      Handle a segment for a flow in TIME-WAIT.
+     *
+     * @return     False if the segment is a SYN taking over the flow,
+     *             which should be handled as a new connection attempt.
+     */
+    bool time_wait_arrived(tcp::Packet_view&, const tcp::Connection::Tuple&, tcp::Time_wait&);
+
+    void time_wait_timeout();
+
+    void time_wait_released(const tcp::Connection::Tuple&);
+
+    /**
+     * @brief      A connection has grown its receive buffer,
+     *             make sure it is shrunk again when idle.
+     */
+    void rcvbuf_grown();
+
+    void rcvbuf_timeout();
+
     /**
      * @brief      Closes and deletes a listener.
      *
@@ -770,6 +964,16 @@ namespace net {
      */
     void queue_offer(tcp::Connection&);
 
+    /**
+     * @brief      Hold back a paced connection until @when,
+     *             on the clock of Connection::rack_clock.
+     */
+    void throttle_offer(tcp::Connection&, uint64_t when);
+
+    void pacing_arm(uint64_t now);
+
+    void pacing_timeout();
+
     /**
      * @brief      Force the TCP to process the it's queue with the current amount of available packets.
      */
@@ -0,0 +1,130 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef NET_TCP_TIME_WAIT_HPP
+#define NET_TCP_TIME_WAIT_HPP
+
+#include "common.hpp"
+#include <net/socket.hpp>
+#include <delegate>
+#include <deque>
+#include <unordered_map>
+
+namespace net {
+namespace tcp {
+
+/**
+ * What is left of a connection in TIME-WAIT: enough to acknowledge a
+ * retransmitted FIN, and to tell whether a new SYN for the same flow
+ * may take it over before 2*MSL has passed.
+ */
+struct Time_wait {
+  seq_t    snd_nxt   = 0;
+  seq_t    rcv_nxt   = 0;
+  uint32_t ts_recent = 0;
+  uint16_t win       = 0;
+  bool     ts_ok     = false;
+  // milliseconds, on the clock given to Time_wait_table::expire
+  uint64_t expires   = 0;
+
+  /**
+   * @brief      Whether a SYN may reuse the flow right away. By timestamps
+   *             when both the old connection and the SYN have them
+   *             [RFC 6191], otherwise by sequence number [RFC 1122 4.2.2.13].
+   *
+   * @param[in]  seq     The sequence number of the SYN
+   * @param[in]  ts_val  The timestamp value of the SYN, if any
+   */
+  bool acceptable_syn(const seq_t seq, const uint32_t* ts_val) const noexcept
+  {
+    if (ts_ok and ts_val != nullptr)
+      return (int32_t) (*ts_val - ts_recent) > 0;
+    return (int32_t) (seq - rcv_nxt) > 0;
+  }
+};
+
+/**
+ * Flows in TIME-WAIT, which expire in the order they were added.
+ * Refreshing a record is done by moving its expiry forward.
+ */
+class Time_wait_table {
+public:
+  using Tuple        = std::pair<Socket, Socket>;
+  using release_func = delegate<void(const Tuple&)>;
+
+  /** Called for every record that expires or is erased */
+  void on_release(release_func func)
+  { on_release_ = std::move(func); }
+
+  Time_wait& insert(const Tuple& tuple, const Time_wait& record)
+  {
+    queue_.emplace_back(record.expires, tuple);
+    return records_[tuple] = record;
+  }
+
+  Time_wait* find(const Tuple& tuple) noexcept
+  {
+    auto it = records_.find(tuple);
+    return (it != records_.end()) ? &it->second : nullptr;
+  }
+
+  void erase(const Tuple& tuple)
+  {
+    if (records_.erase(tuple) and on_release_) on_release_(tuple);
+  }
+
+  /**
+   * @brief      Release the records expiring at or before @now
+   *
+   * @return     When the next record expires, or 0 if the table is empty
+   */
+  uint64_t expire(const uint64_t now)
+  {
+    while (not queue_.empty() and queue_.front().first <= now)
+    {
+      const Tuple tuple = queue_.front().second;
+      queue_.pop_front();
+      auto it = records_.find(tuple);
+      // erased already
+      if (it == records_.end()) continue;
+      // refreshed, wait some more
+      if (it->second.expires > now) {
+        queue_.emplace_back(it->second.expires, tuple);
+        continue;
+      }
+      records_.erase(it);
+      if (on_release_) on_release_(tuple);
+    }
+    return queue_.empty() ? 0 : queue_.front().first;
+  }
+
+  size_t size() const noexcept
+  { return records_.size(); }
+
+  bool empty() const noexcept
+  { return records_.empty(); }
+
+private:
+  std::unordered_map<Tuple, Time_wait> records_;
+  std::deque<std::pair<uint64_t, Tuple>> queue_;
+  release_func on_release_;
+};
+
+} // < namespace tcp
+} // < namespace net
+
+#endif // < NET_TCP_TIME_WAIT_HPP
@@ -21,7 +21,7 @@
 
 #include <debug>
 #include <delegate>
-#include <deque>
+#include <vector>
 #include "common.hpp"
 
 namespace net {
@@ -79,22 +79,22 @@ public:
     Can be in the middle/back of the queue due to unacknowledged buffers in front.
   */
   const WriteBuffer& nxt() const
-  { return q.at(current_); }
+  { return at(current_); }
 
   /*
     The oldest unacknowledged buffer. (Always in front)
   */
   const WriteBuffer& una() const
-  { return q.at(0); }
+  { return at(0); }
 
   void on_write(WriteCallback cb)
   { on_write_ = std::move(cb); }
 
   bool empty() const
-  { return q.empty(); }
+  { return head_ == q.size(); }
 
   size_t size() const
-  { return q.size(); }
+  { return q.size() - head_; }
 
   auto current() const
   { return current_; }
@@ -106,18 +106,25 @@ public:
   { return acked_; }
 
   const uint8_t* nxt_data() const
-  { return &q.at(current_)->at(offset_); }
+  { return &at(current_)->at(offset_); }
 
   auto nxt_rem() const
-  { return q.at(current_)->size() - offset_; }
+  { return at(current_)->size() - offset_; }
 
   auto bytes_total() const {
     uint32_t n = 0;
-    for(auto& it : q)
-      n += it->size();
+    for(auto i = head_; i < q.size(); ++i)
+      n += q[i]->size();
     return n;
   }
 
+  /*
+    The unacknowledged data @offset bytes from una(),
+    as far as it is contiguous in one buffer.
+    Used to retransmit from the middle of the queue.
+  */
+  std::pair<const uint8_t*, size_t> data_at(uint32_t offset) const;
+
   uint32_t bytes_remaining() const;
 
   uint32_t bytes_unacknowledged() const;
@@ -126,7 +133,12 @@ public:
     If the queue has more data to send
   */
   bool has_remaining_requests() const
-  { return current_ < q.size(); }
+  { return current_ < size(); }
+
+  /*
+    The memory held by the queue, including the buffers queued.
+  */
+  size_t memory_usage() const;
 
 
   // ???
@@ -134,7 +146,16 @@ public:
   int serialize_to(void*) const;
 
 private:
-  std::deque<WriteBuffer> q;
+  const WriteBuffer& at(size_t i) const
+  { return q.at(head_ + i); }
+
+  void pop_front();
+
+  /* Acknowledged buffers are released from the front by moving head_,
+     and the vector is compacted once most of it is behind head_ */
+  std::vector<WriteBuffer> q;
+  /* Index of una() in q */
+  uint32_t head_ = 0;
   /* Current element (index) */
   uint32_t current_;
   /* Offset of nxt() */
@@ -34,6 +34,18 @@ namespace net::udp
   using sendto_handler    = delegate<void()>;
   using error_handler     = delegate<void(const Error&)>;
 
+  /** A datagram received in a batch, or one of a batch to send */
+  struct Datagram {
+    // the source when received, the destination when sent
+    addr_t      addr;
+    port_t      port;
+    const char* data;
+    size_t      length;
+  };
+
+  // the most datagrams handed to a socket in one batch
+  static constexpr size_t rx_batch_max = 64;
+
   // temp
   using Packet_ptr = std::unique_ptr<PacketUDP, std::default_delete<net::Packet>>;
 
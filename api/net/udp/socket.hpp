@@ -38,6 +38,7 @@ namespace net::udp
     using multicast_group_addr = ip4::Addr;
 
     using recvfrom_handler  = delegate<void(addr_t, port_t, const char*, size_t)>;
+    using recvbatch_handler = delegate<void(const Datagram*, size_t)>;
 
     // constructors
     Socket(UDP&, net::Socket socket);
@@ -51,11 +52,31 @@ namespace net::udp
     void on_read(recvfrom_handler callback)
     { on_read_handler = callback; }
 
+    /**
+     * Take the datagrams in batches instead, one for each round of
+     * packets the NIC hands up, of at most rx_batch_max datagrams.
+     * The datagrams are only valid during the call.
+     */
+    void on_read_batch(recvbatch_handler callback)
+    { on_read_batch_handler = callback; }
+
     void sendto(addr_t destIP, port_t port,
                 const void* buffer, size_t length,
                 sendto_handler cb = nullptr,
                 error_handler ecb = nullptr);
 
+    /**
+     * Send @count datagrams at once, in the manner of sendmmsg.
+     * As many as the transmit queue has room for are made right away
+     * from the buffers given, and the rest are queued.
+     * @cb is called when the last one is sent.
+     *
+     * @return the number of datagrams sent right away
+     */
+    size_t sendmmsg(const Datagram* datagrams, size_t count,
+                    sendto_handler cb = nullptr,
+                    error_handler ecb = nullptr);
+
     void bcast(addr_t srcIP, port_t port,
                const void* buffer, size_t length,
                sendto_handler cb = nullptr,
@@ -83,6 +104,7 @@ namespace net::udp
     net::Socket  socket_;
     recvfrom_handler on_read_handler =
       [] (addr_t, port_t, const char*, size_t) {};
+    recvbatch_handler on_read_batch_handler = nullptr;
 
     const bool is_ipv6_;
     bool reuse_addr;
@@ -28,6 +28,7 @@
 #include <map>
 #include <cstring>
 #include <unordered_map>
+#include <vector>
 
 #include <net/packet.hpp>
 #include <net/socket.hpp>
@@ -52,7 +53,7 @@ namespace net {
     using Stack         = Inet;
     using Port_utils    = std::map<Addr, Port_util>;
 
-    using Sockets       = std::map<net::Socket, udp::Socket>;
+    using Sockets       = std::unordered_map<net::Socket, udp::Socket>;
 
     using sendto_handler = udp::sendto_handler;
     using error_handler  = udp::error_handler;
@@ -135,6 +136,13 @@ namespace net {
     //! construct this UDP module with @inet
     UDP(Stack& inet);
 
+    //! construct a UDP module with its own port bookkeeping, eg. one of
+    //! several sharing @inet. When @smp is set the module is not on the CPU
+    //! of @inet, and its owner must call process_sendq() when the transmit
+    //! queue becomes available, and deliver_batches() after each round of
+    //! received packets.
+    UDP(Stack& inet, Port_utils& ports, bool smp);
+
     Stack& stack()
     { return stack_; }
 
@@ -147,6 +155,9 @@ namespace net {
     // create and transmit @num packets from sendq
     void process_sendq(size_t num);
 
+    // hand the datagrams waiting for sockets reading in batches
+    void deliver_batches();
+
     uint16_t max_datagram_size() noexcept;
 
     class Port_in_use_exception : public UDP_error {
@@ -175,6 +186,13 @@ namespace net {
     // the async send queue
     std::deque<WriteBuffer> sendq;
 
+    // datagrams for sockets reading in batches, until the NIC is done
+    // with the round, and the ones being delivered
+    std::vector<udp::Packet_view_ptr> rx_pending_;
+    std::vector<udp::Packet_view_ptr> rx_work_;
+    std::vector<udp::Datagram>        rx_batch_;
+    bool                              rx_delivering_ = false;
+
     Sockets::iterator find(const Socket& socket)
     {
       Sockets::iterator it = sockets_.find(socket);
@@ -212,6 +230,15 @@ namespace net {
 
     void send_dest_unreachable(udp::Packet_view_ptr);
 
+    size_t sendmmsg(const net::Socket& src, const udp::Datagram* datagrams,
+                    size_t count, sendto_handler cb, error_handler ecb);
+
+    // make and transmit the packets of a datagram right away
+    void write(const net::Socket& src, const net::Socket& dst,
+               const char* data, size_t length);
+
+    void add_error_callback(const net::Socket& dst, error_handler ecb);
+
     udp::Packet_view_ptr create_packet(const net::Socket& src, const net::Socket& dst);
 
     friend class udp::Socket;
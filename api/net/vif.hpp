@@ -76,6 +76,9 @@ public:
   size_t transmit_queue_available() override
   { return link_.transmit_queue_available(); }
 
+  void on_rx_batch_done(delegate<void()> del) override
+  { link_.on_rx_batch_done(del); }
+
   void deactivate() override
   { }
 
@@ -0,0 +1,88 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef POSIX_EPOLL_FD_HPP
+#define POSIX_EPOLL_FD_HPP
+
+#include "fd.hpp"
+#include <sys/epoll.h>
+#include <deque>
+#include <unordered_map>
+
+/**
+ * @brief An epoll instance
+ * @details Watches a set of descriptors and keeps a queue of the ones that
+ * signaled readiness, so epoll_wait only looks at descriptors that had
+ * activity since the last call instead of scanning the whole interest list.
+ * Supports level-triggered (default), EPOLLET and EPOLLONESHOT semantics.
+ */
+class Epoll_FD : public FD {
+public:
+  explicit Epoll_FD(const int id)
+    : FD(id)
+  {}
+
+  int close() override;
+
+  /** An epoll instance is readable when it has pending events */
+  short poll_events() override;
+
+  bool is_epoll() override { return true; }
+
+  /** EPOLL_CTL_ADD, EPOLL_CTL_MOD or EPOLL_CTL_DEL @fd */
+  int ctl(int op, FD& fd, struct epoll_event* event);
+
+  /**
+   * Wait for events on the interest list, at most @maxevents.
+   * @return number of events stored in @events, or negative errno
+   */
+  int wait(struct epoll_event* events, int maxevents,
+           std::chrono::nanoseconds timeout);
+
+  /** Number of descriptors on the interest list */
+  size_t size() const noexcept
+  { return interest_.size(); }
+
+  ~Epoll_FD();
+
+private:
+  struct Interest {
+    FD*          fd;
+    uint32_t     events;
+    epoll_data_t data;
+    bool         queued   = false;
+    // EPOLLONESHOT fired, disabled until EPOLL_CTL_MOD
+    bool         disabled = false;
+  };
+  std::unordered_map<id_t, Interest> interest_;
+  // descriptors that may be ready, in the order they signaled
+  std::deque<id_t> ready_;
+
+  // how deep epoll instances may watch each other, as on Linux
+  static constexpr int max_nesting = 5;
+
+  void on_ready(FD&, bool closing);
+  // whether @target is on the interest list of this instance, or of the
+  // ones it watches, or the nesting is deeper than @depth
+  bool reaches(const Epoll_FD* target, int depth) const;
+  void enqueue(id_t, Interest&);
+  void forget(id_t);
+  uint32_t revents(const Interest&) const;
+  int  collect(struct epoll_event* events, int maxevents);
+};
+
+#endif
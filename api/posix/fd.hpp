@@ -22,8 +22,12 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <cstdarg>
 #include <errno.h>
+#include <chrono>
+#include <vector>
+#include <delegate>
 
 #define DEFAULT_ERR EPERM
 /**
@@ -77,29 +81,53 @@ public:
   // linux specific
   virtual long getdents(struct dirent*, unsigned int) { return -1; }
 
+  /** READINESS **/
+  /**
+   * Returns the poll events (POLLIN, POLLOUT, POLLHUP, POLLERR) currently
+   * ready on this descriptor. Regular files are always ready.
+   */
+  virtual short poll_events() { return POLLIN | POLLOUT; }
+
+  /** Called with the descriptor and true when the descriptor is being closed */
+  using on_ready_func = delegate<void(FD&, bool closing)>;
+  /** Get notified whenever readiness on this descriptor may have changed */
+  void add_watcher(const void* key, on_ready_func);
+  void remove_watcher(const void* key);
+
+  /** Descriptors call this from stack events that may change readiness */
+  void notify_ready();
+
+  /**
+   * Block until @ready returns true or @timeout expires (negative waits
+   * forever). @ready is only re-evaluated after some descriptor has
+   * signaled readiness, so waiting on many descriptors costs nothing
+   * while the stacks are idle.
+   * @return the last value returned by @ready
+   */
+  static bool wait_ready(delegate<bool()> ready, std::chrono::nanoseconds timeout);
+
   id_t get_id() const noexcept { return id_; }
 
   virtual bool is_file() { return false; }
   virtual bool is_socket() { return false; }
+  virtual bool is_epoll() { return false; }
 
   bool operator==(const FD& fd) const noexcept { return id_ == fd.id_; }
   bool operator!=(const FD& fd) const noexcept { return !(*this == fd); }
 
   bool is_blocking() const noexcept {
-    return this->non_blocking == 0;
+    return (this->fflags & O_NONBLOCK) == 0;
   }
 
-  virtual ~FD() {}
+  virtual ~FD();
 
 private:
   const id_t id_;
+  std::vector<std::pair<const void*, on_ready_func>> watchers_;
+  // incremented every time any descriptor signals readiness
+  static uint64_t ready_generation_;
   int dflags;
-  union {
-    struct {
-      int   non_blocking : 1;
-    };
-    int fflags;
-  };
+  int fflags;
 };
 
 #endif
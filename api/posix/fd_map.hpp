@@ -20,10 +20,11 @@
 #define INCLUDE_FD_MAP_HPP
 
 #include "fd.hpp"
-#include <map>
+#include <vector>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <cassert>
 #include <common>
 
 class FD_map_error : public std::runtime_error {
@@ -39,13 +40,20 @@ public:
 
 /**
  * @brief File descriptor map
- * @details Singleton class that manages all the file descriptors
+ * @details Singleton class that manages all the file descriptors.
+ * Descriptors live in a dense table indexed by id, with a bitmap of used
+ * slots. As POSIX requires, a new descriptor always gets the lowest free
+ * id. Lookups are a bounds check and an index, and never take a lock or
+ * allocate, so they are safe to do from every syscall.
  */
 class FD_map {
 public:
   using id_t = FD::id_t;
   using FD_ptr = std::unique_ptr<FD>;
 
+  /** Ids below this are reserved (stdin, stdout, stderr, ...) */
+  static constexpr id_t FIRST_ID = 5;
+
   static FD_map& instance()
   {
     static FD_map fd_map;
@@ -57,6 +65,10 @@ public:
 
   FD* get(const id_t id) const noexcept;
 
+  /** Number of open descriptors */
+  size_t size() const noexcept
+  { return count_; }
+
   template <typename T, typename... Args>
   static T& _open(Args&&... args)
   { return instance().open<T>(std::forward<Args>(args)...); }
@@ -68,46 +80,84 @@ public:
   { instance().internal_close(id); }
 
 private:
-  std::map<id_t, std::unique_ptr<FD>> map_;
-  id_t counter_ = 5;
+  static constexpr size_t BITS = 64;
+
+  // slot N holds descriptor FIRST_ID + N
+  std::vector<FD_ptr>   table_;
+  // one bit per slot, set when taken
+  std::vector<uint64_t> used_;
+  // every slot below this one is taken
+  size_t lowest_free_ = 0;
+  size_t count_ = 0;
 
   FD_map() = default;
 
-  auto& counter() noexcept
-  { return counter_; }
+  size_t allocate();
+  void   release(size_t slot) noexcept;
 
   void internal_close(const id_t id)
   {
-    auto erased = map_.erase(id);
-    assert(erased > 0);
+    const size_t slot = id - FIRST_ID;
+    assert(id >= FIRST_ID and slot < table_.size() and table_[slot] != nullptr);
+    // the destructor may open or close other descriptors
+    auto fd = std::move(table_[slot]);
+    release(slot);
   }
 };
 
+inline size_t FD_map::allocate()
+{
+  size_t word = lowest_free_ / BITS;
+  while (word < used_.size() and used_[word] == ~uint64_t(0))
+    word++;
+
+  if (word == used_.size()) {
+    used_.push_back(0);
+    table_.resize(used_.size() * BITS);
+  }
+
+  const size_t slot = word * BITS + __builtin_ctzll(~used_[word]);
+  used_[word] |= uint64_t(1) << (slot % BITS);
+  lowest_free_ = slot + 1;
+  count_++;
+  return slot;
+}
+
+inline void FD_map::release(size_t slot) noexcept
+{
+  used_[slot / BITS] &= ~(uint64_t(1) << (slot % BITS));
+  if (slot < lowest_free_)
+    lowest_free_ = slot;
+  count_--;
+}
+
 template <typename T, typename... Args>
 T& FD_map::open(Args&&... args)
 {
   static_assert(std::is_base_of<FD, T>::value,
     "Template argument is not a File Descriptor (FD)");
 
+  const auto slot = allocate();
+  const id_t id = FIRST_ID + slot;
 
-  const auto id = counter()++;
-
-  auto* fd = new T(id, std::forward<Args>(args)...);
-
-  auto res = map_.emplace(std::piecewise_construct,
-                          std::forward_as_tuple(id),
-                          std::forward_as_tuple(fd));
-
-  if(UNLIKELY(res.second == false))
-    throw FD_map_error{"Unable to open FD (map emplace failed)"};
+  T* fd = nullptr;
+  try {
+    fd = new T(id, std::forward<Args>(args)...);
+  }
+  catch (...) {
+    release(slot);
+    throw;
+  }
 
+  table_[slot].reset(fd);
   return *fd;
 }
 
 inline FD* FD_map::get(const id_t id) const noexcept
 {
-  if(auto it = map_.find(id); it != map_.end())
-    return it->second.get();
+  const size_t slot = id - FIRST_ID;
+  if (LIKELY(id >= FIRST_ID and slot < table_.size()))
+    return table_[slot].get();
 
   return nullptr;
 }
@@ -50,6 +50,8 @@ public:
 
   int     shutdown(int) override;
 
+  short   poll_events() override;
+
   bool is_listener() const noexcept {
     return ld != nullptr;
   }
@@ -70,7 +72,12 @@ private:
 
 struct TCP_FD_Conn
 {
+  // non-blocking sends fail with EAGAIN above this many unsent bytes
+  static constexpr uint32_t SENDQ_LIMIT = 64 * 1024;
+
   TCP_FD_Conn(net::tcp::Connection_ptr c);
+  // the callbacks on the connection point back at us
+  ~TCP_FD_Conn();
 
   void retrieve_buffer();
   void set_default_read();
@@ -79,19 +86,26 @@ struct TCP_FD_Conn
   ssize_t recv(void*, size_t, int fl);
   int     close();
   int     shutdown(int);
+  short   poll_events() const;
+
+  void notify()
+  { if (owner) owner->notify_ready(); }
 
   std::string to_string() const { return conn->to_string(); }
 
   net::tcp::Connection_ptr conn;
   net::tcp::buffer_t buffer;
   size_t buf_offset;
+  // the socket owning this connection, if any
+  TCP_FD* owner = nullptr;
   bool recv_disc = false;
+  bool refused = false;
 };
 
 struct TCP_FD_Listen
 {
-  TCP_FD_Listen(net::tcp::Listener& l)
-    : listener(l)
+  TCP_FD_Listen(TCP_FD& fd, net::tcp::Listener& l)
+    : owner(fd), listener(l)
   {}
 
   int close();
@@ -101,6 +115,7 @@ struct TCP_FD_Listen
 
   std::string to_string() const { return listener.to_string(); }
 
+  TCP_FD& owner;
   net::tcp::Listener& listener;
   std::deque<std::unique_ptr<TCP_FD_Conn>> connq;
 };
@@ -58,6 +58,8 @@ public:
   int     getsockopt(int, int, void *__restrict__, socklen_t *__restrict__) override;
   int     setsockopt(int, int, const void *, socklen_t) override;
 
+  short   poll_events() override;
+
   struct Message {
     Message(const in_addr_t addr, const in_port_t port, net::tcp::buffer_t buf)
       : buffer(std::move(buf))
@@ -35,6 +35,9 @@ public:
   ssize_t sendto(const void* buf, size_t, int fl,
                  const struct sockaddr* addr, socklen_t addrlen) override;
   int     close() override;
+
+  // unix sockets are send-only
+  short   poll_events() override { return POLLOUT; }
 private:
   Impl* impl = nullptr;
   const int type_; // it's probably gonna be necessary
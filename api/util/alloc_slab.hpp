@@ -0,0 +1,368 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef UTIL_ALLOC_SLAB_HPP
+#define UTIL_ALLOC_SLAB_HPP
+
+#include <common>
+#include <smp>
+#include <array>
+#include <new>
+
+namespace os::mem::slab {
+
+  using Size_t = size_t;
+
+  /** Statistics for one size class, summed over all CPUs */
+  struct Class_stats {
+    Size_t   size = 0;
+    // objects handed out and given back
+    uint64_t allocs = 0;
+    uint64_t frees  = 0;
+    // allocations served from the cache of the CPU, without locking
+    uint64_t cache_hits = 0;
+    // slabs held from the backend, and the bytes in them
+    Size_t   slabs = 0;
+    Size_t   slab_bytes = 0;
+    // slabs given back to the backend
+    Size_t   slabs_freed = 0;
+    // bytes asked for by live allocations
+    Size_t   requested = 0;
+
+    uint64_t in_use() const noexcept
+    { return allocs - frees; }
+
+    /** Bytes in slabs not holding a live object, including rounding up */
+    Size_t wasted() const noexcept
+    { return slab_bytes - requested; }
+
+    /** Wasted share of the slab bytes, 0.0 - 1.0 */
+    double fragmentation() const noexcept
+    { return slab_bytes ? double(wasted()) / slab_bytes : 0.0; }
+  };
+
+  /**
+   * Size class allocator for small objects, in front of a page allocator
+   * such as buddy::Alloc.
+   *
+   * Each CPU caches free objects per size class, so that most allocations
+   * and frees are a list push or pop without locks. When a cache runs dry
+   * it takes a batch from the shared pool of its class, which is refilled
+   * with whole slabs from the backend, and a cache that grows too big hands
+   * a batch back. The shared pool keeps the free objects on a list in each
+   * slab, so when every object of a slab is back the slab is given back to
+   * the backend right away, except for one per class.
+   *
+   * The backend is only called under @backend_lock, which must be held by
+   * anyone else using the same backend, as buddy::Alloc has no locking.
+   *
+   * Like the backend the size must be passed to deallocate, which is how
+   * the class is found without any header on the objects. The slab of an
+   * object is found by its address, so the backend must hand out blocks
+   * aligned to their size from addr_begin(), as buddy::Alloc does.
+   **/
+  template <typename Backend>
+  class Alloc {
+  public:
+    static constexpr Size_t min_size = 16;
+    static constexpr Size_t max_size = 2048;
+    static constexpr int    class_count = 14;
+    // objects per class a CPU keeps, and moves at a time to and from the shared pool
+    static constexpr int    cache_max = 64;
+    static constexpr int    batch = cache_max / 2;
+
+    static constexpr std::array<Size_t, class_count> class_sizes {{
+      16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048
+    }};
+
+    Alloc(Backend& backend, spinlock_t& backend_lock) noexcept
+      : backend_{backend}, backend_lock_{backend_lock},
+        origin_{uintptr_t(backend.addr_begin())} {}
+
+    /** With a backend no one else uses */
+    explicit Alloc(Backend& backend) noexcept
+      : Alloc(backend, own_lock_) {}
+
+    Alloc(const Alloc&) = delete;
+    Alloc& operator=(const Alloc&) = delete;
+
+    /** The size class for @size, or -1 if it's too big */
+    static constexpr int size_class(Size_t size) noexcept
+    {
+      if (size <= 64) return size ? (size - 1) / 16 : 0;
+      if (size > max_size) return -1;
+      // above 64 there are two classes per power of two, 1.5x and 2x
+      int cls = 4;
+      Size_t base = 64;
+      while (size > base * 2) {
+        base *= 2;
+        cls  += 2;
+      }
+      return (size <= base + base / 2) ? cls : cls + 1;
+    }
+
+    /** Bytes taken from the backend for each slab of a class */
+    static constexpr Size_t slab_size(int cls) noexcept
+    {
+      const Size_t want = class_sizes[cls] * 8;
+      Size_t size = 4096;
+      while (size < want) size *= 2;
+      return size;
+    }
+
+    /** Objects in each slab of a class, which ends with its Slab_info */
+    static constexpr Size_t slab_objects(int cls) noexcept
+    { return (slab_size(cls) - sizeof(Slab_info)) / class_sizes[cls]; }
+
+    void* allocate(Size_t size) noexcept
+    {
+      const int cls = size_class(size);
+      if (UNLIKELY(cls < 0)) return nullptr;
+      auto& cache = local()[cls];
+      if (cache.head == nullptr) {
+        if (UNLIKELY(not refill(cls, cache))) return nullptr;
+      }
+      else cache.hits++;
+
+      Object* obj = cache.head;
+      cache.head = obj->next;
+      cache.count--;
+      cache.allocs++;
+      cache.requested += size;
+      return obj;
+    }
+
+    void deallocate(void* ptr, Size_t size) noexcept
+    {
+      if (ptr == nullptr) return;
+      const int cls = size_class(size);
+      Expects(cls >= 0);
+      auto& cache = local()[cls];
+      auto* obj = static_cast<Object*>(ptr);
+      obj->next  = cache.head;
+      cache.head = obj;
+      cache.count++;
+      cache.frees++;
+      cache.requested -= size;
+      if (cache.count > cache_max) flush(cls, cache);
+    }
+
+    Class_stats stats(int cls) const noexcept
+    {
+      Class_stats st;
+      st.size       = class_sizes.at(cls);
+      st.slabs      = shared_[cls].slabs;
+      st.slabs_freed = shared_[cls].slabs_freed;
+      st.slab_bytes = st.slabs * slab_size(cls);
+      for (const auto& caches : caches_)
+      {
+        const auto& cache = caches[cls];
+        st.allocs     += cache.allocs;
+        st.frees      += cache.frees;
+        st.cache_hits += cache.hits;
+        st.requested  += cache.requested;
+      }
+      return st;
+    }
+
+    /** Bytes taken from the backend */
+    Size_t bytes_reserved() const noexcept
+    {
+      Size_t total = 0;
+      for (int cls = 0; cls < class_count; cls++)
+          total += shared_[cls].slabs * slab_size(cls);
+      return total;
+    }
+
+    /** Bytes asked for by live allocations */
+    Size_t bytes_requested() const noexcept
+    {
+      Size_t total = 0;
+      for (int cls = 0; cls < class_count; cls++)
+          total += stats(cls).requested;
+      return total;
+    }
+
+  private:
+    struct Object {
+      Object* next;
+    };
+
+    // at the end of each slab
+    struct Slab_info {
+      // objects of the slab in the shared pool
+      Object*    head = nullptr;
+      Size_t     free = 0;
+      // in the list of slabs with free objects
+      Slab_info* prev = nullptr;
+      Slab_info* next = nullptr;
+    };
+
+    struct Cache {
+      Object*  head = nullptr;
+      int      count = 0;
+      uint64_t allocs = 0;
+      uint64_t frees  = 0;
+      uint64_t hits   = 0;
+      // wraps on a CPU freeing what another allocated, the sum is right
+      Size_t   requested = 0;
+    };
+
+    // the caches of one CPU, on cache lines of their own
+    struct alignas(SMP_ALIGN) Cpu_caches : std::array<Cache, class_count> {};
+
+    struct Shared {
+      spinlock_t lock = 0;
+      // slabs with some, but not all, objects in the shared pool
+      Slab_info* partial = nullptr;
+      // a slab with every object in the shared pool, kept for the next time
+      Slab_info* idle = nullptr;
+      Size_t     slabs = 0;
+      Size_t     slabs_freed = 0;
+    };
+
+    Cpu_caches& local() noexcept
+    { return per_cpu_help<Cpu_caches, SMP_MAX_CORES>(caches_); }
+
+    // move up to a batch from the shared pool into @cache, with a new slab if needed
+    bool refill(const int cls, Cache& cache) noexcept
+    {
+      auto& shared = shared_[cls];
+      scoped_spinlock guard(shared.lock);
+      if (shared.partial == nullptr and shared.idle != nullptr) {
+        link(shared, *shared.idle);
+        shared.idle = nullptr;
+      }
+      if (shared.partial == nullptr and not grow(cls, shared)) return false;
+
+      for (int i = 0; i < batch and shared.partial; i++)
+      {
+        auto& info  = *shared.partial;
+        Object* obj = info.head;
+        info.head = obj->next;
+        if (--info.free == 0) unlink(shared, info);
+        obj->next  = cache.head;
+        cache.head = obj;
+        cache.count++;
+      }
+      return true;
+    }
+
+    // give a batch from @cache back to the slabs of the objects
+    void flush(const int cls, Cache& cache) noexcept
+    {
+      Object* obj = cache.head;
+      Object* last = obj;
+      for (int i = 1; i < batch; i++) last = last->next;
+      cache.head   = last->next;
+      cache.count -= batch;
+      last->next   = nullptr;
+
+      auto& shared = shared_[cls];
+      scoped_spinlock guard(shared.lock);
+      while (obj != nullptr)
+      {
+        Object* next = obj->next;
+        auto& info = slab_info(cls, obj);
+        obj->next = info.head;
+        info.head = obj;
+        if (info.free++ == 0) link(shared, info);
+        if (info.free == slab_objects(cls)) release(cls, shared, info);
+        obj = next;
+      }
+    }
+
+    // @info has every object back: keep it if there is no idle slab,
+    // or give it back to the backend
+    void release(const int cls, Shared& shared, Slab_info& info) noexcept
+    {
+      unlink(shared, info);
+      if (shared.idle == nullptr) {
+        shared.idle = &info;
+        return;
+      }
+      {
+        scoped_spinlock guard(backend_lock_);
+        backend_.deallocate(slab_base(cls, &info), slab_size(cls));
+      }
+      shared.slabs--;
+      shared.slabs_freed++;
+    }
+
+    static void link(Shared& shared, Slab_info& info) noexcept
+    {
+      info.prev = nullptr;
+      info.next = shared.partial;
+      if (shared.partial) shared.partial->prev = &info;
+      shared.partial = &info;
+    }
+
+    static void unlink(Shared& shared, Slab_info& info) noexcept
+    {
+      if (info.prev) info.prev->next = info.next;
+      else shared.partial = info.next;
+      if (info.next) info.next->prev = info.prev;
+      info.prev = info.next = nullptr;
+    }
+
+    Slab_info& slab_info(const int cls, const void* obj) const noexcept
+    {
+      const Size_t size = slab_size(cls);
+      const uintptr_t base = origin_ + ((uintptr_t(obj) - origin_) & ~(size - 1));
+      return *reinterpret_cast<Slab_info*>(base + size - sizeof(Slab_info));
+    }
+
+    static void* slab_base(const int cls, Slab_info* info) noexcept
+    { return reinterpret_cast<char*>(info + 1) - slab_size(cls); }
+
+    // carve a new slab into the shared pool
+    bool grow(const int cls, Shared& shared) noexcept
+    {
+      const Size_t size  = class_sizes[cls];
+      const Size_t bytes = slab_size(cls);
+      char* slab = nullptr;
+      {
+        scoped_spinlock guard(backend_lock_);
+        slab = static_cast<char*>(backend_.allocate(bytes));
+      }
+      if (slab == nullptr) return false;
+      shared.slabs++;
+      auto* info = new (slab + bytes - sizeof(Slab_info)) Slab_info{};
+
+      for (Size_t off = (slab_objects(cls) - 1) * size; ; off -= size)
+      {
+        auto* obj  = reinterpret_cast<Object*>(slab + off);
+        obj->next  = info->head;
+        info->head = obj;
+        info->free++;
+        if (off == 0) break;
+      }
+      link(shared, *info);
+      return true;
+    }
+
+    spinlock_t own_lock_ = 0;
+    Backend& backend_;
+    spinlock_t& backend_lock_;
+    const uintptr_t origin_;
+    SMP::Array<Cpu_caches> caches_ {};
+    std::array<Shared, class_count> shared_ {};
+  };
+
+} // os::mem::slab
+
+#endif
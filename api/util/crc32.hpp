@@ -93,6 +93,13 @@ inline uint32_t crc32(const void* buf, size_t len)
 /** Intel (iSCSI) aka CRC32-C with hardware support **/
 extern uint32_t crc32_fast(const void* buf, size_t len);
 
+/**
+ * Combine CRC32-C @crc1 of block A with CRC32-C @crc2 of block B
+ * (of length @len2) into the CRC32-C of A followed by B. Lets large
+ * regions be checksummed in independent chunks.
+ */
+extern uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, size_t len2);
+
 /** Software-only CRC32-C **/
 inline uint32_t crc32c(const void* buf, size_t len)
 {
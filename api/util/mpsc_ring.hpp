@@ -0,0 +1,112 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef UTIL_MPSC_RING_HPP
+#define UTIL_MPSC_RING_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace util
+{
+
+/**
+ * Bounded lock-free multi-producer, single-consumer ring.
+ *
+ * Any CPU may push, only the owner may pop. Each cell carries a sequence
+ * number, so that a producer claims a cell with one CAS on the head and
+ * publishes it with a release store, and the consumer never touches the
+ * head at all.
+ */
+template <typename T, size_t N>
+class MPSC_ring
+{
+public:
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "N must be a power of two");
+
+  MPSC_ring() noexcept
+  {
+    for (size_t i = 0; i < N; i++)
+        cells_[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  /** Push from any CPU. Returns false if the ring is full */
+  bool try_push(T&& value)
+  {
+    size_t pos = head_.load(std::memory_order_relaxed);
+    Cell* cell;
+    for (;;)
+    {
+      cell = &cells_[pos & (N - 1)];
+      const size_t seq = cell->seq.load(std::memory_order_acquire);
+      const intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            break;
+      }
+      else if (diff < 0) {
+        return false;
+      }
+      else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+    cell->value = std::move(value);
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** Pop on the owning CPU. Returns false if the ring is empty */
+  bool try_pop(T& value)
+  {
+    Cell& cell = cells_[tail_ & (N - 1)];
+    const size_t seq = cell.seq.load(std::memory_order_acquire);
+    if ((intptr_t) seq - (intptr_t) (tail_ + 1) < 0)
+        return false;
+    value = std::move(cell.value);
+    cell.seq.store(tail_ + N, std::memory_order_release);
+    tail_++;
+    return true;
+  }
+
+  /** Number of claimed cells, only exact on the owning CPU */
+  size_t size() const noexcept {
+    return head_.load(std::memory_order_relaxed) - tail_;
+  }
+  bool empty() const noexcept {
+    return size() == 0;
+  }
+  static constexpr size_t capacity() noexcept {
+    return N;
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> seq;
+    T value;
+  };
+  std::array<Cell, N> cells_;
+  // producers and the consumer on separate cache lines
+  alignas(64) std::atomic<size_t> head_ {0};
+  alignas(64) size_t tail_ = 0;
+};
+
+} // util
+
+#endif
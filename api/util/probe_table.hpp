@@ -0,0 +1,168 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef UTIL_PROBE_TABLE_HPP
+#define UTIL_PROBE_TABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace util
+{
+
+/**
+ * Open addressing with linear probing, for tables keyed on something
+ * the owner hashes and compares itself.
+ *
+ * The slots hold the value and its hash, so a lookup compares hashes
+ * over a few adjacent slots and only calls the owner to compare a
+ * value when the hash matches. Erasing shifts the following entries
+ * back, so there are no tombstones, and the table doubles at half full.
+ *
+ * There is no locking.
+ */
+template <typename T>
+class Probe_table
+{
+public:
+  struct Slot {
+    T        value {};
+    uint32_t hash     = 0;
+    bool     occupied = false;
+  };
+
+  explicit Probe_table(const size_t capacity = 16)
+    : slots_(round_up(capacity)), mask_{slots_.size() - 1}
+  {}
+
+  /** The slot with hash @h where @match(value) holds, or nullptr */
+  template <typename Match>
+  Slot* lookup(const uint32_t h, Match match) noexcept
+  {
+    for (size_t i = h & mask_; ; i = (i + 1) & mask_)
+    {
+      Slot& slot = slots_[i];
+      if (not slot.occupied)
+        return nullptr;
+      if (slot.hash == h and match(slot.value))
+        return &slot;
+    }
+  }
+
+  template <typename Match>
+  const Slot* lookup(const uint32_t h, Match match) const noexcept
+  { return const_cast<Probe_table*>(this)->lookup(h, std::move(match)); }
+
+  /** A new slot for hash @h, growing the table if needed */
+  Slot& insert(const uint32_t h)
+  {
+    if ((size_ + 1) * 2 > slots_.size())
+      grow();
+    size_++;
+    return place(h);
+  }
+
+  /**
+   * @brief      Erase @slot, which must be occupied
+   *
+   * @return     The value that was in it, so that it can be released
+   *             once the table is consistent again
+   */
+  T erase(Slot* slot)
+  {
+    T erased = std::move(slot->value);
+
+    // shift back what follows in the same run
+    size_t i = slot - slots_.data();
+    for (size_t j = (i + 1) & mask_; slots_[j].occupied; j = (j + 1) & mask_)
+    {
+      const size_t home = slots_[j].hash & mask_;
+      // move it if its home is not in (i, j]
+      if (((j - home) & mask_) >= ((j - i) & mask_)) {
+        slots_[i] = std::move(slots_[j]);
+        i = j;
+      }
+    }
+    slots_[i] = Slot{};
+    size_--;
+    return erased;
+  }
+
+  void clear()
+  {
+    for (auto& slot : slots_)
+      slot = Slot{};
+    size_ = 0;
+  }
+
+  size_t size() const noexcept
+  { return size_; }
+
+  size_t capacity() const noexcept
+  { return slots_.size(); }
+
+  /** Every slot, occupied or not */
+  Slot* begin() noexcept
+  { return slots_.data(); }
+
+  Slot* end() noexcept
+  { return slots_.data() + slots_.size(); }
+
+  const Slot* begin() const noexcept
+  { return slots_.data(); }
+
+  const Slot* end() const noexcept
+  { return slots_.data() + slots_.size(); }
+
+private:
+  std::vector<Slot> slots_;
+  size_t mask_;
+  size_t size_ = 0;
+
+  static size_t round_up(size_t n) noexcept
+  {
+    size_t cap = 2;
+    while (cap < n) cap <<= 1;
+    return cap;
+  }
+
+  Slot& place(const uint32_t h) noexcept
+  {
+    size_t i = h & mask_;
+    while (slots_[i].occupied)
+      i = (i + 1) & mask_;
+    slots_[i].occupied = true;
+    slots_[i].hash     = h;
+    return slots_[i];
+  }
+
+  void grow()
+  {
+    std::vector<Slot> old(slots_.size() * 2);
+    old.swap(slots_);
+    mask_ = slots_.size() - 1;
+    for (auto& slot : old)
+      if (slot.occupied)
+        place(slot.hash).value = std::move(slot.value);
+  }
+};
+
+} // util
+
+#endif
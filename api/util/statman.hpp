@@ -20,10 +20,15 @@
 #define UTIL_STATMAN_HPP
 
 #include <common>
+#include <array>
+#include <chrono>
 #include <cstddef>
 #include <deque>
 #include <string>
-#include <smp_utils>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <smp>
 
 struct Stats_out_of_memory : public std::out_of_range {
   explicit Stats_out_of_memory()
@@ -39,6 +44,128 @@ namespace liu {
   struct Storage; struct Restore;
 }
 
+/**
+ * Counter split in one shard per CPU, summed on read. Increments only touch
+ * the shard of the current CPU, so they need no atomics and share no
+ * cache lines.
+ */
+class Stat_counter {
+public:
+  void operator++() noexcept { local()++; }
+  void operator+=(uint64_t n) noexcept { local() += n; }
+
+  /** The shard of the current CPU */
+  uint64_t& local() noexcept
+  { return per_cpu_help<Shard, SMP_MAX_CORES>(shards_).value; }
+
+  /** Sum of all shards */
+  uint64_t value() const noexcept;
+
+  void reset() noexcept;
+
+private:
+  struct alignas(SMP_ALIGN) Shard {
+    uint64_t value = 0;
+  };
+  SMP::Array<Shard> shards_ {};
+};
+
+/**
+ * Counter that also knows how fast it moved between the last two samples.
+ * The rates of Statman::get() are sampled every Statman::RATE_INTERVAL.
+ */
+class Stat_rate : public Stat_counter {
+public:
+  /** Update and return the rate per second since the previous sample */
+  double sample(uint64_t now_ns) noexcept;
+
+  double per_second() const noexcept
+  { return rate_; }
+
+private:
+  uint64_t last_value_ = 0;
+  uint64_t last_ns_    = 0;
+  double   rate_       = 0.0;
+};
+
+/**
+ * Log-linear (HDR style) histogram: every power of two is split in
+ * SUB_BUCKETS linear buckets, so a value is placed within 1/SUB_BUCKETS
+ * of itself, and values below SUB_BUCKETS exactly.
+ * Sharded per CPU like Stat_counter, where the shard of a CPU is made the
+ * first time it records a value.
+ */
+class Stat_histogram {
+public:
+  static const int SUB_BITS    = 3;
+  static const int SUB_BUCKETS = 1 << SUB_BITS;
+  static const int BUCKETS     = SUB_BUCKETS + (64 - SUB_BITS) * SUB_BUCKETS;
+
+  Stat_histogram() = default;
+  // copies get shards of their own
+  Stat_histogram(const Stat_histogram& other);
+  Stat_histogram& operator=(const Stat_histogram&) = delete;
+  ~Stat_histogram();
+
+  void record(uint64_t value)
+  {
+    auto*& shard = per_cpu_help<Shard*, SMP_MAX_CORES>(shards_);
+    if (UNLIKELY(shard == nullptr)) shard = new Shard();
+    shard->buckets[bucket_of(value)]++;
+    shard->count++;
+    shard->sum += value;
+    if (value > shard->max) shard->max = value;
+  }
+
+  static int bucket_of(uint64_t value) noexcept
+  {
+    if (value < SUB_BUCKETS) return value;
+    const int msb   = 63 - __builtin_clzll(value);
+    const int shift = msb - SUB_BITS;
+    return SUB_BUCKETS + shift * SUB_BUCKETS + ((value >> shift) & (SUB_BUCKETS - 1));
+  }
+
+  /** The smallest value that goes in bucket @i */
+  static uint64_t bucket_low(int i) noexcept
+  {
+    if (i < SUB_BUCKETS) return i;
+    const int shift = (i - SUB_BUCKETS) / SUB_BUCKETS;
+    const uint64_t sub = (i - SUB_BUCKETS) % SUB_BUCKETS;
+    return (uint64_t(SUB_BUCKETS) | sub) << shift;
+  }
+
+  /** The largest value that goes in bucket @i */
+  static uint64_t bucket_limit(int i) noexcept
+  {
+    if (i < SUB_BUCKETS) return i;
+    const int shift = (i - SUB_BUCKETS) / SUB_BUCKETS;
+    return bucket_low(i) + ((uint64_t(1) << shift) - 1);
+  }
+
+  uint64_t count() const noexcept;
+  uint64_t sum() const noexcept;
+  uint64_t max() const noexcept;
+  /** Number of values in bucket @i, over all CPUs */
+  uint64_t bucket(int i) const noexcept;
+
+  double mean() const noexcept
+  { const auto n = count(); return n ? double(sum()) / n : 0.0; }
+
+  /** Upper bound of the value at quantile @q, 0.0 - 1.0 */
+  uint64_t percentile(double q) const noexcept;
+
+  void reset() noexcept;
+
+private:
+  struct alignas(SMP_ALIGN) Shard {
+    uint64_t count = 0;
+    uint64_t sum   = 0;
+    uint64_t max   = 0;
+    std::array<uint64_t, BUCKETS> buckets {};
+  };
+  SMP::Array<Shard*> shards_ {};
+};
+
 class Stat {
 public:
   static const int MAX_NAME_LEN = 46;
@@ -49,13 +176,18 @@ public:
   {
     FLOAT,
     UINT32,
-    UINT64
+    UINT64,
+    // sharded per CPU, and owned by Statman
+    COUNTER,
+    RATE,
+    HISTOGRAM
   };
 
   Stat(const Stat_type type, const std::string& name);
+  // copies of a sharded stat get shards of their own
   Stat(const Stat& other);
   Stat& operator=(const Stat& other);
-  ~Stat() = default;
+  ~Stat() { release(); }
 
   // increment stat counter
   void operator++();
@@ -63,6 +195,8 @@ public:
   Stat_type type() const noexcept
   { return (Stat_type)(m_bits & 0xF); }
 
+  bool is_sharded() const noexcept { return type() >= COUNTER; }
+
   bool is_persistent() const noexcept { return m_bits & PERSIST_BIT; }
   void make_persistent() noexcept { m_bits |= PERSIST_BIT; }
 
@@ -81,14 +215,30 @@ public:
   uint32_t&       get_uint32();
   const uint64_t& get_uint64() const;
   uint64_t&       get_uint64();
+  // COUNTER and RATE
+  const Stat_counter& get_counter() const;
+  Stat_counter&       get_counter();
+  Stat_rate&          get_rate();
+  const Stat_histogram& get_histogram() const;
+  Stat_histogram&       get_histogram();
+
+  /** The value as a scalar, sharded stats summed up */
+  uint64_t value() const;
 
   std::string to_string() const;
 
 private:
+  // copy the value, or the shards, of @other
+  void copy(const Stat& other);
+  // free the shards of a sharded stat
+  void release() noexcept;
+  friend class Statman;
+
   union {
     float    f;
     uint32_t ui32;
     uint64_t ui64;
+    void*    shards;
   };
   uint8_t m_bits;
 
@@ -96,8 +246,27 @@ private:
 }; //< class Stat
 
 
+/** A stat decoded from Statman::snapshot() */
+struct Stat_entry {
+  std::string     name;
+  Stat::Stat_type type;
+  bool            gauge  = false;
+  // integers, and the total of counters and rates
+  uint64_t        value  = 0;
+  float           fvalue = 0.0f;
+  double          per_second = 0.0;
+  // histograms, with the buckets in use as (index, count)
+  uint64_t        count = 0;
+  uint64_t        sum   = 0;
+  uint64_t        max   = 0;
+  std::vector<std::pair<uint16_t, uint64_t>> buckets;
+};
+
 class Statman {
 public:
+  static const uint32_t SNAPSHOT_MAGIC   = 0x54415453; // "STAT"
+  static const uint16_t SNAPSHOT_VERSION = 1;
+
   // retrieve main instance of Statman
   static Statman& get();
 
@@ -115,7 +284,7 @@ public:
   Stat& create(const Stat::Stat_type type, const std::string& name);
   // retrieve stat based on address from stats counter: &stat.get_xxx()
   Stat& get(const Stat* addr);
-  // if you know the name of a statistic already
+  // if you know the name of a statistic already, O(1)
   Stat& get_by_name(const char* name);
   // retrieve stat or create if it doesnt exists
   Stat& get_or_create(const Stat::Stat_type type, const std::string& name);
@@ -148,17 +317,45 @@ public:
   auto cbegin() const noexcept { return m_stats.cbegin(); }
   auto cend() const noexcept { return m_stats.cend(); }
 
+  /** How often the RATE stats of Statman::get() are sampled */
+  static constexpr std::chrono::seconds RATE_INTERVAL {1};
+
+  /** Sample all RATE stats, see Stat_rate::sample.
+   *  Statman::get() does this every RATE_INTERVAL on its own. */
+  void sample_rates(uint64_t now_ns);
+
+  /**
+   * Binary snapshot of all stats in use, little-endian:
+   *   header:   u32 magic, u16 version, u16 reserved, u32 count, u64 timestamp
+   *   per stat: u8 type, u8 flags, u8 name length, name (not terminated),
+   *             FLOAT f32 | UINT32 u32 | UINT64, COUNTER u64
+   *             | RATE u64 total, f64 per second
+   *             | HISTOGRAM u64 count, u64 sum, u64 max, u16 buckets in use,
+   *               then u16 index, u64 count for each
+   * flags holds the gauge and persist bits of the stat.
+   */
+  std::vector<uint8_t> snapshot(uint64_t timestamp = 0) const;
+
+  /** Decode a snapshot, throws Stats_exception if it's malformed */
+  static std::vector<Stat_entry> parse_snapshot(const uint8_t* data, size_t len,
+                                                uint64_t* timestamp = nullptr);
+
+  // sharded stats are stored as UINT64 with their value
   void store(uint32_t id, liu::Storage&);
   void restore(liu::Restore&);
 
   Statman();
 private:
   std::deque<Stat> m_stats;
+  // names of the stats in use, viewing the names in m_stats
+  std::unordered_map<std::string_view, Stat*> m_index;
 #ifdef INCLUDEOS_SMP_ENABLE
   mutable spinlock_t stlock = 0;
 #endif
   ssize_t find_free_stat() const noexcept;
   uint32_t& unused_stats();
+  void index_stat(Stat& stat);
+  void unindex_stat(Stat& stat);
 
   Statman(const Statman& other) = delete;
   Statman(const Statman&& other) = delete;
@@ -196,4 +393,27 @@ inline const uint64_t& Stat::get_uint64() const {
   return ui64;
 }
 
+inline Stat_counter& Stat::get_counter() {
+  if (type() == RATE) return *static_cast<Stat_rate*>(shards);
+  if (UNLIKELY(type() != COUNTER)) throw Stats_exception{"Stat type is not a counter"};
+  return *static_cast<Stat_counter*>(shards);
+}
+inline const Stat_counter& Stat::get_counter() const {
+  if (type() == RATE) return *static_cast<const Stat_rate*>(shards);
+  if (UNLIKELY(type() != COUNTER)) throw Stats_exception{"Stat type is not a counter"};
+  return *static_cast<const Stat_counter*>(shards);
+}
+inline Stat_rate& Stat::get_rate() {
+  if (UNLIKELY(type() != RATE)) throw Stats_exception{"Stat type is not a rate"};
+  return *static_cast<Stat_rate*>(shards);
+}
+inline Stat_histogram& Stat::get_histogram() {
+  if (UNLIKELY(type() != HISTOGRAM)) throw Stats_exception{"Stat type is not a histogram"};
+  return *static_cast<Stat_histogram*>(shards);
+}
+inline const Stat_histogram& Stat::get_histogram() const {
+  if (UNLIKELY(type() != HISTOGRAM)) throw Stats_exception{"Stat type is not a histogram"};
+  return *static_cast<const Stat_histogram*>(shards);
+}
+
 #endif //< UTIL_STATMAN_HPP
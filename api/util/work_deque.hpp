@@ -0,0 +1,119 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef UTIL_WORK_DEQUE_HPP
+#define UTIL_WORK_DEQUE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace util
+{
+
+/**
+ * Bounded lock-free work-stealing deque (Chase-Lev).
+ *
+ * The owning CPU pushes and pops at the bottom, LIFO, which keeps recent
+ * work cache-hot. Other CPUs steal from the top, FIFO, so that they take
+ * the oldest and usually largest pieces of work.
+ * T is stored in atomics, so it must be trivially copyable, eg. a pointer.
+ */
+template <typename T, size_t N>
+class Work_deque
+{
+public:
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "N must be a power of two");
+  static_assert(std::is_trivially_copyable<T>::value,
+                "T must be trivially copyable");
+
+  /** Push on the owning CPU. Returns false if the deque is full */
+  bool push(T value) noexcept
+  {
+    const int64_t b = bottom_.load(std::memory_order_relaxed);
+    const int64_t t = top_.load(std::memory_order_acquire);
+    if (b - t >= (int64_t) N) return false;
+    buffer_[b & (N - 1)].store(value, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  /** Pop the newest item on the owning CPU. Returns false if empty */
+  bool pop(T& value) noexcept
+  {
+    const int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+
+    if (t > b) {
+      // empty
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return false;
+    }
+    value = buffer_[b & (N - 1)].load(std::memory_order_relaxed);
+    if (t == b)
+    {
+      // last item, race against thieves for it
+      const bool won = top_.compare_exchange_strong(t, t + 1,
+                            std::memory_order_seq_cst, std::memory_order_relaxed);
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return won;
+    }
+    return true;
+  }
+
+  /** Steal the oldest item from any CPU. Returns false if empty or lost a race */
+  bool steal(T& value) noexcept
+  {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) return false;
+
+    value = buffer_[t & (N - 1)].load(std::memory_order_relaxed);
+    return top_.compare_exchange_strong(t, t + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed);
+  }
+
+  /** Approximate number of items, exact on the owning CPU when nobody steals */
+  size_t size() const noexcept
+  {
+    const int64_t b = bottom_.load(std::memory_order_relaxed);
+    const int64_t t = top_.load(std::memory_order_relaxed);
+    return (b > t) ? (b - t) : 0;
+  }
+  bool empty() const noexcept {
+    return size() == 0;
+  }
+  static constexpr size_t capacity() noexcept {
+    return N;
+  }
+
+private:
+  std::array<std::atomic<T>, N> buffer_ {};
+  // thieves and the owner on separate cache lines
+  alignas(64) std::atomic<int64_t> top_ {0};
+  alignas(64) std::atomic<int64_t> bottom_ {0};
+};
+
+} // util
+
+#endif
@@ -56,6 +56,20 @@ struct LiveUpdate
   // the same @key value during the resume process
   static void register_partition(std::string key, storage_func);
 
+  // Same as register_partition, but for state that does not change after
+  // it has been registered, such as configuration or certificates.
+  // Stable partitions can be serialized ahead of time with prepare()
+  static void register_stable_partition(std::string key, storage_func);
+
+  // Validate @blob and serialize all stable partitions into the storage area
+  // ahead of the update, so that exec() only has to serialize the rest.
+  // The blob must not change between prepare() and exec(), and prepare()
+  // must be called again if a stable partition changes.
+  // Throws std::runtime_error if the blob is not a valid kernel
+  static void prepare(const buffer_t& blob, void* storage_area = nullptr);
+  // Returns true if prepare() has staged partitions in @storage_area
+  static bool is_prepared(const void* storage_area = nullptr) noexcept;
+
   // Start a live update process, storing all user-defined data
   // If no storage functions are registered no state will be saved
   // If @storage_area is nullptr (default) it will be retrieved from OS
@@ -104,6 +118,24 @@ struct LiveUpdate
   static void rollback_now(const char* reason);
   // Returns if the state in the OS has been set to being "liveupdated"
   static bool os_is_liveupdated() noexcept;
+
+  // Time spent in each phase of a live update, in nanoseconds
+  struct Timings
+  {
+    uint64_t validate  = 0; // validating the new ELF blob
+    uint64_t serialize = 0; // running storage functions
+    uint64_t checksum  = 0; // checksumming partitions
+    uint64_t boot      = 0; // copying the ELF, hotswap and boot until resume
+    uint64_t resume    = 0; // running resume functions
+
+    uint64_t total() const noexcept {
+      return validate + serialize + checksum + boot + resume;
+    }
+  };
+  // Timings of the update that started this kernel, all zero if none.
+  // The boot phase is known after the first call to resume(),
+  // and resume accumulates the time spent in each call to resume()
+  static const Timings& timings() noexcept;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -113,11 +113,16 @@ struct storage_header
   uint32_t get_entries() const noexcept {
     return this->entries;
   }
+  uint32_t get_partitions() const noexcept {
+    return this->partitions;
+  }
 
   storage_header();
   int  create_partition(std::string key);
   int  find_partition(const char*) const;
+  // terminate partition @p, checksum_partition() must be called after
   void finish_partition(int);
+  void checksum_partition(int);
   void zero_partition(int);
 
   void add_marker(uint16_t id);
@@ -20,17 +20,67 @@
 **/
 #include "storage.hpp"
 #include <util/crc32.hpp>
+#include <smp>
+#include <atomic>
 #include <cassert>
 #include <cstring>
+#include <stdexcept>
 extern bool LIVEUPDATE_USE_CHEKSUMS;
+// partitions larger than this are checksummed in parallel on all CPUs
+static const size_t PARALLEL_CRC_MIN = 1024 * 1024;
 
 inline uint32_t liu_crc32(const void* buf, size_t len)
 {
   return crc32_fast(buf, len);
 }
 
+static uint32_t liu_crc32_parallel(const char* buf, size_t len)
+{
+#ifdef INCLUDEOS_SMP_ENABLE
+  const int cpus = SMP::cpu_count();
+  if (cpus > 1 && len >= PARALLEL_CRC_MIN)
+  {
+    struct chunk_t {
+      const char* data;
+      size_t      len;
+      uint32_t    crc;
+    };
+    std::array<chunk_t, SMP_MAX_CORES> chunks;
+    std::atomic<int> remaining {cpus - 1};
+
+    const size_t chunk_len = len / cpus;
+    for (int i = 0; i < cpus; i++) {
+      chunks[i].data = &buf[i * chunk_len];
+      chunks[i].len  = (i == cpus-1) ? len - i * chunk_len : chunk_len;
+    }
+    // the first chunk is ours, the rest go to the other CPUs
+    int next = 1;
+    for (const int cpu : SMP::active_cpus())
+    {
+      if (cpu == SMP::cpu_id()) continue;
+      auto* chunk = &chunks[next++];
+      SMP::add_task(
+        [chunk, &remaining] {
+          chunk->crc = liu_crc32(chunk->data, chunk->len);
+          remaining--;
+        }, cpu);
+      SMP::signal(cpu);
+    }
+    chunks[0].crc = liu_crc32(chunks[0].data, chunks[0].len);
+    // interrupts are off during exec(), so we can only spin
+    while (remaining.load(std::memory_order_acquire) > 0);
+
+    uint32_t crc = chunks[0].crc;
+    for (int i = 1; i < cpus; i++)
+      crc = crc32c_combine(crc, chunks[i].crc, chunks[i].len);
+    return crc;
+  }
+#endif
+  return liu_crc32(buf, len);
+}
+
 uint32_t partition_header::generate_checksum(const char* vla) const {
-  return liu_crc32(&vla[this->offset], this->length);
+  return liu_crc32_parallel(&vla[this->offset], this->length);
 }
 
 int storage_header::create_partition(const std::string key)
@@ -68,9 +118,14 @@ void storage_header::finish_partition(int p)
 {
   // make sure partition ends properly
   this->add_end();
-  // write length and crc
+  // write length
   auto& part = ptable.at(p);
   part.length = this->length - part.offset;
+  part.crc = 0;
+}
+void storage_header::checksum_partition(int p)
+{
+  auto& part = ptable.at(p);
   if (LIVEUPDATE_USE_CHEKSUMS) {
     part.crc = part.generate_checksum(this->vla);
   }
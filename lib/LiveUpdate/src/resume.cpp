@@ -24,6 +24,8 @@
 #include <kernel.hpp>
 #include "storage.hpp"
 #include "serialize_tcp.hpp"
+#include "timings.hpp"
+#include <cstring>
 #include <cstdio>
 
 //#define LPRINT(x, ...) printf(x, ##__VA_ARGS__);
@@ -32,6 +34,29 @@
 namespace liu
 {
 static bool resume_begin(storage_header&, std::string, LiveUpdate::resume_func);
+static LiveUpdate::Timings update_timings;
+
+const LiveUpdate::Timings& LiveUpdate::timings() noexcept
+{
+  return update_timings;
+}
+
+static void resume_timings(storage_header& storage)
+{
+  int p = storage.find_partition(LIU_TIMINGS_KEY);
+  if (p == -1) return;
+  const auto* ent = storage.begin(p);
+  if (ent->type == TYPE_BUFFER && ent->len == sizeof(stored_timings))
+  {
+    stored_timings st;
+    memcpy(&st, ent->data(), sizeof(st));
+    update_timings = st.timings;
+    // TSC keeps counting across the hotswap
+    update_timings.boot = liu_to_nanos(os::cycles_since_boot() - st.exec_cycles);
+    update_timings.resume = 0;
+  }
+  storage.zero_partition(p);
+}
 
 bool LiveUpdate::is_resumable()
 {
@@ -53,6 +78,8 @@ static bool resume_helper(void* location, std::string key, LiveUpdate::resume_fu
       return false;
 
   LPRINT("* Restoring data...\n");
+  // the first resume after an update picks up its timings
+  resume_timings(*(storage_header*) location);
   // restore connections etc.
   return resume_begin(*(storage_header*) location, key.c_str(), func);
 }
@@ -95,8 +122,10 @@ bool resume_begin(storage_header& storage, std::string key, LiveUpdate::resume_f
 
   // resume wrapper
   Restore wrapper(storage.begin(p));
+  const uint64_t t0 = os::cycles_since_boot();
   // use registered functions when we can, otherwise, use normal
   func(wrapper);
+  update_timings.resume += liu_to_nanos(os::cycles_since_boot() - t0);
 
   // wake all the slumbering IP stacks
   serialized_tcp::wakeup_ip_networks();
@@ -210,11 +210,12 @@ int  Write_queue::serialize_to(void* addr) const
   writeq->current = this->current_;
   writeq->offset  = this->offset_;
   writeq->acked   = this->acked_;
-  writeq->buffers = this->q.size();
+  writeq->buffers = this->size();
 
   int len = 0;
-  for (auto& wbuf : this->q)
+  for (auto i = this->head_; i < this->q.size(); ++i)
   {
+    auto& wbuf = this->q[i];
     auto* current = (write_buffer*) &writeq->vla[len];
 
     // header
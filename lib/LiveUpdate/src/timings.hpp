@@ -0,0 +1,36 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include "liveupdate.hpp"
+#include <os.hpp>
+
+// internal partition carrying the update timings to the new kernel
+#define LIU_TIMINGS_KEY  "__liu_timings"
+
+struct stored_timings
+{
+  liu::LiveUpdate::Timings timings;
+  // TSC at the moment the old kernel jumped to the new one
+  uint64_t exec_cycles;
+};
+
+inline uint64_t liu_to_nanos(uint64_t cycles) noexcept
+{
+  const double khz = os::cpu_freq().count();
+  if (khz <= 0) return 0;
+  return cycles * 1e6 / khz;
+}
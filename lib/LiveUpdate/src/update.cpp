@@ -27,6 +27,7 @@
 #include <unordered_map>
 #include <elf.h>
 #include "storage.hpp"
+#include "timings.hpp"
 #include <kernel.hpp>
 #include <os.hpp>
 #include <kernel/memory.hpp>
@@ -54,30 +55,74 @@ bool LIVEUPDATE_USE_CHEKSUMS    = true;
 // turn this om to zero-initialize all memory between new kernel and heap end
 bool LIVEUPDATE_ZERO_OLD_MEMORY = false;
 
+namespace liu {
+  extern void* find_kernel_start32(const Elf32_Ehdr* hdr);
+  extern void* find_kernel_start64(const Elf64_Ehdr* hdr);
+}
 using namespace liu;
 
-static size_t update_store_data(void* location, const buffer_t*);
+static size_t update_store_data(void* location, const buffer_t*,
+                                LiveUpdate::Timings* = nullptr);
 
+struct storage_callback
+{
+  LiveUpdate::storage_func func;
+  // stable partitions can be serialized ahead of time by prepare()
+  bool stable;
+};
 // serialization callbacks
-static std::unordered_map<std::string, LiveUpdate::storage_func> storage_callbacks;
+static std::unordered_map<std::string, storage_callback> storage_callbacks;
 
-void LiveUpdate::register_partition(std::string key, storage_func callback)
+// the results of validating an ELF blob
+struct elf_info
+{
+  const char* bin_data  = nullptr;
+  int         bin_len   = 0;
+  char*       phys_base = nullptr;
+  uint32_t    start_offset = 0;
+  bool        found_kernel_start = false;
+};
+static elf_info validate_elf(const buffer_t& blob);
+
+// state staged by prepare(), consumed by exec()
+static struct {
+  const char* blob_data = nullptr;
+  size_t      blob_size = 0;
+  elf_info    elf;
+  // storage area with the serialized stable partitions
+  const void* location = nullptr;
+  uint32_t    partitions = 0;
+  size_t      length = 0;
+} prepared;
+
+static void add_partition(std::string key, LiveUpdate::storage_func callback, bool stable)
 {
 #if defined(USERSPACE_KERNEL)
   // on linux we cant make the jump, so the tracking wont reset
-  storage_callbacks[key] = std::move(callback);
+  storage_callbacks[key] = {std::move(callback), stable};
 #else
   auto it = storage_callbacks.find(key);
   if (it == storage_callbacks.end())
   {
     storage_callbacks.emplace(std::piecewise_construct,
               std::forward_as_tuple(std::move(key)),
-              std::forward_as_tuple(std::move(callback)));
+              std::forward_as_tuple(storage_callback{std::move(callback), stable}));
   }
   else {
     throw std::runtime_error("Storage key '" + key + "' already used");
   }
 #endif
+  // any staged partitions are now incomplete
+  prepared.location = nullptr;
+}
+
+void LiveUpdate::register_partition(std::string key, storage_func callback)
+{
+  add_partition(std::move(key), std::move(callback), false);
+}
+void LiveUpdate::register_stable_partition(std::string key, storage_func callback)
+{
+  add_partition(std::move(key), std::move(callback), true);
 }
 
 template <typename Class>
@@ -95,33 +140,13 @@ void LiveUpdate::exec(const buffer_t& blob, std::string key, storage_func func)
   LiveUpdate::exec(blob);
 }
 
-void LiveUpdate::exec(const buffer_t& blob, void* location)
+static void validate_storage_area(const char* storage_area)
 {
-  if (location == nullptr) location = kernel::liveupdate_storage_area();
-  LPRINT("LiveUpdate::begin(%p, %p:%d, ...)\n", location, blob.data(), (int) blob.size());
-#if defined(__includeos__)
-  // 1. turn off interrupts
-  asm volatile("cli");
-#endif
-
-  // use area provided to us directly, which we will assume
-  // is far enough into heap to not get overwritten by hotswap.
-  // even then, it's still guaranteed to work: the copy mechanism
-  // is implemented in hotswap.cpp and copies forwards. the
-  // blobs are separated by at least one old kernel size and
-  // some early heap allocations, which is at least 1mb, while
-  // the copy mechanism just copies single bytes.
-  if (blob.size() < ELF_MINIMUM)
-      throw std::runtime_error("Buffer too small to be valid ELF");
-  const char* update_area  = blob.data();
-  char* storage_area = (char*) location;
-
   // validate not overwriting heap, kernel area and other things
   if (storage_area < (char*) 0x200) {
     throw std::runtime_error("LiveUpdate storage area is (probably) a null pointer");
   }
 #if !defined(PLATFORM_UNITTEST) && !defined(USERSPACE_KERNEL)
-  const uintptr_t storage_area_phys = os::mem::virt_to_phys((uintptr_t) storage_area);
   // NOTE: on linux the heap location is randomized,
   // so we could compare against that but: How to get the heap base address?
   if (storage_area >= &_ELF_START_ && storage_area < &_end) {
@@ -131,6 +156,13 @@ void LiveUpdate::exec(const buffer_t& blob, void* location)
     throw std::runtime_error("LiveUpdate storage area is inside the heap area");
   }
 #endif
+}
+
+elf_info validate_elf(const buffer_t& blob)
+{
+  if (blob.size() < ELF_MINIMUM)
+      throw std::runtime_error("Buffer too small to be valid ELF");
+  const char* update_area  = blob.data();
 
   // search for ELF header
   LPRINT("* Looking for ELF header at %p\n", update_area);
@@ -151,15 +183,8 @@ void LiveUpdate::exec(const buffer_t& blob, void* location)
   }
   LPRINT("* Found ELF header\n");
 
-  bool      found_kernel_start = false;
+  elf_info elf;
   size_t    expected_total = 0;
-  uint32_t  start_offset = 0;
-  extern void* find_kernel_start32(const Elf32_Ehdr* hdr);
-  extern void* find_kernel_start64(const Elf64_Ehdr* hdr);
-
-  const char* bin_data  = nullptr;
-  int         bin_len   = 0;
-  char*       phys_base = nullptr;
 
   if (hdr->e_ident[EI_CLASS] == ELFCLASS32)
   {
@@ -169,14 +194,14 @@ void LiveUpdate::exec(const buffer_t& blob, void* location)
         hdr->e_shoff;
     /// program entry point
     void* start = find_kernel_start32(hdr);
-    start_offset = (start) ? (uintptr_t) start : hdr->e_entry;
-    found_kernel_start = (start != nullptr);
+    elf.start_offset = (start) ? (uintptr_t) start : hdr->e_entry;
+    elf.found_kernel_start = (start != nullptr);
 
     // get offsets for the new service from program header
     auto* phdr = (Elf32_Phdr*) &binary[hdr->e_phoff];
-    bin_data  = &binary[phdr->p_offset];
-    bin_len   = phdr->p_filesz;
-    phys_base = (char*) (uintptr_t) phdr->p_paddr;
+    elf.bin_data  = &binary[phdr->p_offset];
+    elf.bin_len   = phdr->p_filesz;
+    elf.phys_base = (char*) (uintptr_t) phdr->p_paddr;
   }
   else {
     auto* ehdr = (Elf64_Ehdr*) hdr;
@@ -186,13 +211,13 @@ void LiveUpdate::exec(const buffer_t& blob, void* location)
         ehdr->e_shoff;
     /// program entry point
     void* start = find_kernel_start64(ehdr);
-    start_offset = (start) ? (uintptr_t) start : ehdr->e_entry;
-    found_kernel_start = (start != nullptr);
+    elf.start_offset = (start) ? (uintptr_t) start : ehdr->e_entry;
+    elf.found_kernel_start = (start != nullptr);
     // get offsets for the new service from program header
     auto* phdr = (Elf64_Phdr*) &binary[ehdr->e_phoff];
-    bin_data  = &binary[phdr->p_offset];
-    bin_len   = phdr->p_filesz;
-    phys_base = (char*) phdr->p_paddr;
+    elf.bin_data  = &binary[phdr->p_offset];
+    elf.bin_len   = phdr->p_filesz;
+    elf.phys_base = (char*) phdr->p_paddr;
   }
 
   if (blob.size() < expected_total || expected_total < ELF_MINIMUM)
@@ -208,10 +233,89 @@ void LiveUpdate::exec(const buffer_t& blob, void* location)
   LPRINT("* Validated ELF header\n");
 
   // _start() entry point
-  LPRINT("* Kernel entry is located at %#x\n", start_offset);
+  LPRINT("* Kernel entry is located at %#x\n", elf.start_offset);
+  return elf;
+}
+
+static bool is_staged(const void* location) noexcept
+{
+  if (location == nullptr || prepared.location != location) return false;
+  // make sure nobody has written to the storage area since prepare()
+  auto* storage = (const storage_header*) location;
+  return storage->get_partitions() == prepared.partitions
+      && storage->get_length() == prepared.length;
+}
+
+void LiveUpdate::prepare(const buffer_t& blob, void* location)
+{
+  if (location == nullptr) location = kernel::liveupdate_storage_area();
+  validate_storage_area((char*) location);
+  prepared = {};
+
+  const uint64_t t0 = os::cycles_since_boot();
+  const elf_info elf = validate_elf(blob);
+  const uint64_t t1 = os::cycles_since_boot();
+
+  // serialize and checksum the stable partitions
+  new (location) storage_header();
+  auto* storage = (storage_header*) location;
+  Storage wrapper(*storage);
+  for (const auto& pair : storage_callbacks)
+  {
+    if (pair.second.stable == false) continue;
+    int p = storage->create_partition(pair.first);
+    pair.second.func(wrapper, &blob);
+    storage->finish_partition(p);
+    storage->checksum_partition(p);
+  }
+  const uint64_t t2 = os::cycles_since_boot();
+
+  prepared.blob_data  = blob.data();
+  prepared.blob_size  = blob.size();
+  prepared.elf        = elf;
+  prepared.location   = location;
+  prepared.partitions = storage->get_partitions();
+  prepared.length     = storage->get_length();
+  LPRINT("* Prepared %u stable partitions (%zu bytes): validate %lu ns, serialize %lu ns\n",
+         prepared.partitions, prepared.length,
+         (unsigned long) liu_to_nanos(t1 - t0), (unsigned long) liu_to_nanos(t2 - t1));
+}
+bool LiveUpdate::is_prepared(const void* location) noexcept
+{
+  if (location == nullptr) location = kernel::liveupdate_storage_area();
+  return is_staged(location);
+}
+
+void LiveUpdate::exec(const buffer_t& blob, void* location)
+{
+  if (location == nullptr) location = kernel::liveupdate_storage_area();
+  LPRINT("LiveUpdate::begin(%p, %p:%d, ...)\n", location, blob.data(), (int) blob.size());
+#if defined(__includeos__)
+  // 1. turn off interrupts
+  asm volatile("cli");
+#endif
+
+  // use area provided to us directly, which we will assume
+  // is far enough into heap to not get overwritten by hotswap.
+  // even then, it's still guaranteed to work: the copy mechanism
+  // is implemented in hotswap.cpp and copies forwards. the
+  // blobs are separated by at least one old kernel size and
+  // some early heap allocations, which is at least 1mb, while
+  // the copy mechanism just copies single bytes.
+  char* storage_area = (char*) location;
+  validate_storage_area(storage_area);
+
+  Timings timings;
+  // the blob was already validated if it was prepared
+  const uint64_t t0 = os::cycles_since_boot();
+  const bool was_prepared = prepared.blob_data == blob.data()
+                         && prepared.blob_size == blob.size();
+  const elf_info elf = (was_prepared) ? prepared.elf : validate_elf(blob);
+  timings.validate = liu_to_nanos(os::cycles_since_boot() - t0);
 
   // save ourselves if function passed
-  update_store_data(storage_area, &blob);
+  update_store_data(storage_area, &blob, &timings);
+  prepared = {};
 
 #if !defined(PLATFORM_UNITTEST) && !defined(USERSPACE_KERNEL)
   // 2. flush all NICs
@@ -235,6 +339,10 @@ void LiveUpdate::exec(const buffer_t& blob, void* location)
   void* sr_data = nullptr;
 #endif
 
+  const char* bin_data  = elf.bin_data;
+  const int   bin_len   = elf.bin_len;
+  char*       phys_base = elf.phys_base;
+  const uint32_t start_offset = elf.start_offset;
   // get offsets for the new service from program header
   if (bin_data == nullptr ||
       phys_base == nullptr || bin_len <= 64) {
@@ -256,7 +364,7 @@ void LiveUpdate::exec(const buffer_t& blob, void* location)
 # elif defined(ARCH_x86_64)
     // change to simple pagetable
     __x86_init_paging((void*) 0x1000);
-  if (found_kernel_start == false)
+  if (elf.found_kernel_start == false)
   {
     // copy hotswapping function to sweet spot
     memcpy(HOTSWAP_AREA, (void*) &hotswap64, hotswap64_len);
@@ -302,23 +410,59 @@ size_t LiveUpdate::stored_data_length(const void* location)
   return storage->total_bytes();
 }
 
-size_t update_store_data(void* location, const buffer_t* blob)
+static void store_timings(storage_header& storage, const LiveUpdate::Timings& timings)
 {
-  // create storage header in the fixed location
-  new (location) storage_header();
+  stored_timings st;
+  st.timings = timings;
+  // the boot phase is measured by the new kernel from here
+  st.exec_cycles = os::cycles_since_boot();
+
+  int p = storage.create_partition(LIU_TIMINGS_KEY);
+  storage.add_buffer(0, (const char*) &st, sizeof(st));
+  storage.finish_partition(p);
+  storage.checksum_partition(p);
+}
+
+size_t update_store_data(void* location, const buffer_t* blob,
+                         LiveUpdate::Timings* timings)
+{
+  // stable partitions may already be stored by prepare()
+  const bool staged = is_staged(location);
+  if (!staged) {
+    // create storage header in the fixed location
+    new (location) storage_header();
+  }
   auto* storage = (storage_header*) location;
+  const int first = storage->get_partitions();
 
+  const uint64_t t0 = os::cycles_since_boot();
   Storage wrapper(*storage);
   /// callback for storing stuff, if provided
   for (const auto& pair : storage_callbacks)
   {
+    if (staged && pair.second.stable) continue;
     // create partition
     int p = storage->create_partition(pair.first);
     // run serialization process
-    pair.second(wrapper, blob);
+    pair.second.func(wrapper, blob);
     // add end for partition
     storage->finish_partition(p);
   }
+  const uint64_t t1 = os::cycles_since_boot();
+  // checksum the new partitions in one go
+  for (int p = first; p < (int) storage->get_partitions(); p++)
+    storage->checksum_partition(p);
+  const uint64_t t2 = os::cycles_since_boot();
+
+  if (timings != nullptr)
+  {
+    timings->serialize = liu_to_nanos(t1 - t0);
+    timings->checksum  = liu_to_nanos(t2 - t1);
+    LPRINT("* Validate %lu ns, serialize %lu ns, checksum %lu ns (%s)\n",
+           (unsigned long) timings->validate, (unsigned long) timings->serialize,
+           (unsigned long) timings->checksum, staged ? "prepared" : "not prepared");
+    store_timings(*storage, *timings);
+  }
 
   /// finalize
   storage->finalize();
@@ -553,10 +553,12 @@ void e1000::receive_handler()
   {
     // acknowledge all rx packets
     write_cmd(REG_RXDESCTAIL, old_idx);
+    record_rx_batch(received);
     // process rx packets
     for (uint32_t i = 0; i < received; i++) {
       Link_layer::receive(std::move(recv_array[i]));
     }
+    rx_batch_done();
   }
 }
 
@@ -31,8 +31,8 @@ const char* Solo5Net::driver_name() const { return "Solo5Net"; }
 
 Solo5Net::Solo5Net()
   : Link(Link_protocol{{this, &Solo5Net::transmit}, mac()}),
-    packets_rx_{Statman::get().create(Stat::UINT64, device_name() + ".packets_rx").get_uint64()},
-    packets_tx_{Statman::get().create(Stat::UINT64, device_name() + ".packets_tx").get_uint64()},
+    packets_rx_{Statman::get().create(Stat::COUNTER, device_name() + ".packets_rx").get_counter()},
+    packets_tx_{Statman::get().create(Stat::COUNTER, device_name() + ".packets_tx").get_counter()},
     bufstore_{NUM_BUFFERS, 2048u} // don't change this
 {
   INFO("Solo5Net", "Driver initializing");
@@ -55,7 +55,7 @@ void Solo5Net::transmit(net::Packet_ptr pckt)
     // set tail to next, releasing tail
     tail = std::move(next);
     // Stat increase packets transmitted
-    packets_tx_++;
+    ++packets_tx_;
   }
 
   // Buffer the rest
@@ -94,6 +94,7 @@ void Solo5Net::poll()
 
   if (LIKELY(pckt_ptr != nullptr)) {
     Link::receive(std::move(pckt_ptr));
+    rx_batch_done();
   }
 }
 
@@ -86,8 +86,8 @@ private:
   MAC::Addr mac_addr;
   std::unique_ptr<net::Packet> recv_packet();
   /** Stats */
-  uint64_t& packets_rx_;
-  uint64_t& packets_tx_;
+  Stat_counter& packets_rx_;
+  Stat_counter& packets_tx_;
 
   net::BufferStore bufstore_;
 
@@ -74,14 +74,14 @@ VirtioNet::VirtioNet(hw::PCI_Device& d, const uint16_t /*mtu*/)
                 device_name() + ".sendq_dropped").get_uint64()},
     stat_rx_refill_dropped_{Statman::get().create(Stat::UINT64,
                 device_name() + ".rx_refill_dropped").get_uint64()},
-    stat_bytes_rx_total_{Statman::get().create(Stat::UINT64,
-                device_name() + ".stat_rx_total_bytes").get_uint64()},
-    stat_bytes_tx_total_{Statman::get().create(Stat::UINT64,
-                device_name() + ".stat_tx_total_bytes").get_uint64()},
-    stat_packets_rx_total_{Statman::get().create(Stat::UINT64,
-                device_name() + ".stat_rx_total_packets").get_uint64()},
-    stat_packets_tx_total_{Statman::get().create(Stat::UINT64,
-                device_name() + ".stat_tx_total_packets").get_uint64()}
+    stat_bytes_rx_total_{Statman::get().create(Stat::COUNTER,
+                device_name() + ".stat_rx_total_bytes").get_counter()},
+    stat_bytes_tx_total_{Statman::get().create(Stat::COUNTER,
+                device_name() + ".stat_tx_total_bytes").get_counter()},
+    stat_packets_rx_total_{Statman::get().create(Stat::COUNTER,
+                device_name() + ".stat_rx_total_packets").get_counter()},
+    stat_packets_tx_total_{Statman::get().create(Stat::COUNTER,
+                device_name() + ".stat_tx_total_packets").get_counter()}
 
 {
   INFO("VirtioNet", "Driver initializing");
@@ -230,7 +230,7 @@ void VirtioNet::msix_conf_handler()
 }
 void VirtioNet::msix_recv_handler()
 {
-  auto rx = stat_packets_rx_total_;
+  uint32_t rx = 0;
   rx_q.disable_interrupts();
   // handle incoming packets as long as bufstore has available buffers
   int max = 128;
@@ -241,8 +241,9 @@ void VirtioNet::msix_recv_handler()
     auto pckt = recv_packet(res.data(), res.size());
 
     // Stat increase packets received
-    stat_packets_rx_total_++;
+    ++stat_packets_rx_total_;
     stat_bytes_rx_total_ += pckt->size();
+    rx++;
 
     Link::receive(std::move(pckt));
 
@@ -255,7 +256,11 @@ void VirtioNet::msix_recv_handler()
     add_receive_buffer(bufstore().get_buffer());
   }
   rx_q.enable_interrupts();
-  if (rx != stat_packets_rx_total_) rx_q.kick();
+  if (rx > 0) {
+    record_rx_batch(rx);
+    rx_q.kick();
+    rx_batch_done();
+  }
 }
 void VirtioNet::msix_xmit_handler()
 {
@@ -356,7 +361,7 @@ void VirtioNet::transmit(net::Packet_ptr pckt)
   if (sendq.size() > stat_sendq_max_)
     stat_sendq_max_ = sendq.size();
 
-  auto tx = this->stat_packets_tx_total_;
+  uint32_t tx = 0;
 
   VDBG_TX("[virtionet] tx: packets in send queue %#zu\n",
           sendq.size());
@@ -372,14 +377,14 @@ void VirtioNet::transmit(net::Packet_ptr pckt)
     enqueue_tx(next);
 
     // Increase TX-stats
-    stat_packets_tx_total_++;
+    ++stat_packets_tx_total_;
     stat_bytes_tx_total_ += next->size();
-    stat_packets_tx_total_++;
+    tx++;
   }
 
   VDBG_TX("[virtionet] tx: packet enqueued\n");
 
-  if (tx != this->stat_packets_tx_total_) {
+  if (tx > 0) {
 #ifdef NO_DEFERRED_KICK
     tx_q.kick();
 #else
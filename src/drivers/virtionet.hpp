@@ -240,10 +240,10 @@ private:
   uint64_t& stat_sendq_now_;
   uint64_t& stat_sendq_limit_dropped_;
   uint64_t& stat_rx_refill_dropped_;
-  uint64_t& stat_bytes_rx_total_;
-  uint64_t& stat_bytes_tx_total_;
-  uint64_t& stat_packets_rx_total_;
-  uint64_t& stat_packets_tx_total_;
+  Stat_counter& stat_bytes_rx_total_;
+  Stat_counter& stat_bytes_tx_total_;
+  Stat_counter& stat_packets_rx_total_;
+  Stat_counter& stat_packets_tx_total_;
 
   std::deque<net::Packet_ptr> sendq{};
 
@@ -127,10 +127,10 @@ vmxnet3::vmxnet3(hw::PCI_Device& d, const uint16_t mtu) :
     stat_sendq_max{Statman::get().create(Stat::UINT32, device_name() + ".sendq_max").get_uint32()},
 
     //TODO make some of these stats generic and put them into LINK object so that they can be seen on all networking drivers
-    stat_tx_total_packets{Statman::get().create(Stat::UINT64, device_name() + ".stat_tx_total_packets").get_uint64()},
-    stat_tx_total_bytes{Statman::get().create(Stat::UINT64, device_name() + ".stat_tx_total_bytes").get_uint64()},
-    stat_rx_total_packets{Statman::get().create(Stat::UINT64, device_name() + ".stat_rx_total_packets").get_uint64()},
-    stat_rx_total_bytes{Statman::get().create(Stat::UINT64, device_name() + ".stat_rx_total_bytes").get_uint64()},
+    stat_tx_total_packets{Statman::get().create(Stat::COUNTER, device_name() + ".stat_tx_total_packets").get_counter()},
+    stat_tx_total_bytes{Statman::get().create(Stat::COUNTER, device_name() + ".stat_tx_total_bytes").get_counter()},
+    stat_rx_total_packets{Statman::get().create(Stat::COUNTER, device_name() + ".stat_rx_total_packets").get_counter()},
+    stat_rx_total_bytes{Statman::get().create(Stat::COUNTER, device_name() + ".stat_rx_total_bytes").get_counter()},
     stat_rx_zero_dropped{Statman::get().create(Stat::UINT64, device_name() + ".stat_rx_zero_dropped").get_uint64()},
 
     stat_rx_refill_dropped{Statman::get().create(Stat::UINT64, device_name() + ".rx_refill_dropped").get_uint64()},
@@ -542,7 +542,7 @@ bool vmxnet3::receive_handler(const int Q)
     assert(rx[Q].buffers[desc] != nullptr);
     recvq.push_back(recv_packet(rx[Q].buffers[desc], len));
 
-    stat_rx_total_packets++;
+    ++stat_rx_total_packets;
     stat_rx_total_bytes+=len;
 
     rx[Q].buffers[desc] = nullptr;
@@ -551,11 +551,14 @@ bool vmxnet3::receive_handler(const int Q)
   // refill always
   if (!recvq.empty()) {
     this->refill(rx[Q]);
+    record_rx_batch(recvq.size());
   }
   // handle packets
   for (auto& pckt : recvq) {
     Link::receive(std::move(pckt));
   }
+  if (!recvq.empty())
+    rx_batch_done();
   return recvq.empty() == false;
 }
 
@@ -622,7 +625,7 @@ void vmxnet3::transmit_data(uint8_t* data, uint16_t data_length)
   desc.flags[0] = gen | data_length;
   desc.flags[1] = VMXNET3_TXF_CQ | VMXNET3_TXF_EOP;
 
-  stat_tx_total_packets++;
+  ++stat_tx_total_packets;
   stat_tx_total_bytes+=data_length;
 }
 
@@ -20,6 +20,7 @@
 #include <net/ethernet/ethernet_8021q.hpp>
 #include <deque>
 #include <vector>
+class Stat_counter;
 struct vmxnet3_dma;
 struct vmxnet3_rx_desc;
 struct vmxnet3_rx_comp;
@@ -145,10 +146,10 @@ private:
   // sendq as double-ended q
   uint32_t& stat_sendq_cur;
   uint32_t& stat_sendq_max;
-  uint64_t& stat_tx_total_packets;
-  uint64_t& stat_tx_total_bytes;
-  uint64_t& stat_rx_total_packets;
-  uint64_t& stat_rx_total_bytes;
+  Stat_counter& stat_tx_total_packets;
+  Stat_counter& stat_tx_total_bytes;
+  Stat_counter& stat_rx_total_packets;
+  Stat_counter& stat_rx_total_bytes;
   uint64_t& stat_rx_zero_dropped;
   uint64_t& stat_rx_refill_dropped;
   uint64_t& stat_sendq_dropped;
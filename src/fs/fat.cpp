@@ -19,6 +19,7 @@
 #include <fs/fat_internal.hpp>
 
 #include <fs/mbr.hpp>
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <locale>
@@ -288,4 +289,126 @@ namespace fs
     return found_last;
   }
 
+  uint32_t FAT::fat_entry(const uint8_t* data, uint32_t cl) const
+  {
+    const uint8_t* ptr = data + cl_to_entry_offset(cl);
+    switch (this->fat_type) {
+    case FAT::T_FAT12: {
+        uint16_t val;
+        memcpy(&val, ptr, sizeof(val));
+        return (cl & 1) ? (val >> 4) : (val & 0xFFF);
+      }
+    case FAT::T_FAT16: {
+        uint16_t val;
+        memcpy(&val, ptr, sizeof(val));
+        return val;
+      }
+    default: {
+        uint32_t val;
+        memcpy(&val, ptr, sizeof(val));
+        return val & 0x0FFFFFFF;
+      }
+    }
+  }
+
+  bool FAT::is_chain_end(uint32_t entry) const noexcept
+  {
+    // end-of-chain and bad cluster markers are all above the
+    // highest valid cluster, and free clusters mean a broken chain
+    return entry < 2 || entry >= this->clusters + 2;
+  }
+
+  FAT::Chain FAT::new_chain(const Dirent& ent) const
+  {
+    Chain chain;
+    chain.cluster = ent.block();
+    chain.total   = (ent.size() + cluster_size() - 1) / cluster_size();
+    chain.length  = 0;
+    if (chain.total > 0) {
+      chain.extents.push_back({0, chain.cluster, 1});
+      chain.length = 1;
+    }
+    return chain;
+  }
+
+  bool FAT::chain_step(Chain& chain, uint64_t sector, const uint8_t* data) const
+  {
+    while (chain.length < chain.total)
+    {
+      // the next entry is in another FAT sector
+      if (lba_base + cl_to_entry_sector(chain.cluster) != sector)
+        return false;
+
+      const uint32_t next = fat_entry(data, chain.cluster);
+      if (UNLIKELY(is_chain_end(next))) {
+        FS_PRINT("Cluster chain ends early at %u\n", chain.cluster);
+        return true;
+      }
+      // extend the current run, or start a new one
+      auto& last = chain.extents.back();
+      if (next == last.cluster + last.count)
+        last.count++;
+      else
+        chain.extents.push_back({chain.length, next, 1});
+
+      chain.cluster = next;
+      chain.length++;
+    }
+    return true;
+  }
+
+  FAT::Extent_ptr FAT::cached_extents(const Dirent& ent) const
+  {
+    auto it = extent_cache.find(ent.block());
+    if (it == extent_cache.end()) return nullptr;
+    // make sure the cached chain covers the whole file
+    const auto& ext = it->second->back();
+    const uint64_t covered = (uint64_t) (ext.index + ext.count) * cluster_size();
+    if (covered < ent.size()) return nullptr;
+    return it->second;
+  }
+
+  FAT::Extent_ptr FAT::store_extents(uint32_t first, Extent_map map) const
+  {
+    auto ptr = std::make_shared<const Extent_map> (std::move(map));
+    // empty files have no chain to remember
+    if (ptr->empty()) return ptr;
+
+    if (extent_cache.size() >= EXTENT_CACHE_MAX)
+        extent_cache.clear();
+    extent_cache[first] = ptr;
+    return ptr;
+  }
+
+  FAT::Sector_runs FAT::map_sectors(const Extent_map& map, uint32_t sector, uint32_t nsect) const
+  {
+    Sector_runs runs;
+    uint32_t cl  = sector / sectors_per_cluster;
+    uint32_t ofs = sector % sectors_per_cluster;
+
+    // find the extent containing the first cluster
+    auto it = std::upper_bound(map.begin(), map.end(), cl,
+        [] (uint32_t cl, const Extent& ext) { return cl < ext.index; });
+    if (it == map.begin()) return {};
+    --it;
+
+    while (nsect > 0)
+    {
+      // the chain doesn't cover the requested range
+      if (it == map.end() || cl >= it->index + it->count) return {};
+
+      const uint64_t start = cl_to_sector(it->cluster + (cl - it->index)) + ofs;
+      const uint32_t avail = (it->index + it->count - cl) * sectors_per_cluster - ofs;
+      const uint32_t len   = std::min(avail, nsect);
+      // extents are never adjacent on disk, so each one is a separate read
+      runs.emplace_back(start, len);
+      nsect -= len;
+
+      ++it;
+      if (it != map.end()) cl = it->index;
+      ofs = 0;
+    }
+    return runs;
+  }
+
 }
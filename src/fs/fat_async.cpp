@@ -176,6 +176,53 @@ namespace fs
     int_ls(S, dirents, on_ls);
   }
 
+  void FAT::extents(const Dirent& ent, on_extents_func callback) const
+  {
+    auto cached = cached_extents(ent);
+    if (cached != nullptr) {
+      callback(no_error, std::move(cached));
+      return;
+    }
+
+    auto chain = std::make_shared<Chain> (new_chain(ent));
+    const uint32_t first = ent.block();
+    if (chain->length >= chain->total) {
+      callback(no_error, store_extents(first, std::move(chain->extents)));
+      return;
+    }
+
+    // follow the cluster chain FAT sector by FAT sector
+    typedef delegate<void()> next_func_t;
+
+    auto next = std::make_shared<next_func_t> ();
+    auto weak_next = std::weak_ptr<next_func_t>(next);
+    *next = next_func_t::make_packed(
+    [this, chain, first, callback, weak_next] ()
+    {
+      const uint64_t sector = lba_base + cl_to_entry_sector(chain->cluster);
+      FS_PRINT("extents: cl=%u fat sector=%lu\n", chain->cluster, sector);
+      auto next = weak_next.lock();
+      device.read(
+        sector,
+        fat_read_sectors(),
+        hw::Block_device::on_read_func::make_packed(
+        [this, chain, first, callback, next, sector] (buffer_t data)
+        {
+          if (data == nullptr) {
+            callback({ error_t::E_IO, "Unable to read FAT" }, nullptr);
+            return;
+          }
+          if (chain_step(*chain, sector, data->data()))
+            callback(no_error, store_extents(first, std::move(chain->extents)));
+          else
+            (*next)();
+        })
+      );
+    });
+
+    (*next)();
+  }
+
   void FAT::read(const Dirent& ent, uint64_t pos, uint64_t n, on_read_func callback) const
   {
     // when n=0 roundup() will return an invalid value
@@ -188,36 +235,79 @@ namespace fs
     uint32_t endpos = std::min(ent.size(), pos + n);
     // new length
     n = endpos - stapos;
+    if (n == 0) {
+      callback(no_error, construct_buffer());
+      return;
+    }
     // calculate start and length in sectors
     uint32_t sector = stapos / this->sector_size;
     uint32_t nsect = roundup(endpos, sector_size) / sector_size - sector;
     uint32_t internal_ofs = stapos % device.block_size();
 
-    // cluster -> sector + position
-    device.read(
-      this->cl_to_sector(ent.block()) + sector,
-      nsect,
-      hw::Block_device::on_read_func::make_packed(
-      [n, callback, internal_ofs] (buffer_t data)
+    extents(ent,
+      on_extents_func::make_packed(
+      [this, sector, nsect, n, internal_ofs, callback] (error_t err, Extent_ptr map)
       {
-        if (!data) {
-          // general I/O error occurred
-          callback({ error_t::E_IO, "Unable to read file" }, nullptr);
+        if (UNLIKELY(err)) {
+          callback(err, nullptr);
           return;
         }
-
-        // when the offset is non-zero we aren't on a sector boundary
-        if (internal_ofs != 0) {
-          // so, we need to create new buffer with offset data
-          data = construct_buffer(data->begin() + internal_ofs, data->begin() + internal_ofs + n);
-        }
-        else {
-          // when not offset all we have to do is resize the buffer down from
-          // a sector size multiple to its given length
-          data->resize(n);
+        // each contiguous run of clusters is one device read
+        auto runs = map_sectors(*map, sector, nsect);
+        if (UNLIKELY(runs.empty())) {
+          callback({ error_t::E_IO, "Cluster chain is shorter than file" }, nullptr);
+          return;
         }
 
-        callback(no_error, data);
+        struct read_state {
+          std::vector<buffer_t> parts;
+          size_t pending;
+          bool   failed = false;
+        };
+        auto state = std::make_shared<read_state> ();
+        state->parts.resize(runs.size());
+        state->pending = runs.size();
+
+        for (size_t i = 0; i < runs.size(); i++)
+        {
+          device.read(
+            runs[i].first,
+            runs[i].second,
+            hw::Block_device::on_read_func::make_packed(
+            [state, i, n, callback, internal_ofs] (buffer_t data)
+            {
+              if (!data) state->failed = true;
+              state->parts[i] = std::move(data);
+              if (--state->pending > 0) return;
+
+              if (state->failed) {
+                // general I/O error occurred
+                callback({ error_t::E_IO, "Unable to read file" }, nullptr);
+                return;
+              }
+
+              buffer_t result = std::move(state->parts[0]);
+              // stitch fragmented files back together
+              for (size_t p = 1; p < state->parts.size(); p++) {
+                auto& part = *state->parts[p];
+                result->insert(result->end(), part.begin(), part.end());
+              }
+
+              // when the offset is non-zero we aren't on a sector boundary
+              if (internal_ofs != 0) {
+                // so, we need to create new buffer with offset data
+                result = construct_buffer(result->begin() + internal_ofs, result->begin() + internal_ofs + n);
+              }
+              else {
+                // when not offset all we have to do is resize the buffer down from
+                // a sector size multiple to its given length
+                result->resize(n);
+              }
+
+              callback(no_error, result);
+            })
+          );
+        }
       })
     );
   }
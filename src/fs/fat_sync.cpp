@@ -33,6 +33,25 @@ inline size_t roundup(size_t n, size_t multiple)
 
 namespace fs
 {
+  error_t FAT::extents(const Dirent& ent, Extent_ptr& result) const
+  {
+    result = cached_extents(ent);
+    if (result != nullptr) return no_error;
+
+    Chain chain = new_chain(ent);
+    while (chain.length < chain.total)
+    {
+      const uint64_t sector = lba_base + cl_to_entry_sector(chain.cluster);
+      buffer_t data = device.read_sync(sector, fat_read_sectors());
+      if (UNLIKELY(!data))
+          return { error_t::E_IO, "Unable to read FAT" };
+      if (chain_step(chain, sector, data->data()))
+          break;
+    }
+    result = store_extents(ent.block(), std::move(chain.extents));
+    return no_error;
+  }
+
   Buffer FAT::read(const Dirent& ent, uint64_t pos, uint64_t n) const
   {
     // bounds check the read position and length
@@ -40,12 +59,30 @@ namespace fs
     auto endpos = std::min(ent.size(), pos + n);
     // new length
     n = endpos - stapos;
+    if (n == 0)
+      return Buffer(no_error, construct_buffer());
     // cluster -> sector + position
     auto sector = stapos / this->sector_size;
     auto nsect = roundup(endpos, sector_size) / sector_size - sector;
 
-    // read @nsect sectors ahead
-    buffer_t data = device.read_sync(this->cl_to_sector(ent.block()) + sector, nsect);
+    Extent_ptr map;
+    auto err = extents(ent, map);
+    if (UNLIKELY(err))
+      return Buffer(err, nullptr);
+    // each contiguous run of clusters is one device read
+    auto runs = map_sectors(*map, sector, nsect);
+    if (UNLIKELY(runs.empty()))
+      return Buffer({ error_t::E_IO, "Cluster chain is shorter than file" }, nullptr);
+
+    buffer_t data = device.read_sync(runs[0].first, runs[0].second);
+    for (size_t i = 1; data && i < runs.size(); i++) {
+      auto part = device.read_sync(runs[i].first, runs[i].second);
+      if (!part) data = nullptr;
+      else data->insert(data->end(), part->begin(), part->end());
+    }
+    if (UNLIKELY(!data))
+      return Buffer({ error_t::E_IO, "Unable to read file" }, nullptr);
+
     // where to start copying from the device result
     auto internal_ofs = stapos % device.block_size();
     // when the offset is non-zero we aren't on a sector boundary
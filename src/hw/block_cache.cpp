@@ -0,0 +1,477 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <hw/block_cache.hpp>
+#include <common>
+#include <statman>
+#include <algorithm>
+#include <cstring>
+
+namespace hw {
+
+  static uint64_t& cache_stat(const Block_device& dev, const char* what)
+  {
+    return Statman::get().create(Stat::UINT64,
+        dev.device_name() + ".cache." + what).get_uint64();
+  }
+
+  Block_cache::Block_cache(Block_device& dev, size_t capacity)
+    : Block_cache(dev, nullptr, capacity) {}
+
+  Block_cache::Block_cache(Writable_Block_device& dev, size_t capacity)
+    : Block_cache(dev, &dev, capacity) {}
+
+  Block_cache::Block_cache(Block_device& dev, Writable_Block_device* wdev,
+                           size_t capacity)
+    : Writable_Block_device(),
+      dev_{dev}, wdev_{wdev}, capacity_{capacity},
+      stat_hits(cache_stat(dev, "hits")),
+      stat_misses(cache_stat(dev, "misses")),
+      stat_read_ahead(cache_stat(dev, "read_ahead")),
+      stat_evictions(cache_stat(dev, "evictions")),
+      stat_writebacks(cache_stat(dev, "writebacks")),
+      stat_write_errors(cache_stat(dev, "write_errors"))
+  {
+    Expects(capacity_ > 0);
+    index_.reserve(capacity_);
+  }
+
+  Block_cache::~Block_cache()
+  {
+    this->flush();
+  }
+
+  Block_cache::Entry* Block_cache::lookup(block_t blk)
+  {
+    auto it = index_.find(blk);
+    if (it == index_.end()) return nullptr;
+    // move to front of LRU
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return &*it->second;
+  }
+
+  bool Block_cache::all_cached(block_t blk, size_t count)
+  {
+    for (size_t i = 0; i < count; i++)
+      if (index_.count(blk + i) == 0) return false;
+    return true;
+  }
+
+  void Block_cache::mark_clean(block_t blk, uint64_t gen)
+  {
+    auto it = index_.find(blk);
+    if (it != index_.end() && it->second->dirty && it->second->gen == gen) {
+      it->second->dirty = false;
+      dirty_--;
+    }
+  }
+
+  bool Block_cache::write_back(Entry& entry, bool sync)
+  {
+    if (entry.writing) return false;
+    const block_t  blk = entry.blk;
+    const uint64_t gen = entry.gen;
+    auto data = std::make_shared<os::mem::buffer>(entry.data.begin(), entry.data.end());
+    stat_writebacks++;
+    if (sync) {
+      if (wdev_->write_sync(blk, std::move(data))) {
+        stat_write_errors++;
+        return false;
+      }
+      mark_clean(blk, gen);
+      return true;
+    }
+    entry.writing = true;
+    wdev_->write(blk, std::move(data),
+      on_write_func::make_packed(
+      [this, alive = std::weak_ptr<bool>(alive_), blk, gen] (bool error) {
+        if (alive.expired()) return;
+        auto it = index_.find(blk);
+        if (it != index_.end()) it->second->writing = false;
+        if (error) stat_write_errors++;
+        else mark_clean(blk, gen);
+      }));
+    // the device may have completed the write already
+    return not entry.dirty;
+  }
+
+  void Block_cache::retire(Entry& entry)
+  {
+    Expects(not entry.dirty);
+    index_.erase(entry.blk);
+    stat_evictions++;
+  }
+
+  Block_cache::lru_list::iterator Block_cache::victim(bool sync)
+  {
+    for (auto it = lru_.rbegin(); it != lru_.rend(); ++it)
+    {
+      if (it->dirty && not write_back(*it, sync)) continue;
+      return std::prev(it.base());
+    }
+    return lru_.end();
+  }
+
+  bool Block_cache::evict_one(bool sync)
+  {
+    auto it = victim(sync);
+    if (it == lru_.end()) return false;
+    retire(*it);
+    lru_.erase(it);
+    return true;
+  }
+
+  Block_cache::Entry& Block_cache::insert(block_t blk, const uint8_t* data,
+                                          bool hot, bool sync)
+  {
+    const auto pos = hot ? lru_.begin() : lru_.end();
+    lru_list::iterator it = lru_.end();
+    // recycle the least recently used clean entry and its buffer
+    if (index_.size() >= capacity_)
+      it = victim(sync);
+    if (it != lru_.end()) {
+      retire(*it);
+      lru_.splice(pos, lru_, it);
+    }
+    else {
+      it = lru_.emplace(pos);
+      it->data.resize(block_size());
+    }
+    it->blk     = blk;
+    it->dirty   = false;
+    it->writing = false;
+    std::memcpy(it->data.data(), data, it->data.size());
+    index_.emplace(blk, it);
+    return *it;
+  }
+
+  Block_cache::buffer_t Block_cache::assemble(block_t blk, size_t count,
+                                              const buffer_t& dev_data, block_t dev_blk)
+  {
+    const auto bs = block_size();
+    auto result = std::make_shared<os::mem::buffer> (count * bs);
+    for (size_t i = 0; i < count; i++)
+    {
+      uint8_t* dst = result->data() + i * bs;
+      // cached blocks are always at least as new as the device data
+      auto* entry = lookup(blk + i);
+      if (entry != nullptr) {
+        std::memcpy(dst, entry->data.data(), bs);
+      }
+      else {
+        Expects(dev_data != nullptr);
+        std::memcpy(dst, dev_data->data() + (blk + i - dev_blk) * bs, bs);
+      }
+    }
+    return result;
+  }
+
+  void Block_cache::fill(block_t blk, const buffer_t& data,
+                         block_t hot_begin, block_t hot_end)
+  {
+    const auto bs = block_size();
+    const size_t count = data->size() / bs;
+    // make room for the whole batch up front, so that cold blocks
+    // from the same read don't end up evicting each other
+    size_t fresh = 0;
+    for (size_t i = 0; i < count; i++)
+      if (index_.count(blk + i) == 0) fresh++;
+    fresh = std::min(fresh, capacity_);
+    while (not lru_.empty() && index_.size() + fresh > capacity_)
+      if (not evict_one(false)) break;
+
+    for (size_t i = 0; i < count; i++)
+    {
+      const block_t b = blk + i;
+      const bool hot = b >= hot_begin && b < hot_end;
+      auto it = index_.find(b);
+      if (it != index_.end()) {
+        // never overwrite cached data, it may be dirty
+        if (hot) lru_.splice(lru_.begin(), lru_, it->second);
+        continue;
+      }
+      // cold blocks only go into free slots
+      if (not hot && index_.size() >= capacity_) continue;
+      insert(b, data->data() + i * bs, hot, false);
+    }
+  }
+
+  size_t Block_cache::update_sequential(block_t blk, size_t count)
+  {
+    if (ra_max_ == 0) return 0;
+    if (blk == next_seq_) {
+      // grow the window for every sequential access
+      if (ra_window_ == 0)
+        ra_window_ = std::max<size_t>(count, 4);
+      else
+        ra_window_ *= 2;
+      ra_window_ = std::min(ra_window_, ra_max_);
+    }
+    else {
+      ra_window_ = 0;
+      ra_end_    = 0;
+    }
+    next_seq_ = blk + count;
+    return ra_window_;
+  }
+
+  void Block_cache::read_ahead(block_t blk, size_t count)
+  {
+    // skip blocks we already have
+    while (count > 0 && index_.count(blk)) { blk++; count--; }
+    if (count == 0) return;
+
+    ra_end_ = blk + count;
+    stat_read_ahead += count;
+    dev_.read(blk, count,
+      on_read_func::make_packed(
+      [this, alive = std::weak_ptr<bool>(alive_), blk] (buffer_t data)
+      {
+        if (alive.expired()) return;
+        if (data != nullptr) fill(blk, data, blk, blk);
+      }));
+  }
+
+  void Block_cache::read(block_t blk, size_t count, on_read_func reader)
+  {
+    if (UNLIKELY(count == 0 || blk + count > size())) {
+      reader(nullptr);
+      return;
+    }
+    const block_t end    = blk + count;
+    const size_t  window = update_sequential(blk, count);
+    const block_t ra_to  = std::min<block_t>(end + window, size());
+
+    if (all_cached(blk, count))
+    {
+      stat_hits += count;
+      auto result = assemble(blk, count);
+      // keep the stream ahead of the reader by requesting another
+      // window when less than half of the current one remains
+      if (window > 0 && ra_end_ < end + window / 2) {
+        const block_t from = std::max(end, ra_end_);
+        const block_t to   = std::min<block_t>(from + window, size());
+        if (to > from) read_ahead(from, to - from);
+      }
+      reader(std::move(result));
+      return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      if (index_.count(blk + i)) stat_hits++;
+      else stat_misses++;
+    }
+    // extend the device read with the read-ahead window
+    const block_t dev_end = std::max(end, ra_to);
+    if (dev_end > end) {
+      stat_read_ahead += dev_end - end;
+      ra_end_ = dev_end;
+    }
+
+    dev_.read(blk, dev_end - blk,
+      on_read_func::make_packed(
+      [this, alive = std::weak_ptr<bool>(alive_), blk, count,
+       bytes = count * block_size(), reader] (buffer_t data)
+      {
+        if (data == nullptr || data->size() < bytes) {
+          reader(nullptr);
+          return;
+        }
+        if (alive.expired()) {
+          // everything was written back on destruction, the device is current
+          if (data->size() > bytes)
+            data = std::make_shared<os::mem::buffer>(data->begin(), data->begin() + bytes);
+          reader(std::move(data));
+          return;
+        }
+        auto result = assemble(blk, count, data, blk);
+        fill(blk, data, blk, blk + count);
+        reader(std::move(result));
+      }));
+  }
+
+  Block_cache::buffer_t Block_cache::read_sync(block_t blk, size_t count)
+  {
+    if (UNLIKELY(count == 0 || blk + count > size()))
+      return nullptr;
+
+    const block_t end    = blk + count;
+    const size_t  window = update_sequential(blk, count);
+
+    if (all_cached(blk, count)) {
+      stat_hits += count;
+      return assemble(blk, count);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      if (index_.count(blk + i)) stat_hits++;
+      else stat_misses++;
+    }
+    const block_t dev_end = std::max(end, std::min<block_t>(end + window, size()));
+    stat_read_ahead += dev_end - end;
+
+    auto data = dev_.read_sync(blk, dev_end - blk);
+    if (data == nullptr || data->size() < count * block_size())
+      return nullptr;
+
+    auto result = assemble(blk, count, data, blk);
+    fill(blk, data, blk, end);
+    return result;
+  }
+
+  bool Block_cache::write_blocks(block_t blk, const buffer_t& data, bool sync)
+  {
+    const auto bs = block_size();
+    if (wdev_ == nullptr || data == nullptr || data->size() % bs != 0)
+      return true;
+    const size_t count = data->size() / bs;
+    if (blk + count > size())
+      return true;
+
+    for (size_t i = 0; i < count; i++)
+    {
+      const uint8_t* src = data->data() + i * bs;
+      auto* entry = lookup(blk + i);
+      if (entry == nullptr)
+        entry = &insert(blk + i, src, true, sync);
+      else
+        std::memcpy(entry->data.data(), src, bs);
+
+      entry->gen = ++gen_;
+      if (not entry->dirty) {
+        entry->dirty = true;
+        dirty_++;
+      }
+    }
+    return false;
+  }
+
+  void Block_cache::write(block_t blk, buffer_t data, on_write_func callback)
+  {
+    callback(write_blocks(blk, data, false));
+  }
+
+  bool Block_cache::write_sync(block_t blk, buffer_t data)
+  {
+    return write_blocks(blk, data, true);
+  }
+
+  std::vector<Block_cache::Run> Block_cache::dirty_runs()
+  {
+    std::vector<Entry*> dirty;
+    dirty.reserve(dirty_);
+    for (auto& entry : lru_)
+      if (entry.dirty) dirty.push_back(&entry);
+
+    std::sort(dirty.begin(), dirty.end(),
+      [] (const Entry* a, const Entry* b) { return a->blk < b->blk; });
+
+    // coalesce contiguous blocks into single device writes
+    std::vector<Run> runs;
+    for (auto* entry : dirty)
+    {
+      if (runs.empty() ||
+          runs.back().blk + runs.back().gens.size() != entry->blk)
+      {
+        runs.push_back({entry->blk, std::make_shared<os::mem::buffer>(), {}});
+      }
+      auto& buf = *runs.back().data;
+      buf.insert(buf.end(), entry->data.begin(), entry->data.end());
+      runs.back().gens.push_back(entry->gen);
+    }
+    return runs;
+  }
+
+  void Block_cache::written(const Run& run)
+  {
+    for (size_t i = 0; i < run.gens.size(); i++)
+      mark_clean(run.blk + i, run.gens[i]);
+  }
+
+  void Block_cache::flush()
+  {
+    if (wdev_ == nullptr || dirty_ == 0) return;
+
+    for (auto& run : dirty_runs())
+    {
+      stat_writebacks += run.gens.size();
+      // failed blocks stay dirty for the next flush
+      if (wdev_->write_sync(run.blk, run.data))
+        stat_write_errors++;
+      else
+        written(run);
+    }
+  }
+
+  void Block_cache::flush(on_write_func on_done)
+  {
+    if (wdev_ == nullptr || dirty_ == 0) {
+      on_done(wdev_ == nullptr && dirty_ != 0);
+      return;
+    }
+
+    struct flush_state {
+      size_t        pending;
+      bool          error = false;
+      on_write_func callback;
+    };
+    auto runs  = dirty_runs();
+    auto state = std::make_shared<flush_state>();
+    state->pending  = runs.size();
+    state->callback = std::move(on_done);
+
+    for (auto& run : runs)
+    {
+      stat_writebacks += run.gens.size();
+      auto written_run = std::make_shared<Run>(std::move(run));
+      wdev_->write(written_run->blk, written_run->data,
+        on_write_func::make_packed(
+        [this, alive = std::weak_ptr<bool>(alive_), state, written_run] (bool error)
+        {
+          // the caller is still told when the cache is gone
+          const bool live = not alive.expired();
+          if (error) {
+            if (live) stat_write_errors++;
+            state->error = true;
+          }
+          else if (live) {
+            written(*written_run);
+          }
+          if (--state->pending == 0)
+            state->callback(state->error);
+        }));
+    }
+  }
+
+  void Block_cache::invalidate()
+  {
+    for (auto it = lru_.begin(); it != lru_.end(); )
+    {
+      if (it->dirty) { ++it; continue; }
+      index_.erase(it->blk);
+      it = lru_.erase(it);
+    }
+    ra_window_ = 0;
+    ra_end_    = 0;
+  }
+
+  void Block_cache::deactivate()
+  {
+    this->flush();
+    dev_.deactivate();
+  }
+
+} //< namespace hw
@@ -16,6 +16,7 @@
 // limitations under the License.
 
 #include <hw/nic.hpp>
+#include <statman>
 
 namespace hw
 {
@@ -25,4 +26,15 @@ namespace hw
     (void) idx;
     return default_MTU;
   }
+
+  void Nic::record_rx_batch(const uint32_t packets)
+  {
+    if (UNLIKELY(stat_rx_batch_ == nullptr))
+    {
+      // created on first use, as the name is not known when constructed
+      stat_rx_batch_ = &Statman::get().create(Stat::HISTOGRAM,
+                          device_name() + ".rx_batch").get_histogram();
+    }
+    stat_rx_batch_->record(packets);
+  }
 }
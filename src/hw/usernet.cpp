@@ -40,6 +40,7 @@ void UserNet::receive(net::Packet_ptr packet)
 {
   // wrap in packet, pass to Link-layer
   Link::receive( std::move(packet) );
+  rx_batch_done();
 }
 void UserNet::receive(void* data, net::BufferStore* bufstore)
 {
@@ -55,6 +56,7 @@ void UserNet::receive(void* data, net::BufferStore* bufstore)
       bufstore);
 
   Link::receive(net::Packet_ptr(ptr));
+  rx_batch_done();
 }
 void UserNet::receive(const void* data, int len)
 {
@@ -71,6 +73,18 @@ void UserNet::receive(const void* data, int len)
   memcpy(ptr->layer_begin(), data, len);
   // send to network stack
   Link::receive(net::Packet_ptr(ptr));
+  rx_batch_done();
+}
+void UserNet::receive_round(std::deque<net::Packet_ptr>& packets)
+{
+  // packets arriving meanwhile are part of the round
+  while (not packets.empty())
+  {
+    auto packet = std::move(packets.front());
+    packets.pop_front();
+    Link::receive(std::move(packet));
+  }
+  rx_batch_done();
 }
 
 // create new packet from nothing
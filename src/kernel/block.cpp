@@ -57,8 +57,9 @@ void os::block() noexcept
   if (*blocking_level > *highest_blocking_level)
     *highest_blocking_level = *blocking_level;
 
-  // Process immediate events
-  Events::get().process_events();
+  // Process immediate events, and any work left over by their budgets,
+  // which would otherwise wait for the next interrupt
+  while (Events::get().process_events());
 
   // Await next interrupt
   os::halt();
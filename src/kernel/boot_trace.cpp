@@ -0,0 +1,121 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <kernel/boot_trace.hpp>
+#include <os.hpp>
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+
+// recorded before global constructors run, so only zero-initialized data
+static Boot_trace::Phase trace_phases[Boot_trace::MAX_PHASES];
+static int  trace_count = 0;
+static bool trace_finished = false;
+
+static void end_current(uint64_t now) noexcept
+{
+  if (trace_count > 0 && trace_phases[trace_count-1].end == 0)
+      trace_phases[trace_count-1].end = now;
+}
+
+void Boot_trace::start(const char* name, uint64_t tsc) noexcept
+{
+  trace_count = 0;
+  trace_finished = false;
+  trace_phases[trace_count++] = {name, tsc, 0};
+}
+
+void Boot_trace::phase(const char* name) noexcept
+{
+  if (trace_finished) return;
+  const uint64_t now = os::cycles_since_boot();
+  // when the table is full the last phase absorbs the rest
+  if (trace_count == MAX_PHASES) return;
+  end_current(now);
+  trace_phases[trace_count++] = {name, now, 0};
+}
+
+void Boot_trace::finish() noexcept
+{
+  if (trace_finished) return;
+  end_current(os::cycles_since_boot());
+  trace_finished = true;
+}
+
+bool Boot_trace::finished() noexcept
+{
+  return trace_finished;
+}
+
+const Boot_trace::Phase* Boot_trace::phases() noexcept
+{
+  return trace_phases;
+}
+int Boot_trace::size() noexcept
+{
+  return trace_count;
+}
+
+uint64_t Boot_trace::total_cycles() noexcept
+{
+  if (trace_count == 0) return 0;
+  const auto& last = trace_phases[trace_count-1];
+  const uint64_t end = (last.end) ? last.end : os::cycles_since_boot();
+  return end - trace_phases[0].begin;
+}
+
+uint64_t Boot_trace::to_micros(uint64_t cycles) noexcept
+{
+  const double khz = os::cpu_freq().count();
+  if (khz <= 0) return 0;
+  return cycles * 1000.0 / khz;
+}
+
+std::string Boot_trace::to_json()
+{
+  char buffer[128];
+  snprintf(buffer, sizeof(buffer),
+           "{\"tsc_khz\":%" PRIu64 ",\"total_us\":%" PRIu64 ",\"phases\":[",
+           (uint64_t) std::max(0.0, os::cpu_freq().count()),
+           to_micros(total_cycles()));
+  std::string json = buffer;
+
+  for (int i = 0; i < trace_count; i++)
+  {
+    const auto& ph = trace_phases[i];
+    const uint64_t end = (ph.end) ? ph.end : os::cycles_since_boot();
+    snprintf(buffer, sizeof(buffer),
+             "%s{\"name\":\"%s\",\"start_us\":%" PRIu64 ",\"us\":%" PRIu64 "}",
+             (i > 0) ? "," : "", ph.name,
+             to_micros(ph.begin - trace_phases[0].begin),
+             to_micros(end - ph.begin));
+    json += buffer;
+  }
+  json += "]}";
+  return json;
+}
+
+void Boot_trace::print()
+{
+  const auto json = to_json();
+  printf("BOOT_TIMELINE %s\n", json.c_str());
+}
+
+void Boot_trace::reset() noexcept
+{
+  trace_count = 0;
+  trace_finished = false;
+}
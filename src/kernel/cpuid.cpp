@@ -336,6 +336,60 @@ bool CPUID::kvm_feature(unsigned mask) noexcept
   return (res.EAX & mask) != 0;
 }
 
+static uint32_t max_leaf() noexcept
+{
+  return cpuid(0, 0).EAX;
+}
+static bool is_hypervisor() noexcept
+{
+  return (cpuid(1, 0).ECX & (1u << 31)) != 0;
+}
+
+#define HYPERVISOR_TIMING_LEAF    0x40000010
+
+// EAX: TSC frequency in KHz, EBX: local APIC bus frequency in KHz
+static cpuid_t hypervisor_timing() noexcept
+{
+  if (is_hypervisor() && cpuid(0x40000000, 0).EAX >= HYPERVISOR_TIMING_LEAF)
+      return cpuid(HYPERVISOR_TIMING_LEAF, 0);
+  return {};
+}
+// core crystal clock in KHz, and the TSC/crystal ratio
+static uint32_t crystal_khz(uint32_t& numerator, uint32_t& denominator) noexcept
+{
+  numerator = denominator = 0;
+  if (max_leaf() < 0x15) return 0;
+  const auto res = cpuid(0x15, 0);
+  denominator = res.EAX;
+  numerator   = res.EBX;
+  if (res.ECX != 0) return res.ECX / 1000;
+  // the crystal is not enumerated, derive it from the base frequency
+  if (numerator != 0 && denominator != 0)
+      return uint64_t(CPUID::base_khz()) * denominator / numerator;
+  return 0;
+}
+
+uint32_t CPUID::tsc_khz() noexcept
+{
+  uint32_t num, den;
+  const uint32_t crystal = crystal_khz(num, den);
+  if (crystal != 0 && num != 0 && den != 0)
+      return uint64_t(crystal) * num / den;
+  return hypervisor_timing().EAX;
+}
+uint32_t CPUID::base_khz() noexcept
+{
+  if (max_leaf() < 0x16) return 0;
+  return (cpuid(0x16, 0).EAX & 0xffff) * 1000;
+}
+uint32_t CPUID::lapic_khz() noexcept
+{
+  uint32_t num, den;
+  const uint32_t crystal = crystal_khz(num, den);
+  if (crystal != 0) return crystal;
+  return hypervisor_timing().EBX;
+}
+
 std::vector<Feature> CPUID::detect_features() {
   std::vector<Feature> vec;
   for (const auto feat : feature_names) {
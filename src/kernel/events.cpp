@@ -18,8 +18,10 @@
 #include <kernel/events.hpp>
 #include <algorithm>
 #include <cassert>
+#include <climits>
 #include <statman>
 #include <smp>
+#include <os.hpp>
 //#define DEBUG_SMP
 
 static SMP::Array<Events> managers;
@@ -43,12 +45,19 @@ void Events::init_local()
   std::memset(event_subs.data(), 0, sizeof(event_subs));
   std::memset(event_pend.data(), 0, sizeof(event_pend));
 
-  if (SMP::cpu_id() == 0)
+  this->cpu = SMP::cpu_id();
+  if (this->cpu == 0)
   {
     // prevent legacy IRQs from being free for taking
     for (int evt = 0; evt < 32; evt++)
         event_subs[evt] = true;
   }
+
+  const std::string CPU = "cpu" + std::to_string(this->cpu);
+  stat_run     = &Statman::get().create(Stat::UINT64, CPU + ".events.deferred_run").get_uint64();
+  stat_depth   = &Statman::get().create(Stat::UINT64, CPU + ".events.deferred_depth").get_uint64();
+  stat_latency = &Statman::get().create(Stat::UINT64, CPU + ".events.deferred_latency_max").get_uint64();
+  stat_irq_latency = &Statman::get().create(Stat::HISTOGRAM, CPU + ".events.irq_latency_cycles").get_histogram();
 }
 
 uint8_t Events::subscribe(event_callback func)
@@ -94,30 +103,124 @@ void Events::unsubscribe(uint8_t evt)
   throw std::out_of_range("Event was not in sublist?");
 }
 
+void Events::set_budget(uint8_t evt, uint16_t budget)
+{
+  budgets.at(evt) = budget;
+}
+
+void Events::push_overflow(overflow_node* node) noexcept
+{
+  node->next.store(nullptr, std::memory_order_relaxed);
+  auto* prev = overflow_head.exchange(node, std::memory_order_acq_rel);
+  prev->next.store(node, std::memory_order_release);
+}
+
+Events::overflow_node* Events::pop_overflow() noexcept
+{
+  auto* tail = overflow_tail;
+  auto* next = tail->next.load(std::memory_order_acquire);
+  if (tail == &overflow_stub) {
+    if (next == nullptr) return nullptr;
+    overflow_tail = tail = next;
+    next = next->next.load(std::memory_order_acquire);
+  }
+  if (next != nullptr) {
+    overflow_tail = next;
+    return tail;
+  }
+  // a push is between taking the head and linking it in
+  if (tail != overflow_head.load(std::memory_order_acquire))
+    return nullptr;
+  push_overflow(&overflow_stub);
+  next = tail->next.load(std::memory_order_acquire);
+  if (next != nullptr) {
+    overflow_tail = next;
+    return tail;
+  }
+  return nullptr;
+}
+
 void Events::defer(event_callback callback)
 {
-  auto ev = subscribe(nullptr);
-  subscribe(ev, event_callback::make_packed(
-    [this, ev, callback] () {
-      callback();
-      // NOTE: we cant unsubscribe before after callback(),
-      // because unsubscribe() deallocates event storage
-      this->unsubscribe(ev);
-    }));
-  // and trigger it once
-  event_pend[ev] = true;
+  deferred_t entry {std::move(callback), os::cycles_since_boot()};
+  // keep the order of calls when the overflow is in use
+  if (overflow_size.load(std::memory_order_acquire) != 0
+      || defer_ring.try_push(std::move(entry)) == false)
+  {
+    auto* node = new overflow_node;
+    node->entry = std::move(entry);
+    overflow_size.fetch_add(1, std::memory_order_release);
+    push_overflow(node);
+    __sync_fetch_and_add(&dstats.overflowed, 1);
+  }
+#ifdef INCLUDEOS_SMP_ENABLE
+  // wake up the owner, which might be sleeping
+  if (this->cpu != SMP::cpu_id()) {
+    if (this->cpu == 0) SMP::signal_bsp();
+    else SMP::signal(this->cpu);
+  }
+#endif
+}
+
+void Events::run_deferred(int& budget)
+{
+  const size_t depth = deferred_pending();
+  if (depth > dstats.max_depth) dstats.max_depth = depth;
+
+  deferred_t entry;
+  while (budget > 0)
+  {
+    // calls in the ring are older than the ones in the overflow
+    if (defer_ring.try_pop(entry) == false)
+    {
+      if (overflow_size.load(std::memory_order_acquire) == 0) break;
+      auto* node = pop_overflow();
+      // still being pushed, pick it up the next round
+      if (node == nullptr) break;
+      entry = std::move(node->entry);
+      delete node;
+      overflow_size.fetch_sub(1, std::memory_order_release);
+    }
+    const uint64_t latency = os::cycles_since_boot() - entry.posted;
+    dstats.latency_total += latency;
+    if (latency > dstats.latency_max) dstats.latency_max = latency;
+    dstats.run++;
+    budget--;
+
+    entry.func();
+    entry.func.reset();
+  }
+}
+
+void Events::update_stats()
+{
+  if (stat_run == nullptr) return;
+  *stat_run     = dstats.run;
+  *stat_depth   = dstats.max_depth;
+  *stat_latency = dstats.latency_max;
 }
 
-void Events::process_events()
+bool Events::process_events()
 {
+  std::array<uint16_t, NUM_EVENTS> handled {};
+  int defer_left = (defer_budget > 0) ? defer_budget : INT_MAX;
   bool handled_any;
+  bool over_budget = false;
   do {
     handled_any = false;
 
     for (const uint8_t intr : sublist)
     if (event_pend[intr])
     {
+      if (budgets[intr] && handled[intr] >= budgets[intr]) {
+        // leave it pending for the next round
+        over_budget = true;
+        continue;
+      }
+      handled[intr]++;
       event_pend[intr] = false;
+      if (stat_irq_latency)
+          stat_irq_latency->record(os::cycles_since_boot() - raised_at[intr]);
       // call handler
 #ifdef DEBUG_SMP
       if (intr != 0) {
@@ -132,5 +235,19 @@ void Events::process_events()
       handled_array[intr]++;
       handled_any = true;
     }
+    // deferred work runs between rounds of events
+    if (deferred_pending() != 0)
+    {
+      run_deferred(defer_left);
+      if (defer_left == 0 && deferred_pending() != 0) {
+        // calls that defer themselves would otherwise never let go
+        over_budget = true;
+        break;
+      }
+      handled_any = true;
+    }
   } while (handled_any);
+
+  update_stats();
+  return over_budget;
 }
@@ -0,0 +1,214 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <kernel/executor.hpp>
+#include <kernel/events.hpp>
+#include <util/mpsc_ring.hpp>
+#include <util/work_deque.hpp>
+#include <smp>
+#include <algorithm>
+
+namespace {
+
+struct Task {
+  Executor::task_func func;
+  Executor::done_func done;
+  int origin;
+};
+
+struct alignas(SMP_ALIGN) Worker {
+  // tasks any CPU may run, only pushed by the owner
+  util::Work_deque<Task*, Executor::DEQUE_SIZE> deque;
+  // tasks for this CPU only, pushed by anyone
+  util::MPSC_ring<Task*, Executor::INBOX_SIZE>  inbox;
+  // a run is queued in Events, or running
+  std::atomic<bool> scheduled {false};
+  Executor::Stats stats;
+};
+
+struct Range_group {
+  Executor::range_func func;
+  Executor::done_func  done;
+  std::atomic<size_t>  left;
+  int origin;
+};
+
+SMP::Array<Worker> workers;
+
+int cpu_count()
+{
+#ifdef INCLUDEOS_SMP_ENABLE
+  return SMP::cpu_count();
+#else
+  return 1;
+#endif
+}
+int cpu_at(int index)
+{
+#ifdef INCLUDEOS_SMP_ENABLE
+  return SMP::active_cpus(index);
+#else
+  (void) index;
+  return 0;
+#endif
+}
+
+void run_task(Worker& worker, Task* task)
+{
+  task->func();
+  if (task->done) {
+    Events::get(task->origin).defer(std::move(task->done));
+  }
+  delete task;
+  worker.stats.run++;
+}
+
+void run_worker();
+
+void schedule(int cpu)
+{
+  auto& worker = workers[cpu];
+  if (worker.scheduled.exchange(true) == false) {
+    // wakes the CPU if it's not this one
+    Events::get(cpu).defer(run_worker);
+  }
+}
+
+// schedule a CPU that is not already busy, so that it will steal
+void wake_idle_peer(const int self)
+{
+  for (int i = 0; i < cpu_count(); i++)
+  {
+    const int cpu = cpu_at(i);
+    if (cpu != self && workers[cpu].scheduled.load(std::memory_order_relaxed) == false) {
+      schedule(cpu);
+      return;
+    }
+  }
+}
+
+bool try_steal(const int self, Task*& task)
+{
+  for (int i = 0; i < cpu_count(); i++)
+  {
+    const int cpu = cpu_at(i);
+    if (cpu != self && workers[cpu].deque.steal(task)) return true;
+  }
+  return false;
+}
+
+void run_worker()
+{
+  const int self = SMP::cpu_id();
+  auto& worker = workers[self];
+
+  Task* task;
+  for (int budget = Executor::RUN_BUDGET; budget > 0; budget--)
+  {
+    if (worker.inbox.try_pop(task) || worker.deque.pop(task)) {
+      run_task(worker, task);
+    }
+    else if (try_steal(self, task)) {
+      worker.stats.stolen++;
+      run_task(worker, task);
+    }
+    else break;
+  }
+
+  worker.scheduled.store(false);
+  // work may have arrived after the last look, while still scheduled
+  if (not worker.inbox.empty() || not worker.deque.empty()) {
+    schedule(self);
+  }
+}
+
+void enqueue_inbox(int cpu, Task* task)
+{
+  auto& worker = workers[cpu];
+  if (worker.inbox.try_push(std::move(task)) == false)
+  {
+    // Events has an unbounded overflow
+    __sync_fetch_and_add(&worker.stats.overflowed, 1);
+    Events::get(cpu).defer(
+      [task] { run_task(workers[SMP::cpu_id()], task); });
+    return;
+  }
+  schedule(cpu);
+}
+
+void enqueue_local(const int self, Task* task)
+{
+  if (workers[self].deque.push(task) == false) {
+    enqueue_inbox(self, task);
+    return;
+  }
+  schedule(self);
+}
+
+} // anonymous
+
+void Executor::submit(task_func func, done_func done)
+{
+  const int self = SMP::cpu_id();
+  enqueue_local(self, new Task{std::move(func), std::move(done), self});
+  wake_idle_peer(self);
+}
+
+void Executor::submit_to(int cpu, task_func func, done_func done)
+{
+  const int self = SMP::cpu_id();
+  enqueue_inbox(cpu, new Task{std::move(func), std::move(done), self});
+}
+
+void Executor::parallel_for(size_t begin, size_t end, range_func func,
+                            done_func done, size_t grain)
+{
+  const int self = SMP::cpu_id();
+  if (begin >= end) {
+    if (done) Events::get(self).defer(std::move(done));
+    return;
+  }
+  // a few chunks per CPU so that stealing can even out the load
+  const size_t total  = end - begin;
+  const size_t chunks = std::max<size_t>(1,
+        std::min<size_t>(total / std::max<size_t>(grain, 1), cpu_count() * 4));
+  const size_t size   = (total + chunks - 1) / chunks;
+
+  auto* group = new Range_group{std::move(func), std::move(done), {0}, self};
+  group->left.store((total + size - 1) / size);
+
+  for (size_t first = begin; first < end; first += size)
+  {
+    const size_t last = std::min(end, first + size);
+    auto chunk = [group, first, last] {
+      group->func(first, last);
+      if (group->left.fetch_sub(1) == 1)
+      {
+        if (group->done) Events::get(group->origin).defer(std::move(group->done));
+        delete group;
+      }
+    };
+    enqueue_local(self, new Task{chunk, nullptr, self});
+  }
+  // everyone that is idle should come and steal
+  for (int i = 1; i < std::min<int>(cpu_count(), chunks); i++)
+      wake_idle_peer(self);
+}
+
+const Executor::Stats& Executor::stats(int cpu)
+{
+  return workers.at(cpu).stats;
+}
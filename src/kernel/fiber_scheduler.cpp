@@ -0,0 +1,154 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <kernel/fiber_scheduler.hpp>
+#include <kernel/events.hpp>
+#include <common>
+#include <deque>
+
+struct Fiber_scheduler::Task {
+  Task(task_func f, int stack_size)
+    : func{std::move(f)}, fiber{stack_size, &Task::main, this} {}
+
+  static void main(Task* task) {
+    task->func();
+  }
+
+  task_func func;
+  Fiber     fiber;
+  bool      parked = false;
+  bool      woken  = false;
+};
+
+namespace {
+  struct alignas(SMP_ALIGN) Scheduler {
+    std::deque<Fiber_scheduler::Task*> run_queue;
+    Fiber_scheduler::Task* current = nullptr;
+    // stands in for the event loop stack when fibers yield back, and is
+    // never freed, as the stack pools may be gone before the schedulers
+    Fiber* root = nullptr;
+    size_t alive = 0;
+    bool scheduled = false;
+  };
+  SMP::Array<Scheduler> schedulers;
+}
+
+void Fiber_scheduler::schedule()
+{
+  auto& sched = PER_CPU(schedulers);
+  if (sched.scheduled) return;
+  sched.scheduled = true;
+  Events::get().defer(run_round);
+}
+
+void Fiber_scheduler::run_round()
+{
+  auto& sched = PER_CPU(schedulers);
+  sched.scheduled = false;
+  // eg. a fiber blocking in os::block(), come back later
+  if (Fiber::current() != nullptr) {
+    if (not sched.run_queue.empty()) schedule();
+    return;
+  }
+  if (sched.root == nullptr) {
+    sched.root = new Fiber(0, (void(*)()) nullptr);
+  }
+  auto& root = *sched.root;
+  PER_CPU(Fiber::current_) = &root;
+  root.suspended_ = true;
+
+  // each fiber runnable now gets one turn
+  for (size_t turns = sched.run_queue.size(); turns > 0; turns--)
+  {
+    auto* task = sched.run_queue.front();
+    sched.run_queue.pop_front();
+    sched.current = task;
+
+    if (task->fiber.started() == false) task->fiber.start();
+    else task->fiber.resume();
+
+    sched.current = nullptr;
+    if (task->fiber.done()) {
+      delete task;
+      sched.alive--;
+    }
+  }
+  PER_CPU(Fiber::current_) = nullptr;
+  root.suspended_ = false;
+
+  if (not sched.run_queue.empty()) schedule();
+}
+
+Fiber_scheduler::Task* Fiber_scheduler::spawn(task_func func, int stack_size)
+{
+  auto& sched = PER_CPU(schedulers);
+  auto* task = new Task(std::move(func), stack_size);
+  sched.alive++;
+  sched.run_queue.push_back(task);
+  schedule();
+  return task;
+}
+
+Fiber_scheduler::Task* Fiber_scheduler::current() noexcept
+{
+  return PER_CPU(schedulers).current;
+}
+
+void Fiber_scheduler::park()
+{
+  auto* task = current();
+  Expects(task != nullptr && "park() outside of a scheduled fiber");
+  if (task->woken) {
+    task->woken = false;
+    return;
+  }
+  task->parked = true;
+  Fiber::yield();
+  task->woken = false;
+}
+
+void Fiber_scheduler::wake(Task* task)
+{
+  Expects(task != nullptr);
+  if (task->parked == false) {
+    task->woken = true;
+    return;
+  }
+  auto& sched = PER_CPU(schedulers);
+  task->parked = false;
+  sched.run_queue.push_back(task);
+  schedule();
+}
+
+void Fiber_scheduler::yield()
+{
+  auto* task = current();
+  Expects(task != nullptr && "yield() outside of a scheduled fiber");
+  auto& sched = PER_CPU(schedulers);
+  sched.run_queue.push_back(task);
+  schedule();
+  Fiber::yield();
+}
+
+size_t Fiber_scheduler::alive() noexcept
+{
+  return PER_CPU(schedulers).alive;
+}
+
+size_t Fiber_scheduler::runnable() noexcept
+{
+  return PER_CPU(schedulers).run_queue.size();
+}
@@ -0,0 +1,122 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <kernel/fiber.hpp>
+#include <common>
+#include <util/bitops.hpp>
+#include <malloc.h>
+#include <unordered_map>
+#include <vector>
+#if defined(ARCH_x86_64) && !defined(UNITTESTS)
+#include <kernel/memory.hpp>
+#define FIBER_GUARD_PAGES
+#endif
+
+namespace {
+  struct alignas(SMP_ALIGN) Stack_pool {
+    // free stacks by size
+    std::unordered_map<int, std::vector<char*>> bins;
+    size_t pooled = 0;
+  };
+  SMP::Array<Stack_pool> pools;
+  size_t stacks_in_use = 0;
+  // decided by the first stack, and kept from then on, so that stacks
+  // are always given back the access they were guarded with
+  enum class Guards { unknown, on, off };
+#ifdef FIBER_GUARD_PAGES
+  Guards guards = Guards::unknown;
+#else
+  Guards guards = Guards::off;
+#endif
+
+  inline size_t usable_size(int size) {
+    // the top of the stack is aligned down to 16 bytes
+    return util::bits::roundto(Fiber_stack::guard_size, size + 16);
+  }
+
+  void set_guard(char* base, bool guard)
+  {
+#ifdef FIBER_GUARD_PAGES
+    if (guards == Guards::off) return;
+    using os::mem::Access;
+    try {
+      os::mem::protect((uintptr_t) base, Fiber_stack::guard_size,
+                       guard ? Access::none : Access::read | Access::write);
+      guards = Guards::on;
+    }
+    catch (const std::exception&) {
+      // memory not mapped with 4k pages, carry on without guards unless
+      // there are guarded stacks out there already. This stack is then
+      // left accessible, and taking off its guard fails the same way.
+      if (guards == Guards::unknown)
+        guards = Guards::off;
+    }
+#else
+    (void) base; (void) guard;
+#endif
+  }
+}
+
+char* Fiber_stack::alloc(int size)
+{
+  Expects(size >= 0);
+  __sync_fetch_and_add(&stacks_in_use, 1);
+  auto& pool = PER_CPU(pools);
+  auto it = pool.bins.find(size);
+  if (it != pool.bins.end() and not it->second.empty())
+  {
+    char* stack = it->second.back();
+    it->second.pop_back();
+    pool.pooled--;
+    return stack;
+  }
+  auto* base = (char*) memalign(guard_size, guard_size + usable_size(size));
+  if (UNLIKELY(base == nullptr)) throw std::bad_alloc();
+  set_guard(base, true);
+  return base + guard_size;
+}
+
+void Fiber_stack::free(char* stack, int size) noexcept
+{
+  if (stack == nullptr) return;
+  __sync_fetch_and_sub(&stacks_in_use, 1);
+  auto& pool = PER_CPU(pools);
+  auto& bin = pool.bins[size];
+  if (bin.size() < pool_max)
+  {
+    bin.push_back(stack);
+    pool.pooled++;
+    return;
+  }
+  char* base = stack - guard_size;
+  set_guard(base, false);
+  ::free(base);
+}
+
+size_t Fiber_stack::pooled() noexcept
+{
+  return PER_CPU(pools).pooled;
+}
+
+size_t Fiber_stack::in_use() noexcept
+{
+  return stacks_in_use;
+}
+
+bool Fiber_stack::guard_pages() noexcept
+{
+  return guards != Guards::off;
+}
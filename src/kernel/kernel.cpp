@@ -17,6 +17,7 @@
 
 #include <os.hpp>
 #include <kernel.hpp>
+#include <kernel/boot_trace.hpp>
 #include <kernel/cpuid.hpp>
 #include <kernel/rng.hpp>
 #include <service>
@@ -26,14 +27,6 @@
 #include <system_log>
 #define MYINFO(X,...) INFO("Kernel", X, ##__VA_ARGS__)
 
-//#define ENABLE_PROFILERS
-#ifdef ENABLE_PROFILERS
-#include <profile>
-#define PROFILE(name)  ScopedProfiler __CONCAT(sp, __COUNTER__){name};
-#else
-#define PROFILE(name) /* name */
-#endif
-
 using namespace util;
 
 extern char _start;
@@ -96,6 +89,7 @@ void os::shutdown() noexcept
 
 void kernel::post_start()
 {
+  Boot_trace::phase("post start");
   // Enable timestamps (if present)
   kernel::state().timestamps_ready = true;
 
@@ -107,7 +101,7 @@ void kernel::post_start()
   SystemLog::initialize();
 
   MYINFO("Initializing RNG");
-  PROFILE("RNG init");
+  Boot_trace::phase("RNG init");
   RNG::get().init();
 
   // Seed rand with 32 bits from RNG
@@ -120,7 +114,7 @@ void kernel::post_start()
 #endif
 
   // Run plugins
-  PROFILE("Plugins init");
+  Boot_trace::phase("plugins");
   for (auto plugin : plugins) {
     INFO2("* Initializing %s", plugin.name);
     plugin.func();
@@ -131,12 +125,13 @@ void kernel::post_start()
   // the boot sequence is over when we get to plugins/Service::start
   kernel::state().boot_sequence_passed = true;
 
+  Boot_trace::phase("service ctors");
 #ifndef __MACH__
     // Run service constructors
   kernel::run_ctors(&__service_ctors_start, &__service_ctors_end);
 #endif
 
-  PROFILE("Service::start");
+  Boot_trace::phase("Service::start");
   // begin service start
   FILLINE('=');
   printf(" IncludeOS %s (%s / %u-bit)\n",
@@ -166,6 +161,8 @@ void kernel::post_start()
 
   // service program start
   Service::start();
+  // until the timer system is ready and Service::ready() is called
+  Boot_trace::phase("event loop");
 }
 
 void os::add_stdout(os::print_func func)
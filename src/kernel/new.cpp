@@ -0,0 +1,119 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common>
+#include <kernel.hpp>
+#include <kernel/memory.hpp>
+#include <cstdlib>
+#include <new>
+
+/**
+ * Small objects from operator new come from the slab allocator, the rest
+ * from malloc. Every object has a header with its size, since operator
+ * delete is not always told, and where it came from, so that neither
+ * allocator is ever given the objects of the other. These are weak, so
+ * that a heap debugging driver can take over operator new and delete.
+ */
+namespace {
+  struct alignas(alignof(std::max_align_t)) New_header {
+    size_t size;
+    bool   slab;
+  };
+}
+
+__attribute__((weak))
+void* operator new(std::size_t size)
+{
+  using Slab = os::mem::Slab_allocator;
+  const size_t total = size + sizeof(New_header);
+  New_header* hdr = nullptr;
+  bool slab = false;
+  if (LIKELY(kernel::heap_ready()) and total <= Slab::max_size) {
+    hdr  = (New_header*) os::mem::slab_allocator().allocate(total);
+    slab = (hdr != nullptr);
+  }
+  if (hdr == nullptr)
+    hdr = (New_header*) malloc(total);
+  if (UNLIKELY(hdr == nullptr))
+    throw std::bad_alloc();
+  hdr->size = size;
+  hdr->slab = slab;
+  return hdr + 1;
+}
+
+__attribute__((weak))
+void operator delete(void* ptr) noexcept
+{
+  if (ptr == nullptr) return;
+  auto* hdr = (New_header*) ptr - 1;
+  if (hdr->slab)
+    os::mem::slab_allocator().deallocate(hdr, hdr->size + sizeof(New_header));
+  else
+    free(hdr);
+}
+
+__attribute__((weak))
+void* operator new[](std::size_t size)
+{
+  return ::operator new(size);
+}
+
+__attribute__((weak))
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+  try {
+    return ::operator new(size);
+  }
+  catch (const std::bad_alloc&) {
+    return nullptr;
+  }
+}
+
+__attribute__((weak))
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+  return ::operator new(size, std::nothrow);
+}
+
+__attribute__((weak))
+void operator delete[](void* ptr) noexcept
+{
+  ::operator delete(ptr);
+}
+
+__attribute__((weak))
+void operator delete(void* ptr, std::size_t) noexcept
+{
+  ::operator delete(ptr);
+}
+
+__attribute__((weak))
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+  ::operator delete(ptr);
+}
+
+__attribute__((weak))
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+  ::operator delete(ptr);
+}
+
+__attribute__((weak))
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+  ::operator delete(ptr);
+}
@@ -1,4 +1,5 @@
 #include <kernel/timers.hpp>
+#include <kernel/boot_trace.hpp>
 
 #include <os.hpp>
 #include <kernel/events.hpp>
@@ -84,6 +85,8 @@ struct alignas(SMP_ALIGN) timer_system
   int64_t*  oneshot_stopped = &dummy.i64;
   uint32_t* periodic_started = &dummy.u32;
   uint32_t* periodic_stopped = &dummy.u32;
+  // how late timers fire, in nanoseconds
+  Stat_histogram* lateness = nullptr;
 };
 static SMP::Array<timer_system> systems;
 
@@ -111,7 +114,7 @@ void Timers::init(const start_func_t& start, const stop_func_t& stop)
   system.oneshot_stopped = (int64_t*) &Statman::get().create(Stat::UINT64, CPU + ".timers.oneshot_stopped").get_uint64();
   system.periodic_started = &Statman::get().create(Stat::UINT32, CPU + ".timers.periodic_started").get_uint32();
   system.periodic_stopped = &Statman::get().create(Stat::UINT32, CPU + ".timers.periodic_stopped").get_uint32();
-
+  system.lateness = &Statman::get().create(Stat::HISTOGRAM, CPU + ".timers.lateness_ns").get_histogram();
 }
 
 bool Timers::is_ready()
@@ -128,7 +131,13 @@ void Timers::ready()
   if (SMP::cpu_id() == 0)
   {
     // call Service::ready(), because timer system is ready!
+    const bool booting = Boot_trace::size() > 0 && !Boot_trace::finished();
+    if (booting) Boot_trace::phase("Service::ready");
     Service::ready();
+    if (booting) {
+      Boot_trace::finish();
+      Boot_trace::print();
+    }
   }
 }
 
@@ -238,6 +247,7 @@ void Timers::timers_handler()
     if (ts_now >= when) {
       // erase immediately
       system.scheduled.erase(it);
+      if (system.lateness) system.lateness->record((ts_now - when).count());
 
       // call the users callback function
       system.timers[id].callback(id);
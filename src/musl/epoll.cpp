@@ -0,0 +1,93 @@
+#include "common.hpp"
+#include <sys/epoll.h>
+#include <signal.h>
+
+#include <posix/fd_map.hpp>
+#include <posix/epoll_fd.hpp>
+
+static Epoll_FD* get_epoll(int epfd)
+{
+  auto* fildes = FD_map::_get(epfd);
+  if (fildes == nullptr or not fildes->is_epoll())
+    return nullptr;
+  return static_cast<Epoll_FD*>(fildes);
+}
+
+static long sys_epoll_create1(int flags)
+{
+  if (UNLIKELY(flags & ~EPOLL_CLOEXEC))
+    return -EINVAL;
+  return FD_map::_open<Epoll_FD>().get_id();
+}
+
+static long sys_epoll_create(int size)
+{
+  // size is ignored, but must be positive
+  if (UNLIKELY(size <= 0))
+    return -EINVAL;
+  return sys_epoll_create1(0);
+}
+
+static long sys_epoll_ctl(int epfd, int op, int fd, struct epoll_event* event)
+{
+  auto* ep = get_epoll(epfd);
+  if (UNLIKELY(ep == nullptr))
+    return (FD_map::_get(epfd) == nullptr) ? -EBADF : -EINVAL;
+
+  auto* fildes = FD_map::_get(fd);
+  if (UNLIKELY(fildes == nullptr))
+    return -EBADF;
+
+  return ep->ctl(op, *fildes, event);
+}
+
+static long sys_epoll_pwait(int epfd, struct epoll_event* events,
+                            int maxevents, int timeout,
+                            const sigset_t* /*sigmask*/)
+{
+  auto* ep = get_epoll(epfd);
+  if (UNLIKELY(ep == nullptr))
+    return (FD_map::_get(epfd) == nullptr) ? -EBADF : -EINVAL;
+
+  if (UNLIKELY(events == nullptr))
+    return -EFAULT;
+
+  using namespace std::chrono;
+  return ep->wait(events, maxevents,
+      (timeout < 0) ? nanoseconds(-1) : milliseconds(timeout));
+}
+
+static long sys_epoll_wait(int epfd, struct epoll_event* events,
+                           int maxevents, int timeout)
+{
+  return sys_epoll_pwait(epfd, events, maxevents, timeout, nullptr);
+}
+
+extern "C" {
+long syscall_SYS_epoll_create(int size)
+{
+  return strace(sys_epoll_create, "epoll_create", size);
+}
+
+long syscall_SYS_epoll_create1(int flags)
+{
+  return strace(sys_epoll_create1, "epoll_create1", flags);
+}
+
+long syscall_SYS_epoll_ctl(int epfd, int op, int fd, struct epoll_event* event)
+{
+  return strace(sys_epoll_ctl, "epoll_ctl", epfd, op, fd, event);
+}
+
+long syscall_SYS_epoll_wait(int epfd, struct epoll_event* events,
+                            int maxevents, int timeout)
+{
+  return strace(sys_epoll_wait, "epoll_wait", epfd, events, maxevents, timeout);
+}
+
+long syscall_SYS_epoll_pwait(int epfd, struct epoll_event* events,
+                             int maxevents, int timeout, const sigset_t* sigmask)
+{
+  return strace(sys_epoll_pwait, "epoll_pwait", epfd, events, maxevents, timeout, sigmask);
+}
+} // extern "C"
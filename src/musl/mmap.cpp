@@ -9,30 +9,44 @@
 #include <kprint>
 
 using Alloc = os::mem::Raw_allocator;
+using Slab  = os::mem::Slab_allocator;
 static Alloc* alloc;
+static Slab*  slab_alloc;
+// buddy::Alloc is not thread safe, the slab allocator shares this lock
+static spinlock_t alloc_lock = 0;
+// constructed in __init_mmap, which runs before the global constructors
+alignas(Slab) static char slab_storage[sizeof(Slab)];
 
 Alloc& os::mem::raw_allocator() {
   Expects(alloc);
   return *alloc;
 }
 
+Slab& os::mem::slab_allocator() {
+  Expects(slab_alloc);
+  return *slab_alloc;
+}
+
 uintptr_t __init_mmap(uintptr_t addr_begin, size_t size)
 {
   auto aligned_begin = (addr_begin + Alloc::align - 1) & ~(Alloc::align - 1);
   int64_t len = size & ~int64_t(Alloc::align - 1);
 
   alloc = Alloc::create((void*)aligned_begin, len);
+  slab_alloc = new (slab_storage) Slab(*alloc, alloc_lock);
   return aligned_begin + len;
 }
 
 extern "C" __attribute__((weak))
 void* kalloc(size_t size) {
   Expects(kernel::heap_ready());
+  scoped_spinlock guard(alloc_lock);
   return alloc->allocate(size);
 }
 
 extern "C" __attribute__((weak))
 void kfree (void* ptr, size_t size) {
+  scoped_spinlock guard(alloc_lock);
   alloc->deallocate(ptr, size);
 }
 
@@ -1,32 +1,71 @@
-#include "stub.hpp"
+#include "common.hpp"
 #include <poll.h>
 #include <signal.h>
 
+#include <posix/fd_map.hpp>
 
-static long sys_poll(struct pollfd *fds, nfds_t nfds, int /*timeout*/)
+// stores ready events in revents, returns number of ready descriptors
+static int poll_scan(struct pollfd *fds, nfds_t nfds)
 {
+  int ready = 0;
   for (nfds_t i = 0; i < nfds; i++)
   {
-    fds[i].revents = fds[i].events;
+    auto& pfd = fds[i];
+    pfd.revents = 0;
+    // negative descriptors are ignored
+    if (pfd.fd < 0) continue;
+
+    if (pfd.fd == 1 or pfd.fd == 2) {
+      pfd.revents = pfd.events & POLLOUT;
+    }
+    else if (auto* fildes = FD_map::_get(pfd.fd); fildes) {
+      // POLLERR and POLLHUP are always reported
+      pfd.revents = fildes->poll_events() & (pfd.events | POLLERR | POLLHUP);
+    }
+    else if (pfd.fd != 0) {
+      pfd.revents = POLLNVAL;
+    }
+
+    if (pfd.revents != 0) ready++;
   }
-  return nfds;
+  return ready;
 }
-static long sys_ppoll(struct pollfd *fds, nfds_t nfds, const struct timespec * /*timeout_ts*/, const sigset_t * /*sigmask*/)
+
+static long do_poll(struct pollfd *fds, nfds_t nfds, std::chrono::nanoseconds timeout)
 {
-  for (nfds_t i = 0; i < nfds; i++)
-  {
-    fds[i].revents = fds[i].events;
-  }
-  return nfds;
+  if (UNLIKELY(fds == nullptr and nfds > 0))
+    return -EFAULT;
+
+  int ready = 0;
+  FD::wait_ready([fds, nfds, &ready] () -> bool {
+      ready = poll_scan(fds, nfds);
+      return ready > 0;
+    }, timeout);
+  return ready;
+}
+
+static long sys_poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+  using namespace std::chrono;
+  return do_poll(fds, nfds, (timeout < 0) ? nanoseconds(-1) : milliseconds(timeout));
+}
+static long sys_ppoll(struct pollfd *fds, nfds_t nfds, const struct timespec *timeout_ts, const sigset_t * /*sigmask*/)
+{
+  using namespace std::chrono;
+  if (timeout_ts == nullptr)
+    return do_poll(fds, nfds, nanoseconds(-1));
+  if (UNLIKELY(timeout_ts->tv_sec < 0 or timeout_ts->tv_nsec < 0 or timeout_ts->tv_nsec >= 1000000000L))
+    return -EINVAL;
+  return do_poll(fds, nfds, seconds(timeout_ts->tv_sec) + nanoseconds(timeout_ts->tv_nsec));
 }
 extern "C"
 long syscall_SYS_poll(struct pollfd *fds, nfds_t nfds, int timeout)
 {
-  return stubtrace(sys_poll, "poll", fds, nfds, timeout);
+  return strace(sys_poll, "poll", fds, nfds, timeout);
 }
 
 extern "C"
 int syscall_SYS_ppoll(struct pollfd *fds, nfds_t nfds, const struct timespec *timeout_ts, const sigset_t *sigmask)
 {
-	return stubtrace(sys_ppoll, "ppoll", fds, nfds, timeout_ts,sigmask);
+	return strace(sys_ppoll, "ppoll", fds, nfds, timeout_ts,sigmask);
 }
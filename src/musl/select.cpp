@@ -1,13 +1,102 @@
 #include "common.hpp"
 #include <sys/select.h>
 
-long sys_select(int /*nfds*/,
-                fd_set* /*readfds*/,
-                fd_set* /*writefds*/,
-                fd_set* /*exceptfds*/,
-                struct timeval* /*timeout*/)
+#include <posix/fd_map.hpp>
+
+struct Select_sets {
+  int    nfds;
+  fd_set in[3];   // requested read, write and except sets
+  fd_set* out[3]; // caller sets, receiving the result (may be null)
+};
+
+static short select_events(int fd)
+{
+  if (fd == 0) return 0;
+  if (fd == 1 or fd == 2) return POLLOUT;
+  if (auto* fildes = FD_map::_get(fd); fildes)
+    return fildes->poll_events();
+  return POLLNVAL;
+}
+
+// stores ready descriptors in the caller sets, returns number of bits set
+static int select_scan(Select_sets& sets)
+{
+  int ready = 0;
+  fd_set res[3];
+  for (auto& set : res) FD_ZERO(&set);
+
+  for (int fd = 0; fd < sets.nfds; fd++)
+  {
+    const bool rd = FD_ISSET(fd, &sets.in[0]);
+    const bool wr = FD_ISSET(fd, &sets.in[1]);
+    if (not (rd or wr)) continue;
+
+    const short ev = select_events(fd);
+    // same mapping as Linux: hangup and errors count as readable
+    if (rd and (ev & (POLLIN | POLLHUP | POLLERR))) {
+      FD_SET(fd, &res[0]); ready++;
+    }
+    if (wr and (ev & (POLLOUT | POLLERR))) {
+      FD_SET(fd, &res[1]); ready++;
+    }
+    // no out-of-band data, the except set is never ready
+  }
+
+  if (ready > 0) {
+    for (int i = 0; i < 3; i++)
+      if (sets.out[i]) *sets.out[i] = res[i];
+  }
+  return ready;
+}
+
+static long sys_select(int nfds,
+                fd_set* readfds,
+                fd_set* writefds,
+                fd_set* exceptfds,
+                struct timeval* timeout)
 {
-  return -ENOSYS;
+  if (UNLIKELY(nfds < 0 or nfds > FD_SETSIZE))
+    return -EINVAL;
+  if (UNLIKELY(timeout != nullptr and
+      (timeout->tv_sec < 0 or timeout->tv_usec < 0 or timeout->tv_usec >= 1000000)))
+    return -EINVAL;
+
+  Select_sets sets;
+  sets.nfds = nfds;
+  sets.out[0] = readfds;
+  sets.out[1] = writefds;
+  sets.out[2] = exceptfds;
+  for (int i = 0; i < 3; i++) {
+    if (sets.out[i]) sets.in[i] = *sets.out[i];
+    else FD_ZERO(&sets.in[i]);
+  }
+
+  for (int fd = 0; fd < nfds; fd++)
+  {
+    if (FD_ISSET(fd, &sets.in[0]) or FD_ISSET(fd, &sets.in[1])
+        or FD_ISSET(fd, &sets.in[2]))
+    {
+      if (select_events(fd) == POLLNVAL)
+        return -EBADF;
+    }
+  }
+
+  using namespace std::chrono;
+  const auto tmo = (timeout == nullptr) ? nanoseconds(-1)
+    : duration_cast<nanoseconds>(seconds(timeout->tv_sec) + microseconds(timeout->tv_usec));
+
+  int ready = 0;
+  FD::wait_ready([&sets, &ready] () -> bool {
+      ready = select_scan(sets);
+      return ready > 0;
+    }, tmo);
+
+  // nothing ready, clear all sets
+  if (ready == 0) {
+    for (auto* set : sets.out)
+      if (set) FD_ZERO(set);
+  }
+  return ready;
 }
 
 extern "C"
@@ -17,6 +17,8 @@
 
 #include <net/http/response_writer.hpp>
 
+#include <rtc>
+#include <statman>
 #include <sstream>
 
 namespace http {
@@ -99,8 +101,20 @@ namespace http {
       write_header(response_->status_code());
   }
 
+  void Response_writer::measure(Stat_histogram& histogram)
+  {
+    service_time_ = &histogram;
+    started_      = RTC::nanos_now();
+  }
+
   void Response_writer::end()
   {
+    // only the first end counts
+    if(service_time_)
+    {
+      service_time_->record((RTC::nanos_now() - started_) / 1000);
+      service_time_ = nullptr;
+    }
     connection_.end();
   }
 
@@ -32,7 +32,8 @@ namespace http {
       stat_conns_{Statman::get().create(Stat::UINT32, tcp.stack().ifname() + ".http_server.connections")},
       stat_req_rx_{Statman::get().create(Stat::UINT64, tcp.stack().ifname() + ".http_server.requests_rx")},
       stat_req_bad_{Statman::get().create(Stat::UINT32, tcp.stack().ifname() + ".http_server.requests_bad")},
-      stat_timeouts_{Statman::get().create(Stat::UINT32, tcp.stack().ifname() + ".http_server.timeouts")}
+      stat_timeouts_{Statman::get().create(Stat::UINT32, tcp.stack().ifname() + ".http_server.timeouts")},
+      stat_service_time_{Statman::get().create(Stat::HISTOGRAM, tcp.stack().ifname() + ".http_server.service_time_us").get_histogram()}
   {
   }
 
@@ -113,7 +114,9 @@ namespace http {
     ++stat_req_rx_;
     if(code == OK)
     {
-      on_request_(std::move(req), std::make_unique<Response_writer>( create_response(code), conn ));
+      auto writer = std::make_unique<Response_writer>( create_response(code), conn );
+      writer->measure(stat_service_time_);
+      on_request_(std::move(req), std::move(writer));
     }
     else
     {
@@ -103,25 +103,16 @@ namespace net {
   void Arp::cache(ip4::Addr ip, MAC::Addr mac) {
     PRINT("<Arp> Caching IP %s for %s\n", ip.str().c_str(), mac.str().c_str());
 
-    auto entry = cache_.find(ip);
-
-    if (entry != cache_.end()) {
-      PRINT("Cached entry found: %s recorded @ %zu. Updating timestamp\n",
-             entry->second.mac().str().c_str(), entry->second.timestamp());
-
-      if (entry->second.mac() != mac) {
-        cache_.erase(entry);
-        cache_.emplace(ip, mac);
-      } else {
-        entry->second.update();
-      }
+    const auto now = RTC::time_since_boot();
+    const auto& entry = cache_.set(ip, mac, Neighbour_state::REACHABLE, now);
+    flush_at(cache_.due(entry, now), now);
+  }
 
-    } else {
-      cache_.emplace(ip, mac); // Insert
-      if (UNLIKELY(not flush_timer_.is_running())) {
-        flush_timer_.start(flush_interval_);
-      }
-    }
+  void Arp::flush_at(uint64_t due, uint64_t now) {
+    if (flush_timer_.is_running() and flush_due_ <= due)
+      return;
+    flush_due_ = due;
+    flush_timer_.restart(std::chrono::seconds(due - now));
   }
 
 
@@ -166,15 +157,21 @@ namespace net {
       dest_mac = linux_tap_device;
 #else
       // If we don't have a cached IP, perform address resolution
-      auto cache_entry = cache_.find(next_hop);
-      if (UNLIKELY(cache_entry == cache_.end())) {
+      const auto* cache_entry = cache_.use(next_hop);
+      if (UNLIKELY(cache_entry == nullptr)) {
         PRINT("<ARP> No cache entry for IP %s.  Resolving. \n", next_hop.to_string().c_str());
         await_resolution(std::move(pckt), next_hop);
         return;
       }
 
       // Get MAC from cache
-      dest_mac = cache_[next_hop].mac();
+      dest_mac = cache_entry->mac;
+
+      // a stale neighbour in use is probed on the next round
+      if (UNLIKELY(cache_entry->state == Neighbour_state::STALE)) {
+        const auto now = RTC::time_since_boot();
+        flush_at(now + Cache::retrans_time, now);
+      }
 #endif
 
       PRINT("<ARP> Found cache entry for IP %s -> %s \n",
@@ -239,23 +236,30 @@ namespace net {
     linklayer_out_(std::move(req), MAC::BROADCAST, Ethertype::ARP);
   }
 
+  void Arp::arp_probe(ip4::Addr ip, MAC::Addr mac) {
+    PRINT("<ARP PROBE> %s at %s\n", ip.str().c_str(), mac.str().c_str());
+
+    auto req = static_unique_ptr_cast<PacketArp>(inet_.create_packet());
+    req->init(mac_, inet_.ip_addr(), ip);
+
+    req->set_dest_mac(mac);
+    req->set_opcode(H_request);
+
+    // Stat increment requests sent
+    requests_tx_++;
+
+    linklayer_out_(std::move(req), mac, Ethertype::ARP);
+  }
+
 
   void Arp::flush_expired()
   {
-    PRINT("<ARP> Flushing expired entries\n");
-    std::vector<ip4::Addr> expired;
-    for (auto ent : cache_) {
-      if (ent.second.expired()) {
-        expired.push_back(ent.first);
-      }
-    }
-
-    for (auto ip : expired) {
-      cache_.erase(ip);
-    }
+    PRINT("<ARP> Aging %zu cache entries\n", cache_.size());
+    const auto now  = RTC::time_since_boot();
+    const auto next = cache_.age(now, {this, &Arp::arp_probe});
 
-    if (not cache_.empty()) {
-      flush_timer_.start(flush_interval_);
+    if (next != 0) {
+      flush_at(next, now);
     }
   }
 
@@ -138,6 +138,7 @@ namespace net
 
     auto payload    = req.payload();
     auto* data      = payload.data();
+    bool has_lladdr = false;
     // Parse the options
     adv.parse_options(data + payload.size(), [&](const auto* opt)
     {
@@ -150,6 +151,7 @@ namespace net
             reinterpret_cast<const Target_link_layer_address<MAC::Addr>*>(opt)->addr;
 
           // For now, just create a cache entry, if one doesn't exist
+          has_lladdr = true;
           cache(target, lladdr,
             adv.solicited() ? NeighbourStates::REACHABLE : NeighbourStates::STALE,
             NEIGH_UPDATE_WEAK_OVERRIDE |
@@ -166,6 +168,13 @@ namespace net
       }
     });
 
+    // the answer to a unicast probe may leave the address out
+    if (not has_lladdr and adv.solicited()) {
+      const auto* entry = neighbour_cache_.find(target);
+      if (entry != nullptr and entry->state != NeighbourStates::INCOMPLETE)
+        cache(target, entry->mac, NeighbourStates::REACHABLE, entry->flags);
+    }
+
     auto waiting = waiting_packets_.find(target);
     if (waiting != waiting_packets_.end()) {
       PRINT("Ndp: Had a packet waiting for this IP. Sending\n");
@@ -174,7 +183,7 @@ namespace net
     }
   }
 
-  void Ndp::send_neighbour_solicitation(ip6::Addr target)
+  void Ndp::send_neighbour_solicitation(ip6::Addr target, MAC::Addr mac)
   {
     using namespace ndp;
 
@@ -185,9 +194,10 @@ namespace net
     req.set_type(ICMP_type::ND_NEIGHBOUR_SOL);
     req.set_code(0);
 
-    auto dest = ip6::Addr::solicit(target);
-    // Solicit destination address. Source address
-    // option must be present
+    // Solicit destination address, unless probing a neighbour
+    // we have the link-layer address of [RFC 4861 7.2.2]
+    const bool unicast = (mac != MAC::EMPTY);
+    auto dest = unicast ? target : ip6::Addr::solicit(target);
     req.ip().set_ip_dst(dest);
 
     // Construct neigbor sol msg on with target address on our ICMP
@@ -208,7 +218,7 @@ namespace net
     }
 
     req.set_checksum();
-    auto dest_mac = MAC::Addr::ipv6_mcast(dest);
+    auto dest_mac = unicast ? mac : MAC::Addr::ipv6_mcast(dest);
 
     PRINT("NDP: Sending Neighbour solicit size: %i payload size: %i,"
         "checksum: 0x%x, src: %s, dst: %s, dmac: %s\n",
@@ -216,7 +226,8 @@ namespace net
         req.ip().ip_src().str().c_str(),
         req.ip().ip_dst().str().c_str(), dest_mac.str().c_str());
 
-    cache(dest, MAC::EMPTY, NeighbourStates::INCOMPLETE, 0);
+    if (not unicast)
+      cache(dest, MAC::EMPTY, NeighbourStates::INCOMPLETE, 0);
     transmit(req.release(), dest, dest_mac);
   }
 
@@ -633,11 +644,7 @@ namespace net
 
   bool Ndp::lookup(ip6::Addr ip)
   {
-    auto entry = neighbour_cache_.find(ip);
-    if (entry != neighbour_cache_.end()) {
-      return true;
-    }
-    return false;
+    return neighbour_cache_.find(ip) != nullptr;
   }
 
   void Ndp::cache(ip6::Addr ip, uint8_t *ll_addr, NeighbourStates state, uint32_t flags, bool update)
@@ -651,26 +658,22 @@ namespace net
   void Ndp::cache(ip6::Addr ip, MAC::Addr mac, NeighbourStates state, uint32_t flags, bool update)
   {
     PRINT("Ndp Caching IP %s for %s\n", ip.str().c_str(), mac.str().c_str());
-    auto entry = neighbour_cache_.find(ip);
-    if (entry != neighbour_cache_.end()) {
-      PRINT("Cached entry found: %s recorded @ %zu. Updating timestamp\n",
-         entry->second.mac().str().c_str(), entry->second.timestamp());
-      if (entry->second.mac() != mac) {
-        neighbour_cache_.erase(entry);
-        neighbour_cache_.emplace(
-           std::make_pair(ip, Neighbour_Cache_entry{mac, state, flags})); // Insert
-      } else if (update) {
-        entry->second.set_state(state);
-        entry->second.set_flags(flags);
-        entry->second.update();
-      }
-    } else {
-      neighbour_cache_.emplace(
-        std::make_pair(ip, Neighbour_Cache_entry{mac, state, flags})); // Insert
-      if (UNLIKELY(not flush_neighbour_timer_.is_running())) {
-        flush_neighbour_timer_.start(flush_interval_);
-      }
-    }
+    const auto* entry = neighbour_cache_.find(ip);
+    if (entry != nullptr and entry->mac == mac and not update)
+      return;
+
+    const auto now = RTC::time_since_boot();
+    auto& cached = neighbour_cache_.set(ip, mac, state, now);
+    cached.flags = flags;
+    flush_neighbours_at(neighbour_cache_.due(cached, now), now);
+  }
+
+  void Ndp::flush_neighbours_at(uint64_t due, uint64_t now)
+  {
+    if (flush_neighbour_timer_.is_running() and flush_neighbour_due_ <= due)
+      return;
+    flush_neighbour_due_ = due;
+    flush_neighbour_timer_.restart(std::chrono::seconds(due - now));
   }
 
   void Ndp::dest_cache(ip6::Addr dest_ip, ip6::Addr next_hop)
@@ -761,20 +764,12 @@ namespace net
 
   void Ndp::flush_expired_neighbours()
   {
-    PRINT("NDP: Flushing expired entries\n");
-    std::vector<IP6::addr> expired;
-    for (auto ent : neighbour_cache_) {
-      if (ent.second.expired()) {
-        expired.push_back(ent.first);
-      }
-    }
-
-    for (auto ip : expired) {
-      neighbour_cache_.erase(ip);
-    }
+    PRINT("NDP: Aging %zu neighbour cache entries\n", neighbour_cache_.size());
+    const auto now  = RTC::time_since_boot();
+    const auto next = neighbour_cache_.age(now, {this, &Ndp::ndp_probe});
 
-    if (not neighbour_cache_.empty()) {
-      flush_neighbour_timer_.start(flush_interval_);
+    if (next != 0) {
+      flush_neighbours_at(next, now);
     }
   }
 
@@ -805,6 +800,16 @@ namespace net
     send_neighbour_solicitation(next_hop);
   }
 
+  void Ndp::ndp_probe(ip6::Addr ip, MAC::Addr mac)
+  {
+    PRINT("<NDP PROBE> %s at %s\n", ip.str().c_str(), mac.str().c_str());
+
+    // Stat increment requests sent
+    requests_tx_++;
+
+    send_neighbour_solicitation(ip, mac);
+  }
+
   void Ndp::transmit(Packet_ptr pckt, ip6::Addr next_hop, MAC::Addr mac)
   {
 
@@ -812,15 +817,21 @@ namespace net
 
     if (mac == MAC::EMPTY) {
       // If we don't have a cached IP, perform NDP sol
-      auto neighbour_cache_entry = neighbour_cache_.find(next_hop);
-      if (UNLIKELY(neighbour_cache_entry == neighbour_cache_.end())) {
+      const auto* neighbour_cache_entry = neighbour_cache_.use(next_hop);
+      if (UNLIKELY(neighbour_cache_entry == nullptr)) {
         PRINT("NDP: No cache entry for IP %s.  Resolving. \n", next_hop.to_string().c_str());
         await_resolution(std::move(pckt), next_hop);
         return;
       }
 
       // Get MAC from cache
-      mac = neighbour_cache_[next_hop].mac();
+      mac = neighbour_cache_entry->mac;
+
+      // a stale neighbour in use is probed on the next round
+      if (UNLIKELY(neighbour_cache_entry->state == Neighbour_state::STALE)) {
+        const auto now = RTC::time_since_boot();
+        flush_neighbours_at(now + Cache::retrans_time, now);
+      }
 
       PRINT("NDP: Found cache entry for IP %s -> %s \n",
           next_hop.to_string().c_str(), mac.to_string().c_str());
@@ -0,0 +1,247 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <net/smp_transport.hpp>
+#include <kernel/executor.hpp>
+#include <net/iana.hpp>
+
+namespace net {
+
+Smp_transport::Smp_transport(Inet& stack)
+  : stack_{stack}, stack_cpu{stack.get_cpu_id()}
+{}
+
+int Smp_transport::flow_index(ip4::Addr remote, uint16_t remote_port,
+                              uint16_t local_port, int count) noexcept
+{
+  // the replies to outgoing connections go to the owner of the port
+  if (port_ranges::is_dynamic(local_port))
+      return Port_util::ephemeral_partition(local_port, count);
+  // Jenkins one-at-a-time over the flow
+  const uint32_t words[2] = { remote.whole, uint32_t(remote_port) << 16 | local_port };
+  const auto* bytes = reinterpret_cast<const uint8_t*>(words);
+  uint32_t hash = 0;
+  for (size_t i = 0; i < sizeof(words); i++) {
+    hash += bytes[i];
+    hash += hash << 10;
+    hash ^= hash >> 6;
+  }
+  hash += hash << 3;
+  hash ^= hash >> 11;
+  hash += hash << 15;
+  return hash % count;
+}
+
+int Smp_transport::cpu_for(const PacketIP4& packet, bool is_udp) const noexcept
+{
+  const auto data = packet.ip_data();
+  if (UNLIKELY(data.size() < 4)) return stack_cpu;
+  // source and destination ports lead both TCP and UDP headers
+  const uint16_t src_port = ntohs(*(const uint16_t*) &data[0]);
+  const uint16_t dst_port = ntohs(*(const uint16_t*) &data[2]);
+
+  const auto& replicated = is_udp ? udp_replicated : tcp_replicated;
+  if (not port_ranges::is_dynamic(dst_port) and replicated[dst_port] == false) {
+    // bound only on the CPU of the stack
+    return stack_cpu;
+  }
+  return cpus[flow_index(packet.ip_src(), src_port, dst_port, cpus.size())];
+}
+
+void Smp_transport::steer_tcp4(Packet_ptr pkt)
+{
+  auto& ip4 = static_cast<PacketIP4&>(*pkt);
+  const int cpu = cpu_for(ip4, false);
+  slots[cpu].steered++;
+  if (cpu == stack_cpu) {
+    stack_.tcp().receive4(std::move(pkt));
+    return;
+  }
+  auto* raw = pkt.release();
+  Executor::submit_to(cpu,
+    [this, raw, cpu] { slots[cpu].tcp->receive4(Packet_ptr(raw)); });
+}
+
+void Smp_transport::steer_udp4(Packet_ptr pkt)
+{
+  auto& ip4 = static_cast<PacketIP4&>(*pkt);
+  const int cpu = cpu_for(ip4, true);
+  slots[cpu].steered++;
+  if (cpu == stack_cpu) {
+    stack_.udp().receive4(std::move(pkt));
+    return;
+  }
+  if (not slots[cpu].udp_round) {
+    slots[cpu].udp_round = true;
+    udp_round.push_back(cpu);
+  }
+  auto* raw = pkt.release();
+  Executor::submit_to(cpu,
+    [this, raw, cpu] { slots[cpu].udp->receive4(Packet_ptr(raw)); });
+}
+
+void Smp_transport::rx_batch_done()
+{
+  // the datagrams are queued ahead of this on each CPU
+  for (const int cpu : udp_round)
+  {
+    slots[cpu].udp_round = false;
+    Executor::submit_to(cpu,
+      [this, cpu] { slots[cpu].udp->deliver_batches(); });
+  }
+  udp_round.clear();
+}
+
+void Smp_transport::transmit4(Packet_ptr pkt)
+{
+  if (SMP::cpu_id() == stack_cpu) {
+    stack_.ip_obj().transmit(std::move(pkt));
+    return;
+  }
+  auto* raw = pkt.release();
+  Executor::submit_to(stack_cpu,
+    [this, raw] { stack_.ip_obj().transmit(Packet_ptr(raw)); });
+}
+
+void Smp_transport::process_sendq(size_t packets)
+{
+  // the TCP instances take care of themselves, see TCP::smp_process_writeq
+  for (const int cpu : cpus)
+  {
+    if (cpu == stack_cpu) continue;
+    Executor::submit_to(cpu,
+      [this, cpu, packets] { slots[cpu].udp->process_sendq(packets); });
+  }
+}
+
+void Smp_transport::setup_cpu(const int index)
+{
+  const int cpu = cpus.at(index);
+  auto& slot = slots[cpu];
+  TCP::Port_utils* tcp_ports = &stack_.tcp_ports();
+  UDP::Port_utils* udp_ports = &stack_.udp_ports();
+
+  if (cpu != stack_cpu)
+  {
+    tcp_ports = &slot.tcp_ports;
+    udp_ports = &slot.udp_ports;
+    slot.own_tcp = std::make_unique<TCP>(stack_, *tcp_ports, true);
+    slot.own_udp = std::make_unique<UDP>(stack_, *udp_ports, true);
+    slot.own_tcp->set_network_out4({this, &Smp_transport::transmit4});
+    slot.own_udp->set_network_out4({this, &Smp_transport::transmit4});
+    slot.tcp = slot.own_tcp.get();
+    slot.udp = slot.own_udp.get();
+  }
+  else
+  {
+    slot.tcp = &stack_.tcp();
+    slot.udp = &stack_.udp();
+  }
+  // ephemeral ports owned by this CPU
+  const Addr addrs[] { stack_.ip_addr(), ip4::Addr::addr_any };
+  for (const auto& addr : addrs)
+  {
+    (*tcp_ports)[addr].set_ephemeral_partition(index, cpus.size());
+    (*udp_ports)[addr].set_ephemeral_partition(index, cpus.size());
+  }
+}
+
+void Smp_transport::start(ready_func ready)
+{
+  Expects(SMP::cpu_id() == stack_cpu);
+  cpus = SMP::active_cpus();
+
+  auto* left = new int(cpus.size());
+  auto finish = Executor::done_func::make_packed(
+  [this, left, ready] {
+    if (--(*left) > 0) return;
+    delete left;
+    // begin steering
+    stack_.ip_obj().set_tcp_handler({this, &Smp_transport::steer_tcp4});
+    stack_.ip_obj().set_udp_handler({this, &Smp_transport::steer_udp4});
+    stack_.on_transmit_queue_available({this, &Smp_transport::process_sendq});
+    stack_.on_rx_batch_done({this, &Smp_transport::rx_batch_done});
+    this->ready_ = true;
+    if (ready) ready();
+  });
+  for (size_t i = 0; i < cpus.size(); i++)
+  {
+    Executor::submit_to(cpus[i],
+      [this, i] { setup_cpu(i); }, finish);
+  }
+}
+
+TCP& Smp_transport::tcp(int cpu)
+{
+  auto* tcp = slots.at(cpu).tcp;
+  Expects(tcp != nullptr);
+  return *tcp;
+}
+UDP& Smp_transport::udp(int cpu)
+{
+  auto* udp = slots.at(cpu).udp;
+  Expects(udp != nullptr);
+  return *udp;
+}
+TCP& Smp_transport::tcp()
+{
+  return tcp(SMP::cpu_id());
+}
+UDP& Smp_transport::udp()
+{
+  return udp(SMP::cpu_id());
+}
+
+void Smp_transport::listen(uint16_t port, TCP::ConnectCallback cb)
+{
+  Expects(ready_);
+  // steer by flow only once every CPU is listening
+  auto* left = new int(cpus.size());
+  auto finish = Executor::done_func::make_packed(
+  [this, left, port] {
+    if (--(*left) > 0) return;
+    delete left;
+    tcp_replicated.set(port);
+  });
+  for (const int cpu : cpus)
+  {
+    Executor::submit_to(cpu, Executor::task_func::make_packed(
+      [this, port, cb] { tcp().listen(port, cb); }), finish);
+  }
+}
+
+void Smp_transport::udp_bind(uint16_t port, delegate<void(udp::Socket&)> on_bound)
+{
+  Expects(ready_);
+  // steer by flow only once every CPU has the port bound
+  auto* left = new int(cpus.size());
+  auto finish = Executor::done_func::make_packed(
+  [this, left, port] {
+    if (--(*left) > 0) return;
+    delete left;
+    udp_replicated.set(port);
+  });
+  for (const int cpu : cpus)
+  {
+    Executor::submit_to(cpu, Executor::task_func::make_packed(
+      [this, port, on_bound] {
+        auto& sock = udp().bind(port);
+        if (on_bound) on_bound(sock);
+      }), finish);
+  }
+}
+
+} // net
@@ -23,6 +23,9 @@
 #include <net/tcp/connection_states.hpp>
 #include <net/tcp/tcp.hpp>
 #include <net/tcp/tcp_errors.hpp>
+#include <statman>
+#include <rtc>
+#include <cstring>
 
 using namespace net::tcp;
 using namespace std;
@@ -40,8 +43,10 @@ Connection::Connection(TCP& host, Socket local, Socket remote, ConnectCallback c
     on_disconnect_({this, &Connection::default_on_disconnect}),
     rtx_timer({this, &Connection::rtx_timeout}),
     timewait_dack_timer({this, &Connection::dack_timeout}),
+    rack_timer({this, &Connection::rack_timeout}),
     recv_wnd_getter{nullptr},
     queued_(false),
+    rcvbuf_{host_.min_bufsize(), host_.max_bufsize()},
     dack_{0},
     last_ack_sent_{cb.RCV.NXT},
     smss_{MSS()}
@@ -64,11 +69,9 @@ void Connection::_on_read(size_t recv_bufsz, ReadCallback cb)
   (void) recv_bufsz;
   if(read_request == nullptr)
   {
-    Expects(bufalloc != nullptr);
-    read_request.reset(
-      new Read_request(this->cb.RCV.NXT, host_.min_bufsize(), host_.max_bufsize(), bufalloc.get()));
+    create_read_request();
     read_request->on_read_callback = cb;
-    const size_t avail_thres = host_.max_bufsize() * Read_request::buffer_limit;
+    const size_t avail_thres = host_.min_bufsize() * Read_request::buffer_limit;
     bufalloc->on_avail(avail_thres, {this, &Connection::trigger_window_update});
   }
   // read request is already set, only reset if new size.
@@ -89,11 +92,9 @@ void Connection::_on_read(size_t recv_bufsz, ReadCallback cb)
 void Connection::_on_data(DataCallback cb) {
   if(read_request == nullptr)
   {
-    Expects(bufalloc != nullptr);
-    read_request.reset(
-      new Read_request(this->cb.RCV.NXT, host_.min_bufsize(), host_.max_bufsize(), bufalloc.get()));
+    create_read_request();
     read_request->on_data_callback = cb;
-    const size_t avail_thres = host_.max_bufsize() * Read_request::buffer_limit;
+    const size_t avail_thres = host_.min_bufsize() * Read_request::buffer_limit;
     bufalloc->on_avail(avail_thres, {this, &Connection::trigger_window_update});
   }
   // read request is already set, only reset if new size.
@@ -193,8 +194,9 @@ void Connection::write(buffer_t buffer)
     // add to queue
     writeq.push_back(std::move(buffer));
 
-    // request packets if connected, else let ACK clock do the writing
-    if(state_->is_connected())
+    // request packets if connected, else let ACK clock do the writing.
+    // With Fast Open the answer may go before the handshake is complete
+    if(state_->is_connected() or (fast_open_ and is_state(SynReceived::instance())))
       host_.request_offer(*this);
   }
 }
@@ -207,8 +209,20 @@ void Connection::offer(size_t& packets)
   // write until we either cant send more (window closes or no more in queue),
   // or we're out of packets.
 
+  // paced connections may be ahead of their rate by the slack,
+  // past that they wait in the writeq
+  const auto rate  = pacing_rate();
+  const auto slack = (uint64_t) std::chrono::microseconds{default_pacing_slack}.count();
+  const auto now   = (rate != 0) ? rack_clock() : 0;
+
   while(can_send() and packets)
   {
+    if(rate != 0 and next_send_ > now + slack)
+    {
+      host_.throttle_offer(*this, next_send_ - slack);
+      break;
+    }
+
     auto packet = create_outgoing_packet();
     packets--;
 
@@ -239,6 +253,9 @@ void Connection::offer(size_t& packets)
     }
 
     transmit(std::move(packet));
+
+    if(rate != 0)
+      next_send_ = std::max(next_send_, now) + written * 1000000ull / rate;
   }
 
   debug2("<Connection::offer> Finished working offer with [%u] packets left and a queue of (%u) with a usable window of %i\n",
@@ -283,6 +300,7 @@ void Connection::writeq_reset() {
   debug2("<Connection::writeq_reset> Reseting.\n");
   writeq.reset();
   rtx_timer.stop();
+  rack_timer.stop();
 }
 
 void Connection::open(bool active)
@@ -310,13 +328,9 @@ void Connection::close() {
 
 void Connection::receive_disconnect() {
   Expects(read_request and read_request->size());
-
-  if(read_request->on_read_callback) {
-    // TODO: consider adding back when SACK is complete
-    //auto& buf = read_request->buffer;
-    //if (buf.size() > 0 && buf.missing() == 0)
-    //    read_request->callback(buf.buffer(), buf.size());
-  }
+  // every byte before the FIN is in, so what is in the read buffer
+  // has no holes and is handed over, even if PUSH was never seen
+  read_request->reset(cb.RCV.NXT);
 }
 
 void Connection::update_fin(const Packet_view& pkt)
@@ -335,8 +349,8 @@ void Connection::handle_fin()
   const auto snd_nxt = cb.SND.NXT;
 
   // empty the read buffer
-  //if(read_request and read_request->size())
-  //  receive_disconnect();
+  if(read_request and read_request->size())
+    receive_disconnect();
 
   // signal disconnect to the user
   signal_disconnect(Disconnect::CLOSING);
@@ -433,6 +447,8 @@ void Connection::transmit(Packet_view_ptr packet) {
   }
   if(packet->isset(ACK))
     last_ack_sent_ = cb.RCV.NXT;
+  if(sack_perm and packet->has_tcp_data())
+    rack_sent(packet->seq(), packet->end());
 
   //printf("<Connection::transmit> TX %s\n%s\n", packet->to_string().c_str(), to_string().c_str());
 
@@ -454,12 +470,16 @@ bool Connection::handle_ack(const Packet_view& in)
     (e) the advertised window in the incoming acknowledgment equals the
     advertised window in the last incoming acknowledgment.
   */
+  // The SACK blocks are needed on duplicate ACKs as well
+  if(rack_ != nullptr)
+    sack_update(in);
+
   // Duplicate ACK
   // Needs to be checked before (SEG.ACK >= SND.UNA)
   if(UNLIKELY(is_dup_ack(in, true_win)))
   {
     dup_acks_++;
-    on_dup_ack(in);
+    (rack_ != nullptr) ? (void) sack_recovery(in, 0) : on_dup_ack(in);
     return false;
   } // < dup ack
 
@@ -499,9 +519,18 @@ bool Connection::handle_ack(const Packet_view& in)
 
   take_rtt_measure(in);
 
-  // do either congctrl or fastrecov according to New Reno
-  (not fast_recovery_)
-    ? congestion_control(in) : fast_recovery(in);
+  // with SACK, loss recovery is driven by the scoreboard and RACK,
+  // else do either congctrl or fastrecov according to New Reno
+  if(rack_ != nullptr)
+  {
+    if(not sack_recovery(in, highest_ack_ - prev_highest_ack_))
+      congestion_control(in);
+  }
+  else
+  {
+    (not fast_recovery_)
+      ? congestion_control(in) : fast_recovery(in);
+  }
 
   dup_acks_ = 0;
 
@@ -730,13 +759,96 @@ void Connection::rtx_ack(const seq_t ack) {
 
 void Connection::trigger_window_update(os::mem::Pmr_resource& res)
 {
-  const auto reserve = (host_.max_bufsize() * Read_request::buffer_limit);
+  const auto reserve = (rcvbuf_.space() * Read_request::buffer_limit);
   if(res.allocatable() >= reserve and cb.RCV.WND == 0) {
     //printf("allocatable=%zu cur_win=%u\n", res.allocatable(), cb.RCV.WND);
     send_window_update();
   }
 }
 
+void Connection::create_read_request()
+{
+  Expects(bufalloc != nullptr);
+  const auto bufsize = rcvbuf_.space();
+  read_request.reset(
+    new Read_request(this->cb.RCV.NXT, bufsize, bufsize, bufalloc.get()));
+  // the memory is taken when there is data
+  read_request->release();
+}
+
+void Connection::rcvbuf_drained(const Packet_view& in, size_t bytes)
+{
+  const auto now = rack_clock();
+  // receive side RTT from the timestamp echoed [RFC 7323 4.3]
+  const Option::opt_ts* ts = nullptr;
+  if(cb.SND.TS_OK)
+    ts = (in.ts_option() != nullptr) ? in.ts_option() : in.parse_ts_option();
+  const auto elapsed = (ts != nullptr and ts->ecr != 0) ? host_.ts_elapsed(ntohl(ts->ecr)) : -1;
+  if(elapsed >= 0)
+    rcvbuf_.rtt_sample((uint64_t) elapsed * 1000, now);
+  // without a sample SRTT is only the initial placeholder, leave min_rtt to apply
+  else if(rcvbuf_.rtt() == 0 and rttm.samples > 0)
+    rcvbuf_.rtt_sample((uint64_t) (rttm.SRTT.count() * 1e6f), now);
+
+  const bool was_grown = rcvbuf_.grown();
+  if(rcvbuf_.on_drain(bytes, now))
+  {
+    read_request->set_bufsize(rcvbuf_.space());
+    if(not was_grown)
+      host_.rcvbuf_grown();
+  }
+  // everything is delivered, and the flow is not fast enough to keep
+  // the memory around for the next segment
+  else if(not rcvbuf_.grown() and read_request->front().size() == 0)
+  {
+    read_request->release();
+  }
+}
+
+bool Connection::rcvbuf_idle(uint64_t now, uint64_t timeout)
+{
+  if(not rcvbuf_.grown())
+    return false;
+  if(not rcvbuf_.idle(now, timeout))
+    return true;
+
+  rcvbuf_.shrink(now);
+  if(read_request != nullptr)
+  {
+    read_request->set_bufsize(rcvbuf_.space());
+    read_request->release();
+  }
+  return false;
+}
+
+uint64_t Connection::pacing_rate() const
+{
+  uint64_t rate = 0;
+  // from the congestion window, once there is an RTT to go by
+  if(host_.uses_pacing() and rttm.samples > 0 and rttm.SRTT.count() > 0)
+  {
+    const float ratio = cb.slow_start() ? 2.0f : 1.2f;
+    rate = (uint64_t) (ratio * cb.cwnd / rttm.SRTT.count());
+  }
+  if(max_pacing_rate_ != 0)
+    rate = (rate == 0) ? max_pacing_rate_ : std::min(rate, max_pacing_rate_);
+  return rate;
+}
+
+size_t Connection::memory_usage() const
+{
+  size_t bytes = sizeof(*this) + writeq.memory_usage();
+  if(read_request)
+    bytes += read_request->memory_usage();
+  if(sack_list)
+    bytes += sizeof(Sack_list);
+  if(scoreboard_)
+    bytes += sizeof(Sack_scoreboard);
+  if(rack_)
+    bytes += sizeof(Rack) + rack_->size() * sizeof(Rack::Segment);
+  return bytes;
+}
+
 uint32_t Connection::calculate_rcv_wnd() const
 {
   // PRECISE REPORTING
@@ -747,8 +859,10 @@ uint32_t Connection::calculate_rcv_wnd() const
   auto remaining = rbuf.capacity() - rbuf.size();
 
   auto buf_avail = bufalloc->allocatable() + remaining;
-  auto reserve   = (host_.max_bufsize() * Read_request::buffer_limit);
+  auto reserve   = (rcvbuf_.space() * Read_request::buffer_limit);
   auto win = buf_avail > reserve ? buf_avail - reserve : 0;
+  // no more than the buffers take at the size tuned to the drain rate
+  win = std::min(win, read_request->window(cb.RCV.NXT));
 
   return (win < SMSS()) ? 0 : win; // Avoid small silly windows
 
@@ -828,6 +942,8 @@ void Connection::recv_data(const Packet_view& in)
 
   // Keep track if a packet is being sent during the async read callback
   const auto snd_nxt = cb.SND.NXT;
+  // [RFC 5681] p. 9 - data out of order, or filling in a gap, is ACKed at once
+  bool ack_now = false;
 
   // The packet we expect
   if(cb.RCV.NXT == in.seq())
@@ -838,6 +954,7 @@ void Connection::recv_data(const Packet_view& in)
     // and increase the total amount of bytes acked
     if(UNLIKELY(sack_list != nullptr))
     {
+      ack_now = sack_list->size() > 0;
       const auto res = sack_list->new_valid_ack(in.seq(), length);
       // if any bytes are cleared up in sack, increase expected sequence number
       cb.RCV.NXT += res.blocksize;
@@ -861,6 +978,7 @@ void Connection::recv_data(const Packet_view& in)
       const auto recv = read_request->insert(in.seq(), in.tcp_data(), length, in.isset(PSH));
       // this ensures that the data we ACK is actually put in our buffer.
       Ensures(recv == length);
+      rcvbuf_drained(in, recv);
     }
   }
   // Packet out of order
@@ -869,16 +987,41 @@ void Connection::recv_data(const Packet_view& in)
     // only accept the data if we have a read request
     if(read_request != nullptr)
       recv_out_of_order(in);
+    ack_now = true;
   }
 
 
   // User callback didnt result in transmitting an ACK
   if(cb.SND.NXT == snd_nxt)
-    ack_data();
+  {
+    if(ack_now and not can_send())
+    {
+      stop_dack();
+      send_ack();
+    }
+    else
+    {
+      ack_data();
+    }
+  }
 
   // [RFC 5681] ???
 }
 
+void Connection::recv_syn_data(const Packet_view& syn)
+{
+  Expects(syn.has_tcp_data());
+  const auto length = syn.tcp_data_length();
+  // already acknowledged by the SYN-ACK
+  cb.RCV.NXT += length;
+  if(read_request != nullptr)
+  {
+    // the data starts after the sequence number of the SYN
+    const auto recv = read_request->insert(syn.seq() + 1, syn.tcp_data(), length, true);
+    Ensures(recv == length);
+  }
+}
+
 // This function need to sync both SACK and the read buffer, meaning:
 // * Data cannot be old segments (already acked)
 // * Data cannot be duplicate (already S-acked)
@@ -911,7 +1054,8 @@ void Connection::recv_out_of_order(const Packet_view& in)
     return;
   }
 
-  auto fits = read_request->fits(seq);
+  // the data may run on from one buffer into the next
+  auto fits = read_request->window(seq);
   // TODO: if our packet partial fits, we just ignores it for now
   // to avoid headache
   if(fits >= length)
@@ -992,14 +1136,21 @@ void Connection::take_rtt_measure(const Packet_view& packet)
       ts = packet.parse_ts_option();
     if(ts)
     {
-      rttm.rtt_measurement(RTTM::milliseconds{host_.get_ts_value() - ntohl(ts->ecr)});
+      const auto elapsed = host_.ts_elapsed(ntohl(ts->ecr));
+      if(elapsed >= 0)
+      {
+        const RTTM::milliseconds R{elapsed};
+        rttm.rtt_measurement(R);
+        if(host_.rtt_ms_) host_.rtt_ms_->record(R.count());
+      }
       return;
     }
   }
 
   if(rttm.active())
   {
-    rttm.stop(RTTM::milliseconds{host_.get_ts_value()});
+    const auto R = rttm.stop(RTTM::milliseconds{host_.get_ts_value()});
+    if(host_.rtt_ms_ and R.count() >= 0) host_.rtt_ms_->record(R.count());
   }
 }
 
@@ -1023,6 +1174,9 @@ void Connection::retransmit() {
     packet->set_flag(SYN);
     syn_rtx_++;
     add_syn_options(*packet);
+    // something on the path may be dropping SYNs with data [RFC 7413 4.1.3]
+    if(fast_open_)
+      host_.fast_open_cache().syn_lost(remote_.address());
   }
   else if(UNLIKELY(is_state(SynReceived::instance())))
   {
@@ -1044,6 +1198,9 @@ void Connection::retransmit() {
   }
   packet->set_seq(cb.SND.UNA);
 
+  if(rack_ != nullptr and packet->has_tcp_data())
+    rack_->on_transmit(packet->seq(), packet->end(), rack_clock());
+
   /*
   Set a "RetransmitTS" variable to the value of the
   Timestamp Value field of the Timestamps option included in
@@ -1113,6 +1270,7 @@ void Connection::rtx_timeout() {
   //printf("<Connection::RTX@timeout> Timed out (RTO %lld ms). FS: %u usable=%u\n",
   //  rttm.rto_ms().count(), flight_size(), usable_window());
 
+  ++(*host_.rto_timeouts_);
   signal_rtx_timeout();
   // experimental
   if(rto_limit_reached()) {
@@ -1122,6 +1280,20 @@ void Connection::rtx_timeout() {
     return;
   }
 
+  /*
+    [RFC 6675] 5.1 / [RFC 8985] 6.3
+    With SACK, everything not SACKed is taken as lost, and is
+    retransmitted from the scoreboard as the ACKs come in.
+  */
+  if(rack_ != nullptr)
+  {
+    rack_->mark_all_lost();
+    sack_recovery_ = true;
+    tlp_sent_ = false;
+    rack_reo_ = false;
+    rack_timer.stop();
+  }
+
   // retransmit SND.UNA
   retransmit();
   rtx_attempt_++;
@@ -1190,13 +1362,9 @@ void Connection::set_state(State& state) {
 }
 
 void Connection::timewait_start() {
-  const auto timeout = 2 * host().MSL(); // 60 seconds
-  timewait_dack_timer.restart(timeout, {this, &Connection::timewait_timeout});
-}
-
-void Connection::timewait_restart() {
-  const auto timeout = 2 * host().MSL(); // 60 seconds
-  timewait_dack_timer.restart(timeout);
+  // the host keeps the flow in TIME-WAIT for 2*MSL,
+  // so that this connection can be closed right away
+  host_.add_time_wait(*this);
 }
 
 void Connection::send_ack() {
@@ -1230,8 +1398,7 @@ void Connection::signal_connect(const bool success)
   // If no data event was registered we still want to start buffering here,
   // in case the user is not yet ready to subscribe to data.
   if (read_request == nullptr and success) {
-    read_request.reset(
-      new Read_request(this->cb.RCV.NXT, host_.min_bufsize(), host_.max_bufsize(), bufalloc.get()));
+    create_read_request();
   }
 }
 
@@ -1394,6 +1561,99 @@ void Connection::parse_options(const Packet_view& packet) {
   }
 }
 
+size_t Connection::fast_open_syn(Packet_view& packet)
+{
+  if(not host_.uses_fast_open())
+    return 0;
+
+  auto& cache = host_.fast_open_cache();
+  const auto* entry = cache.get(remote_.address());
+  // ask for a cookie to use the next time
+  if(entry == nullptr)
+  {
+    packet.add_tcp_option<Option::opt_tfo>();
+    return 0;
+  }
+  if(not cache.usable(remote_.address()) or not writeq.has_remaining_requests())
+    return 0;
+
+  packet.add_tcp_option<Option::opt_tfo>(entry->cookie.data(), entry->length);
+  // the MSS of the server is not known before the SYN-ACK, so the last one seen
+  const size_t mss = (entry->mss != 0) ? entry->mss
+    : (is_ipv6_ ? default_mss_v6 : default_mss);
+  const auto written = fill_packet(packet, writeq.nxt_data(),
+                                   std::min((size_t) writeq.nxt_rem(), mss));
+  fast_open_ = written > 0;
+  if(fast_open_)
+    ++(*host_.fast_open_sent_);
+  return written;
+}
+
+void Connection::fast_open_synack(const Packet_view& in)
+{
+  if(host_.uses_fast_open())
+  {
+    const auto* opt = in.parse_tfo_option();
+    if(opt != nullptr and opt->cookie_length() >= Option::opt_tfo::min_cookie)
+      host_.fast_open_cache().put(remote_.address(), opt->cookie, opt->cookie_length(), cb.SND.MSS);
+  }
+  if(not fast_open_)
+    return;
+
+  // the SYN takes one sequence number, the rest is data
+  const uint32_t acked = in.ack() - cb.ISS - 1;
+  if(acked > 0)
+  {
+    writeq.advance(acked);
+    writeq.acknowledge(acked);
+  }
+  else
+  {
+    ++(*host_.fast_open_failed_);
+  }
+  // [RFC 7413] 4.2.2 what was not acknowledged is sent after the handshake
+  cb.SND.NXT = in.ack();
+}
+
+bool Connection::fast_open_listen(const Packet_view& syn, Packet_view& synack)
+{
+  if(not host_.uses_fast_open())
+    return false;
+
+  const auto* opt = syn.parse_tfo_option();
+  if(opt == nullptr)
+    return false;
+
+  const auto period = Syn_cookies::current_period();
+  uint64_t cookie = 0;
+  if(syn.has_tcp_data() and opt->cookie_length() == sizeof(cookie))
+    std::memcpy(&cookie, opt->cookie, sizeof(cookie));
+  if(cookie != 0 and host_.syn_cookies_.check_fast_open(remote_.address(), cookie, period))
+  {
+    // too many pending, the data is sent again after the handshake
+    if(not fast_open_room_)
+      return false;
+    fast_open_ = true;
+    // the data is acknowledged along with the SYN
+    synack.set_ack(cb.RCV.NXT + syn.tcp_data_length());
+    // the window of the SYN, to answer before the handshake is complete
+    cb.SND.WND = syn.win();
+    cb.SND.WL1 = syn.seq();
+    cb.SND.WL2 = cb.ISS;
+    ++(*host_.fast_open_accepted_);
+    // one from the last period is renewed before it expires
+    const uint64_t current = host_.syn_cookies_.fast_open(remote_.address(), period);
+    if(cookie != current)
+      synack.add_tcp_option<Option::opt_tfo>(reinterpret_cast<const uint8_t*>(&current), sizeof(current));
+    return true;
+  }
+
+  // asked for a cookie, or had one no longer valid
+  cookie = host_.syn_cookies_.fast_open(remote_.address(), period);
+  synack.add_tcp_option<Option::opt_tfo>(reinterpret_cast<const uint8_t*>(&cookie), sizeof(cookie));
+  return false;
+}
+
 void Connection::add_option(Option::Kind kind, Packet_view& packet) {
 
   switch(kind) {
@@ -1530,3 +1790,248 @@ void Connection::finish_fast_recovery() {
   cb.cwnd = cb.ssthresh;
   //printf("<TCP::Connection::finish_fast_recovery> Finished Fast Recovery - Cwnd: %u\n", cb.cwnd);
 }
+
+uint64_t Connection::rack_clock() {
+  return RTC::nanos_now() / 1000;
+}
+
+void Connection::rack_sent(const seq_t start, const seq_t end)
+{
+  if(UNLIKELY(rack_ == nullptr))
+  {
+    rack_       = std::make_unique<Rack>();
+    scoreboard_ = std::make_unique<Sack_scoreboard>();
+  }
+  rack_->on_transmit(start, end, rack_clock());
+
+  // sending new data arms the tail loss probe [RFC 8985 7.2]
+  if(not rack_timer.is_running())
+    rack_arm(0);
+}
+
+void Connection::sack_update(const Packet_view& in)
+{
+  const auto now = rack_clock();
+  if(in.ack() != cb.SND.UNA)
+  {
+    rack_->on_ack(in.ack(), now);
+    scoreboard_->new_valid_ack(in.ack());
+    tlp_sent_ = false;
+  }
+
+  const auto* opt = in.parse_sack_option();
+  if(opt == nullptr)
+    return;
+
+  const auto* end = (const uint8_t*) opt + opt->length;
+  for(const auto* val = &opt->val[0];
+      val + sizeof(sack::Block) <= end and val < in.tcp_data();
+      val += sizeof(sack::Block))
+  {
+    sack::Block blk;
+    std::memcpy(&blk, val, sizeof(blk));
+    blk.swap_endian();
+
+    // D-SACK [RFC 2883] and blocks for what was never sent are of no use here
+    if(static_cast<int32_t>(blk.start - in.ack()) < 0
+      or static_cast<int32_t>(blk.end - cb.SND.NXT) > 0
+      or static_cast<int32_t>(blk.end - blk.start) <= 0)
+      continue;
+
+    scoreboard_->recv_sack(in.ack(), blk);
+    rack_->on_sack(blk, now);
+  }
+}
+
+/*
+  [RFC 6675] Conservative SACK-based loss recovery,
+  where a segment is lost if the scoreboard says so (IsLost),
+  or if a later sent segment has been delivered [RFC 8985].
+*/
+bool Connection::sack_recovery(const Packet_view& in, const uint32_t bytes_acked)
+{
+  // IsLost, for what is not retransmitted already
+  if(scoreboard_->size())
+  {
+    rack_->mark_lost([this] (const Rack::Segment& seg) {
+      return not seg.rtx and scoreboard_->is_lost(seg.start, SMSS());
+    });
+  }
+  const auto reo_timeout = rack_->detect_loss(rack_clock(), sack_recovery_);
+
+  if(sack_recovery_)
+  {
+    // the ACK covers everything outstanding when recovery started
+    if(static_cast<int32_t>(in.ack() - cb.recover) >= 0)
+    {
+      sack_recovery_ = false;
+      rack_arm(reo_timeout);
+      return false;
+    }
+    // after a timeout, slow start up to ssthresh
+    if(cb.slow_start() and bytes_acked > 0)
+      reno_increase_cwnd(bytes_acked);
+    // [RFC 6582] a partial ACK takes the next segment as lost, for when
+    // nothing sent after it is left to tell (a lost tail)
+    if(bytes_acked > 0)
+    {
+      const auto una = in.ack();
+      rack_->mark_lost([una] (const Rack::Segment& seg) {
+        return not seg.rtx and static_cast<int32_t>(seg.start - una) <= 0;
+      });
+    }
+  }
+  // DupThresh duplicate ACKs are also taken as the first segment being lost
+  else if(rack_->next_lost() != nullptr or dup_acks_ >= 3)
+  {
+    const auto una = in.ack();
+    rack_->mark_lost([una] (const Rack::Segment& seg) {
+      return static_cast<int32_t>(seg.start - una) <= 0;
+    });
+    sack_enter_recovery();
+  }
+  // [RFC 3042] limited transmit on the first duplicate ACKs
+  else if(bytes_acked == 0 and limited_tx_
+    and cb.SND.WND >= flight_size() + SMSS()
+    and writeq.has_remaining_requests())
+  {
+    limited_tx();
+  }
+
+  if(sack_recovery_)
+    sack_send();
+
+  rack_arm(reo_timeout);
+  return sack_recovery_;
+}
+
+void Connection::sack_enter_recovery()
+{
+  // [RFC 6675] p. 8 (4.1) - (4.2)
+  cb.recover = cb.SND.NXT;
+  reduce_ssthresh();
+  cb.cwnd = cb.ssthresh;
+  sack_recovery_ = true;
+  tlp_sent_ = false;
+
+  // (4.3) the first segment taken as lost is retransmitted right away,
+  // whatever the pipe, else a window with a lost tail waits for the RTO
+  if(const auto* seg = rack_->next_lost())
+    retransmit(seg->start, seg->size());
+}
+
+void Connection::sack_send()
+{
+  uint32_t pipe = rack_->pipe();
+
+  while(cb.cwnd >= pipe + SMSS())
+  {
+    // (1) the first lost segment not yet retransmitted
+    if(const auto* seg = rack_->next_lost())
+    {
+      const auto sent = retransmit(seg->start, seg->size());
+      if(sent == 0)
+        break;
+      pipe += sent;
+    }
+    // (2) new data, if the receive window allows
+    else if(writeq.has_remaining_requests()
+      and cb.SND.WND >= flight_size() + SMSS())
+    {
+      const auto nxt = cb.SND.NXT;
+      limited_tx();
+      if(cb.SND.NXT == nxt)
+        break;
+      pipe += cb.SND.NXT - nxt;
+    }
+    else
+    {
+      break;
+    }
+  }
+}
+
+void Connection::rack_arm(const uint64_t reo_timeout)
+{
+  using namespace std::chrono;
+  if(reo_timeout > 0)
+  {
+    rack_reo_ = true;
+    rack_timer.restart(microseconds{reo_timeout});
+    return;
+  }
+  rack_reo_ = false;
+
+  // [RFC 8985 7.2] one probe at a time, and not during recovery
+  if(sack_recovery_ or tlp_sent_ or flight_size() == 0)
+  {
+    rack_timer.stop();
+    return;
+  }
+  // PTO = 2 * SRTT, with room for a delayed ACK if there is only one segment
+  auto pto = duration_cast<milliseconds>(rttm.SRTT * 2);
+  if(flight_size() <= SMSS())
+    pto += milliseconds{200};
+  rack_timer.restart(std::min(std::max(pto, milliseconds{10}), rttm.rto_ms()));
+}
+
+void Connection::rack_timeout()
+{
+  if(rack_reo_)
+  {
+    rack_reo_ = false;
+    const auto reo_timeout = rack_->detect_loss(rack_clock(), sack_recovery_);
+    if(not sack_recovery_ and rack_->next_lost() != nullptr)
+      sack_enter_recovery();
+    if(sack_recovery_)
+      sack_send();
+    rack_arm(reo_timeout);
+    return;
+  }
+
+  // [RFC 8985 7.3] tail loss probe, with new data if possible,
+  // else the last segment sent
+  tlp_sent_ = true;
+  if(writeq.has_remaining_requests() and cb.SND.WND >= flight_size() + SMSS())
+    limited_tx();
+  else if(const auto* seg = rack_->last())
+    retransmit(seg->start, seg->size());
+  rtx_reset();
+}
+
+size_t Connection::retransmit(seq_t seq, uint32_t len)
+{
+  // what is partially acknowledged is not sent again
+  if(static_cast<int32_t>(seq - cb.SND.UNA) < 0)
+  {
+    len -= std::min(len, cb.SND.UNA - seq);
+    seq = cb.SND.UNA;
+  }
+
+  auto packet = create_outgoing_packet();
+  packet->set_seq(seq).set_flag(ACK);
+
+  const size_t max = std::min(len, (uint32_t) SMSS());
+  size_t n = 0;
+  while(n < max)
+  {
+    const auto data = writeq.data_at(seq + n - cb.SND.UNA);
+    if(data.second == 0)
+      break;
+    const auto x = packet->fill(data.first, std::min(max - n, data.second));
+    if(x == 0)
+      break;
+    n += x;
+  }
+  if(n == 0)
+    return 0;
+
+  packet->set_flag(PSH);
+  rack_->on_transmit(seq, seq + n, rack_clock());
+
+  if(not rtx_timer.is_running())
+    rtx_start();
+  debug("<Connection::retransmit> RTX: %s\n", packet->to_string().c_str());
+  host_.transmit(std::move(packet));
+  return n;
+}
@@ -384,6 +384,8 @@ void Connection::Closed::open(Connection& tcp, bool active) {
 
       tcb.SND.UNA = tcb.ISS;
       tcb.SND.NXT = tcb.ISS+1;
+      // [RFC 7413] the first data may go along
+      tcb.SND.NXT += tcp.fast_open_syn(*packet);
       tcp.transmit(std::move(packet));
       tcp.set_state(SynSent::instance());
     } else {
@@ -660,9 +662,22 @@ State::Result Connection::Listen::handle(Connection& tcp, Packet_view& in) {
     // add the negotiated options here
     tcp.add_synack_options(*packet);
 
+    // [RFC 7413] with a valid Fast Open cookie the data is taken right away
+    const bool fast_open = tcp.fast_open_listen(in, *packet);
+
     tcp.transmit(std::move(packet));
     tcp.set_state(SynReceived::instance());
 
+    // handed over before the handshake is complete,
+    // so the answer can go in the same round trip
+    if(fast_open)
+    {
+      auto self = tcp.retrieve_shared();
+      tcp.signal_connect(); // NOTE: User callback
+      if(tcp.is_state(SynReceived::instance()))
+        tcp.recv_syn_data(in);
+    }
+
     return OK;
   }
   return OK;
@@ -754,6 +769,9 @@ State::Result Connection::SynSent::handle(Connection& tcp, Packet_view& in) {
     // Parse options
     tcp.parse_options(in);
 
+    if(in.isset(ACK))
+      tcp.fast_open_synack(in);
+
     tcp.take_rtt_measure(in);
 
     // (our SYN has been ACKed)
@@ -801,6 +819,12 @@ State::Result Connection::SynSent::handle(Connection& tcp, Packet_view& in) {
     }
     // Otherwise enter SYN-RECEIVED, form a SYN,ACK segment <SEQ=ISS><ACK=RCV.NXT><CTL=SYN,ACK>
     else {
+      // the data in our SYN goes after the handshake
+      if(tcp.fast_open_)
+      {
+        tcp.fast_open_ = false;
+        tcb.SND.NXT = tcb.ISS+1;
+      }
       auto packet = tcp.outgoing_packet();
       packet->set_seq(tcb.ISS).set_ack(tcb.RCV.NXT).set_flags(SYN | ACK);
       tcp.transmit(std::move(packet));
@@ -872,6 +896,11 @@ State::Result Connection::SynReceived::handle(Connection& tcp, Packet_view& in)
 
       tcp.set_state(Connection::Established::instance());
 
+      // with Fast Open data may be sent already; the SYN takes
+      // one sequence number, but no place in the write queue
+      if(tcp.fast_open_ and in.ack() != tcb.ISS)
+        tcb.SND.UNA = tcb.ISS+1;
+
       tcp.handle_ack(in);
 
       // [RFC 6298] p.4 (5.7)
@@ -881,7 +910,9 @@ State::Result Connection::SynReceived::handle(Connection& tcp, Packet_view& in)
         tcp.rttm.RTO = RTTM::seconds(3.0);
       }
 
-      tcp.signal_connect(); // NOTE: User callback
+      // a Fast Open connection was handed over with the SYN
+      if(not tcp.fast_open_)
+        tcp.signal_connect(); // NOTE: User callback
 
       // 7. proccess the segment text
       if(UNLIKELY(in.has_tcp_data())) {
@@ -1029,6 +1060,7 @@ State::Result Connection::FinWait1::handle(Connection& tcp, Packet_view& in) {
       if(tcp.rtx_timer.is_running())
         tcp.rtx_stop();
       tcp.timewait_start();
+      return CLOSED;
     } else {
       tcp.set_state(Closing::instance());
     }
@@ -1078,6 +1110,7 @@ State::Result Connection::FinWait2::handle(Connection& tcp, Packet_view& in) {
     if(tcp.rtx_timer.is_running())
       tcp.rtx_stop();
     tcp.timewait_start();
+    return CLOSED;
   }
   return OK;
 }
@@ -1151,6 +1184,7 @@ State::Result Connection::Closing::handle(Connection& tcp, Packet_view& in) {
     tcp.set_state(TimeWait::instance());
     tcp.release_memory();
     tcp.timewait_start();
+    return CLOSED;
   }
 
   // 7. proccess the segment text
@@ -1224,9 +1258,9 @@ State::Result Connection::TimeWait::handle(Connection& tcp, Packet_view& in) {
   // 8. check FIN
   if(in.isset(FIN)) {
     process_fin(tcp, in);
-    // Remain in state
-    tcp.timewait_restart();
-    return OK;
+    // wait another 2*MSL, in the host
+    tcp.timewait_start();
+    return CLOSED;
   }
   return OK;
 }
@@ -17,7 +17,10 @@
 
 #include <gsl/gsl_assert>
 #include <net/tcp/listener.hpp>
+#include <net/tcp/connection_states.hpp>
 #include <net/tcp/tcp.hpp>
+#include <statman>
+#include <algorithm>
 
 using namespace net;
 using namespace tcp;
@@ -52,15 +55,12 @@ void Listener::segment_arrived(Packet_view& packet) {
   TCPL_PRINT2("<Listener::segment_arrived> Received packet: %s\n",
     packet.to_string().c_str());
 
-  auto it = std::find_if(syn_queue_.begin(), syn_queue_.end(),
-    [&packet] (const Connection_ptr& conn) {
-      return conn->remote() == packet.source();
-    });
+  auto it = syn_queue_.find(packet.source());
 
   // if it's an reply to any of our half-open connections
   if(it != syn_queue_.end())
   {
-    auto conn = *it;
+    auto conn = it->second;
     debug("<Listener::segment_arrived> Found packet receiver: %s\n",
       conn->to_string().c_str());
     conn->segment_arrived(packet);
@@ -70,8 +70,17 @@ void Listener::segment_arrived(Packet_view& packet) {
   // if it's a new attempt (SYN)
   else
   {
-    // don't waste time if the packet does not have SYN
-    if(UNLIKELY(not packet.isset(SYN) or packet.has_tcp_data()))
+    // it might be completing a handshake answered with a cookie
+    if(packet.isset(ACK) and not packet.isset(SYN) and not packet.isset(RST)
+       and accept_syn_cookie(packet))
+    {
+      return;
+    }
+
+    // don't waste time if the packet does not have SYN,
+    // or has data without Fast Open in use
+    if(UNLIKELY(not packet.isset(SYN)
+      or (packet.has_tcp_data() and not host_.uses_fast_open())))
     {
       TCPL_PRINT2("<Listener::segment_arrived> Packet did not have SYN - dropping\n");
       host_.send_reset(packet);
@@ -79,7 +88,7 @@ void Listener::segment_arrived(Packet_view& packet) {
     }
 
     // Stat increment number of connection attempts
-    host_.connection_attempts_++;
+    ++(*host_.connection_attempts_);
 
     // if we don't like this client, do nothing
     if(UNLIKELY(on_accept_(packet.source()) == false)) {
@@ -87,56 +96,199 @@ void Listener::segment_arrived(Packet_view& packet) {
       return;
     }
 
-    // remove oldest connection if queue is full
     TCPL_PRINT2("<Listener::segment_arrived> SynQueue: %u\n", syn_queue_.size());
     // SYN queue is full
-    if(syn_queue_.size() >= host_.max_syn_backlog())
+    if(syn_queue_full())
     {
       TCPL_PRINT2("<Listener::segment_arrived> Queue is full\n");
+      // answer without keeping any state
+      if(host_.uses_syn_cookies())
+      {
+        send_syn_cookie(packet);
+        return;
+      }
+      // or make room for the new connection
       Expects(not syn_queue_.empty());
-      debug("<Listener::segment_arrived> Connection %s dropped to make room for new connection\n",
-        syn_queue_.back()->to_string().c_str());
-
-      syn_queue_.pop_back();
+      drop_oldest();
     }
 
-    auto& conn = *(syn_queue_.emplace(
-      syn_queue_.cbegin(),
-      std::make_shared<Connection>(host_, packet.destination(), packet.source(), ConnectCallback{this, &Listener::connected})
-      )
-    );
+    // a copy, as Fast Open may hand it over while handling the SYN
+    auto conn = add_half_open(
+      std::make_shared<Connection>(host_, packet.destination(), packet.source(), ConnectCallback{this, &Listener::connected}));
     conn->_on_cleanup({this, &Listener::remove});
     // Open connection
     conn->open(false);
     Ensures(conn->is_listening());
     debug("<Listener::segment_arrived> Connection %s created\n",
       conn->to_string().c_str());
+    if(packet.has_tcp_data())
+      conn->fast_open_room_ = fast_open_room();
     conn->segment_arrived(packet);
+    if(conn->fast_opened() and conn->is_state(Connection::SynReceived::instance()))
+      fast_open_pending_.push_back(conn);
     TCPL_PRINT2("<Listener::segment_arrived> Connection done handling segment\n");
     return;
   }
   TCPL_PRINT2("<Listener::segment_arrived> No receipent\n");
 }
 
-void Listener::remove(const Connection* conn) {
-  TCPL_PRINT2("<Listener::remove> Try remove %s\n", conn->to_string().c_str());
-  auto it = syn_queue_.begin();
-  while(it != syn_queue_.end())
+void Listener::send_syn_cookie(const Packet_view& syn)
+{
+  // what the connection needs to remember from the SYN
+  Syn_cookies::Params params;
+  params.mss = (syn.ipv() == Protocol::IPv6) ? default_mss_v6 : default_mss;
+  const uint8_t* opt = syn.tcp_options();
+  while(opt < syn.tcp_data())
   {
-    if(it->get() == conn)
+    const auto* option = reinterpret_cast<const Option*>(opt);
+    if(option->kind == Option::END) break;
+    if(option->kind == Option::NOP) { opt++; continue; }
+    if(UNLIKELY(option->length < 2)) break;
+
+    if(option->kind == Option::MSS and option->length == sizeof(Option::opt_mss))
+      params.mss = ntohs(reinterpret_cast<const Option::opt_mss*>(option)->mss);
+    else if(option->kind == Option::WS and option->length == sizeof(Option::opt_ws))
+      params.wscale = std::min(reinterpret_cast<const Option::opt_ws*>(option)->shift_cnt, (uint8_t)14);
+    else if(option->kind == Option::SACK_PERM)
+      params.sack = true;
+    opt += option->length;
+  }
+  if(not host_.uses_wscale()) params.wscale = Syn_cookies::NO_WSCALE;
+  if(not host_.uses_SACK())   params.sack = false;
+
+  cookie_slot_  = Syn_cookies::current_slot();
+  cookies_sent_ = true;
+  const seq_t cookie = host_.syn_cookies_.make(
+      syn.destination(), syn.source(), syn.seq(), params, cookie_slot_);
+
+  auto out = (syn.ipv() == Protocol::IPv6)
+    ? host_.create_outgoing_packet6() : host_.create_outgoing_packet();
+  out->set_source(syn.destination());
+  out->set_destination(syn.source());
+  out->set_seq(cookie).set_ack(syn.seq() + 1).set_flags(SYN | ACK);
+  out->set_win(std::min(host_.window_size(), (uint32_t)default_window_size));
+  // the same options as Connection::add_synack_options, without timestamps
+  out->add_tcp_option<Option::opt_mss>(host_.MSS(syn.ipv()));
+  if(params.wscale != Syn_cookies::NO_WSCALE)
+    out->add_tcp_option<Option::opt_ws>(host_.wscale());
+  if(params.sack)
+    out->add_tcp_option<Option::opt_sack_perm>();
+
+  ++(*host_.syn_cookies_sent_);
+  host_.transmit(std::move(out));
+}
+
+bool Listener::accept_syn_cookie(Packet_view& ack)
+{
+  // only when cookies have been sent lately
+  if(not cookies_sent_ or not host_.uses_syn_cookies())
+    return false;
+  const uint32_t slot = Syn_cookies::current_slot();
+  if(slot - cookie_slot_ > 1)
+    return false;
+
+  const seq_t irs = ack.seq() - 1;
+  const auto params = host_.syn_cookies_.check(
+      ack.destination(), ack.source(), irs, ack.ack() - 1, slot);
+  if(not params)
+    return false;
+
+  TCPL_PRINT2("<Listener::accept_syn_cookie> Valid cookie from %s\n",
+    ack.source().to_string().c_str());
+  ++(*host_.syn_cookies_accepted_);
+
+  auto& conn = add_half_open(
+    std::make_shared<Connection>(host_, ack.destination(), ack.source(), ConnectCallback{this, &Listener::connected}));
+  conn->_on_cleanup({this, &Listener::remove});
+  conn->open(false);
+  Ensures(conn->is_listening());
+
+  // as if the SYN had been received in LISTEN, with the cookie as ISS
+  auto& tcb = conn->tcb();
+  tcb.IRS     = irs;
+  tcb.RCV.NXT = ack.seq();
+  tcb.ISS     = ack.ack() - 1;
+  tcb.recover = tcb.ISS;
+  tcb.SND.UNA = tcb.ISS;
+  tcb.SND.NXT = ack.ack();
+  tcb.SND.MSS = params->mss;
+  if(params->wscale != Syn_cookies::NO_WSCALE)
+  {
+    tcb.SND.wind_shift = params->wscale;
+    tcb.RCV.wind_shift = host_.wscale();
+  }
+  conn->sack_perm = params->sack;
+  conn->set_state(Connection::SynReceived::instance());
+
+  conn->segment_arrived(ack);
+  return true;
+}
+
+Connection_ptr& Listener::add_half_open(Connection_ptr conn)
+{
+  // forget the ones that are no longer half-open now and then,
+  // so the order doesn't grow with every connection ever made
+  if(syn_order_.size() >= 2 * syn_queue_.size() + 16)
+  {
+    syn_order_.erase(std::remove_if(syn_order_.begin(), syn_order_.end(),
+      [this] (const auto& entry) { return not is_half_open(entry); }),
+      syn_order_.end());
+  }
+  const auto remote = conn->remote();
+  auto& entry = syn_queue_.emplace(remote, std::move(conn)).first->second;
+  syn_order_.emplace_back(remote, entry.get());
+  return entry;
+}
+
+bool Listener::is_half_open(const std::pair<Socket, const Connection*>& entry) const
+{
+  auto it = syn_queue_.find(entry.first);
+  return it != syn_queue_.end() and it->second.get() == entry.second;
+}
+
+void Listener::drop_oldest()
+{
+  while(not syn_order_.empty())
+  {
+    const auto oldest = syn_order_.front();
+    syn_order_.pop_front();
+    if(is_half_open(oldest))
     {
-      syn_queue_.erase(it);
-      debug("<Listener::remove> %s removed.\n", conn->to_string().c_str());
+      debug("<Listener::drop_oldest> Connection %s dropped to make room for new connection\n",
+        oldest.second->to_string().c_str());
+      syn_queue_.erase(oldest.first);
       return;
     }
-    it++;
+  }
+}
+
+bool Listener::fast_open_room()
+{
+  // forget the ones done with the handshake, or gone
+  fast_open_pending_.erase(
+    std::remove_if(fast_open_pending_.begin(), fast_open_pending_.end(),
+      [] (const auto& weak) {
+        auto conn = weak.lock();
+        return conn == nullptr or not conn->is_state(Connection::SynReceived::instance());
+      }),
+    fast_open_pending_.end());
+  return fast_open_pending_.size() < host_.max_fast_open_pending();
+}
+
+void Listener::remove(const Connection* conn) {
+  TCPL_PRINT2("<Listener::remove> Try remove %s\n", conn->to_string().c_str());
+  auto it = syn_queue_.find(conn->remote());
+  if(it != syn_queue_.end() and it->second.get() == conn)
+  {
+    syn_queue_.erase(it);
+    debug("<Listener::remove> %s removed.\n", conn->to_string().c_str());
   }
 }
 
 void Listener::connected(Connection_ptr conn) {
   debug("<Listener::connected> %s connected\n", conn->to_string().c_str());
   remove(conn.get());
-  Expects(conn->is_connected());
+  Expects(conn->is_connected() or conn->fast_opened());
   if (UNLIKELY(! host_.add_connection(conn)))
     return;
 
@@ -146,8 +298,14 @@ void Listener::connected(Connection_ptr conn) {
 
 void Listener::close() {
   // Maybe abort() is too harsh, but connections are fully established yet so why not
-  for(auto conn : syn_queue_)
+  // aborting removes them from the queue
+  std::vector<Connection_ptr> half_open;
+  half_open.reserve(syn_queue_.size());
+  for(auto& entry : syn_queue_)
+    half_open.push_back(entry.second);
+  for(auto& conn : half_open)
     conn->abort();
+  syn_order_.clear();
 
   _on_close_(*this);
 }
@@ -163,8 +321,8 @@ std::string Listener::to_string() const {
           "[%s] SynQueue (%zu) ", local_.to_string().c_str(), syn_queue_.size());
   std::string str(buffer, len);
   // add syn queue
-  for(auto& conn : syn_queue_)
-      str += "\n\t" + conn->to_string();
+  for(auto& entry : syn_queue_)
+      str += "\n\t" + entry.second->to_string();
 
   return str;
 }
@@ -119,6 +119,12 @@ void Read_buffer::reset_buffer_if_needed()
   }
 }
 
+void Read_buffer::release()
+{
+  if(buf->empty() and buf.unique())
+    buf->shrink_to_fit();
+}
+
 __attribute__((weak))
 int Read_buffer::deserialize_from(void*) { return 0; }
 __attribute__((weak))
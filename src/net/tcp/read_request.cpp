@@ -16,12 +16,13 @@
 // limitations under the License.
 
 #include <net/tcp/read_request.hpp>
+#include <util/bitops.hpp>
 
 namespace net {
 namespace tcp {
 
   Read_request::Read_request(seq_t start, size_t min, size_t max, Alloc&& alloc)
-    : alloc{alloc}
+    : alloc{alloc}, bufsize_{max}
   {
     buffers.push_back(std::make_unique<Read_buffer>(start, min, max, alloc));
   }
@@ -71,7 +72,7 @@ namespace tcp {
           // it means the local sequence number is much farther behind
           // the real one
           seq = end_seq - rem;
-          buf->reset(seq);
+          buf->reset(seq, bufsize_);
           //printf("size=1, reset rem=%u start=%u end=%u\n",
           //  rem, buf->start_seq(), buf->end_seq());
           break;
@@ -95,7 +96,7 @@ namespace tcp {
           {
             //printf("finished, pop front start=%u end=%u\n",
             //  buf->start_seq(), buf->end_seq());
-            buffers.pop_front();
+            buffers.erase(buffers.begin());
             buf = buffers.front().get();
           }
         }
@@ -132,7 +133,7 @@ namespace tcp {
       // we probably need to create multiple buffers,
       // ... or just decide we only support gaps of 1 buffer size.
       buffers.push_back(
-        std::make_unique<Read_buffer>(cur_back->end_seq(), cur_back->capacity(), cur_back->capacity(), alloc));
+        std::make_unique<Read_buffer>(cur_back->end_seq(), bufsize_, bufsize_, alloc));
 
       auto& back = buffers.back();
       //printf("new buffer added start=%u end=%u, fits(%lu)=%lu\n",
@@ -202,10 +203,11 @@ namespace tcp {
           // For now the user will have to make sure to re-read later if they couldn't
         }
       } else if (on_read_callback != nullptr) {
-        for (auto buf : complete_buffers) {
+        while (not complete_buffers.empty()) {
           // Pop each time, in case callback leads to another call here.
-          complete_buffers.pop_front();
-          on_read_callback(buf);
+          auto buf = std::move(complete_buffers.front());
+          complete_buffers.erase(complete_buffers.begin());
+          on_read_callback(std::move(buf));
         }
       }
     }
@@ -222,10 +224,52 @@ namespace tcp {
     if (UNLIKELY(complete_buffers.empty()))
         return nullptr;
     auto buf = std::move(complete_buffers.front());
-    complete_buffers.pop_front();
+    complete_buffers.erase(complete_buffers.begin());
     return buf;
   }
 
+  void Read_request::set_bufsize(const size_t size)
+  {
+    Expects(util::bits::is_pow2(size));
+    bufsize_ = size;
+  }
+
+  size_t Read_request::window(const seq_t seq) const
+  {
+    // the buffers follow each other in sequence space
+    const auto& back = *buffers.back();
+    const auto more  = (buffer_limit - buffers.size()) * bufsize_;
+    const auto rel   = (int32_t)(seq - back.end_seq());
+    if(rel < 0)
+      return (seq_t)(back.end_seq() - seq) + more;
+    // past the end, only the next buffer is created to hold it
+    return ((size_t) rel < std::min(more, bufsize_)) ? more - rel : 0;
+  }
+
+  void Read_request::release()
+  {
+    for(auto& ptr : buffers)
+      ptr->release();
+
+    if(complete_buffers.empty())
+      complete_buffers.shrink_to_fit();
+  }
+
+  size_t Read_request::memory_usage() const
+  {
+    size_t bytes = sizeof(*this)
+      + buffers.capacity() * sizeof(Buffer_ptr)
+      + complete_buffers.capacity() * sizeof(buffer_t);
+
+    for(auto& ptr : buffers)
+      bytes += sizeof(Read_buffer) + ptr->memory_usage();
+
+    for(auto& buf : complete_buffers)
+      bytes += buf->capacity();
+
+    return bytes;
+  }
+
   void Read_request::reset(const seq_t seq)
   {
     Expects(not buffers.empty());
@@ -251,7 +295,7 @@ namespace tcp {
     signal_data();
 
     // reset the first buffer
-    buf->reset(seq);
+    buf->reset(seq, bufsize_);
     // throw the others away
     buffers.erase(++it, buffers.end());
 
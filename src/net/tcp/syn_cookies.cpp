@@ -0,0 +1,145 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <net/tcp/syn_cookies.hpp>
+#include <kernel/rng.hpp>
+#include <rtc>
+
+using namespace net;
+using namespace tcp;
+
+static const uint32_t MAC_BITS  = 22;
+static const uint32_t MAC_MASK  = (1u << MAC_BITS) - 1;
+static const uint32_t SLOT_MASK = 0x3;
+
+static inline uint64_t rotl(const uint64_t x, const int b) noexcept
+{ return (x << b) | (x >> (64 - b)); }
+
+// SipHash-2-4 over whole words
+static uint64_t siphash(const uint64_t k0, const uint64_t k1,
+                        const uint64_t* words, const size_t count) noexcept
+{
+  uint64_t v0 = 0x736f6d6570736575ull ^ k0;
+  uint64_t v1 = 0x646f72616e646f6dull ^ k1;
+  uint64_t v2 = 0x6c7967656e657261ull ^ k0;
+  uint64_t v3 = 0x7465646279746573ull ^ k1;
+  auto round = [&] {
+    v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);
+    v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;
+    v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;
+    v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);
+  };
+  for (size_t i = 0; i < count; i++) {
+    v3 ^= words[i];
+    round(); round();
+    v0 ^= words[i];
+  }
+  const uint64_t last = uint64_t(count * sizeof(uint64_t)) << 56;
+  v3 ^= last;
+  round(); round();
+  v0 ^= last;
+  v2 ^= 0xff;
+  round(); round(); round(); round();
+  return v0 ^ v1 ^ v2 ^ v3;
+}
+
+Syn_cookies::Syn_cookies()
+  : Syn_cookies(rng_extract_uint64(), rng_extract_uint64())
+{}
+
+uint32_t Syn_cookies::current_slot()
+{
+  return RTC::nanos_now() / (SLOT_SECONDS * 1000000000ull);
+}
+
+uint32_t Syn_cookies::current_period()
+{
+  return RTC::nanos_now() / (FAST_OPEN_SECONDS * 1000000000ull);
+}
+
+int Syn_cookies::mss_index(const uint16_t mss) noexcept
+{
+  for (int i = mss_table.size() - 1; i > 0; i--)
+    if (mss_table[i] <= mss) return i;
+  return 0;
+}
+
+uint32_t Syn_cookies::mac(const Socket& local, const Socket& remote,
+                          const seq_t irs, const uint32_t slot,
+                          const uint32_t fields) const noexcept
+{
+  const auto& laddr = local.address().v6();
+  const auto& raddr = remote.address().v6();
+  const uint64_t words[] {
+    laddr.i64[0], laddr.i64[1],
+    raddr.i64[0], raddr.i64[1],
+    uint64_t(local.port()) << 48 | uint64_t(remote.port()) << 32 | irs,
+    uint64_t(slot) << 32 | fields
+  };
+  return siphash(key0_, key1_, words, sizeof(words) / sizeof(words[0])) & MAC_MASK;
+}
+
+uint64_t Syn_cookies::fast_open(const Address& remote,
+                                const uint32_t period) const noexcept
+{
+  const auto& addr = remote.v6();
+  // kept apart from the SYN cookie MACs by the length
+  const uint64_t words[] { addr.i64[0], addr.i64[1], period };
+  return siphash(key0_, key1_, words, sizeof(words) / sizeof(words[0]));
+}
+
+bool Syn_cookies::check_fast_open(const Address& remote, const uint64_t cookie,
+                                  const uint32_t period) const noexcept
+{
+  return cookie == fast_open(remote, period)
+      or cookie == fast_open(remote, period - 1);
+}
+
+seq_t Syn_cookies::make(const Socket& local, const Socket& remote,
+                        const seq_t irs, const Params params,
+                        const uint32_t slot) const noexcept
+{
+  const uint32_t wscale = std::min(params.wscale, NO_WSCALE);
+  const uint32_t fields = uint32_t(mss_index(params.mss)) << 5
+                        | wscale << 1
+                        | (params.sack ? 1 : 0);
+  return (slot & SLOT_MASK) << 30
+       | fields << MAC_BITS
+       | mac(local, remote, irs, slot, fields);
+}
+
+std::optional<Syn_cookies::Params>
+Syn_cookies::check(const Socket& local, const Socket& remote,
+                   const seq_t irs, const seq_t cookie,
+                   const uint32_t slot) const noexcept
+{
+  const uint32_t fields = (cookie >> MAC_BITS) & 0xff;
+  // made in this slot or the one before
+  for (uint32_t age = 0; age < 2; age++)
+  {
+    const uint32_t made = slot - age;
+    if ((made & SLOT_MASK) != cookie >> 30) continue;
+    if (mac(local, remote, irs, made, fields) != (cookie & MAC_MASK))
+      return std::nullopt;
+
+    Params params;
+    params.mss    = mss_table[fields >> 5];
+    params.wscale = (fields >> 1) & 0xf;
+    params.sack   = fields & 1;
+    return params;
+  }
+  return std::nullopt;
+}
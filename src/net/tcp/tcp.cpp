@@ -27,6 +27,7 @@
 #include <net/inet_common.hpp> // checksum
 #include <statman>
 #include <rtc> // nanos_now (get_ts_value)
+#include <kernel/rng.hpp>
 #include <net/tcp/packet4_view.hpp>
 #include <net/tcp/packet6_view.hpp>
 
@@ -34,14 +35,18 @@ using namespace std;
 using namespace net;
 using namespace net::tcp;
 
-TCP::TCP(IPStack& inet, bool smp_enable) :
+TCP::TCP(IPStack& inet, bool smp_enable)
+  : TCP(inet, inet.tcp_ports(), smp_enable)
+{}
+
+TCP::TCP(IPStack& inet, Port_utils& ports, bool smp_enable) :
   inet_{inet},
   listeners_(),
-  connections_(),
+  connections_(rng_extract_uint64()),
   total_bufsize_{default_total_bufsize},
   mempool_{total_bufsize_},
   min_bufsize_{default_min_bufsize}, max_bufsize_{default_max_bufsize},
-  ports_(inet.tcp_ports()),
+  ports_(ports),
   writeq(),
   max_seg_lifetime_{default_msl},       // 30s
   win_size_{default_ws_window_size},    // 8096*1024
@@ -53,6 +58,7 @@ TCP::TCP(IPStack& inet, bool smp_enable) :
 {
   Expects(wscale_ <= 14 && "WScale factor cannot exceed 14");
   Expects(win_size_ <= 0x40000000 && "Invalid size");
+  time_wait_.on_release({this, &TCP::time_wait_released});
 
   this->cpu_id = SMP::cpu_id();
   this->smp_enabled = smp_enable;
@@ -69,20 +75,31 @@ TCP::TCP(IPStack& inet, bool smp_enable) :
     SMP::global_unlock();
     stat_prefix = inet.ifname() + ".cpu" + std::to_string(this->cpu_id);
   }
-  bytes_rx_ = &Statman::get().create(Stat::UINT64, stat_prefix + ".tcp.rx").get_uint64();
-  bytes_tx_ = &Statman::get().create(Stat::UINT64, stat_prefix + ".tcp.tx").get_uint64();
-  packets_rx_ = &Statman::get().create(Stat::UINT64, stat_prefix + ".tcp.packets_rx").get_uint64();
-  packets_tx_ = &Statman::get().create(Stat::UINT64, stat_prefix + ".tcp.packets_tx").get_uint64();
-  incoming_connections_ = &Statman::get().create(Stat::UINT64, stat_prefix + ".tcp.conn_incoming").get_uint64();
-  outgoing_connections_ = &Statman::get().create(Stat::UINT64, stat_prefix + ".tcp.conn_outgoing").get_uint64();
-  connection_attempts_ = &Statman::get().create(Stat::UINT64, stat_prefix + ".tcp.conn_attempts").get_uint64();
-  packets_dropped_ = &Statman::get().create(Stat::UINT32, stat_prefix + ".tcp.dropped").get_uint32();
+  bytes_rx_ = &Statman::get().create(Stat::COUNTER, stat_prefix + ".tcp.rx").get_counter();
+  bytes_tx_ = &Statman::get().create(Stat::COUNTER, stat_prefix + ".tcp.tx").get_counter();
+  packets_rx_ = &Statman::get().create(Stat::COUNTER, stat_prefix + ".tcp.packets_rx").get_counter();
+  packets_tx_ = &Statman::get().create(Stat::COUNTER, stat_prefix + ".tcp.packets_tx").get_counter();
+  incoming_connections_ = &Statman::get().create(Stat::COUNTER, stat_prefix + ".tcp.conn_incoming").get_counter();
+  outgoing_connections_ = &Statman::get().create(Stat::COUNTER, stat_prefix + ".tcp.conn_outgoing").get_counter();
+  connection_attempts_ = &Statman::get().create(Stat::COUNTER, stat_prefix + ".tcp.conn_attempts").get_counter();
+  packets_dropped_ = &Statman::get().create(Stat::COUNTER, stat_prefix + ".tcp.dropped").get_counter();
+  rto_timeouts_ = &Statman::get().create(Stat::COUNTER, stat_prefix + ".tcp.rto_timeouts").get_counter();
+  rtt_ms_ = &Statman::get().create(Stat::HISTOGRAM, stat_prefix + ".tcp.rtt_ms").get_histogram();
+  syn_cookies_sent_ = &Statman::get().create(Stat::COUNTER, stat_prefix + ".tcp.syn_cookies_sent").get_counter();
+  syn_cookies_accepted_ = &Statman::get().create(Stat::COUNTER, stat_prefix + ".tcp.syn_cookies_accepted").get_counter();
+  fast_open_sent_ = &Statman::get().create(Stat::COUNTER, stat_prefix + ".tcp.fast_open_sent").get_counter();
+  fast_open_accepted_ = &Statman::get().create(Stat::COUNTER, stat_prefix + ".tcp.fast_open_accepted").get_counter();
+  fast_open_failed_ = &Statman::get().create(Stat::COUNTER, stat_prefix + ".tcp.fast_open_failed").get_counter();
+  fq_delay_us_ = &Statman::get().create(Stat::HISTOGRAM, stat_prefix + ".tcp.fq_delay_us").get_histogram();
+  fq_sparse_packets_ = &Statman::get().create(Stat::COUNTER, stat_prefix + ".tcp.fq_sparse_packets").get_counter();
+  fq_bulk_packets_ = &Statman::get().create(Stat::COUNTER, stat_prefix + ".tcp.fq_bulk_packets").get_counter();
+  fq_throttled_ = &Statman::get().create(Stat::COUNTER, stat_prefix + ".tcp.fq_throttled").get_counter();
 }
 
 void TCP::smp_process_writeq(size_t packets)
 {
-  assert(SMP::cpu_id() == 0);
-  assert(this->cpu_id != 0);
+  assert(SMP::cpu_id() == inet_.get_cpu_id());
+  assert(this->cpu_id != inet_.get_cpu_id());
   SMP::add_task(
   [this, packets] () {
     this->process_writeq(packets);
@@ -197,12 +214,30 @@ Connection_ptr TCP::connect(Socket local, Socket remote)
   return conn;
 }
 
+void TCP::connect(Socket remote, buffer_t data, ConnectCallback callback)
+{
+  auto addr = [&]()->auto{
+    if(remote.address().is_v6())
+    {
+      auto dest = remote.address().v6();
+      return Addr{inet_.addr6_config().get_src(dest)};
+    }
+    else
+    {
+      return Addr{inet_.ip_addr()};
+    }
+  }();
+
+  auto conn = create_connection(bind(addr), remote, std::move(callback));
+  // queued before the SYN is made, so it can go along
+  if(data != nullptr and not data->empty())
+    conn->writeq.push_back(std::move(data));
+  conn->open(true);
+}
+
 void TCP::insert_connection(Connection_ptr conn)
 {
-  connections_.emplace(
-      std::piecewise_construct,
-      std::forward_as_tuple(conn->local(), conn->remote()),
-      std::forward_as_tuple(conn));
+  connections_.insert({conn->local(), conn->remote()}, conn);
 }
 
 void TCP::receive4(net::Packet_ptr ptr)
@@ -230,7 +265,7 @@ void TCP::receive6(net::Packet_ptr ptr)
 void TCP::receive(Packet_view& packet)
 {
   // Stat increment packets received
-  (*packets_rx_)++;
+  ++(*packets_rx_);
   assert(get_cpuid() == SMP::cpu_id());
 
   // validate some unlikely but invalid packet properties
@@ -266,15 +301,22 @@ void TCP::receive(Packet_view& packet)
   const Connection::Tuple tuple { dest, packet.source() };
 
   // Try to find the receiver
-  auto conn_it = connections_.find(tuple);
+  auto* conn = connections_.find(tuple);
 
   // Connection found
-  if (conn_it != connections_.end()) {
-    PRINT("<TCP::receive> Connection found: %s \n", conn_it->second->to_string().c_str());
-    conn_it->second->segment_arrived(packet);
+  if (conn != nullptr) {
+    PRINT("<TCP::receive> Connection found: %s \n", conn->to_string().c_str());
+    conn->segment_arrived(packet);
     return;
   }
 
+  // A closed connection waiting out TIME-WAIT
+  if (not time_wait_.empty()) {
+    auto* tw = time_wait_.find(tuple);
+    if (tw != nullptr and time_wait_arrived(packet, tuple, *tw))
+      return;
+  }
+
   // No open connection found, find listener for destination
   debug("<TCP::receive> No connection found - looking for listener..\n");
   auto listener_it = find_listener(dest);
@@ -305,11 +347,12 @@ string TCP::to_string() const {
   }
   str +=
   "\nCONNECTIONS:\nLocal\tRemote\tState\n";
-  for(auto& con_it : connections_) {
-    auto& c = *(con_it.second);
+  for(auto& conn : connections_) {
+    auto& c = *conn;
     str += c.local().to_string() + "\t" + c.remote().to_string() + "\t"
         + c.state().to_string() + "\n";
   }
+  str += "\nTIME-WAIT: " + std::to_string(time_wait_.size()) + "\n";
   return str;
 }
 
@@ -336,8 +379,8 @@ void TCP::error_report(const Error& err, Socket dest) {
 
       // Find all connections sending to this destination
       // Notify the TCP Connection that the sent packet has been dropped and needs to be retransmitted
-      for (auto& conn_entry : connections_) {
-        if (conn_entry.first.second == dest) {
+      for (auto& conn : connections_) {
+        if (conn->remote() == dest) {
           /*
           Note: One MUST not retransmit in response to every Datagram Too Big message, since
           a burst of several oversized segments will give rise to several such messages and hence
@@ -352,8 +395,8 @@ void TCP::error_report(const Error& err, Socket dest) {
           // minus the size of the IP header and minus the size of the TCP header
           auto new_smss = icmp_err->pmtu() - sizeof(ip4::Header) - sizeof(tcp::Header);
 
-          if (conn_entry.second->SMSS() > new_smss) {
-            conn_entry.second->set_SMSS(new_smss);
+          if (conn->SMSS() > new_smss) {
+            conn->set_SMSS(new_smss);
 
             // TODO Check that this works as expected:
             // Unlike a retransmission caused by a TCP retransmission timeout, a retransmission
@@ -366,8 +409,8 @@ void TCP::error_report(const Error& err, Socket dest) {
 
             // Note:
             // Check if it is necessary to call reduce_ssthresh() (slow start)
-            conn_entry.second->reduce_ssthresh();
-            conn_entry.second->retransmit();
+            conn->reduce_ssthresh();
+            conn->retransmit();
           }
         }
       }
@@ -386,9 +429,9 @@ void TCP::reset_pmtu(Socket dest, IP4::PMTU pmtu) {
 
   // Find all connections sending to this destination and update their SMSS value
   // based on the new increased pmtu
-  for (auto& conn_entry : connections_) {
-    if (conn_entry.first.second == dest)
-      conn_entry.second->set_SMSS(pmtu - sizeof(ip4::Header) - sizeof(tcp::Header));
+  for (auto& conn : connections_) {
+    if (conn->remote() == dest)
+      conn->set_SMSS(pmtu - sizeof(ip4::Header) - sizeof(tcp::Header));
   }
 }
 
@@ -399,7 +442,7 @@ void TCP::transmit(tcp::Packet_view_ptr packet)
 
   // Stat increment bytes transmitted and packets transmitted
   (*bytes_tx_) += packet->tcp_data_length();
-  (*packets_tx_)++;
+  ++(*packets_tx_);
 
   if(packet->ipv() == Protocol::IPv6) {
     network_layer_out6_(packet->release());
@@ -445,12 +488,13 @@ seq_t TCP::generate_iss() {
 
 uint32_t TCP::get_ts_value() const
 {
-  return ((RTC::nanos_now() / 1000000000ull) & 0xffffffff);
+  // milliseconds, which is what RTTM takes the samples to be
+  return ((RTC::nanos_now() / 1000000ull) & 0xffffffff);
 }
 
 void TCP::drop(const tcp::Packet_view&) {
   // Stat increment packets dropped
-  (*packets_dropped_)++;
+  ++(*packets_dropped_);
   debug("<TCP::drop> Packet dropped\n");
 }
 
@@ -508,9 +552,10 @@ bool TCP::unbind(const Socket& socket)
 
 bool TCP::add_connection(tcp::Connection_ptr conn)
 {
-  const size_t alloc_thres = max_bufsize() * Read_request::buffer_limit;
+  // buffers start small and grow with the connection
+  const size_t alloc_thres = min_bufsize() * Read_request::buffer_limit;
   // Stat increment number of incoming connections
-  (*incoming_connections_)++;
+  ++(*incoming_connections_);
 
   debug("<TCP::add_connection> Connection added %s \n", conn->to_string().c_str());
   auto resource = mempool_.get_resource();
@@ -529,12 +574,12 @@ bool TCP::add_connection(tcp::Connection_ptr conn)
 
   Expects(conn->bufalloc != nullptr);
   conn->_on_cleanup({this, &TCP::close_connection});
-  return connections_.emplace(conn->tuple(), conn).second;
+  return connections_.insert(conn->tuple(), conn).second;
 }
 
 Connection_ptr TCP::create_connection(Socket local, Socket remote, ConnectCallback cb)
 {
-  const size_t alloc_thres = max_bufsize() * Read_request::buffer_limit;
+  const size_t alloc_thres = min_bufsize() * Read_request::buffer_limit;
 
   auto resource = mempool_.get_resource();
   // Don't create connection if we can't allocate memory
@@ -544,13 +589,12 @@ Connection_ptr TCP::create_connection(Socket local, Socket remote, ConnectCallba
   }
 
   // Stat increment number of outgoing connections
-  (*outgoing_connections_)++;
+  ++(*outgoing_connections_);
 
-  auto& conn = (connections_.emplace(
+  auto& conn = *connections_.insert(
       Connection::Tuple{ local, remote },
       std::make_shared<Connection>(*this, local, remote, std::move(cb))
-      )
-    ).first->second;
+    ).first;
   conn->_on_cleanup({this, &TCP::close_connection});
   conn->bufalloc = std::move(resource);
 
@@ -560,18 +604,131 @@ Connection_ptr TCP::create_connection(Socket local, Socket remote, ConnectCallba
   return conn;
 }
 
+static inline uint64_t now_ms() noexcept
+{ return RTC::nanos_now() / 1000000ull; }
+
+void TCP::add_time_wait(const Connection& conn)
+{
+  const auto& cb = conn.cb;
+  tcp::Time_wait tw;
+  tw.snd_nxt   = cb.SND.NXT;
+  tw.rcv_nxt   = cb.RCV.NXT;
+  tw.ts_recent = cb.TS_recent;
+  tw.ts_ok     = cb.SND.TS_OK;
+  tw.win       = std::min(cb.RCV.WND >> cb.RCV.wind_shift, (uint32_t)default_window_size);
+  tw.expires   = now_ms() + 2 * MSL().count();
+  time_wait_.insert(conn.tuple(), tw);
+
+  if (not time_wait_timer_.is_running())
+    time_wait_timer_.start(2 * MSL(), {this, &TCP::time_wait_timeout});
+}
+
+bool TCP::time_wait_arrived(Packet_view& packet, const Connection::Tuple& tuple, tcp::Time_wait& tw)
+{
+  if (packet.isset(RST)) {
+    time_wait_.erase(tuple);
+    drop(packet);
+    return true;
+  }
+
+  const auto* ts = packet.parse_ts_option();
+  if (packet.isset(SYN) and not packet.isset(ACK))
+  {
+    const uint32_t ts_val = ts ? ntohl(ts->val) : 0;
+    if (tw.acceptable_syn(packet.seq(), ts ? &ts_val : nullptr)) {
+      // a new incarnation of the flow, let the listener have it
+      time_wait_.erase(tuple);
+      return false;
+    }
+  }
+  else if (packet.isset(FIN)) {
+    // our ACK of the FIN was lost, wait another 2*MSL
+    tw.expires = now_ms() + 2 * MSL().count();
+    if (ts and tw.ts_ok) tw.ts_recent = ntohl(ts->val);
+  }
+  else {
+    drop(packet);
+    return true;
+  }
+
+  // <SEQ=SND.NXT><ACK=RCV.NXT><CTL=ACK>
+  auto out = (packet.ipv() == Protocol::IPv6)
+    ? create_outgoing_packet6() : create_outgoing_packet();
+  out->set_source(packet.destination());
+  out->set_destination(packet.source());
+  out->set_seq(tw.snd_nxt).set_ack(tw.rcv_nxt).set_flag(ACK);
+  out->set_win(tw.win);
+  if (tw.ts_ok)
+    out->add_tcp_option_aligned<tcp::Option::opt_ts_align>(get_ts_value(), tw.ts_recent);
+  transmit(std::move(out));
+  return true;
+}
+
+void TCP::time_wait_timeout()
+{
+  const auto now  = now_ms();
+  const auto next = time_wait_.expire(now);
+  if (next != 0)
+    time_wait_timer_.start(std::chrono::milliseconds(next - now), {this, &TCP::time_wait_timeout});
+}
+
+void TCP::rcvbuf_grown()
+{
+  if (not rcvbuf_timer_.is_running())
+    rcvbuf_timer_.start(tcp::default_rcvbuf_idle, {this, &TCP::rcvbuf_timeout});
+}
+
+void TCP::rcvbuf_timeout()
+{
+  using namespace std::chrono;
+  const auto now     = Connection::rack_clock();
+  const auto timeout = duration_cast<microseconds>(tcp::default_rcvbuf_idle).count();
+
+  bool grown = false;
+  for (auto& conn : connections_)
+    grown |= conn->rcvbuf_idle(now, timeout);
+
+  if (grown)
+    rcvbuf_timer_.start(tcp::default_rcvbuf_idle, {this, &TCP::rcvbuf_timeout});
+}
+
+size_t TCP::memory_usage() const
+{
+  size_t bytes = connections_.capacity() * sizeof(Connections::Slot);
+  for (auto& conn : connections_)
+    bytes += conn->memory_usage();
+  return bytes;
+}
+
+void TCP::time_wait_released(const Connection::Tuple& tuple)
+{
+  // unless a new connection has taken over the flow
+  if (connections_.find(tuple) == nullptr)
+    unbind(tuple.first);
+}
+
 void TCP::process_writeq(size_t packets) {
   debug2("<TCP::process_writeq> size=%u p=%u\n", writeq.size(), packets);
-  // foreach connection who wants to write
+  const auto now = Connection::rack_clock();
+  writeq.release(now);
+  // foreach connection who wants to write, a quantum at a time
   while(packets and !writeq.empty()) {
     debug("<TCP::process_writeq> Processing writeq size=%u, p=%u\n", writeq.size(), packets);
-    auto conn = writeq.front();
-    // remove from writeq
-    writeq.pop_front();
-    conn->set_queued(false);
-    // packets taken in as reference
-    conn->offer(packets);
+    auto entry = writeq.dequeue();
+    entry.flow->set_queued(false);
+    // flows queued by the offers above got in after now was taken
+    fq_delay_us_->record(entry.since < now ? now - entry.since : 0);
+
+    // quantum taken in as reference
+    size_t quantum = std::min(packets, fq_quantum_);
+    const auto offered = quantum;
+    entry.flow->offer(quantum);
+
+    const auto used = offered - quantum;
+    packets -= used;
+    *(entry.sparse ? fq_sparse_packets_ : fq_bulk_packets_) += used;
   }
+  pacing_arm(now);
 }
 
 void TCP::request_offer(Connection& conn) {
@@ -582,19 +739,23 @@ void TCP::request_offer(Connection& conn) {
   debug2("<TCP::request_offer> %s requestin offer: uw=%u rem=%u\n",
     conn.to_string().c_str(), conn.usable_window(), conn.sendq_remaining());
 
-  // Note: Must be called even if packets is 0
-  // because the connectoin is responsible for requeuing itself (see Connection::offer)
-  conn.offer(packets);
+  // take a place in the queue, ahead of the bulk flows if nothing
+  // is in flight, and let the queue be served with what is available
+  if(not conn.is_queued() and conn.can_send())
+  {
+    writeq.enqueue(conn.retrieve_shared(), conn.flight_size() == 0, Connection::rack_clock());
+    conn.set_queued(true);
+  }
+  process_writeq(packets);
 }
 
-
 void TCP::queue_offer(Connection& conn)
 {
   if(not conn.is_queued() and conn.can_send())
   {
     try {
       debug("<TCP::queue_offer> %s queued\n", conn.to_string().c_str());
-      writeq.push_back(conn.retrieve_shared());
+      writeq.enqueue(conn.retrieve_shared(), false, Connection::rack_clock());
       conn.set_queued(true);
     }
     catch (std::exception& e) {
@@ -605,6 +766,33 @@ void TCP::queue_offer(Connection& conn)
   }
 }
 
+void TCP::throttle_offer(Connection& conn, uint64_t when)
+{
+  if(conn.is_queued())
+    return;
+  writeq.throttle(conn.retrieve_shared(), when);
+  conn.set_queued(true);
+  ++(*fq_throttled_);
+  pacing_arm(Connection::rack_clock());
+}
+
+void TCP::pacing_arm(uint64_t now)
+{
+  const auto due = writeq.next_release();
+  if(due == 0 or (pacing_timer_.is_running() and pacing_due_ <= due))
+    return;
+
+  pacing_due_ = due;
+  const std::chrono::microseconds wait{(due > now) ? due - now : 0};
+  pacing_timer_.restart(wait, {this, &TCP::pacing_timeout});
+}
+
+void TCP::pacing_timeout()
+{
+  pacing_due_ = 0;
+  process_writeq(inet_.transmit_queue_available());
+}
+
 tcp::Address TCP::address() const noexcept
 { return inet_.ip_addr(); }
 
@@ -38,21 +38,23 @@ void Write_queue::advance(size_t bytes)
 
   if(offset_ == buf->size())
   {
+    // the callback may queue more, moving the buffers around
+    const auto written = buf->size();
     current_++;
     offset_ = 0;
 
     if(on_write_)
-      on_write_(buf->size());
+      on_write_(written);
 
     debug("<WriteQueue> Advance: Done (%u) current++ [%u] sz=%u\n",
-      buf->size(), current_, q.size());
+      written, current_, size());
   }
 }
 
 void Write_queue::acknowledge(size_t bytes)
 {
   debug2("<WriteQueue> Acknowledge %u bytes, ack=%u\n", bytes, acked_);
-  while(bytes and !q.empty())
+  while(bytes and !empty())
   {
     auto& buf = una();
     assert(buf->size() >= acked_);
@@ -67,7 +69,7 @@ void Write_queue::acknowledge(size_t bytes)
       // reset acked
       acked_ = 0;
       // pop and subtract index
-      q.pop_front();
+      pop_front();
       current_--;
 
       debug("<WriteQueue> Acknowledge done, current-- [%u] sz=%u\n", current_, q.size());
@@ -87,30 +89,70 @@ void Write_queue::reset()
     on_write_(offset_);
 
   q.clear();
+  q.shrink_to_fit();
+  head_ = 0;
   current_ = 0;
   debug("<WriteQueue::reset> Reset\n");
 }
 
+void Write_queue::pop_front()
+{
+  // release the buffer right away
+  q[head_++] = nullptr;
+
+  if(head_ == q.size())
+  {
+    q.clear();
+    head_ = 0;
+  }
+  else if(head_ >= 16 and head_ * 2 >= q.size())
+  {
+    q.erase(q.begin(), q.begin() + head_);
+    head_ = 0;
+  }
+}
+
+size_t Write_queue::memory_usage() const
+{
+  size_t bytes = q.capacity() * sizeof(WriteBuffer);
+  for(auto i = head_; i < q.size(); ++i)
+    bytes += q[i]->capacity();
+  return bytes;
+}
+
+std::pair<const uint8_t*, size_t> Write_queue::data_at(uint32_t offset) const
+{
+  offset += acked_;
+  for(auto i = head_; i < q.size(); ++i)
+  {
+    auto& buf = q[i];
+    if(offset < buf->size())
+      return {buf->data() + offset, buf->size() - offset};
+    offset -= buf->size();
+  }
+  return {nullptr, 0};
+}
+
 uint32_t Write_queue::bytes_remaining() const
 {
-  if(current_ >= q.size()) return 0;
+  if(current_ >= size()) return 0;
 
   uint32_t n = nxt()->size() - offset_;
 
-  for(auto i = current_ + 1; i < q.size(); ++i)
-    n += q.at(i)->size();
+  for(auto i = current_ + 1; i < size(); ++i)
+    n += at(i)->size();
 
   return n;
 }
 
 uint32_t Write_queue::bytes_unacknowledged() const
 {
-  if(q.empty()) return 0;
+  if(empty()) return 0;
 
   uint32_t n = una()->size() - acked_;
 
-  for(uint32_t i = 1; i < q.size(); ++i)
-    n += q.at(i)->size();
+  for(uint32_t i = 1; i < size(); ++i)
+    n += at(i)->size();
 
   return n;
 }
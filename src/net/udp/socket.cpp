@@ -29,6 +29,13 @@ namespace net::udp
 
   void Socket::internal_read(const Packet_view& udp)
   {
+    if (on_read_batch_handler != nullptr)
+    {
+      const Datagram dgram {udp.ip_src(), udp.src_port(),
+                            (const char*) udp.udp_data(), udp.udp_data_length()};
+      on_read_batch_handler(&dgram, 1);
+      return;
+    }
     on_read_handler(udp.ip_src(), udp.src_port(),
                    (const char*) udp.udp_data(), udp.udp_data_length());
   }
@@ -51,6 +58,15 @@ namespace net::udp
     udp_.flush();
   }
 
+  size_t Socket::sendmmsg(
+    const Datagram* datagrams,
+    size_t count,
+    sendto_handler cb,
+    error_handler ecb)
+  {
+    return udp_.sendmmsg(socket_, datagrams, count, cb, ecb);
+  }
+
   void Socket::bcast(
     addr_t srcIP,
     port_t port,
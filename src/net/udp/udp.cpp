@@ -34,10 +34,21 @@
 namespace net {
 
   UDP::UDP(Stack& inet)
+    : UDP(inet, inet.udp_ports(), false)
+  {}
+
+  UDP::UDP(Stack& inet, Port_utils& ports, bool smp)
     : stack_(inet),
-      ports_(inet.udp_ports())
+      ports_(ports)
   {
-    inet.on_transmit_queue_available({this, &UDP::process_sendq});
+    if (not smp)
+    {
+      inet.on_transmit_queue_available({this, &UDP::process_sendq});
+      inet.on_rx_batch_done({this, &UDP::deliver_batches});
+    }
+    rx_pending_.reserve(udp::rx_batch_max);
+    rx_work_.reserve(udp::rx_batch_max);
+    rx_batch_.reserve(udp::rx_batch_max);
   }
 
   void UDP::receive4(net::Packet_ptr ptr)
@@ -91,6 +102,14 @@ namespace net {
     if (it != sockets_.end()) {
       PRINT("<%s> UDP found listener on %s\n",
               stack_.ifname().c_str(), udp_packet->destination().to_string().c_str());
+      // kept until the NIC is done with the round
+      if (it->second.on_read_batch_handler != nullptr)
+      {
+        rx_pending_.push_back(std::move(udp_packet));
+        if (rx_pending_.size() >= udp::rx_batch_max)
+          deliver_batches();
+        return;
+      }
       it->second.internal_read(*udp_packet);
       return;
     }
@@ -99,16 +118,22 @@ namespace net {
       auto dport = dest.port();
       PRINT("<%s> UDP received broadcast on port %d\n", stack_.ifname().c_str(), dport);
 
-      for(auto it = sockets_.begin(); it != sockets_.end();)
+      // internal_read() may bind or close sockets, which can rehash
+      // the map, so the receivers are looked up again one by one
+      std::vector<Socket> receivers;
+      for(const auto& entry : sockets_)
       {
-        auto current = it++; // internal_read() may result in close,
-                             // this is to avoid iterator invalidation
-        if(current->first.port() == dport)
-        {
-          PRINT("<%s> UDP found broadcast receiver: %s\n",
-              stack_.ifname().c_str(), current->first.to_string().c_str());
-          current->second.internal_read(*udp_packet);
-        }
+        if(entry.first.port() == dport)
+          receivers.push_back(entry.first);
+      }
+      for(const auto& receiver : receivers)
+      {
+        auto current = sockets_.find(receiver);
+        if(current == sockets_.end())
+          continue;
+        PRINT("<%s> UDP found broadcast receiver: %s\n",
+            stack_.ifname().c_str(), current->first.to_string().c_str());
+        current->second.internal_read(*udp_packet);
       }
       return;
     }
@@ -121,6 +146,40 @@ namespace net {
     send_dest_unreachable(std::move(udp_packet));
   }
 
+  void UDP::deliver_batches()
+  {
+    // the handlers may close sockets and send, but a round
+    // received meanwhile waits for this one to finish
+    if (rx_delivering_)
+      return;
+    rx_delivering_ = true;
+
+    while (not rx_pending_.empty())
+    {
+      std::swap(rx_pending_, rx_work_);
+
+      size_t i = 0;
+      while (i < rx_work_.size())
+      {
+        // the datagrams in a row for the same socket go together
+        const auto dest = rx_work_[i]->destination();
+        rx_batch_.clear();
+        for (; i < rx_work_.size() and rx_work_[i]->destination() == dest; i++)
+        {
+          const auto& pkt = *rx_work_[i];
+          rx_batch_.push_back({pkt.ip_src(), pkt.src_port(),
+                               (const char*) pkt.udp_data(), pkt.udp_data_length()});
+        }
+        // the socket may have been closed since
+        auto it = find(dest);
+        if (it != sockets_.end() and it->second.on_read_batch_handler != nullptr)
+          it->second.on_read_batch_handler(rx_batch_.data(), rx_batch_.size());
+      }
+      rx_work_.clear();
+    }
+    rx_delivering_ = false;
+  }
+
   void UDP::send_dest_unreachable(udp::Packet_view_ptr udp)
   {
     if(udp->ipv() == Protocol::IPv4)
@@ -278,14 +337,8 @@ namespace net {
         if (buffer.send_callback != nullptr)
           buffer.send_callback();
 
-        if (buffer.error_callback != nullptr) {
-          error_callbacks_.emplace(std::piecewise_construct,
-                              std::forward_as_tuple(buffer.dst),
-                              std::forward_as_tuple(Error_entry{buffer.error_callback}));
-
-          if (UNLIKELY(not flush_timer_.is_running()))
-            flush_timer_.start(flush_interval_);
-        }
+        if (buffer.error_callback != nullptr)
+          add_error_callback(buffer.dst, buffer.error_callback);
 
         // remove buffer from queue
         sendq.pop_front();
@@ -298,6 +351,82 @@ namespace net {
     }
   }
 
+  void UDP::add_error_callback(const net::Socket& dst, error_handler ecb)
+  {
+    error_callbacks_.emplace(std::piecewise_construct,
+                        std::forward_as_tuple(dst),
+                        std::forward_as_tuple(Error_entry{ecb}));
+
+    if (UNLIKELY(not flush_timer_.is_running()))
+      flush_timer_.start(flush_interval_);
+  }
+
+  size_t UDP::sendmmsg(const net::Socket& src, const udp::Datagram* datagrams,
+                       const size_t count, sendto_handler cb, error_handler ecb)
+  {
+    size_t sent = 0;
+    // straight into packets, unless queued datagrams are to go first
+    if (sendq.empty())
+    {
+      const size_t mds = max_datagram_size();
+      size_t avail = stack_.transmit_queue_available();
+      for (; sent < count; sent++)
+      {
+        const auto& dgram = datagrams[sent];
+        if (UNLIKELY(dgram.length == 0)) continue;
+
+        const size_t needed = (dgram.length + mds - 1) / mds;
+        if (needed > avail) break;
+        write(src, {dgram.addr, dgram.port}, dgram.data, dgram.length);
+        avail -= needed;
+      }
+    }
+
+    // the rest wait for room in the transmit queue
+    const auto queued = sendq.size();
+    for (size_t i = sent; i < count; i++)
+    {
+      const auto& dgram = datagrams[i];
+      if (UNLIKELY(dgram.length == 0)) continue;
+      sendq.emplace_back(*this, src, net::Socket{dgram.addr, dgram.port},
+                         (const uint8_t*) dgram.data, dgram.length,
+                         nullptr, nullptr);
+    }
+
+    if (sendq.size() > queued)
+    {
+      sendq.back().send_callback  = cb;
+      sendq.back().error_callback = ecb;
+      flush();
+    }
+    else if (count > 0)
+    {
+      if (cb != nullptr)
+        cb();
+      if (ecb != nullptr)
+        add_error_callback({datagrams[count-1].addr, datagrams[count-1].port}, ecb);
+    }
+    return sent;
+  }
+
+  void UDP::write(const net::Socket& src, const net::Socket& dst,
+                  const char* data, size_t length)
+  {
+    const size_t mds = max_datagram_size();
+    while (length)
+    {
+      const size_t total = std::min(length, mds);
+      auto pkt = create_packet(src, dst);
+      if (UNLIKELY(!pkt)) return;
+
+      pkt->fill((const uint8_t*) data, total);
+      transmit(std::move(pkt));
+
+      data   += total;
+      length -= total;
+    }
+  }
+
   size_t UDP::WriteBuffer::packets_needed() const
   {
     int r = remaining();
@@ -63,10 +63,11 @@ void os::halt() noexcept{
 
 void os::event_loop()
 {
-  Events::get(0).process_events();
+  bool pending = Events::get(0).process_events();
   do {
-    os::halt();
-    Events::get(0).process_events();
+    // work left over from the last round runs without sleeping
+    if (not pending) os::halt();
+    pending = Events::get(0).process_events();
   } while (kernel::is_running());
 
   MYINFO("Stopping service");
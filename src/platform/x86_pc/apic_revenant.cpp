@@ -121,8 +121,8 @@ void revenant_main(int cpu)
   SMP::global_unlock();
   while (true)
   {
-    Events::get().process_events();
-    os::halt();
+    if (not Events::get().process_events())
+        os::halt();
   }
   __builtin_unreachable();
 }
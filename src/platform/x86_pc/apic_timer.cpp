@@ -18,9 +18,13 @@
 #include "apic_timer.hpp"
 #include "apic.hpp"
 #include "pit.hpp"
+#include <arch/x86/cpu.hpp>
+#include <kernel/cpuid.hpp>
 #include <kernel/events.hpp>
 #include <kernel/timers.hpp>
+#include <os.hpp>
 #include <smp>
+#include <algorithm>
 #include <cstdio>
 #include <info>
 
@@ -30,15 +34,24 @@
 
 // vol 3a  10-10
 #define DIVIDE_BY_16     0x3
+// the divider programmed by timer_init()
+#define TIMER_DIVIDER    4
 
-#define CALIBRATION_MS   125
+#define IA32_TSC_DEADLINE  0x6E0
 
 using namespace std::chrono;
 
 namespace x86
 {
-  // calculated once on BSP
-  static uint32_t ticks_per_micro = 0;
+  // calculated once on BSP, per millisecond so that rates that aren't
+  // a whole number of ticks per microsecond aren't truncated
+  static uint32_t ticks_per_milli = 0;
+  // TSC-deadline mode is used when available, and needs no calibration
+  static bool   tsc_deadline = false;
+  static double tsc_per_nano = 0.0;
+  static const char* timer_mode = "not started";
+  // set when the timer had to be measured against the PIT
+  static bool pit_calibrated = false;
 
   struct alignas(SMP_ALIGN) timer_data
   {
@@ -60,13 +73,32 @@ namespace x86
     GET_TIMER().intr =
         Events::get().subscribe(Timers::timers_handler);
     // initialize local APIC timer
-    APIC::get().timer_init(GET_TIMER().intr);
+    tsc_deadline = CPUID::has_feature(CPUID::Feature::TSC_DEADLINE);
+    APIC::get().timer_init(GET_TIMER().intr, tsc_deadline);
+    // order the LVT write before any write to the deadline MSR
+    if (tsc_deadline) asm volatile("mfence" ::: "memory");
   }
   void APIC_Timer::calibrate()
   {
     init();
 
-    if (ticks_per_micro != 0) {
+    if (tsc_deadline) {
+      // the TSC frequency is already known, so nothing to measure
+      assert(os::cpu_freq().count() > 0);
+      tsc_per_nano = os::cpu_freq().count() / 1e6;
+      timer_mode = "TSC-deadline";
+    }
+    else if (ticks_per_milli == 0) {
+      // the CPU or hypervisor may tell us the timer frequency
+      ticks_per_milli = CPUID::lapic_khz() / TIMER_DIVIDER;
+      timer_mode = (ticks_per_milli) ? "one-shot, CPUID frequency"
+                                     : "one-shot, PIT calibrated";
+    }
+    else {
+      timer_mode = "one-shot, previous kernel";
+    }
+
+    if (ready()) {
       start_timers();
       // with SMP, signal everyone else too (IRQ 1)
       if (SMP::cpu_count() > 1) {
@@ -77,6 +109,7 @@ namespace x86
 
     // start timer (unmask)
     INFO("APIC", "Measuring APIC timer...");
+    pit_calibrated = true;
 
     auto& lapic = APIC::get();
     // See: Vol3a 10.5.4.1 TSC-Deadline Mode
@@ -95,14 +128,14 @@ namespace x86
     PIT::oneshot(milliseconds(CALIBRATION_MS),
     [overhead] {
       uint32_t diff = APIC::get().timer_diff() - overhead;
-      assert(ticks_per_micro == 0);
+      assert(ticks_per_milli == 0);
       // measure difference
-      ticks_per_micro = diff / CALIBRATION_MS / 1000;
+      ticks_per_milli = diff / CALIBRATION_MS;
       // stop APIC timer
       APIC::get().timer_interrupt(false);
 
       //printf("* APIC timer: ticks %ums: %u\t 1mi: %u\n",
-      //       CALIBRATION_MS, diff, ticks_per_micro);
+      //       CALIBRATION_MS, diff, ticks_per_milli);
       start_timers();
 
       // with SMP, signal everyone else too (IRQ 1)
@@ -121,13 +154,42 @@ namespace x86
 
   bool APIC_Timer::ready() noexcept
   {
-    return ticks_per_micro != 0;
+    return ticks_per_milli != 0 || tsc_per_nano != 0.0;
+  }
+  bool APIC_Timer::calibration_skipped() noexcept
+  {
+    return ready() && not pit_calibrated;
+  }
+  bool APIC_Timer::is_tsc_deadline() noexcept
+  {
+    return tsc_deadline;
+  }
+  const char* APIC_Timer::mode() noexcept
+  {
+    return timer_mode;
   }
 
   void APIC_Timer::oneshot(std::chrono::nanoseconds nanos) noexcept
   {
+    if (tsc_deadline)
+    {
+      // prevent oneshots less than a microsecond
+      const int64_t ns = std::max<int64_t>(nanos.count(), 1000);
+      const uint64_t cycles = ns * tsc_per_nano;
+      // arming the deadline also replaces any previous one
+      CPU::write_msr(IA32_TSC_DEADLINE, os::cycles_since_boot() + cycles);
+      if (GET_TIMER().intr_enabled == false) {
+        GET_TIMER().intr_enabled = true;
+        APIC::get().timer_interrupt(true);
+      }
+      return;
+    }
+    // whole milliseconds, then multiply before dividing the rest
+    const uint64_t ns = std::max<int64_t>(nanos.count(), 0);
+    uint64_t ticks = ns / 1000000 * ticks_per_milli
+                   + ns % 1000000 * ticks_per_milli / 1000000;
+    const uint64_t ticks_per_micro = std::max(ticks_per_milli / 1000, 1u);
     // prevent overflow
-    uint64_t ticks = nanos.count() / 1000 * ticks_per_micro;
     if (ticks > 0xFFFFFFFF)
         ticks = 0xFFFFFFFF;
     // prevent oneshots less than a microsecond
@@ -148,15 +210,17 @@ namespace x86
   {
     GET_TIMER().intr_enabled = false;
     APIC::get().timer_interrupt(false);
+    // disarm, so that unmasking does not deliver a stale deadline
+    if (tsc_deadline) CPU::write_msr(IA32_TSC_DEADLINE, (uint64_t) 0);
   }
 
   // used by soft-reset
   uint32_t apic_timer_get_ticks() noexcept
   {
-    return ticks_per_micro;
+    return ticks_per_milli;
   }
   void     apic_timer_set_ticks(uint32_t tpm) noexcept
   {
-    ticks_per_micro = tpm;
+    ticks_per_milli = tpm;
   }
 }
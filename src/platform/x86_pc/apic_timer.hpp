@@ -26,11 +26,19 @@ namespace x86 {
 
 struct APIC_Timer
 {
+  // time spent measuring the timer against the PIT, when needed
+  static const int CALIBRATION_MS = 125;
+
   static void init();
   static void calibrate();
   static void start_timers() noexcept;
 
   static bool ready() noexcept;
+  // true when the timer became ready without measuring it against the PIT
+  static bool calibration_skipped() noexcept;
+  static bool is_tsc_deadline() noexcept;
+  // describes how the timer was set up, for boot reporting
+  static const char* mode() noexcept;
 
   static void oneshot(std::chrono::nanoseconds) noexcept;
   static void stop() noexcept;
@@ -38,6 +38,10 @@ struct sysclock_t
   tsc_khz_t     tsc_khz     = nullptr;
 };
 static sysclock_t current_clock;
+static bool kvm_clock_ = false;
+// unless get_khz() is called the frequency was restored by soft-reset
+static const char* khz_source_ = "previous kernel";
+static bool khz_sampled_ = false;
 
 namespace x86
 {
@@ -51,6 +55,7 @@ namespace x86
         current_clock.system_time = {&KVM_clock::system_time};
         current_clock.wall_time   = {&KVM_clock::wall_clock};
         current_clock.tsc_khz     = {&KVM_clock::get_tsc_khz};
+        kvm_clock_ = true;
         x86::register_deactivation_function(KVM_clock::deactivate);
         INFO("x86", "KVM PV clocks initialized");
       }
@@ -70,8 +75,32 @@ namespace x86
 
   KHz Clocks::get_khz()
   {
+    // prefer frequencies that the CPU or hypervisor report directly
+    if (const uint32_t khz = CPUID::tsc_khz()) {
+      khz_source_ = "CPUID";
+      return KHz(khz);
+    }
+    if (kvm_clock_) {
+      khz_source_ = "kvmclock";
+      return current_clock.tsc_khz();
+    }
+    // nominal frequency, the invariant TSC runs at this rate
+    if (const uint32_t khz = CPUID::base_khz()) {
+      khz_source_ = "CPUID base frequency";
+      return KHz(khz);
+    }
+    khz_source_  = "PIT sampling";
+    khz_sampled_ = true;
     return current_clock.tsc_khz();
   }
+  const char* Clocks::khz_source() noexcept
+  {
+    return khz_source_;
+  }
+  bool Clocks::khz_sampled() noexcept
+  {
+    return khz_sampled_;
+  }
 }
 
 uint64_t __arch_system_time() noexcept
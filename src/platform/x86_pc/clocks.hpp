@@ -24,5 +24,9 @@ namespace x86
   struct Clocks {
     static void init();
     static util::KHz  get_khz();
+    // where get_khz() found the TSC frequency
+    static const char* khz_source() noexcept;
+    // true when the TSC frequency had to be measured against the PIT
+    static bool khz_sampled() noexcept;
   };
 }
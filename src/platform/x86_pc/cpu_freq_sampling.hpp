@@ -22,6 +22,8 @@
 namespace x86
 {
   static const int CPU_FREQUENCY_SAMPLES = 18;
+  // one sample per PIT interrupt at 100 Hz
+  static const int CPU_FREQUENCY_SAMPLING_MS = CPU_FREQUENCY_SAMPLES * 10;
 
   extern void   reset_cpufreq_sampling();
   extern double calculate_cpu_frequency();
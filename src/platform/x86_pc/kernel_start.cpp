@@ -15,6 +15,7 @@
 // limitations under the License.
 
 #include <kernel.hpp>
+#include <kernel/boot_trace.hpp>
 #include <kernel/rng.hpp>
 #include <os.hpp>
 #include <boot/multiboot.h>
@@ -62,6 +63,8 @@ extern "C"
 __attribute__((no_sanitize("all")))
 void kernel_start(uint32_t magic, uint32_t addr)
 {
+  // .bss is not cleared yet, so remember when we started
+  const uint64_t boot_tsc = os::Arch::cpu_cycles();
   PRATTLE("\n//////////////////  IncludeOS kernel start ////////////////// \n");
   PRATTLE("* Booted with magic 0x%x, grub @ 0x%x \n",
           magic, addr);
@@ -93,8 +96,10 @@ void kernel_start(uint32_t magic, uint32_t addr)
 
   PRATTLE("* Init .bss\n");
   _init_bss();
+  Boot_trace::start("early boot", boot_tsc);
 
   // Instantiate machine
+  Boot_trace::phase("machine init");
   size_t memsize = memory_end - free_mem_begin;
   __machine = os::Machine::create((void*)free_mem_begin, memsize);
 
@@ -107,6 +112,7 @@ void kernel_start(uint32_t magic, uint32_t addr)
   // TODO: Move more stuff into Machine::init
   RNG::init();
 
+  Boot_trace::phase("libc init");
   PRATTLE("* Init syscalls\n");
   _init_syscalls();
 
@@ -20,6 +20,7 @@
 
 #include <boot/multiboot.h>
 #include <kernel.hpp>
+#include <kernel/boot_trace.hpp>
 #include <os.hpp>
 #include <rtc>
 #include <kernel/events.hpp>
@@ -30,14 +31,6 @@
 #include <cinttypes>
 #include "cmos.hpp"
 
-//#define ENABLE_PROFILERS
-#ifdef ENABLE_PROFILERS
-#include <profile>
-#define PROFILE(name)  ScopedProfiler __CONCAT(sp, __COUNTER__){name};
-#else
-#define PROFILE(name) /* name */
-#endif
-
 extern "C" void* get_cpu_esp();
 extern uintptr_t _start;
 extern uintptr_t _end;
@@ -89,7 +82,7 @@ extern void elf_protect_symbol_areas();
 
 void kernel::start(uint32_t boot_magic, uint32_t boot_addr)
 {
-  PROFILE("OS::start");
+  Boot_trace::phase("kernel start");
   kernel::state().cmdline = Service::binary_name();
 
   // Initialize stdout handlers
@@ -106,11 +99,11 @@ void kernel::start(uint32_t boot_magic, uint32_t boot_addr)
   MYINFO("Boot magic: 0x%x, addr: 0x%x", boot_magic, boot_addr);
 
   // PAGING //
-  PROFILE("Enable paging");
+  Boot_trace::phase("paging");
   __arch_init_paging();
 
   // BOOT METHOD //
-  PROFILE("Multiboot / legacy");
+  Boot_trace::phase("multiboot");
   // Detect memory limits etc. depending on boot type
   if (boot_magic == MULTIBOOT_BOOTLOADER_MAGIC) {
     kernel::multiboot(boot_addr);
@@ -129,7 +122,7 @@ void kernel::start(uint32_t boot_magic, uint32_t boot_addr)
   kernel::state().heap_max = kernel::memory_end() - 1;
   assert(kernel::heap_begin() != 0x0 and kernel::heap_max() != 0x0);
 
-  PROFILE("Memory map");
+  Boot_trace::phase("memory map");
   // Assign memory ranges used by the kernel
   auto& memmap = os::mem::vmmap();
   INFO2("Assigning fixed memory ranges (Memory map)");
@@ -157,10 +150,9 @@ void kernel::start(uint32_t boot_magic, uint32_t boot_addr)
   for (const auto& entry : memmap)
       INFO2("%s", entry.second.to_string().c_str());
 
-  PROFILE("Platform init");
   __platform_init();
 
-  PROFILE("RTC init");
+  Boot_trace::phase("RTC init");
   // Realtime/monotonic clock
   RTC::init();
 }
@@ -169,10 +161,11 @@ extern void __arch_poweroff();
 
 void os::event_loop()
 {
-  Events::get(0).process_events();
+  bool pending = Events::get(0).process_events();
   do {
-    os::halt();
-    Events::get(0).process_events();
+    // work left over from the last round runs without sleeping
+    if (not pending) os::halt();
+    pending = Events::get(0).process_events();
   } while (kernel::is_running());
 
   MYINFO("Stopping service");
@@ -19,10 +19,12 @@
 #include "apic.hpp"
 #include "apic_timer.hpp"
 #include "clocks.hpp"
+#include "cpu_freq_sampling.hpp"
 #include "idt.hpp"
 #include "smbios.hpp"
 #include "smp.hpp"
 #include <arch/x86/gdt.hpp>
+#include <kernel/boot_trace.hpp>
 #include <kernel/events.hpp>
 #include <hw/pci_manager.hpp>
 #include <kernel.hpp>
@@ -49,14 +51,31 @@ namespace x86 {
 }
 
 
+static void report_clock_setup(uint64_t begin)
+{
+  [[maybe_unused]] const double ms = (os::cycles_since_boot() - begin) / os::cpu_freq().count();
+  // blocking PIT measurements that did not have to be made
+  [[maybe_unused]] int saved_ms = 0;
+  if (x86::Clocks::khz_sampled() == false)
+      saved_ms += x86::CPU_FREQUENCY_SAMPLING_MS;
+  if (x86::APIC_Timer::calibration_skipped())
+      saved_ms += x86::APIC_Timer::CALIBRATION_MS;
+  MYINFO("Clocks ready in %.3f ms, APIC timer: %s", ms, x86::APIC_Timer::mode());
+  INFO2("+--> %d ms of PIT calibration avoided", saved_ms);
+}
+
 void __platform_init()
 {
   // read ACPI tables
+  Boot_trace::phase("ACPI");
   x86::ACPI::init();
 
   // read SMBIOS tables
+  Boot_trace::phase("SMBIOS");
   x86::SMBIOS::init();
 
+  Boot_trace::phase("CPU init");
+
   // enable fs/gs for local APIC
   INFO("x86", "Setting up GDT, TLS, IST");
   //initialize_gdt_for_cpu(0);
@@ -78,31 +97,39 @@ void __platform_init()
 
   // initialize and start registered APs found in ACPI-tables
 #ifdef INCLUDEOS_SMP_ENABLE
+  Boot_trace::phase("SMP bring-up");
   x86::init_SMP();
 #endif
 
   // Setup kernel clocks
   MYINFO("Setting up kernel clock sources");
+  Boot_trace::phase("clocks");
+  const uint64_t clocks_begin = os::cycles_since_boot();
   x86::Clocks::init();
 
   if (os::cpu_freq().count() <= 0.0) {
     kernel::state().cpu_khz = x86::Clocks::get_khz();
   }
-  INFO2("+--> %f MHz", os::cpu_freq().count() / 1000.0);
+  INFO2("+--> %f MHz (%s)", os::cpu_freq().count() / 1000.0,
+        x86::Clocks::khz_source());
 
   // Note: CPU freq must be known before we can start timer system
   // Initialize APIC timers and timer systems
   // Deferred call to Service::ready() when calibration is complete
   x86::APIC_Timer::calibrate();
+  report_clock_setup(clocks_begin);
 
+  Boot_trace::phase("driver init");
   INFO2("Initializing drivers");
   extern kernel::ctor_t __driver_ctors_start;
   extern kernel::ctor_t __driver_ctors_end;
   kernel::run_ctors(&__driver_ctors_start, &__driver_ctors_end);
 
   // Scan PCI buses
+  Boot_trace::phase("PCI scan");
   hw::PCI_manager::init();
   // Initialize storage devices
+  Boot_trace::phase("device init");
   hw::PCI_manager::init_devices(PCI::STORAGE);
   kernel::state().block_drivers_ready = true;
   // Initialize network devices
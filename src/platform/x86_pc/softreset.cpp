@@ -21,7 +21,7 @@ struct softreset_t
   uint64_t  liveupdate_loc;
   uint64_t  high_mem;
   KHz       cpu_freq;
-  uint32_t  apic_ticks;
+  uint32_t  apic_ticks;  // per millisecond
   uint64_t  extra;
   uint32_t  extra_len;
 };
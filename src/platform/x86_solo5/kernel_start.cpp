@@ -1,4 +1,6 @@
 #include <kernel.hpp>
+#include <kernel/boot_trace.hpp>
+#include <os.hpp>
 #include "../x86_pc/init_libc.hpp"
 #include <kprint>
 #include <info>
@@ -42,6 +44,7 @@ int solo5_app_main(const struct solo5_start_info *si)
 extern "C"
 void kernel_start()
 {
+  Boot_trace::start("early boot", os::Arch::cpu_cycles());
   // generate checksums of read-only areas etc.
   __init_sanity_checks();
 
@@ -1,6 +1,7 @@
 #include <os>
 
 #include <kernel.hpp>
+#include <kernel/boot_trace.hpp>
 #include <kernel/events.hpp>
 #include <kernel/timers.hpp>
 #include <kernel/solo5_manager.hpp>
@@ -32,13 +33,6 @@ extern kernel::ctor_t __driver_ctors_end;
 
 #define MYINFO(X,...) INFO("Kernel", X, ##__VA_ARGS__)
 
-#ifdef ENABLE_PROFILERS
-#include <profile>
-#define PROFILE(name)  ScopedProfiler __CONCAT(sp, __COUNTER__){name};
-#else
-#define PROFILE(name) /* name */
-#endif
-
 // actually uses nanoseconds (but its just a number)
 uint64_t os::cycles_asleep() noexcept {
   return os_cycles_hlt;
@@ -61,21 +55,21 @@ void kernel::start(const char* cmdline)
     os::add_stdout(&kernel::default_stdout);
   }
 
-  PROFILE("Global stdout constructors");
+  Boot_trace::phase("stdout ctors");
   kernel::run_ctors(&__stdout_ctors_start, &__stdout_ctors_end);
 
   // Call global ctors
-  PROFILE("Global kernel constructors");
+  Boot_trace::phase("kernel ctors");
   kernel::run_ctors(&__init_array_start, &__init_array_end);
 
-  PROFILE("");
+  Boot_trace::phase("kernel start");
   // Print a fancy header
   CAPTION("#include<os> // Literally");
 
   void* esp = get_cpu_esp();
   MYINFO("Stack: %p", esp);
 
-  PROFILE("Memory map");
+  Boot_trace::phase("memory map");
   // Assign memory ranges used by the kernel
   auto& memmap = os::mem::vmmap();
   MYINFO("Assigning fixed memory ranges (Memory map)");
@@ -102,13 +96,16 @@ void kernel::start(const char* cmdline)
   for (const auto &i : memmap)
     INFO2("* %s",i.second.to_string().c_str());
 
+  Boot_trace::phase("platform init");
   __platform_init();
 
   MYINFO("Booted at monotonic_ns=%ld walltime_ns=%ld",
          solo5_clock_monotonic(), solo5_clock_wall());
 
+  Boot_trace::phase("driver init");
   kernel::run_ctors(&__driver_ctors_start, &__driver_ctors_end);
 
+  Boot_trace::phase("device init");
   Solo5_manager::init();
 
   // We don't need a start or stop function in solo5.
@@ -121,11 +118,19 @@ void kernel::start(const char* cmdline)
   Events::get().defer(Timers::ready);
 }
 
+// budgeted work left over by the last process_events()
+static bool events_pending = false;
+
 static inline void event_loop_inner()
 {
   int res = 0;
   auto nxt = Timers::next();
-  if (nxt == std::chrono::nanoseconds(0))
+  if (events_pending)
+  {
+    // work left over from the last round, only poll for I/O
+    res = solo5_yield(solo5_clock_monotonic());
+  }
+  else if (nxt == std::chrono::nanoseconds(0))
   {
     // no next timer, wait forever
     //printf("Waiting 15s, next is indeterminate...\n");
@@ -147,7 +152,7 @@ static inline void event_loop_inner()
 
   // handle any activated timers
   Timers::timers_handler();
-  Events::get().process_events();
+  events_pending = Events::get().process_events();
   if (res != 0)
   {
     // handle any network traffic
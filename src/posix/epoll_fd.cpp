@@ -0,0 +1,196 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <posix/epoll_fd.hpp>
+#include <algorithm>
+#include <errno.h>
+
+int Epoll_FD::close()
+{
+  for (auto& it : interest_)
+    it.second.fd->remove_watcher(this);
+  interest_.clear();
+  ready_.clear();
+  return 0;
+}
+
+Epoll_FD::~Epoll_FD()
+{
+  close();
+}
+
+short Epoll_FD::poll_events()
+{
+  // drop what is not ready anymore, so the next notification
+  // from it queues it again and is passed on
+  while (not ready_.empty())
+  {
+    auto& in = interest_.at(ready_.front());
+    if (revents(in) != 0)
+      return POLLIN;
+    in.queued = false;
+    ready_.pop_front();
+  }
+  return 0;
+}
+
+int Epoll_FD::ctl(int op, FD& fd, struct epoll_event* event)
+{
+  if (&fd == this)
+    return -EINVAL;
+
+  const auto id = fd.get_id();
+  auto it = interest_.find(id);
+
+  switch (op) {
+  case EPOLL_CTL_ADD:
+    if (it != interest_.end())
+      return -EEXIST;
+    if (event == nullptr)
+      return -EFAULT;
+    // epoll instances watching each other would notify each other forever
+    if (fd.is_epoll() and static_cast<Epoll_FD&>(fd).reaches(this, max_nesting))
+      return -ELOOP;
+    it = interest_.emplace(id, Interest{&fd, event->events, event->data}).first;
+    fd.add_watcher(this, {this, &Epoll_FD::on_ready});
+    // the descriptor may already be ready
+    enqueue(id, it->second);
+    return 0;
+
+  case EPOLL_CTL_MOD:
+    if (it == interest_.end())
+      return -ENOENT;
+    if (event == nullptr)
+      return -EFAULT;
+    it->second.events   = event->events;
+    it->second.data     = event->data;
+    it->second.disabled = false;
+    enqueue(id, it->second);
+    return 0;
+
+  case EPOLL_CTL_DEL:
+    if (it == interest_.end())
+      return -ENOENT;
+    fd.remove_watcher(this);
+    forget(id);
+    return 0;
+
+  default:
+    return -EINVAL;
+  }
+}
+
+int Epoll_FD::wait(struct epoll_event* events, int maxevents,
+                   std::chrono::nanoseconds timeout)
+{
+  if (maxevents <= 0)
+    return -EINVAL;
+
+  int count = 0;
+  wait_ready([this, &count, events, maxevents] () -> bool {
+      count = collect(events, maxevents);
+      return count > 0;
+    }, timeout);
+  return count;
+}
+
+void Epoll_FD::on_ready(FD& fd, bool closing)
+{
+  // closed descriptors are removed from the interest list
+  if (closing) {
+    forget(fd.get_id());
+    return;
+  }
+  auto it = interest_.find(fd.get_id());
+  if (it != interest_.end())
+    enqueue(it->first, it->second);
+}
+
+void Epoll_FD::enqueue(id_t id, Interest& in)
+{
+  if (in.disabled or in.queued)
+    return;
+  in.queued = true;
+  ready_.push_back(id);
+  // someone may be watching this epoll instance
+  notify_ready();
+}
+
+bool Epoll_FD::reaches(const Epoll_FD* target, int depth) const
+{
+  if (this == target)
+    return true;
+  if (depth == 0)
+    return true;
+  for (const auto& it : interest_)
+  {
+    auto* fd = it.second.fd;
+    if (fd->is_epoll() and static_cast<const Epoll_FD*>(fd)->reaches(target, depth - 1))
+      return true;
+  }
+  return false;
+}
+
+void Epoll_FD::forget(id_t id)
+{
+  auto it = interest_.find(id);
+  if (it == interest_.end())
+    return;
+  if (it->second.queued)
+    ready_.erase(std::find(ready_.begin(), ready_.end(), id));
+  interest_.erase(it);
+}
+
+uint32_t Epoll_FD::revents(const Interest& in) const
+{
+  // EPOLLERR and EPOLLHUP are always reported
+  return in.fd->poll_events() & (in.events | EPOLLERR | EPOLLHUP);
+}
+
+int Epoll_FD::collect(struct epoll_event* events, int maxevents)
+{
+  int count = 0;
+  // only visit what was queued on entry, level-triggered
+  // descriptors are put back at the end of the queue
+  size_t remaining = ready_.size();
+
+  while (count < maxevents and remaining-- > 0)
+  {
+    const auto id = ready_.front();
+    ready_.pop_front();
+
+    auto& in = interest_.at(id);
+    in.queued = false;
+
+    const uint32_t ev = revents(in);
+    // not ready anymore, wait for the next notification
+    if (ev == 0)
+      continue;
+
+    events[count].events = ev;
+    events[count].data   = in.data;
+    count++;
+
+    if (in.events & EPOLLONESHOT) {
+      in.disabled = true;
+    }
+    else if (not (in.events & EPOLLET)) {
+      in.queued = true;
+      ready_.push_back(id);
+    }
+  }
+  return count;
+}
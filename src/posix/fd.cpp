@@ -16,10 +16,74 @@
 // limitations under the License.
 
 #include <posix/fd.hpp>
+#include <kernel/timers.hpp>
+#include <os.hpp>
+#include <algorithm>
 #include <fcntl.h>
 #include <cstdarg>
 #include <errno.h>
 
+uint64_t FD::ready_generation_ = 0;
+
+FD::~FD()
+{
+  // let watchers (epoll instances) forget about us
+  auto watchers = std::move(watchers_);
+  for (auto& w : watchers)
+    w.second(*this, true);
+}
+
+void FD::add_watcher(const void* key, on_ready_func func)
+{
+  for (auto& w : watchers_) {
+    if (w.first == key) {
+      w.second = std::move(func);
+      return;
+    }
+  }
+  watchers_.emplace_back(key, std::move(func));
+}
+
+void FD::remove_watcher(const void* key)
+{
+  watchers_.erase(std::remove_if(watchers_.begin(), watchers_.end(),
+                    [key] (const auto& w) { return w.first == key; }),
+                  watchers_.end());
+}
+
+void FD::notify_ready()
+{
+  ready_generation_++;
+  // watchers may remove themselves while being notified
+  for (size_t i = 0; i < watchers_.size(); i++)
+    watchers_[i].second(*this, false);
+}
+
+bool FD::wait_ready(delegate<bool()> ready, std::chrono::nanoseconds timeout)
+{
+  if (ready()) return true;
+  if (timeout == std::chrono::nanoseconds::zero()) return false;
+
+  bool expired = false;
+  Timers::id_t timer = Timers::UNUSED_ID;
+  if (timeout > std::chrono::nanoseconds::zero())
+    timer = Timers::oneshot(timeout, [&expired] (auto) { expired = true; });
+
+  auto generation = ready_generation_;
+  while (not expired)
+  {
+    os::block();
+    if (generation == ready_generation_) continue;
+    generation = ready_generation_;
+
+    if (ready()) {
+      if (timer != Timers::UNUSED_ID) Timers::stop(timer);
+      return true;
+    }
+  }
+  return ready();
+}
+
 int FD::fcntl(int cmd, va_list list)
 {
   //PRINT("fcntl(%d)\n", cmd);
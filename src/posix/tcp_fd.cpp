@@ -93,13 +93,12 @@ long TCP_FD::connect(const struct sockaddr* address, socklen_t address_len)
   PRINT("TCP: connect(%s:%u)\n", addr.to_string().c_str(), port);
 
   auto outgoing = net_stack().tcp().connect({addr, port});
-
-  bool refused = false;
-  outgoing->on_connect([&refused](auto conn) {
-    refused = (conn == nullptr);
-  });
+  // out with the old, in with the new
+  this->cd = std::make_unique<TCP_FD_Conn>(outgoing);
+  cd->owner = this;
   // O_NONBLOCK is set for the file descriptor for the socket and the connection
   // cannot be immediately established; the connection shall be established asynchronously.
+  // Completion is signaled as POLLOUT (or POLLERR) on the descriptor.
   if (this->is_blocking() == false) {
     return -EINPROGRESS;
   }
@@ -108,19 +107,16 @@ long TCP_FD::connect(const struct sockaddr* address, socklen_t address_len)
   while (not (outgoing->is_connected() or
               outgoing->is_closing() or
               outgoing->is_closed() or
-              refused))
+              cd->refused))
   {
     os::block();
   }
-  // set connection whether good or bad
   if (outgoing->is_connected()) {
-    // out with the old, in with the new
-    this->cd = std::make_unique<TCP_FD_Conn>(outgoing);
-    cd->set_default_read();
     return 0;
   }
   // failed to connect
   // TODO: try to distinguish the reason for connection failure
+  cd = nullptr;
   return -ECONNREFUSED;
 }
 
@@ -195,7 +191,7 @@ long TCP_FD::bind(const struct sockaddr *addr, socklen_t addrlen)
       delete ld;
     }
     // create new one
-    ld = new TCP_FD_Listen(L);
+    ld = new TCP_FD_Listen(*this, L);
     return 0;
 
   } catch (...) {
@@ -209,6 +205,17 @@ int TCP_FD::shutdown(int mode)
   }
   return cd->shutdown(mode);
 }
+short TCP_FD::poll_events()
+{
+  if (cd) {
+    return cd->poll_events();
+  }
+  if (ld) {
+    return has_connq() ? POLLIN : 0;
+  }
+  // unconnected socket
+  return POLLOUT | POLLHUP;
+}
 
 /// socket as connection
 TCP_FD_Conn::TCP_FD_Conn(net::tcp::Connection_ptr c)
@@ -226,30 +233,48 @@ TCP_FD_Conn::TCP_FD_Conn(net::tcp::Connection_ptr c)
     // net::tcp::Connection::Disconnect::CLOSING
     if(not self->is_connected())
       self->close();
+    this->notify();
+  });
+  // only fires for outgoing connections
+  conn->on_connect([this](auto self) {
+    this->refused = (self == nullptr);
+    this->notify();
   });
+  conn->on_write([this](size_t) { this->notify(); });
+}
+TCP_FD_Conn::~TCP_FD_Conn()
+{
+  conn->reset_callbacks();
 }
 void TCP_FD_Conn::set_default_read()
 {
-  conn->on_data({this, &TCP_FD_Conn::retrieve_buffer});
+  conn->on_data([this] {
+    this->retrieve_buffer();
+    this->notify();
+  });
 }
-ssize_t TCP_FD_Conn::send(const void* data, size_t len, int)
+ssize_t TCP_FD_Conn::send(const void* data, size_t len, int fl)
 {
   if (not conn->is_connected()) {
     return -ENOTCONN;
   }
 
-  bool written = false;
-  conn->on_write([&written] (bool) { written = true; }); // temp
+  const bool blocking = owner == nullptr
+    or (owner->is_blocking() and not (fl & MSG_DONTWAIT));
+
+  if (not blocking) {
+    if (conn->sendq_remaining() >= SENDQ_LIMIT)
+      return -EAGAIN;
+    conn->write(data, len);
+    return len;
+  }
 
   conn->write(data, len);
 
-  // sometimes we can just write and forget
-  if (written) return len;
-  while (!written) {
+  // wait for everything queued so far to leave the send queue
+  while (conn->sendq_remaining() > 0 and conn->is_writable()) {
     os::block();
   }
-
-  conn->on_write(nullptr); // temp
   return len;
 }
 
@@ -261,11 +286,33 @@ void TCP_FD_Conn::retrieve_buffer()
     buf_offset = 0;
   }
 }
-ssize_t TCP_FD_Conn::recv(void* dest, size_t len, int)
+short TCP_FD_Conn::poll_events() const
+{
+  short events = 0;
+  if (buffer != nullptr or conn->next_size() > 0)
+    events |= POLLIN;
+  // a non-blocking connect() completes with POLLOUT, so not before send() works
+  if (conn->is_connected() and conn->sendq_remaining() < SENDQ_LIMIT)
+    events |= POLLOUT;
+  // EOF is readable
+  if (recv_disc or conn->is_closed())
+    events |= POLLIN | POLLHUP;
+  if (refused)
+    events |= POLLERR;
+  return events;
+}
+ssize_t TCP_FD_Conn::recv(void* dest, size_t len, int fl)
 {
   if(buffer == nullptr)
     retrieve_buffer();
 
+  if (buffer == nullptr and !conn->is_closed() and !recv_disc)
+  {
+    if (owner != nullptr and
+        (not owner->is_blocking() or (fl & MSG_DONTWAIT)))
+      return -EAGAIN;
+  }
+
   // BLOCK HERE:
   // If we havent read the data we asked for or if we're not yet closed/want to close
   while (buffer == nullptr and !conn->is_closed() and !recv_disc) {
@@ -292,6 +339,8 @@ ssize_t TCP_FD_Conn::recv(void* dest, size_t len, int)
 }
 int TCP_FD_Conn::close()
 {
+  // the stack must not call back into us after the socket is gone
+  conn->reset_callbacks();
   conn->close();
   return 0;
 }
@@ -326,16 +375,22 @@ long TCP_FD_Listen::listen(int backlog)
       return;
 
     // remove oldest if full
-    if ((int) this->connq.size() >= backlog)
+    if ((int) this->connq.size() >= backlog) {
+        this->connq.back()->close();
         this->connq.pop_back();
+    }
     // new connection
     this->connq.push_front(std::make_unique<TCP_FD_Conn>(conn));
     /// if someone is blocking they should be leaving right about now
+    owner.notify_ready();
   });
   return 0;
 }
 long TCP_FD_Listen::accept(struct sockaddr *__restrict__ addr, socklen_t *__restrict__ addr_len)
 {
+  if (connq.empty() and not owner.is_blocking()) {
+    return -EAGAIN;
+  }
   // block until connection appears
   while (connq.empty()) {
     os::block();
@@ -348,6 +403,7 @@ long TCP_FD_Listen::accept(struct sockaddr *__restrict__ addr, socklen_t *__rest
   // create connected TCP socket
   auto& fd = FD_map::_open<TCP_FD>();
   fd.cd = std::move(sock);
+  fd.cd->owner = &fd;
   // set address and length
   if(addr != nullptr and addr_len != nullptr)
   {
@@ -45,6 +45,7 @@ void UDP_FD::recv_to_buffer(net::udp::addr_t addr,
     auto buff = net::tcp::construct_buffer(buf, buf + len);
     // emplace the message in buffer
     buffer_.emplace_back(htonl(addr.v4().whole), htons(port), std::move(buff));
+    notify_ready();
   }
 }
 
@@ -204,6 +205,10 @@ ssize_t UDP_FD::recvfrom(void *__restrict__ buffer, size_t len, int flags,
   {
     return read_from_buffer(buffer, len, flags, address, address_len);
   }
+  else if(not is_blocking() or (flags & MSG_DONTWAIT))
+  {
+    return -EAGAIN;
+  }
   // Else make a blocking receive
   else
   {
@@ -250,6 +255,11 @@ ssize_t UDP_FD::recvfrom(void *__restrict__ buffer, size_t len, int flags,
     return bytes;
   }
 }
+short UDP_FD::poll_events()
+{
+  // datagrams are sent immediately, so the socket is always writable
+  return buffer_.empty() ? POLLOUT : (POLLIN | POLLOUT);
+}
 int UDP_FD::getsockopt(int level, int option_name,
   void *option_value, socklen_t *option_len)
 {
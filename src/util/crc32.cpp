@@ -161,3 +161,56 @@ uint32_t crc32_fast(const void* buf, size_t len)
 #endif
 #endif
 }
+
+// GF(2) matrix helpers for crc32c_combine, see zlib crc32_combine()
+static uint32_t gf2_matrix_times(const uint32_t* mat, uint32_t vec)
+{
+  uint32_t sum = 0;
+  while (vec) {
+    if (vec & 1) sum ^= *mat;
+    vec >>= 1;
+    mat++;
+  }
+  return sum;
+}
+
+static void gf2_matrix_square(uint32_t* square, const uint32_t* mat)
+{
+  for (int n = 0; n < 32; n++)
+    square[n] = gf2_matrix_times(mat, mat[n]);
+}
+
+uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, size_t len2)
+{
+  if (len2 == 0) return crc1;
+
+  uint32_t even[32]; // even-power-of-two zeros operator
+  uint32_t odd[32];  // odd-power-of-two zeros operator
+
+  // operator for one zero bit in odd
+  odd[0] = 0x82F63B78; // CRC32-C polynomial (reflected)
+  uint32_t row = 1;
+  for (int n = 1; n < 32; n++) {
+    odd[n] = row;
+    row <<= 1;
+  }
+  // operator for two zero bits in even
+  gf2_matrix_square(even, odd);
+  // operator for four zero bits in odd
+  gf2_matrix_square(odd, even);
+
+  // apply len2 zeros to crc1 (first square will put the operator for one
+  // zero byte, eight zero bits, in even)
+  do {
+    gf2_matrix_square(even, odd);
+    if (len2 & 1) crc1 = gf2_matrix_times(even, crc1);
+    len2 >>= 1;
+    if (len2 == 0) break;
+
+    gf2_matrix_square(odd, even);
+    if (len2 & 1) crc1 = gf2_matrix_times(odd, crc1);
+    len2 >>= 1;
+  } while (len2 != 0);
+
+  return crc1 ^ crc2;
+}
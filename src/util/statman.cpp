@@ -18,12 +18,81 @@
 #include <statman>
 #include <info>
 #include <smp_utils>
+#include <timers>
+#include <rtc>
+#include <cmath>
+#include <cstring>
 
 // this is done to make sure construction only happens here
 static Statman statman_instance;
 Statman& Statman::get() {
   return statman_instance;
 }
+// started when the first RATE stat is created
+static Timers::id_t rate_timer = Timers::UNUSED_ID;
+
+uint64_t Stat_counter::value() const noexcept {
+  uint64_t total = 0;
+  for (const auto& shard : shards_) total += shard.value;
+  return total;
+}
+void Stat_counter::reset() noexcept {
+  for (auto& shard : shards_) shard.value = 0;
+}
+
+double Stat_rate::sample(uint64_t now_ns) noexcept {
+  const uint64_t total = value();
+  if (last_ns_ != 0 && now_ns > last_ns_) {
+    rate_ = (total - last_value_) * 1e9 / (now_ns - last_ns_);
+  }
+  last_value_ = total;
+  last_ns_    = now_ns;
+  return rate_;
+}
+
+Stat_histogram::Stat_histogram(const Stat_histogram& other) {
+  for (size_t i = 0; i < shards_.size(); i++)
+    if (other.shards_[i]) shards_[i] = new Shard(*other.shards_[i]);
+}
+Stat_histogram::~Stat_histogram() {
+  for (auto* shard : shards_) delete shard;
+}
+uint64_t Stat_histogram::count() const noexcept {
+  uint64_t total = 0;
+  for (const auto* shard : shards_) if (shard) total += shard->count;
+  return total;
+}
+uint64_t Stat_histogram::sum() const noexcept {
+  uint64_t total = 0;
+  for (const auto* shard : shards_) if (shard) total += shard->sum;
+  return total;
+}
+uint64_t Stat_histogram::max() const noexcept {
+  uint64_t highest = 0;
+  for (const auto* shard : shards_) if (shard) highest = std::max(highest, shard->max);
+  return highest;
+}
+uint64_t Stat_histogram::bucket(int i) const noexcept {
+  uint64_t total = 0;
+  for (const auto* shard : shards_) if (shard) total += shard->buckets.at(i);
+  return total;
+}
+
+uint64_t Stat_histogram::percentile(double q) const noexcept {
+  const uint64_t total = count();
+  if (total == 0) return 0;
+  const uint64_t rank = std::max<uint64_t>(1, std::ceil(q * total));
+  uint64_t seen = 0;
+  for (int i = 0; i < BUCKETS; i++) {
+    seen += bucket(i);
+    if (seen >= rank) return std::min(bucket_limit(i), max());
+  }
+  return max();
+}
+
+void Stat_histogram::reset() noexcept {
+  for (auto* shard : shards_) if (shard) *shard = Shard{};
+}
 
 Stat::Stat(const Stat_type type, const std::string& name)
   : ui64(0)
@@ -35,17 +104,44 @@ Stat::Stat(const Stat_type type, const std::string& name)
     throw Stats_exception("Stat name cannot be longer than " + std::to_string(MAX_NAME_LEN) + " characters");
 
   snprintf(name_, sizeof(name_), "%s", name.c_str());
+
+  switch (type) {
+    case COUNTER:   shards = new Stat_counter(); break;
+    case RATE:      shards = new Stat_rate(); break;
+    case HISTOGRAM: shards = new Stat_histogram(); break;
+    default: break;
+  }
 }
 Stat::Stat(const Stat& other) {
-  this->ui64   = other.ui64;
-  this->m_bits = other.m_bits;
-  __builtin_memcpy(this->name_, other.name_, sizeof(name_));
+  this->copy(other);
 }
 Stat& Stat::operator=(const Stat& other) {
-  this->ui64   = other.ui64;
+  if (this != &other) {
+    this->release();
+    this->copy(other);
+  }
+  return *this;
+}
+
+void Stat::copy(const Stat& other) {
   this->m_bits = other.m_bits;
   __builtin_memcpy(this->name_, other.name_, sizeof(name_));
-  return *this;
+  switch (other.type()) {
+    case COUNTER:   shards = new Stat_counter(other.get_counter()); break;
+    case RATE:      shards = new Stat_rate(*static_cast<const Stat_rate*>(other.shards)); break;
+    case HISTOGRAM: shards = new Stat_histogram(other.get_histogram()); break;
+    default:        ui64 = other.ui64; break;
+  }
+}
+
+void Stat::release() noexcept {
+  switch (this->type()) {
+    case COUNTER:   delete static_cast<Stat_counter*>(shards); break;
+    case RATE:      delete static_cast<Stat_rate*>(shards); break;
+    case HISTOGRAM: delete static_cast<Stat_histogram*>(shards); break;
+    default: return;
+  }
+  shards = nullptr;
 }
 
 void Stat::operator++() {
@@ -53,15 +149,39 @@ void Stat::operator++() {
     case UINT32: ui32++;    break;
     case UINT64: ui64++;    break;
     case FLOAT:  f += 1.0f; break;
+    case COUNTER:
+    case RATE:   ++get_counter(); break;
     default: throw Stats_exception("Invalid stat type encountered when incrementing");
   }
 }
 
+uint64_t Stat::value() const {
+  switch (this->type()) {
+    case UINT32:    return ui32;
+    case UINT64:    return ui64;
+    case FLOAT:     return f;
+    case COUNTER:
+    case RATE:      return get_counter().value();
+    case HISTOGRAM: return get_histogram().count();
+    default: throw Stats_exception("Invalid stat type");
+  }
+}
+
 std::string Stat::to_string() const {
   switch (this->type()) {
     case UINT32: return std::to_string(ui32);
     case UINT64: return std::to_string(ui64);
     case FLOAT:  return std::to_string(f);
+    case COUNTER:
+    case RATE:   return std::to_string(get_counter().value());
+    case HISTOGRAM: {
+      const auto& histo = get_histogram();
+      return "count: " + std::to_string(histo.count())
+          + ", p50: " + std::to_string(histo.percentile(0.5))
+          + ", p99: " + std::to_string(histo.percentile(0.99))
+          + ", p99.9: " + std::to_string(histo.percentile(0.999))
+          + ", max: " + std::to_string(histo.max());
+    }
     default:     return "Unknown stat type";
   }
 }
@@ -72,6 +192,27 @@ Statman::Statman() {
   this->create(Stat::UINT32, "statman.unused_stats");
 }
 
+void Statman::index_stat(Stat& stat)
+{
+  // the first one wins when names are reused
+  m_index.emplace(std::string_view(stat.name()), &stat);
+}
+
+void Statman::unindex_stat(Stat& stat)
+{
+  auto it = m_index.find(std::string_view(stat.name()));
+  if (it == m_index.end() || it->second != &stat) return;
+  m_index.erase(it);
+  for (auto& other : m_stats)
+  {
+    if (&other != &stat && other.unused() == false
+        && strcmp(other.name(), stat.name()) == 0) {
+      index_stat(other);
+      return;
+    }
+  }
+}
+
 Stat& Statman::create(const Stat::Stat_type type, const std::string& name)
 {
 #ifdef INCLUDEOS_SMP_ENABLE
@@ -80,15 +221,26 @@ Stat& Statman::create(const Stat::Stat_type type, const std::string& name)
   if (name.empty())
     throw Stats_exception("Cannot create Stat with no name");
 
+  // the rates of the system stats are kept fresh by a timer
+  if (type == Stat::RATE && this == &statman_instance
+      && rate_timer == Timers::UNUSED_ID) {
+    rate_timer = Timers::periodic(RATE_INTERVAL,
+      [] (Timers::id_t) {
+        statman_instance.sample_rates(RTC::nanos_now());
+      });
+  }
+
   const ssize_t idx = this->find_free_stat();
   if (idx < 0) {
     m_stats.emplace_back(type, name);
+    index_stat(m_stats.back());
     return m_stats.back();
   }
 
   // note: we have to create this early in case it throws
   auto& stat = *new (&m_stats[idx]) Stat(type, name);
   unused_stats()--; // decrease unused stats
+  index_stat(stat);
   return stat;
 }
 
@@ -112,13 +264,8 @@ Stat& Statman::get_by_name(const char* name)
 #ifdef INCLUDEOS_SMP_ENABLE
   volatile scoped_spinlock lock(this->stlock);
 #endif
-  for (auto& stat : this->m_stats)
-  {
-    if (stat.unused() == false) {
-      if (strncmp(stat.name(), name, Stat::MAX_NAME_LEN) == 0)
-        return stat;
-    }
-  }
+  auto it = m_index.find(std::string_view(name, strnlen(name, Stat::MAX_NAME_LEN)));
+  if (it != m_index.end()) return *it->second;
   throw std::out_of_range("No stat found with exact given name");
 }
 
@@ -143,6 +290,8 @@ void Statman::free(void* addr)
   volatile scoped_spinlock lock(this->stlock);
 #endif
   // delete entry
+  unindex_stat(stat);
+  stat.release();
   new (&stat) Stat(Stat::FLOAT, "");
   unused_stats()++; // increase unused stats
 }
@@ -160,5 +309,160 @@ void Statman::clear()
 {
   if (size() <= 1) return;
   m_stats.clear();
+  m_index.clear();
   this->create(Stat::UINT32, "statman.unused_stats");
 }
+
+void Statman::sample_rates(uint64_t now_ns)
+{
+  for (auto& stat : m_stats)
+  {
+    if (stat.type() == Stat::RATE && stat.unused() == false)
+        stat.get_rate().sample(now_ns);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+  template <typename T>
+  void put(std::vector<uint8_t>& buffer, const T value)
+  {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+  }
+
+  struct Reader {
+    const uint8_t* data;
+    size_t len;
+    size_t pos = 0;
+
+    template <typename T>
+    T get()
+    {
+      if (pos + sizeof(T) > len)
+          throw Stats_exception("Stats snapshot is truncated");
+      T value;
+      memcpy(&value, data + pos, sizeof(T));
+      pos += sizeof(T);
+      return value;
+    }
+  };
+}
+
+std::vector<uint8_t> Statman::snapshot(uint64_t timestamp) const
+{
+#ifdef INCLUDEOS_SMP_ENABLE
+  volatile scoped_spinlock lock(this->stlock);
+#endif
+  std::vector<uint8_t> buffer;
+  buffer.reserve(24 + m_stats.size() * 64);
+  put<uint32_t>(buffer, SNAPSHOT_MAGIC);
+  put<uint16_t>(buffer, SNAPSHOT_VERSION);
+  put<uint16_t>(buffer, 0);
+  const size_t count_pos = buffer.size();
+  put<uint32_t>(buffer, 0);
+  put<uint64_t>(buffer, timestamp);
+
+  uint32_t count = 0;
+  for (const auto& stat : m_stats)
+  {
+    if (stat.unused()) continue;
+    const size_t name_len = strnlen(stat.name(), Stat::MAX_NAME_LEN);
+    put<uint8_t>(buffer, stat.type());
+    put<uint8_t>(buffer, stat.m_bits & (Stat::GAUGE_BIT | Stat::PERSIST_BIT));
+    put<uint8_t>(buffer, name_len);
+    buffer.insert(buffer.end(), stat.name(), stat.name() + name_len);
+
+    switch (stat.type()) {
+    case Stat::FLOAT:   put<float>(buffer, stat.f); break;
+    case Stat::UINT32:  put<uint32_t>(buffer, stat.ui32); break;
+    case Stat::UINT64:  put<uint64_t>(buffer, stat.ui64); break;
+    case Stat::COUNTER: put<uint64_t>(buffer, stat.value()); break;
+    case Stat::RATE:
+      put<uint64_t>(buffer, stat.value());
+      put<double>(buffer, static_cast<const Stat_rate*>(stat.shards)->per_second());
+      break;
+    case Stat::HISTOGRAM: {
+      const auto& histo = stat.get_histogram();
+      put<uint64_t>(buffer, histo.count());
+      put<uint64_t>(buffer, histo.sum());
+      put<uint64_t>(buffer, histo.max());
+      const size_t used_pos = buffer.size();
+      put<uint16_t>(buffer, 0);
+      uint16_t used = 0;
+      for (int i = 0; i < Stat_histogram::BUCKETS; i++)
+      {
+        const uint64_t n = histo.bucket(i);
+        if (n == 0) continue;
+        put<uint16_t>(buffer, i);
+        put<uint64_t>(buffer, n);
+        used++;
+      }
+      memcpy(&buffer[used_pos], &used, sizeof(used));
+      break;
+    }
+    }
+    count++;
+  }
+  memcpy(&buffer[count_pos], &count, sizeof(count));
+  return buffer;
+}
+
+std::vector<Stat_entry> Statman::parse_snapshot(const uint8_t* data, size_t len,
+                                                uint64_t* timestamp)
+{
+  Reader rd {data, len};
+  if (rd.get<uint32_t>() != SNAPSHOT_MAGIC)
+      throw Stats_exception("Not a stats snapshot");
+  if (rd.get<uint16_t>() != SNAPSHOT_VERSION)
+      throw Stats_exception("Unsupported stats snapshot version");
+  rd.get<uint16_t>();
+  const uint32_t count = rd.get<uint32_t>();
+  const uint64_t ts = rd.get<uint64_t>();
+  if (timestamp) *timestamp = ts;
+
+  std::vector<Stat_entry> entries;
+  entries.reserve(count);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    Stat_entry entry;
+    const uint8_t type = rd.get<uint8_t>();
+    if (type > Stat::HISTOGRAM)
+        throw Stats_exception("Invalid stat type in snapshot");
+    entry.type  = (Stat::Stat_type) type;
+    entry.gauge = rd.get<uint8_t>() & Stat::GAUGE_BIT;
+    const uint8_t name_len = rd.get<uint8_t>();
+    if (name_len > Stat::MAX_NAME_LEN || rd.pos + name_len > len)
+        throw Stats_exception("Invalid stat name in snapshot");
+    entry.name.assign((const char*) data + rd.pos, name_len);
+    rd.pos += name_len;
+
+    switch (entry.type) {
+    case Stat::FLOAT:   entry.fvalue = rd.get<float>(); break;
+    case Stat::UINT32:  entry.value  = rd.get<uint32_t>(); break;
+    case Stat::UINT64:
+    case Stat::COUNTER: entry.value  = rd.get<uint64_t>(); break;
+    case Stat::RATE:
+      entry.value      = rd.get<uint64_t>();
+      entry.per_second = rd.get<double>();
+      break;
+    case Stat::HISTOGRAM: {
+      entry.count = rd.get<uint64_t>();
+      entry.sum   = rd.get<uint64_t>();
+      entry.max   = rd.get<uint64_t>();
+      const uint16_t used = rd.get<uint16_t>();
+      for (int b = 0; b < used; b++)
+      {
+        const uint16_t idx = rd.get<uint16_t>();
+        if (idx >= Stat_histogram::BUCKETS)
+            throw Stats_exception("Invalid histogram bucket in snapshot");
+        entry.buckets.emplace_back(idx, rd.get<uint64_t>());
+      }
+      break;
+    }
+    }
+    entries.push_back(std::move(entry));
+  }
+  return entries;
+}
@@ -5,7 +5,19 @@
 
 void Statman::store(uint32_t id, liu::Storage& store)
 {
-  store.add_vector<Stat>(id, {m_stats.begin(), m_stats.end()});
+  std::vector<Stat> stats {m_stats.begin(), m_stats.end()};
+  // the shards don't survive, keep their value
+  for (auto& stat : stats)
+  {
+    if (stat.is_sharded()) {
+      const auto bits = stat.m_bits & (Stat::GAUGE_BIT | Stat::PERSIST_BIT);
+      const auto value = stat.value();
+      stat = Stat(Stat::UINT64, stat.name());
+      stat.m_bits = Stat::UINT64 | bits;
+      stat.get_uint64() = value;
+    }
+  }
+  store.add_vector<Stat>(id, stats);
 }
 void Statman::restore(liu::Restore& store)
 {
@@ -20,7 +32,14 @@ void Statman::restore(liu::Restore& store)
   {
     try {
       // TODO: merge here
-      this->get_by_name(merge_stat.name()) = merge_stat;
+      auto& stat = this->get_by_name(merge_stat.name());
+      if (stat.is_sharded()) {
+        // counters carry on from the stored value
+        if (stat.type() != Stat::HISTOGRAM && merge_stat.type() == Stat::UINT64)
+            stat.get_counter().local() += merge_stat.get_uint64();
+        continue;
+      }
+      stat = merge_stat;
     }
     catch (const std::exception& e)
     {
@@ -29,10 +29,64 @@ static std::shared_ptr<fs::Disk> disk;
 const uint64_t SIZE = 4294967296;
 const std::string shallow_banana{"/banana.txt"};
 const std::string deep_banana{"/dir1/dir2/dir3/dir4/dir5/dir6/banana.txt"};
+const std::string big_file{"/big.bin"};
 
 void is_done() {
   static int counter = 0;
-  if (++counter == 3) INFO("FAT32","SUCCESS\n");
+  if (++counter == 4) INFO("FAT32","SUCCESS\n");
+}
+
+// random reads at large offsets in a fragmented file
+void test_random_reads(fs::File_system& fs)
+{
+  static const int READS = 256;
+  static int completed = 0;
+  static uint64_t t0 = 0;
+
+  static auto verify = [] (uint64_t word, fs::error_t err, fs::buffer_t buf)
+  {
+    CHECKSERT(not err && buf->size() == 4096, "Random read at word %llu", word);
+    const auto* words = (const uint32_t*) buf->data();
+    CHECKSERT(words[0] == word && words[1023] == word + 1023,
+              "Correct data at word %llu", word);
+  };
+
+  fs.stat(big_file,
+  [&fs] (fs::error_t err, const fs::Dirent& ent)
+  {
+    CHECKSERT(not err, "Stat %s", big_file.c_str());
+    CHECKSERT(ent.size() == 4 * 1024 * 1024, "big.bin is 4MB");
+
+    // the first read at the end of the file builds the extent map
+    t0 = os::nanos_since_boot();
+    const uint64_t last = ent.size() / 4 - 1024;
+    fs.read(ent, last * 4, 4096,
+    fs::on_read_func::make_packed(
+    [&fs, ent, last] (fs::error_t err, fs::buffer_t buf)
+    {
+      verify(last, err, buf);
+      INFO("FAT32", "Cluster chain walk and first read in %llu us",
+           (os::nanos_since_boot() - t0) / 1000);
+
+      t0 = os::nanos_since_boot();
+      uint32_t seed = 1;
+      for (int i = 0; i < READS; i++)
+      {
+        seed = seed * 1103515245 + 12345;
+        const uint64_t word = seed % last;
+        fs.read(ent, word * 4, 4096,
+        [word] (fs::error_t err, fs::buffer_t buf)
+        {
+          verify(word, err, buf);
+          if (++completed == READS) {
+            INFO("FAT32", "%d random 4k reads in %llu us", READS,
+                 (os::nanos_since_boot() - t0) / 1000);
+            is_done();
+          }
+        });
+      }
+    }));
+  });
 }
 
 void test2()
@@ -47,6 +101,8 @@ void test2()
   {
     CHECKSERT(not err, "Filesystem mounted on VBR1");
 
+    test_random_reads(fs);
+
     fs.stat(shallow_banana,
     [] (fs::error_t err, const fs::Dirent& ent) {
       INFO("FAT32", "Shallow banana");
@@ -123,7 +179,7 @@ void Service::start()
     fs.ls("/",
     [] (fs::error_t err, auto ents) {
       CHECKSERT(not err, "Listing root directory");
-      CHECKSERT(ents->size() == 2, "Exactly two ents in root dir");
+      CHECKSERT(ents->size() == 4, "Exactly four ents in root dir");
 
       auto& e = ents->at(0);
       CHECKSERT(e.is_file(), "Ent is a file");
@@ -24,6 +24,15 @@ then
   # Create deep nested directory and copy banana.txt into dir
   sudo mkdir -p $MOUNTDIR/dir1/dir2/dir3/dir4/dir5/dir6
   sudo cp banana.txt $MOUNTDIR/dir1/dir2/dir3/dir4/dir5/dir6/
+  # Create a fragmented 4MB file by interleaving its appends with another
+  # file. Every 32-bit word in big.bin holds its own offset divided by 4
+  for i in $(seq 0 63)
+  do
+    python3 -c "import struct,sys; sys.stdout.buffer.write(struct.pack('<16384I', *range($i*16384, ($i+1)*16384)))" \
+      | sudo tee -a $MOUNTDIR/big.bin > /dev/null
+    sudo dd if=/dev/zero bs=4096 count=1 status=none | sudo tee -a $MOUNTDIR/filler.bin > /dev/null
+    sync
+  done
   sync # Mui Importante
   sudo umount $MOUNTDIR/
   rm -rf $MOUNTDIR
@@ -1,6 +1,8 @@
 #include <common.cxx>
 #include <fs/disk.hpp>
 #include <fs/memdisk.hpp>
+#include <fs/mbr.hpp>
+#include <fs/fat_internal.hpp>
 #include <util/sha1.hpp>
 #include <unistd.h>
 using namespace fs;
@@ -152,3 +154,126 @@ CASE("Stat /folder/file.txt")
   const std::string text((const char*) buffer.data(), buffer.size());
   EXPECT(text == "This file contains text\n");
 }
+
+// Builds a tiny FAT12 image with fragmented files:
+// 1 reserved sector, 1 FAT sector, 1 root dir sector and 64 data clusters
+static std::vector<char> fat12_image;
+
+static void fat12_set(uint32_t cl, uint16_t val)
+{
+  auto* fat = (uint8_t*) &fat12_image[512];
+  const uint32_t pos = cl + cl / 2;
+  uint16_t cur;
+  memcpy(&cur, &fat[pos], 2);
+  if (cl & 1) cur = (cur & 0x000F) | (val << 4);
+  else        cur = (cur & 0xF000) | (val & 0xFFF);
+  memcpy(&fat[pos], &cur, 2);
+}
+
+static void fat12_chain(const std::vector<uint32_t>& chain)
+{
+  for (size_t i = 0; i < chain.size(); i++)
+    fat12_set(chain[i], (i+1 < chain.size()) ? chain[i+1] : 0xFFF);
+}
+
+static void fat12_file(int idx, const char* name, uint32_t cluster, uint32_t size)
+{
+  auto* ent = (cl_dir*) &fat12_image[2 * 512];
+  memset(ent[idx].shortname, ' ', 11);
+  memcpy(ent[idx].shortname, name, strlen(name));
+  ent[idx].attrib = ATTR_ARCHIVE;
+  ent[idx].cluster_lo = cluster;
+  ent[idx].filesize = size;
+}
+
+static uint8_t frag_byte(uint32_t pos) { return pos * 7 + pos / 512; }
+
+CASE("Read fragmented FAT12 file using cluster extents")
+{
+  fat12_image.assign(67 * 512, 0);
+  auto* mbr = (MBR::mbr*) fat12_image.data();
+  auto* bpb = mbr->bpb();
+  bpb->bytes_per_sector    = 512;
+  bpb->sectors_per_cluster = 1;
+  bpb->reserved_sectors    = 1;
+  bpb->fa_tables           = 1;
+  bpb->root_entries        = 16;
+  bpb->small_sectors       = 67;
+  bpb->sectors_per_fat     = 1;
+  bpb->signature           = 0x29;
+  mbr->magic = 0xAA55;
+  fat12_set(0, 0xFF8);
+  fat12_set(1, 0xFFF);
+
+  // cluster N lives in sector 3 + (N - 2)
+  const std::vector<uint32_t> chain {3, 4, 5, 9, 10, 6, 20};
+  fat12_chain(chain);
+  for (size_t i = 0; i < chain.size(); i++) {
+    for (uint32_t b = 0; b < 512; b++)
+      fat12_image[(3 + chain[i] - 2) * 512 + b] = frag_byte(i * 512 + b);
+  }
+  fat12_file(0, "FRAGBIN", 3, 3500);
+  // file size claims more than its cluster chain
+  fat12_chain({30});
+  fat12_file(1, "SHORT", 30, 2000);
+
+  static MemDisk fatdisk {fat12_image.data(), fat12_image.data() + fat12_image.size()};
+  static Disk_ptr fdisk = std::make_shared<Disk> (fatdisk);
+  fdisk->init_fs(Disk::MBR, [&lest_env] (auto err, File_system& fs) {
+    EXPECT(!err);
+    EXPECT(fs.name() == "FAT12");
+  });
+  auto& fs = fdisk->fs();
+
+  auto ent = fs.stat("/FRAGBIN");
+  EXPECT(ent.is_file());
+  EXPECT(ent.size() == 3500u);
+
+  // whole file
+  auto buf = fs.read(ent, 0, ent.size());
+  EXPECT(buf.is_valid());
+  EXPECT(buf.size() == 3500u);
+  bool match = true;
+  for (uint32_t i = 0; i < buf.size(); i++)
+    match = match && buf.data()[i] == frag_byte(i);
+  EXPECT(match);
+
+  // unaligned reads across fragments, sync and async
+  const std::vector<std::pair<uint64_t, uint64_t>> ranges {
+    {0, 10}, {500, 30}, {1023, 2}, {1400, 1200}, {2600, 900}, {3490, 100}
+  };
+  for (auto& r : ranges)
+  {
+    const uint64_t len = std::min(r.second, 3500 - r.first);
+    auto part = fs.read(ent, r.first, r.second);
+    EXPECT(part.size() == len);
+    match = true;
+    for (uint32_t i = 0; i < part.size(); i++)
+      match = match && part.data()[i] == frag_byte(r.first + i);
+    EXPECT(match);
+
+    bool done = false;
+    fs.read(ent, r.first, r.second,
+      [&lest_env, &done, &r, len] (auto err, auto data) {
+        EXPECT(!err);
+        EXPECT(data->size() == len);
+        bool ok = true;
+        for (uint32_t i = 0; i < data->size(); i++)
+          ok = ok && data->at(i) == frag_byte(r.first + i);
+        EXPECT(ok);
+        done = true;
+      });
+    EXPECT(done);
+  }
+
+  // broken chains are reported as I/O errors
+  auto bad = fs.stat("/SHORT");
+  EXPECT(bad.is_file());
+  EXPECT(fs.read(bad, 0, 100).is_valid());
+  EXPECT(not fs.read(bad, 1000, 100).is_valid());
+  fs.read(bad, 1000, 100,
+    [&lest_env] (auto err, auto data) {
+      EXPECT(err);
+      EXPECT(data == nullptr);
+    });
+}
@@ -0,0 +1,323 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <hw/block_cache.hpp>
+#include <fs/common.hpp>
+#include <cstring>
+#include <functional>
+
+// RAM backed block device that counts device accesses
+class Ram_disk : public hw::Writable_Block_device {
+public:
+  static constexpr size_t SECTOR_SIZE = 512;
+
+  explicit Ram_disk(size_t blocks)
+    : image(blocks * SECTOR_SIZE)
+  {
+    for (size_t i = 0; i < image.size(); i++)
+      image[i] = i / SECTOR_SIZE;
+  }
+
+  std::string device_name() const override
+  { return "ramdisk" + std::to_string(id()); }
+
+  const char* driver_name() const noexcept override
+  { return "Ram_disk"; }
+
+  block_t size() const noexcept override
+  { return image.size() / SECTOR_SIZE; }
+
+  block_t block_size() const noexcept override
+  { return SECTOR_SIZE; }
+
+  void read(block_t blk, size_t cnt, on_read_func reader) override
+  { reader(read_sync(blk, cnt)); }
+
+  buffer_t read_sync(block_t blk, size_t cnt) override
+  {
+    reads++;
+    blocks_read += cnt;
+    if (blk + cnt > size()) return nullptr;
+    auto* start = image.data() + blk * SECTOR_SIZE;
+    return fs::construct_buffer(start, start + cnt * SECTOR_SIZE);
+  }
+
+  void write(block_t blk, buffer_t buf, on_write_func callback) override
+  { callback(write_sync(blk, buf)); }
+
+  bool write_sync(block_t blk, buffer_t buf) override
+  {
+    writes++;
+    if (blk * SECTOR_SIZE + buf->size() > image.size()) return true;
+    std::memcpy(image.data() + blk * SECTOR_SIZE, buf->data(), buf->size());
+    return false;
+  }
+
+  void deactivate() override {}
+
+  std::vector<uint8_t> image;
+  int reads = 0;
+  int writes = 0;
+  size_t blocks_read = 0;
+};
+
+CASE("Block_cache forwards device properties")
+{
+  Ram_disk disk{64};
+  hw::Block_cache cache{disk, 16};
+  EXPECT(cache.size() == 64u);
+  EXPECT(cache.block_size() == 512u);
+  EXPECT(cache.device_type() == hw::Device::Type::Block);
+  EXPECT(cache.driver_name() == std::string("Block_cache"));
+  EXPECT(cache.is_writable());
+  EXPECT(cache.capacity() == 16u);
+  EXPECT(cache.cached() == 0u);
+}
+
+CASE("Block_cache serves repeated reads from cache")
+{
+  Ram_disk disk{64};
+  hw::Block_cache cache{disk, 16};
+  cache.set_read_ahead_max(0);
+
+  auto buf = cache.read_sync(10, 2);
+  EXPECT(buf != nullptr);
+  EXPECT(buf->size() == 1024u);
+  EXPECT(buf->at(0) == 10);
+  EXPECT(buf->at(512) == 11);
+  EXPECT(disk.reads == 1);
+  EXPECT(cache.misses() == 2u);
+
+  bool called = false;
+  cache.read(10, 2,
+    [&] (auto buf) {
+      called = true;
+      EXPECT(buf != nullptr);
+      EXPECT(buf->at(511) == 10);
+      EXPECT(buf->at(512) == 11);
+    });
+  EXPECT(called);
+  EXPECT(disk.reads == 1);
+  EXPECT(cache.hits() == 2u);
+  EXPECT(cache.hit_rate() == 0.5f);
+
+  // out of bounds
+  EXPECT(cache.read_sync(63, 2) == nullptr);
+}
+
+CASE("Block_cache evicts least recently used blocks")
+{
+  Ram_disk disk{64};
+  hw::Block_cache cache{disk, 4};
+  cache.set_read_ahead_max(0);
+
+  for (int i = 0; i < 4; i++) cache.read_sync(i * 2);
+  EXPECT(cache.cached() == 4u);
+  // touch block 0 so block 2 becomes the oldest
+  cache.read_sync(0);
+  cache.read_sync(20);
+  EXPECT(cache.cached() == 4u);
+
+  const int reads = disk.reads;
+  cache.read_sync(0);
+  EXPECT(disk.reads == reads);
+  cache.read_sync(2);
+  EXPECT(disk.reads == reads + 1);
+}
+
+CASE("Block_cache reads ahead on sequential access")
+{
+  Ram_disk disk{256};
+  hw::Block_cache cache{disk, 128};
+  cache.set_read_ahead_max(16);
+
+  for (int blk = 0; blk < 64; blk++) {
+    auto buf = cache.read_sync(blk);
+    EXPECT(buf != nullptr);
+    EXPECT(buf->at(0) == blk);
+  }
+  // sequential stream should need far fewer device requests than blocks
+  EXPECT(disk.reads < 16);
+  EXPECT(cache.hits() > cache.misses());
+
+  // async readers keep read-ahead in flight
+  const int reads = disk.reads;
+  for (int blk = 64; blk < 128; blk++) {
+    cache.read(blk, 1, [&lest_env, blk] (auto buf) {
+      EXPECT(buf != nullptr);
+      EXPECT(buf->at(0) == blk);
+    });
+  }
+  EXPECT(disk.reads - reads < 8);
+
+  // random access does not read ahead
+  Ram_disk disk2{256};
+  hw::Block_cache cache2{disk2, 128};
+  cache2.read_sync(100);
+  cache2.read_sync(7);
+  cache2.read_sync(50);
+  EXPECT(disk2.blocks_read <= 3 + 4);
+}
+
+CASE("Block_cache writes back dirty blocks on flush")
+{
+  Ram_disk disk{64};
+  hw::Block_cache cache{disk, 16};
+
+  auto data = fs::construct_buffer(1024, 0xff);
+  EXPECT(cache.write_sync(4, data) == false);
+  EXPECT(cache.dirty() == 2u);
+  EXPECT(disk.writes == 0);
+  EXPECT(disk.image[4 * 512] == 4);
+
+  // reads see the written data
+  auto buf = cache.read_sync(3, 3);
+  EXPECT(buf->at(0) == 3);
+  EXPECT(buf->at(512) == 0xff);
+  EXPECT(buf->at(1024) == 0xff);
+
+  // contiguous dirty blocks are written in one request
+  cache.flush();
+  EXPECT(cache.dirty() == 0u);
+  EXPECT(disk.writes == 1);
+  EXPECT(disk.image[4 * 512] == 0xff);
+  EXPECT(disk.image[5 * 512 + 511] == 0xff);
+
+  bool flushed = false;
+  cache.write(20, fs::construct_buffer(512, 0xaa), [] (bool err) { (void) err; });
+  cache.write(30, fs::construct_buffer(512, 0xbb), [] (bool err) { (void) err; });
+  cache.flush([&] (bool err) { flushed = not err; });
+  EXPECT(flushed);
+  EXPECT(disk.writes == 3);
+  EXPECT(disk.image[20 * 512] == 0xaa);
+  EXPECT(disk.image[30 * 512] == 0xbb);
+
+  // invalid writes
+  EXPECT(cache.write_sync(63, data) == true);
+  EXPECT(cache.write_sync(0, fs::construct_buffer(100)) == true);
+}
+
+CASE("Block_cache writes back dirty blocks on eviction")
+{
+  Ram_disk disk{64};
+  hw::Block_cache cache{disk, 2};
+  cache.set_read_ahead_max(0);
+
+  cache.write_sync(1, fs::construct_buffer(512, 0x11));
+  cache.read_sync(10);
+  cache.read_sync(11);
+  EXPECT(cache.dirty() == 0u);
+  EXPECT(disk.writes == 1);
+  EXPECT(disk.image[512] == 0x11);
+}
+
+CASE("Block_cache on read-only devices")
+{
+  Ram_disk disk{8};
+  hw::Block_device& ro = disk;
+  hw::Block_cache cache{ro, 4};
+  EXPECT(not cache.is_writable());
+  EXPECT(cache.write_sync(0, fs::construct_buffer(512)) == true);
+  cache.read_sync(0);
+  cache.invalidate();
+  EXPECT(cache.cached() == 0u);
+}
+
+CASE("Block_cache keeps dirty blocks until they are written back")
+{
+  struct Failing_disk : public Ram_disk {
+    using Ram_disk::Ram_disk;
+    bool write_sync(block_t blk, buffer_t buf) override
+    {
+      if (failing) { writes++; return true; }
+      return Ram_disk::write_sync(blk, buf);
+    }
+    bool failing = true;
+  };
+  Failing_disk disk{64};
+  {
+    hw::Block_cache cache{disk, 2};
+    cache.set_read_ahead_max(0);
+
+    cache.write_sync(1, fs::construct_buffer(512, 0x11));
+    cache.read_sync(10);
+    cache.read_sync(11);
+    // the write-back failed, so the block is still there,
+    // and a clean one went instead
+    EXPECT(cache.dirty() == 1u);
+    EXPECT(cache.cached() == 2u);
+    EXPECT(cache.read_sync(1)->at(0) == 0x11);
+    EXPECT(disk.image[512] == 1);
+
+    cache.flush();
+    EXPECT(cache.dirty() == 1u);
+    bool error = false;
+    cache.flush([&error] (bool err) { error = err; });
+    EXPECT(error);
+    EXPECT(cache.dirty() == 1u);
+
+    // and is written when the device recovers, once the cache is gone
+    disk.failing = false;
+    cache.write_sync(2, fs::construct_buffer(512, 0x22));
+  }
+  EXPECT(disk.image[512] == 0x11);
+  EXPECT(disk.image[2 * 512] == 0x22);
+}
+
+CASE("Block_cache ignores device completions after it is gone")
+{
+  // completes reads and writes only when told to
+  struct Deferred_disk : public Ram_disk {
+    using Ram_disk::Ram_disk;
+    void read(block_t blk, size_t cnt, on_read_func reader) override
+    {
+      pending.push_back([this, blk, cnt, reader] { reader(read_sync(blk, cnt)); });
+    }
+    void write(block_t blk, buffer_t buf, on_write_func callback) override
+    {
+      pending.push_back([this, blk, buf, callback] { callback(write_sync(blk, buf)); });
+    }
+    void complete()
+    {
+      auto done = std::move(pending);
+      pending.clear();
+      for (auto& func : done) func();
+    }
+    std::vector<std::function<void()>> pending;
+  };
+  Deferred_disk disk{64};
+  hw::Block_device::buffer_t result = nullptr;
+  bool flushed = false;
+  {
+    hw::Block_cache cache{disk, 16};
+    cache.set_read_ahead_max(8);
+    // sequential, so the device read is extended with read-ahead
+    cache.read_sync(0);
+    cache.read(1, 2, [&result] (auto buf) { result = std::move(buf); });
+    cache.write_sync(20, fs::construct_buffer(512, 0x33));
+    cache.flush([&flushed] (bool) { flushed = true; });
+    EXPECT(disk.pending.size() == 2u);
+  }
+  disk.complete();
+  // the reader gets what it asked for, and no more
+  EXPECT(result != nullptr);
+  EXPECT(result->size() == 2 * 512u);
+  EXPECT(result->at(0) == 1);
+  EXPECT(result->at(512) == 2);
+  EXPECT(flushed);
+  EXPECT(disk.image[20 * 512] == 0x33);
+}
@@ -18,6 +18,7 @@
 #include <os>
 #include <vector>
 #include <kernel/fiber.hpp>
+#include <kernel/fiber_await.hpp>
 
 void scheduler1();
 void scheduler2();
@@ -247,6 +248,35 @@ long compute_int() {
   return i;
 }
 
+static void scheduler_test()
+{
+  static const int FIBERS = 2000;
+  static int finished = 0;
+  INFO("Service", "Spawning %d scheduled fibers", FIBERS);
+
+  for (int i = 0; i < FIBERS; i++)
+  {
+    Fiber_scheduler::spawn(
+    [i] {
+      // straight-line code waiting on timers
+      fiber::sleep(std::chrono::milliseconds(1 + i % 20));
+      Fiber_scheduler::yield();
+      fiber::sleep(std::chrono::milliseconds(5));
+
+      if (++finished == FIBERS)
+      {
+        INFO("Service", "All fibers done, %zu stacks pooled, guard pages %s",
+             Fiber_stack::pooled(), Fiber_stack::guard_pages() ? "on" : "off");
+        Expects(Fiber_scheduler::alive() == 1);
+        SMP_PRINT("Service done. rsp @ %p \n", get_rsp());
+        SMP_PRINT("SUCCESS\n");
+        exit(0);
+      }
+    });
+  }
+  Expects(Fiber_scheduler::alive() == FIBERS);
+}
+
 void Service::start()
 {
   Expects(Fiber::main() == nullptr);
@@ -317,7 +347,5 @@ void Service::start()
     INFO("Service", "SMP test requires > 1 cpu's, found %i \n", SMP::cpu_count());
   }
 #endif
-  SMP_PRINT("Service done. rsp @ %p \n", get_rsp());
-  SMP_PRINT("SUCCESS\n");
-  exit(0);
+  scheduler_test();
 }
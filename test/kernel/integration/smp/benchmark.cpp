@@ -0,0 +1,102 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Task throughput and latency of SMP::add_task versus Executor
+
+#include <os>
+#include <smp>
+#include <kernel/executor.hpp>
+#include <algorithm>
+#include <cinttypes>
+
+static const int BENCH_TASKS = 20000;
+
+struct Bench {
+  const char* name;
+  uint64_t start;
+  uint64_t latency;
+  int      completed;
+  delegate<void()> next;
+};
+static Bench bench;
+
+static uint64_t to_micros(uint64_t cycles)
+{
+  const double khz = os::cpu_freq().count();
+  return (khz > 0) ? cycles * 1000.0 / khz : 0;
+}
+
+static void bench_task(uint64_t posted)
+{
+  __sync_fetch_and_add(&bench.latency, os::cycles_since_boot() - posted);
+}
+
+static void bench_done()
+{
+  if (++bench.completed < BENCH_TASKS) return;
+  const uint64_t cycles = os::cycles_since_boot() - bench.start;
+  const uint64_t micros = std::max<uint64_t>(1, to_micros(cycles));
+  printf("BENCH %s: %d tasks in %" PRIu64 " us, %" PRIu64 " tasks/sec, avg latency %" PRIu64 " ns\n",
+         bench.name, BENCH_TASKS, micros, BENCH_TASKS * UINT64_C(1000000) / micros,
+         to_micros(bench.latency * 1000 / BENCH_TASKS));
+  bench.next();
+}
+
+static void bench_begin(const char* name, delegate<void()> next)
+{
+  bench = {name, os::cycles_since_boot(), 0, 0, next};
+}
+
+static void bench_spinlock(delegate<void()> next)
+{
+  bench_begin("spinlock", next);
+  for (int i = 0; i < BENCH_TASKS; i++)
+  {
+    const uint64_t posted = os::cycles_since_boot();
+    SMP::add_task([posted] { bench_task(posted); }, bench_done);
+  }
+  SMP::signal();
+}
+
+static void bench_executor(delegate<void()> next)
+{
+  bench_begin("executor", next);
+  for (int i = 0; i < BENCH_TASKS; i++)
+  {
+    const uint64_t posted = os::cycles_since_boot();
+    Executor::submit([posted] { bench_task(posted); }, bench_done);
+  }
+}
+
+void smp_task_benchmark(delegate<void()> next)
+{
+  if (SMP::cpu_count() < 2) {
+    next();
+    return;
+  }
+  using next_func = delegate<void()>;
+  bench_spinlock(next_func::make_packed(
+  [next] {
+    bench_executor(next_func::make_packed(
+    [next] {
+      uint64_t stolen = 0;
+      for (int cpu : SMP::active_cpus())
+          stolen += Executor::stats(cpu).stolen;
+      printf("BENCH executor: %" PRIu64 " tasks stolen\n", stolen);
+      next();
+    }));
+  }));
+}
@@ -108,15 +108,16 @@ static void random_irq_handler()
   }
 }
 
+extern void smp_task_benchmark(delegate<void()>);
+
 static const uint8_t IRQ = 110;
 void SMP::init_task()
 {
   Events::get().subscribe(IRQ, random_irq_handler);
 }
 
-void Service::start()
+static void smp_basic_test()
 {
-
   for (const auto& i : SMP::active_cpus())
   {
     SMP::global_lock();
@@ -137,3 +138,8 @@ void Service::start()
   // the rest
   smp_advanced_test();
 }
+
+void Service::start()
+{
+  smp_task_benchmark(smp_basic_test);
+}
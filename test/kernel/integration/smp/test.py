@@ -6,6 +6,13 @@ import os
 
 from vmrunner import vmrunner
 
+vm = vmrunner.vms[0]
+
+def print_benchmark(line):
+    print("<test.py> " + line.strip())
+
+vm.on_output("BENCH", print_benchmark)
+
 if len(sys.argv) > 1:
     vmrunner.vms[0].boot(image_name=str(sys.argv[1]))
 else:
@@ -3,10 +3,25 @@
 from builtins import str
 import sys
 import os
+import json
 
 from vmrunner import vmrunner
+vm = vmrunner.vms[0]
+
+# the boot sequence ends with a machine-readable timeline
+def check_boot_timeline(line):
+    timeline = json.loads(line.split("BOOT_TIMELINE", 1)[1])
+    phases = [p["name"] for p in timeline["phases"]]
+    print("<test.py> Boot took %d us:" % timeline["total_us"])
+    for p in timeline["phases"]:
+        print("<test.py>   %-16s %8d us" % (p["name"], p["us"]))
+    for name in ["early boot", "paging", "PCI scan", "Service::start", "Service::ready"]:
+        if name not in phases:
+            vm.exit(1, "<test.py> Boot timeline is missing phase " + name)
+
+vm.on_output("BOOT_TIMELINE", check_boot_timeline)
 
 if len(sys.argv) > 1:
-    vmrunner.vms[0].boot(image_name=str(sys.argv[1]))
+    vm.boot(image_name=str(sys.argv[1]))
 else:
-    vmrunner.vms[0].cmake().boot(60).clean()
+    vm.cmake().boot(60).clean()
@@ -0,0 +1,75 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <kernel/boot_trace.hpp>
+#include <os.hpp>
+#include <cstring>
+
+CASE("Boot_trace records contiguous phases")
+{
+  Boot_trace::reset();
+  EXPECT(Boot_trace::size() == 0);
+  EXPECT(Boot_trace::total_cycles() == 0u);
+
+  const uint64_t start = os::cycles_since_boot();
+  Boot_trace::start("early boot", start);
+  Boot_trace::phase("paging");
+  Boot_trace::phase("Service::start");
+  EXPECT(Boot_trace::size() == 3);
+  EXPECT(not Boot_trace::finished());
+
+  Boot_trace::finish();
+  EXPECT(Boot_trace::finished());
+  // phases after the end are ignored
+  Boot_trace::phase("too late");
+  EXPECT(Boot_trace::size() == 3);
+
+  const auto* ph = Boot_trace::phases();
+  EXPECT(ph[0].begin == start);
+  EXPECT(strcmp(ph[1].name, "paging") == 0);
+  for (int i = 0; i < Boot_trace::size(); i++) {
+    EXPECT(ph[i].end >= ph[i].begin);
+    if (i > 0) EXPECT(ph[i].begin == ph[i-1].end);
+  }
+  EXPECT(Boot_trace::total_cycles() == ph[2].end - start);
+}
+
+CASE("Boot_trace timeline as JSON")
+{
+  Boot_trace::start("early boot", os::cycles_since_boot());
+  Boot_trace::phase("PCI scan");
+  Boot_trace::finish();
+
+  const auto json = Boot_trace::to_json();
+  EXPECT(json.front() == '{');
+  EXPECT(json.back() == '}');
+  EXPECT(json.find("\"tsc_khz\":") != std::string::npos);
+  EXPECT(json.find("\"total_us\":") != std::string::npos);
+  EXPECT(json.find("{\"name\":\"early boot\",\"start_us\":0,") != std::string::npos);
+  EXPECT(json.find("\"name\":\"PCI scan\"") != std::string::npos);
+}
+
+CASE("Boot_trace has a fixed number of phases")
+{
+  Boot_trace::start("early boot", os::cycles_since_boot());
+  for (int i = 0; i < Boot_trace::MAX_PHASES * 2; i++)
+      Boot_trace::phase("phase");
+  EXPECT(Boot_trace::size() == Boot_trace::MAX_PHASES);
+  Boot_trace::finish();
+  EXPECT(Boot_trace::phases()[Boot_trace::MAX_PHASES-1].end != 0u);
+  Boot_trace::reset();
+}
@@ -0,0 +1,221 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <kernel/coroutine.hpp>
+#include <deque>
+#include <stdexcept>
+
+using namespace std::chrono;
+
+extern delegate<uint64_t()> systime_override;
+static uint64_t current_time = 0;
+
+// buffers written to it are read back from it
+class Loop_stream : public net::Stream {
+public:
+  void push(buffer_t buf) {
+    bufs.push_back(std::move(buf));
+    if (data_cb) data_cb();
+  }
+  void close() override {
+    readable = false;
+    if (close_cb) close_cb();
+  }
+  void ack(size_t n) { if (write_cb) write_cb(n); }
+
+  void on_connect(ConnectCallback) override {}
+  void on_read(size_t, ReadCallback) override {}
+  void on_data(DataCallback cb) override { data_cb = cb; }
+  size_t next_size() override { return bufs.empty() ? 0 : bufs.front()->size(); }
+  buffer_t read_next() override {
+    auto buf = std::move(bufs.front());
+    bufs.pop_front();
+    return buf;
+  }
+  void on_close(CloseCallback cb) override { close_cb = cb; }
+  void on_write(WriteCallback cb) override { write_cb = cb; }
+  void write(const void* buf, size_t n) override
+  { write(construct_buffer((const uint8_t*) buf, (const uint8_t*) buf + n)); }
+  void write(buffer_t buf) override { written.push_back(std::move(buf)); }
+  void write(const std::string& str) override { write(str.data(), str.size()); }
+  void reset_callbacks() override {}
+  net::Socket local() const override { return {}; }
+  net::Socket remote() const override { return {}; }
+  std::string to_string() const override { return "Loop_stream"; }
+  bool is_connected() const noexcept override { return readable; }
+  bool is_writable() const noexcept override { return readable; }
+  bool is_readable() const noexcept override { return readable; }
+  bool is_closing() const noexcept override { return not readable; }
+  bool is_closed() const noexcept override { return not readable; }
+  int get_cpuid() const noexcept override { return 0; }
+  net::Stream* transport() noexcept override { return nullptr; }
+
+  std::deque<buffer_t> bufs;
+  std::vector<buffer_t> written;
+  bool readable = true;
+  DataCallback  data_cb  = nullptr;
+  CloseCallback close_cb = nullptr;
+  WriteCallback write_cb = nullptr;
+};
+
+static coro::Task<int> add(coro::Arena&, int a, int b)
+{
+  co_return a + b;
+}
+
+static coro::Task<int> fail(coro::Arena&)
+{
+  throw std::runtime_error("failed");
+  co_return 0;
+}
+
+static coro::Task<> sum(coro::Arena& arena, int& result, bool& caught)
+{
+  result = co_await add(arena, 1, 2);
+  result += co_await add(arena, result, 4);
+  try {
+    co_await fail(arena);
+  }
+  catch (const std::runtime_error&) {
+    caught = true;
+  }
+}
+
+static coro::Task<> nap(coro::Arena&, Timers::duration_t time, int& stage)
+{
+  stage = 1;
+  co_await coro::sleep(time);
+  stage = 2;
+}
+
+static coro::Task<> echo(coro::Arena&, net::Stream& stream, size_t& sent, bool& ended)
+{
+  while (auto buf = co_await coro::read(stream))
+    sent += co_await coro::write(stream, std::move(buf));
+  ended = true;
+}
+
+static void process_events()
+{
+  for (int i = 0; i < 10; i++)
+    Events::get().process_events();
+}
+
+CASE("Arena reclaims frames freed from the top, or all at once")
+{
+  coro::Static_arena<1024> arena;
+  EXPECT(arena.capacity() == 1024u);
+
+  void* a = arena.allocate(100);
+  void* b = arena.allocate(10);
+  EXPECT(arena.owns(a));
+  EXPECT(arena.owns(b));
+  EXPECT(((uintptr_t) b % coro::Arena::ALIGN) == 0u);
+  const auto both = arena.in_use();
+  EXPECT(both >= 110u);
+
+  // freed from the top, the space comes back at once
+  arena.deallocate(b, 10);
+  EXPECT(arena.in_use() < both);
+  EXPECT(arena.allocate(10) == b);
+
+  // out of order, there's a hole until the last one goes
+  arena.deallocate(a, 100);
+  EXPECT(arena.in_use() == both);
+  arena.deallocate(b, 10);
+  EXPECT(arena.in_use() == 0u);
+
+  // too large for what's left goes to the heap
+  void* large = arena.allocate(2048);
+  EXPECT(not arena.owns(large));
+  EXPECT(arena.heap_allocs() == 1u);
+  EXPECT(arena.in_use() == 0u);
+  arena.deallocate(large, 2048);
+}
+
+CASE("Tasks get their frames from the arena and hand back results")
+{
+  coro::Static_arena<4096> arena;
+  int result = 0;
+  bool caught = false;
+  coro::spawn(sum(arena, result, caught));
+  // nothing in them waits, so they are done at once
+  EXPECT(result == 10);
+  EXPECT(caught);
+  EXPECT(arena.heap_allocs() == 0u);
+  EXPECT(arena.in_use() == 0u);
+}
+
+CASE("Sleeping coroutines are resumed from the event loop")
+{
+  systime_override = [] () -> uint64_t { return current_time; };
+  Timers::init([] (Timers::duration_t) {}, [] () {});
+  Timers::ready();
+
+  coro::Static_arena<1024> arena;
+  int stage = 0;
+  coro::spawn(nap(arena, 1ms, stage));
+  EXPECT(stage == 1);
+  current_time = 1000000;
+  Timers::timers_handler();
+  // not from inside the timer
+  EXPECT(stage == 1);
+  process_events();
+  EXPECT(stage == 2);
+  EXPECT(arena.in_use() == 0u);
+
+  // no time to wait
+  stage = 0;
+  coro::spawn(nap(arena, 0ms, stage));
+  EXPECT(stage == 2);
+}
+
+CASE("Reading and writing coroutines wait for the stream")
+{
+  coro::Static_arena<1024> arena;
+  Loop_stream stream;
+  size_t sent = 0;
+  bool ended = false;
+  coro::spawn(echo(arena, stream, sent, ended));
+  EXPECT(arena.in_use() > 0u);
+  EXPECT(stream.data_cb != nullptr);
+
+  // resumed from the event loop, not from the callback of the stream
+  stream.push(net::Stream::construct_buffer(8, 'a'));
+  EXPECT(stream.written.empty());
+  process_events();
+  EXPECT(stream.written.size() == 1u);
+  EXPECT(sent == 0u);
+
+  // until every byte is written
+  stream.ack(5);
+  process_events();
+  EXPECT(sent == 0u);
+  stream.ack(3);
+  process_events();
+  EXPECT(sent == 8u);
+
+  // what is left is read after the stream closed, but not written
+  stream.bufs.push_back(net::Stream::construct_buffer(4, 'b'));
+  stream.close();
+  process_events();
+  EXPECT(stream.bufs.empty());
+  EXPECT(stream.written.size() == 1u);
+  EXPECT(sent == 8u);
+  EXPECT(ended);
+  EXPECT(arena.in_use() == 0u);
+}
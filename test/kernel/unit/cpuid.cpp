@@ -6,3 +6,13 @@ CASE("CPUID test")
 {
   EXPECT(!CPUID::detect_features_str().empty());
 }
+
+CASE("CPUID frequencies are either unknown or plausible")
+{
+  const uint32_t tsc = CPUID::tsc_khz();
+  EXPECT((tsc == 0 || tsc > 100000));
+  const uint32_t base = CPUID::base_khz();
+  EXPECT((base == 0 || base > 100000));
+  const uint32_t lapic = CPUID::lapic_khz();
+  EXPECT((lapic == 0 || lapic >= 1000));
+}
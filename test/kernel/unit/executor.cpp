@@ -0,0 +1,85 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <kernel/executor.hpp>
+#include <kernel/events.hpp>
+
+static void run_all()
+{
+  while (Events::get(0).process_events());
+}
+
+CASE("Executor runs tasks and completions from the event loop")
+{
+  static int ran = 0, done = 0;
+  const auto run_before = Executor::stats(0).run;
+  for (int i = 0; i < 100; i++)
+    Executor::submit([] { ran++; }, [] { done++; });
+  Executor::submit_to(0, [] { ran++; });
+  EXPECT(ran == 0);
+  run_all();
+  EXPECT(ran == 101);
+  EXPECT(done == 100);
+  EXPECT(Executor::stats(0).run == run_before + 101);
+
+  // more than fits in the queues
+  ran = 0;
+  for (int i = 0; i < Executor::DEQUE_SIZE * 2; i++)
+    Executor::submit([] { ran++; });
+  for (int i = 0; i < Executor::INBOX_SIZE * 2; i++)
+    Executor::submit_to(0, [] { ran++; });
+  run_all();
+  EXPECT(ran == Executor::DEQUE_SIZE * 2 + Executor::INBOX_SIZE * 2);
+  EXPECT(Executor::stats(0).overflowed > 0u);
+}
+
+CASE("Executor parallel_for covers the range once")
+{
+  static std::vector<int> hits;
+  static bool done = false;
+  hits.assign(1000, 0);
+  Executor::parallel_for(0, hits.size(),
+    [] (size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) hits[i]++;
+    },
+    [] { done = true; }, 10);
+  run_all();
+  EXPECT(done);
+  EXPECT(std::count(hits.begin(), hits.end(), 1) == 1000);
+
+  // empty range completes too
+  done = false;
+  Executor::parallel_for(5, 5, [] (size_t, size_t) {}, [] { done = true; });
+  run_all();
+  EXPECT(done);
+}
+
+CASE("Executor futures deliver results on the submitting CPU")
+{
+  auto future = Executor::async<int>([] { return 42; });
+  EXPECT(future.ready() == false);
+  EXPECT_THROWS_AS(future.get(), std::logic_error);
+  static int result = 0;
+  future.then([] (int& value) { result = value; });
+  run_all();
+  EXPECT(future.ready());
+  EXPECT(future.get() == 42);
+  EXPECT(result == 42);
+  // then() on a ready future calls back immediately
+  future.then([] (int& value) { result = value + 1; });
+  EXPECT(result == 43);
+}
@@ -0,0 +1,170 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <kernel/events.hpp>
+#include <kernel/fiber_await.hpp>
+#include <kernel/fiber_scheduler.hpp>
+#include <string>
+
+// closing it calls back whatever was installed last, every time
+class Closing_stream : public net::Stream {
+public:
+  void close() override {
+    readable = false;
+    if (close_cb) close_cb();
+  }
+
+  void on_connect(ConnectCallback) override {}
+  void on_read(size_t, ReadCallback) override {}
+  void on_data(DataCallback cb) override { data_cb = cb; }
+  size_t next_size() override { return 0; }
+  buffer_t read_next() override { return nullptr; }
+  void on_close(CloseCallback cb) override { close_cb = cb; close_cbs_set++; }
+  void on_write(WriteCallback) override {}
+  void write(const void*, size_t) override {}
+  void write(buffer_t) override {}
+  void write(const std::string&) override {}
+  void reset_callbacks() override {}
+  net::Socket local() const override { return {}; }
+  net::Socket remote() const override { return {}; }
+  std::string to_string() const override { return "Closing_stream"; }
+  bool is_connected() const noexcept override { return readable; }
+  bool is_writable() const noexcept override { return readable; }
+  bool is_readable() const noexcept override { return readable; }
+  bool is_closing() const noexcept override { return not readable; }
+  bool is_closed() const noexcept override { return not readable; }
+  int get_cpuid() const noexcept override { return 0; }
+  net::Stream* transport() noexcept override { return nullptr; }
+
+  bool readable = true;
+  int close_cbs_set = 0;
+  DataCallback  data_cb  = nullptr;
+  CloseCallback close_cb = nullptr;
+};
+
+static void run_rounds(int rounds = 100)
+{
+  for (int i = 0; i < rounds and Fiber_scheduler::runnable() > 0; i++)
+    Events::get().process_events();
+}
+
+CASE("Scheduled fibers take turns")
+{
+  static std::string turns;
+  static bool in_fiber;
+  turns.clear();
+  in_fiber = true;
+  // the first round sets up the scheduler of the CPU
+  Fiber_scheduler::spawn([] {});
+  run_rounds();
+  const auto alive = Fiber_scheduler::alive();
+  const auto in_use = Fiber_stack::in_use();
+
+  for (const char name : {'a', 'b', 'c'})
+  {
+    Fiber_scheduler::spawn(Fiber_scheduler::task_func::make_packed(
+      [name] {
+        in_fiber &= Fiber_scheduler::current() != nullptr;
+        for (int i = 0; i < 3; i++) {
+          turns += name;
+          Fiber_scheduler::yield();
+        }
+      }));
+  }
+  // nothing runs before the event loop gets to it
+  EXPECT(turns.empty());
+  EXPECT(Fiber_scheduler::alive() == alive + 3);
+  EXPECT(Fiber_scheduler::runnable() == 3u);
+  EXPECT(Fiber_scheduler::current() == nullptr);
+
+  run_rounds();
+  EXPECT(turns == "abcabcabc");
+  EXPECT(in_fiber);
+  EXPECT(Fiber_scheduler::alive() == alive);
+  EXPECT(Fiber_scheduler::runnable() == 0u);
+  // the stacks of the fibers that returned are given back
+  EXPECT(Fiber_stack::in_use() == in_use);
+}
+
+CASE("Parked fibers run again when woken")
+{
+  static int progress;
+  static Fiber_scheduler::Task* task;
+  progress = 0;
+  task = Fiber_scheduler::spawn(
+    [] {
+      progress++;
+      Fiber_scheduler::park();
+      progress++;
+      // woken before it parks, it carries on at once
+      Fiber_scheduler::wake(task);
+      Fiber_scheduler::park();
+      progress++;
+    });
+
+  run_rounds();
+  EXPECT(progress == 1);
+  EXPECT(Fiber_scheduler::runnable() == 0u);
+  EXPECT(Fiber_scheduler::alive() > 0u);
+  // parked until woken, however long the event loop runs
+  run_rounds();
+  EXPECT(progress == 1);
+
+  const auto alive = Fiber_scheduler::alive();
+  Fiber_scheduler::wake(task);
+  EXPECT(Fiber_scheduler::runnable() == 1u);
+  run_rounds();
+  EXPECT(progress == 3);
+  EXPECT(Fiber_scheduler::alive() == alive - 1);
+}
+
+CASE("Readers parked on a stream let go of it when it closes")
+{
+  static Closing_stream stream;
+  static bool ended;
+  ended = false;
+  Fiber_scheduler::spawn(
+    [] {
+      auto buf = fiber::read(stream);
+      ended = (buf == nullptr);
+    });
+
+  run_rounds();
+  EXPECT(not ended);
+  EXPECT(Fiber_scheduler::runnable() == 0u);
+  const auto alive = Fiber_scheduler::alive();
+  const auto parked_cbs = stream.close_cbs_set;
+
+  stream.close();
+  run_rounds();
+  EXPECT(ended);
+  EXPECT(Fiber_scheduler::alive() == alive - 1);
+  // the callbacks waking the finished fiber were replaced
+  EXPECT(stream.close_cbs_set > parked_cbs);
+
+  // eg. the full close after a FIN
+  stream.close();
+  stream.data_cb();
+  EXPECT(Fiber_scheduler::runnable() == 0u);
+  EXPECT(Fiber_scheduler::alive() == alive - 1);
+}
+
+CASE("Parking and yielding are for scheduled fibers only")
+{
+  EXPECT_THROWS(Fiber_scheduler::park());
+  EXPECT_THROWS(Fiber_scheduler::yield());
+}
@@ -0,0 +1,60 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <kernel/fiber.hpp>
+#include <set>
+
+CASE("Fiber stacks are reused from the pool")
+{
+  const auto in_use = Fiber_stack::in_use();
+  char* stack = Fiber_stack::alloc(Fiber::default_stack_size);
+  EXPECT(stack != nullptr);
+  EXPECT(Fiber_stack::in_use() == in_use + 1);
+  // the whole stack is usable
+  stack[0] = 1;
+  stack[Fiber::default_stack_size + 15] = 1;
+
+  const auto pooled = Fiber_stack::pooled();
+  Fiber_stack::free(stack, Fiber::default_stack_size);
+  EXPECT(Fiber_stack::pooled() == pooled + 1);
+  EXPECT(Fiber_stack::in_use() == in_use);
+
+  // same size comes back from the pool, other sizes don't
+  EXPECT(Fiber_stack::alloc(Fiber::default_stack_size) == stack);
+  EXPECT(Fiber_stack::pooled() == pooled);
+  char* small = Fiber_stack::alloc(4096);
+  EXPECT(small != stack);
+  Fiber_stack::free(small, 4096);
+  Fiber_stack::free(stack, Fiber::default_stack_size);
+}
+
+CASE("Fiber stack pool is bounded")
+{
+  const int SIZE = 8192;
+  std::vector<char*> stacks;
+  for (size_t i = 0; i < Fiber_stack::pool_max + 10; i++)
+      stacks.push_back(Fiber_stack::alloc(SIZE));
+  // every stack is distinct and page aligned
+  std::set<char*> unique(stacks.begin(), stacks.end());
+  EXPECT(unique.size() == stacks.size());
+  for (auto* stack : stacks)
+      EXPECT(((uintptr_t) stack & (Fiber_stack::guard_size - 1)) == 0u);
+
+  const auto pooled = Fiber_stack::pooled();
+  for (auto* stack : stacks) Fiber_stack::free(stack, SIZE);
+  EXPECT(Fiber_stack::pooled() == pooled + Fiber_stack::pool_max);
+}
@@ -0,0 +1,139 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The operator new and delete of src/kernel/new.cpp are linked into this
+// test, so they serve every allocation in it, backed by the pool below.
+#include <common.cxx>
+#include <kernel.hpp>
+#include <kernel/memory.hpp>
+#include <util/units.hpp>
+#include <cstdlib>
+#include <new>
+
+using namespace util::literals;
+using Buddy = os::mem::Raw_allocator;
+using Slab  = os::mem::Slab_allocator;
+
+// the size of the header operator new puts in front of each object
+static constexpr size_t header = alignof(std::max_align_t);
+
+struct Pool {
+  Pool(size_t s) {
+    auto sz  = Buddy::max_bufsize(s);
+    auto res = posix_memalign(&addr, Buddy::min_size, sz);
+    Expects(res == 0);
+    buddy = Buddy::create(addr, sz);
+    slab  = new (slab_storage) Slab(*buddy);
+  }
+
+  Buddy* buddy = nullptr;
+  Slab*  slab  = nullptr;
+  void*  addr  = nullptr;
+  alignas(Slab) char slab_storage[sizeof(Slab)];
+};
+
+// never destroyed, since objects from it may outlive every test
+static Pool& pool()
+{
+  static Pool* p = new (malloc(sizeof(Pool))) Pool(16_MiB);
+  return *p;
+}
+
+bool kernel::heap_ready() { return true; }
+
+Slab& os::mem::slab_allocator() { return *pool().slab; }
+
+static bool from_slab(void* ptr) {
+  return pool().buddy->in_range(ptr);
+}
+
+CASE("operator new takes small objects from the slab, the rest from malloc")
+{
+  auto& slab = *pool().slab;
+  const auto requested = slab.bytes_requested();
+
+  // the largest object that fits a slab class with its header
+  void* small = ::operator new(Slab::max_size - header);
+  EXPECT(from_slab(small));
+  EXPECT(slab.bytes_requested() == requested + Slab::max_size);
+  // one byte more goes to malloc
+  void* large = ::operator new(Slab::max_size - header + 1);
+  EXPECT(not from_slab(large));
+  EXPECT(slab.bytes_requested() == requested + Slab::max_size);
+
+  memset(small, 0xab, Slab::max_size - header);
+  memset(large, 0xcd, Slab::max_size - header + 1);
+  ::operator delete(small);
+  ::operator delete(large);
+  EXPECT(slab.bytes_requested() == requested);
+
+  // sized delete returns the object to the class it came from
+  void* sized = ::operator new(100);
+  EXPECT(from_slab(sized));
+  ::operator delete(sized, 100);
+  EXPECT(slab.bytes_requested() == requested);
+}
+
+CASE("operator new keeps every object aligned for any scalar type")
+{
+  std::vector<char*> objs;
+  for (size_t sz = 1; sz <= Slab::max_size + 64; sz += 5)
+  {
+    auto* ptr = new char[sz];
+    EXPECT(((uintptr_t) ptr % alignof(std::max_align_t)) == 0u);
+    memset(ptr, sz & 0xff, sz);
+    objs.push_back(ptr);
+  }
+  for (size_t i = 0; i < objs.size(); i++)
+  {
+    const size_t sz = 1 + i * 5;
+    EXPECT(objs[i][0] == char(sz & 0xff));
+    EXPECT(objs[i][sz - 1] == char(sz & 0xff));
+    delete[] objs[i];
+  }
+
+  // over-aligned types bypass the header and come back as asked
+  struct alignas(64) Line { char data[64]; };
+  auto* lines = new Line[3];
+  EXPECT(((uintptr_t) lines % 64) == 0u);
+  delete[] lines;
+  auto* line = new Line;
+  EXPECT(((uintptr_t) line % 64) == 0u);
+  delete line;
+}
+
+CASE("operator delete gives large blocks back to malloc")
+{
+  auto& slab = *pool().slab;
+  const auto requested = slab.bytes_requested();
+
+  for (int i = 0; i < 16; i++)
+  {
+    auto* big = new char[1_MiB];
+    EXPECT(not from_slab(big));
+    big[0] = 1; big[1_MiB - 1] = 2;
+    delete[] big;
+  }
+  auto* vec = new std::vector<int>(100000, 7);
+  EXPECT((*vec)[99999] == 7);
+  delete vec;
+  EXPECT(slab.bytes_requested() == requested);
+
+  // nothrow new reports what malloc could not give
+  auto* huge = new (std::nothrow) char[size_t(1) << 62];
+  EXPECT(huge == nullptr);
+  EXPECT_THROWS_AS(::operator new(size_t(1) << 62), std::bad_alloc);
+}
@@ -125,3 +125,93 @@ CASE("Too many events throws exception")
   // event not subscribed on should throw
   EXPECT_THROWS(manager().unsubscribe(35));
 }
+
+CASE("Deferred calls run in order without using events")
+{
+  static std::vector<int> order;
+  order.clear();
+  const auto run_before = manager().defer_stats().run;
+  for (int i = 0; i < 10; i++)
+      manager().defer([i] { order.push_back(i); });
+  EXPECT(manager().deferred_pending() == 10u);
+  // deferring does not take event slots
+  for (int i = 0; i < Events::NUM_EVENTS; i++)
+      manager().subscribe(i, [] { });
+  for (int i = 0; i < Events::NUM_EVENTS; i++)
+      manager().unsubscribe(i);
+
+  EXPECT(manager().process_events() == false);
+  EXPECT(manager().deferred_pending() == 0u);
+  EXPECT(order.size() == 10u);
+  for (int i = 0; i < 10; i++) EXPECT(order[i] == i);
+  EXPECT(manager().defer_stats().run == run_before + 10);
+  EXPECT(manager().defer_stats().max_depth >= 10u);
+}
+
+CASE("Deferred calls beyond the ring capacity overflow in order")
+{
+  static std::vector<int> order;
+  order.clear();
+  const int COUNT = Events::DEFER_RING_SIZE * 3;
+  const auto overflowed = manager().defer_stats().overflowed;
+  manager().set_defer_budget(0);
+  for (int i = 0; i < COUNT; i++)
+      manager().defer([i] { order.push_back(i); });
+  EXPECT(manager().defer_stats().overflowed == overflowed + COUNT - Events::DEFER_RING_SIZE);
+  EXPECT(manager().process_events() == false);
+  EXPECT(order.size() == (size_t) COUNT);
+  bool in_order = true;
+  for (int i = 0; i < COUNT; i++) in_order = in_order && order[i] == i;
+  EXPECT(in_order);
+  manager().set_defer_budget(Events::DEFER_BUDGET);
+}
+
+CASE("Budgets leave work pending for the next round")
+{
+  static int rx_calls = 0;
+  static int timer_calls = 0;
+  static uint8_t rx = 0;
+  rx = manager().subscribe(
+    [] {
+      // a busy source that always has more to do
+      rx_calls++;
+      manager().trigger_event(rx);
+    });
+  auto timer = manager().subscribe([] { timer_calls++; });
+  manager().set_budget(rx, 4);
+
+  manager().trigger_event(rx);
+  manager().trigger_event(timer);
+  EXPECT(manager().process_events() == true);
+  EXPECT(rx_calls == 4);
+  EXPECT(timer_calls == 1);
+  EXPECT(manager().process_events() == true);
+  EXPECT(rx_calls == 8);
+  manager().set_budget(rx, 0);
+  manager().unsubscribe(rx);
+  manager().unsubscribe(timer);
+  manager().process_events();
+
+  // deferred calls that defer themselves
+  static int again = 0;
+  static bool stop = false;
+  struct Repeat {
+    static void call() {
+      again++;
+      if (not stop) manager().defer(Repeat::call);
+    }
+  };
+  manager().set_defer_budget(16);
+  manager().defer(Repeat::call);
+  EXPECT(manager().process_events() == true);
+  EXPECT(again == 16);
+  EXPECT(manager().deferred_pending() == 1u);
+  manager().set_defer_budget(1);
+  EXPECT(manager().process_events() == true);
+  EXPECT(again == 17);
+  stop = true;
+  manager().set_defer_budget(Events::DEFER_BUDGET);
+  EXPECT(manager().process_events() == false);
+  EXPECT(again == 18);
+  EXPECT(manager().deferred_pending() == 0u);
+}
@@ -173,3 +173,66 @@ CASE("Store some data and restore it")
   EXPECT(stored.strvec1 == svec1);
   EXPECT(stored.strvec2 == svec2);
 }
+
+static int stable_stored = 0;
+static void store_stable(Storage& store, const buffer_t*)
+{
+  stable_stored++;
+  store.add_string(0, "Stable string");
+}
+
+CASE("Prepare stable partitions ahead of an update")
+{
+  Default_paging p{};
+  Nic_mock nic;
+  net::Inet netw{nic};
+  inet = &netw;
+
+  LiveUpdate::register_stable_partition("stable", store_stable);
+  EXPECT_THROWS_AS(LiveUpdate::prepare(buffer_t(16), storage_area), std::runtime_error);
+  EXPECT(not LiveUpdate::is_prepared(storage_area));
+
+  LiveUpdate::prepare(not_a_kernel, storage_area);
+  EXPECT(LiveUpdate::is_prepared(storage_area));
+  EXPECT(stable_stored == 1);
+  try {
+    LiveUpdate::exec(not_a_kernel, storage_area);
+  }
+  catch (const liu::liveupdate_exec_success& e) {
+    printf("LiveUpdate: %s\n", e.what());
+  }
+  LiveUpdate::restore_environment();
+  // the stable partition was not serialized again
+  EXPECT(stable_stored == 1);
+  EXPECT(not LiveUpdate::is_prepared(storage_area));
+
+  Statman::get().clear();
+  std::string stable;
+  EXPECT(LiveUpdate::partition_exists("stable", storage_area));
+  LiveUpdate::resume_from_heap(storage_area, "stable",
+    [&stable] (Restore& thing) {
+      stable = thing.as_string(); thing.go_next();
+    });
+  EXPECT(stable == "Stable string");
+  // the first resume picked up the timings of the update
+  const auto first = LiveUpdate::timings();
+  stored = {};
+  LiveUpdate::resume_from_heap(storage_area, "test", restore_something);
+  EXPECT(stored.integer == 1234);
+  EXPECT(stored.intvec2 == ivec2);
+  // the timings partition is consumed by the first resume
+  EXPECT(not LiveUpdate::partition_exists("__liu_timings", storage_area));
+  // and later ones only add to the time spent resuming
+  const auto& t = LiveUpdate::timings();
+  EXPECT(t.validate == first.validate);
+  EXPECT(t.serialize == first.serialize);
+  EXPECT(t.checksum == first.checksum);
+  EXPECT(t.boot == first.boot);
+  EXPECT(t.resume >= first.resume);
+
+  // registering a partition invalidates the staged state
+  LiveUpdate::prepare(not_a_kernel, storage_area);
+  EXPECT(LiveUpdate::is_prepared(storage_area));
+  LiveUpdate::register_partition("another", store_stable);
+  EXPECT(not LiveUpdate::is_prepared(storage_area));
+}
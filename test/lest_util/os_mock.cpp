@@ -198,6 +198,10 @@ uint32_t __arch_rand32()
 int SMP::cpu_id() noexcept {
   return 0;
 }
+const std::vector<int>& SMP::active_cpus() {
+  static const std::vector<int> cpus {0};
+  return cpus;
+}
 void SMP::global_lock() noexcept {}
 void SMP::global_unlock() noexcept {}
 void SMP::add_task(SMP::task_func func, int) { func(); }
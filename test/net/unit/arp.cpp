@@ -0,0 +1,112 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <net/inet>
+#include <net/interfaces>
+#include <net/ethernet/header.hpp>
+#include <hw/async_device.hpp>
+
+using namespace net;
+
+static const ip4::Addr server_addr {10,0,0,42};
+static const ip4::Addr client_addr {10,0,0,43};
+
+// RTC::time_since_boot() in seconds
+static uint64_t current_time = 100;
+extern delegate<uint64_t()> systime_override;
+
+static std::unique_ptr<hw::Async_device<UserNet>> dev1 = nullptr;
+static std::unique_ptr<hw::Async_device<UserNet>> dev2 = nullptr;
+// the ARP frames sent by the client
+static std::vector<MAC::Addr> arp_sent;
+
+static void setup_inet()
+{
+  systime_override = [] () -> uint64_t { return current_time; };
+  dev1 = std::make_unique<hw::Async_device<UserNet>>(UserNet::create(1500));
+  dev2 = std::make_unique<hw::Async_device<UserNet>>(UserNet::create(1500));
+  dev1->connect(*dev2);
+  dev2->set_transmit(
+    [] (net::Packet_ptr pckt) {
+      auto* eth = reinterpret_cast<const ethernet::Header*>(pckt->layer_begin());
+      if (eth->type() == Ethertype::ARP)
+        arp_sent.push_back(eth->dest());
+      dev1->receive(std::move(pckt));
+    });
+
+  auto& inet_server = net::Interfaces::get(0);
+  inet_server.network_config(server_addr, {255,255,255,0}, {10,0,0,1});
+  auto& inet_client = net::Interfaces::get(1);
+  inet_client.network_config(client_addr, {255,255,255,0}, {10,0,0,1});
+}
+
+static void process_events()
+{
+  for (int round = 0; round < 1000; round++)
+    Events::get().process_events();
+}
+
+CASE("A next-hop in use is probed with unicast and kept reachable")
+{
+  setup_inet();
+  auto& inet_server = net::Interfaces::get(0);
+  auto& inet_client = net::Interfaces::get(1);
+  auto& arp = inet_client.arp();
+  const auto server_mac = inet_server.link_addr();
+
+  int received = 0;
+  inet_server.udp().bind(4000).on_read(
+    [&received] (UDP::addr_t, UDP::port_t, const char*, size_t) { received++; });
+  auto& sock = inet_client.udp().bind();
+
+  // resolved with a broadcast request
+  sock.sendto(server_addr, 4000, "a", 1);
+  process_events();
+  EXPECT(received == 1);
+  EXPECT(arp_sent.size() == 1u);
+  EXPECT(arp_sent.back() == MAC::BROADCAST);
+  const auto* entry = arp.neighbours().find(server_addr);
+  EXPECT(entry != nullptr);
+  EXPECT(entry->state == Neighbour_state::REACHABLE);
+
+  // nothing to do until it is time to probe it
+  current_time += 10;
+  arp.flush_expired();
+  process_events();
+  EXPECT(arp_sent.size() == 1u);
+
+  // in use when the probes are due, so it is asked directly
+  current_time = 100 + arp.neighbours().reachable_time() - Arp::Cache::max_probes;
+  sock.sendto(server_addr, 4000, "b", 1);
+  arp.flush_expired();
+  EXPECT(arp.neighbours().find(server_addr)->state == Neighbour_state::PROBE);
+  process_events();
+  EXPECT(received == 2);
+  EXPECT(arp_sent.size() == 2u);
+  EXPECT(arp_sent.back() == server_mac);
+
+  // the reply confirmed it, also past the time it would have gone stale
+  EXPECT(arp.neighbours().find(server_addr)->state == Neighbour_state::REACHABLE);
+  current_time = 100 + arp.neighbours().reachable_time() + 1;
+  sock.sendto(server_addr, 4000, "c", 1);
+  arp.flush_expired();
+  process_events();
+  EXPECT(received == 3);
+  EXPECT(arp_sent.size() == 2u);
+  EXPECT(arp.neighbours().find(server_addr)->state == Neighbour_state::REACHABLE);
+  EXPECT(arp.neighbours().find(server_addr)->mac == server_mac);
+}
@@ -0,0 +1,173 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <net/neighbour_cache.hpp>
+#include <net/ip4/addr.hpp>
+#include <net/ip6/addr.hpp>
+#include <vector>
+
+using namespace net;
+using State = Neighbour_state;
+using Cache = Neighbour_cache<ip4::Addr>;
+
+static const MAC::Addr gw_mac {0xc0, 0x01, 0x4e, 0x00, 0x00, 0x01};
+static const MAC::Addr other_mac {0xc0, 0x01, 0x4e, 0x00, 0x00, 0x02};
+static const ip4::Addr gateway {10,0,0,1};
+static const ip4::Addr other {10,0,0,2};
+
+// stands in for the unicast requests of ARP and NDP
+struct Prober {
+  std::vector<std::pair<ip4::Addr, MAC::Addr>> sent;
+  void probe(ip4::Addr ip, MAC::Addr mac) { sent.emplace_back(ip, mac); }
+};
+
+CASE("A next-hop in use is refreshed before it goes stale")
+{
+  Cache cache;
+  Prober prober;
+  uint64_t now = 100;
+  cache.set(gateway, gw_mac, State::REACHABLE, now);
+
+  // traffic keeps flowing, and every probe is answered
+  for (int i = 0; i < 300; i++)
+  {
+    const auto* entry = cache.use(gateway);
+    EXPECT(entry != nullptr);
+    EXPECT(entry->mac == gw_mac);
+    EXPECT(entry->state != State::STALE);
+
+    const auto probes = prober.sent.size();
+    cache.age(++now, {prober, &Prober::probe});
+    if (prober.sent.size() > probes)
+      cache.set(gateway, gw_mac, State::REACHABLE, now);
+  }
+  // one probe each reachable time
+  EXPECT(prober.sent.size() == 300u / 27);
+  EXPECT(prober.sent.front().second == gw_mac);
+  EXPECT(cache.find(gateway)->state == State::REACHABLE);
+}
+
+CASE("A neighbour that stops answering is dropped, and resolved again")
+{
+  Cache cache;
+  Prober prober;
+  uint64_t now = 100;
+  cache.set(gateway, gw_mac, State::REACHABLE, now);
+
+  int used = 0;
+  while (cache.use(gateway) != nullptr and used < 100) {
+    used++;
+    cache.age(++now, {prober, &Prober::probe});
+  }
+  // still used while the probes were out
+  EXPECT(prober.sent.size() == (size_t) Cache::max_probes);
+  EXPECT(used == 30);
+  EXPECT(cache.empty());
+}
+
+CASE("Neighbours not in use go stale and are flushed")
+{
+  Cache cache;
+  Prober prober;
+  uint64_t now = 100;
+  cache.set_gc_time(60);
+  cache.set(gateway, gw_mac, State::REACHABLE, now);
+
+  now += Cache::reachable_time_default;
+  cache.age(now, {prober, &Prober::probe});
+  EXPECT(cache.find(gateway)->state == State::STALE);
+  EXPECT(prober.sent.empty());
+
+  // a stale entry is used, and probed when it is
+  EXPECT(cache.use(gateway) != nullptr);
+  cache.age(++now, {prober, &Prober::probe});
+  EXPECT(cache.find(gateway)->state == State::PROBE);
+  EXPECT(prober.sent.size() == 1u);
+  cache.set(gateway, gw_mac, State::REACHABLE, now);
+
+  // unsolicited news of the same address changes nothing,
+  // and of another address makes it stale
+  cache.set(gateway, gw_mac, State::STALE, now);
+  EXPECT(cache.find(gateway)->state == State::REACHABLE);
+  cache.set(gateway, other_mac, State::STALE, now);
+  EXPECT(cache.find(gateway)->state == State::STALE);
+  EXPECT(cache.find(gateway)->mac == other_mac);
+
+  now += 60;
+  cache.age(now, {prober, &Prober::probe});
+  EXPECT(cache.empty());
+}
+
+CASE("Aging tells when the next entry is due")
+{
+  Cache cache;
+  Prober prober;
+  uint64_t now = 100;
+  cache.set_gc_time(60);
+  EXPECT(cache.age(now, {prober, &Prober::probe}) == 0u);
+
+  // the probes of a reachable entry begin before it goes stale
+  const auto& entry = cache.set(gateway, gw_mac, State::REACHABLE, now);
+  const auto probe_at = now + Cache::reachable_time_default - Cache::max_probes;
+  EXPECT(cache.due(entry, now) == probe_at);
+  EXPECT(cache.age(now + 1, {prober, &Prober::probe}) == probe_at);
+
+  // not in use then, so it is next due when it goes stale
+  now = probe_at;
+  EXPECT(cache.age(now, {prober, &Prober::probe}) == 100 + Cache::reachable_time_default);
+  EXPECT(prober.sent.empty());
+  now = 100 + Cache::reachable_time_default;
+  // then dropped when it has not been used for the gc time
+  EXPECT(cache.age(now, {prober, &Prober::probe}) == 100 + 60u);
+  EXPECT(cache.find(gateway)->state == State::STALE);
+
+  // in use, it is probed every retrans_time
+  cache.use(gateway);
+  EXPECT(cache.age(++now, {prober, &Prober::probe}) == now + Cache::retrans_time);
+  EXPECT(prober.sent.size() == 1u);
+  EXPECT(cache.age(++now, {prober, &Prober::probe}) == now + Cache::retrans_time);
+  EXPECT(prober.sent.size() == 2u);
+
+  // the one due first decides
+  cache.set(other, other_mac, State::REACHABLE, now);
+  EXPECT(cache.age(now, {prober, &Prober::probe}) == now + Cache::retrans_time);
+}
+
+CASE("Neighbour cache keeps many entries in flat storage")
+{
+  Neighbour_cache<ip6::Addr> cache {4};
+  static const int N = 5000;
+  for (int i = 0; i < N; i++)
+    cache.set(ip6::Addr{0xfe80, 0, 0, 0, 0, 0, 0, (uint16_t) i},
+              gw_mac, i % 2 ? State::REACHABLE : State::STALE, 0);
+  EXPECT(cache.size() == (size_t) N);
+
+  for (int i = 0; i < N; i += 2)
+    EXPECT(cache.erase(ip6::Addr{0xfe80, 0, 0, 0, 0, 0, 0, (uint16_t) i}) == 1u);
+  EXPECT(cache.size() == (size_t) N / 2);
+
+  for (int i = 0; i < N; i++) {
+    const auto* entry = cache.find(ip6::Addr{0xfe80, 0, 0, 0, 0, 0, 0, (uint16_t) i});
+    EXPECT((entry != nullptr) == (i % 2 == 1));
+  }
+  // being resolved is not usable
+  cache.set({0xfe80, 0, 0, 0, 0, 0, 0, 0xffff}, MAC::EMPTY, State::INCOMPLETE, 0);
+  EXPECT(cache.use({0xfe80, 0, 0, 0, 0, 0, 0, 0xffff}) == nullptr);
+
+  cache.clear();
+  EXPECT(cache.empty());
+}
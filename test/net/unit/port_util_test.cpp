@@ -87,3 +87,29 @@ CASE("Simulating random connections")
     EXPECT(util.has_free_ephemeral() == false);
   }
 }
+
+CASE("Partitioned ephemeral ports do not overlap")
+{
+  using namespace net;
+  const int COUNT = 3;
+  Port_util utils[COUNT];
+  for (int i = 0; i < COUNT; i++)
+    utils[i].set_ephemeral_partition(i, COUNT);
+
+  for (int round = 0; round < 1000; round++)
+  for (int i = 0; i < COUNT; i++)
+  {
+    auto port = utils[i].get_next_ephemeral();
+    EXPECT(port_ranges::is_dynamic(port));
+    EXPECT(Port_util::ephemeral_partition(port, COUNT) == i);
+    utils[i].bind(port);
+  }
+
+  // a full partition throws, even if the rest is free
+  Port_util util;
+  util.set_ephemeral_partition(1, 4096);
+  for (int i = 0; i < Port_util::size() / 4096; i++)
+    util.bind(util.get_next_ephemeral());
+  EXPECT(util.has_free_ephemeral());
+  EXPECT_THROWS_AS(util.get_next_ephemeral(), Port_error);
+}
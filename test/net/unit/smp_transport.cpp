@@ -0,0 +1,57 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <net/smp_transport.hpp>
+
+using namespace net;
+
+CASE("Flows are steered consistently and spread over CPUs")
+{
+  const int CPUS = 4;
+  std::array<int, CPUS> flows {};
+  for (int i = 0; i < 4000; i++)
+  {
+    const ip4::Addr remote {10, 0, uint8_t(i >> 8), uint8_t(i)};
+    const uint16_t rport = 1024 + (i * 7) % 30000;
+    const int index = Smp_transport::flow_index(remote, rport, 80, CPUS);
+    EXPECT(index >= 0);
+    EXPECT(index < CPUS);
+    // the same flow always ends up on the same CPU
+    EXPECT(Smp_transport::flow_index(remote, rport, 80, CPUS) == index);
+    flows[index]++;
+  }
+  for (int count : flows) {
+    EXPECT(count > 800);
+    EXPECT(count < 1200);
+  }
+}
+
+CASE("Replies to outgoing connections go to the owner of the port")
+{
+  const int CPUS = 3;
+  for (int index = 0; index < CPUS; index++)
+  {
+    Port_util ports;
+    ports.set_ephemeral_partition(index, CPUS);
+    for (int i = 0; i < 100; i++)
+    {
+      const auto port = ports.get_next_ephemeral();
+      const ip4::Addr remote {192, 168, 0, uint8_t(i)};
+      EXPECT(Smp_transport::flow_index(remote, 443, port, CPUS) == index);
+    }
+  }
+}
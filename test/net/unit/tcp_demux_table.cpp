@@ -0,0 +1,164 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <net/tcp/demux_table.hpp>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+
+using namespace net;
+using namespace net::tcp;
+
+// Stands in for a Connection, which is found by its local and remote socket
+struct Flow {
+  Socket local_;
+  Socket remote_;
+  int    id;
+
+  Flow(Socket l, Socket r, int i)
+    : local_{l}, remote_{r}, id{i} {}
+
+  const Socket& local() const noexcept { return local_; }
+  const Socket& remote() const noexcept { return remote_; }
+};
+
+using Table = Demux_table<Flow>;
+
+// many clients, each with many ports, to one server port
+static Table::Tuple tuple(const int i)
+{
+  return {{ip4::Addr{10,0,0,1}, 80},
+          {ip4::Addr{10,1,(uint8_t) (i >> 16), (uint8_t) (i >> 8)}, (uint16_t) (1024 + (i & 0xff))}};
+}
+
+static std::shared_ptr<Flow> flow(const int i)
+{
+  const auto t = tuple(i);
+  return std::make_shared<Flow>(t.first, t.second, i);
+}
+
+CASE("Demux table finds, erases and iterates its entries")
+{
+  Table table {1234, 4};
+  EXPECT(table.empty());
+  EXPECT(table.find(tuple(1)) == nullptr);
+
+  static const int N = 1000;
+  for (int i = 0; i < N; i++)
+    EXPECT(table.insert(tuple(i), flow(i)).second);
+  EXPECT(table.size() == (size_t) N);
+  EXPECT(table.capacity() >= 2u * N);
+
+  // no duplicates, and the entry already there is returned
+  auto res = table.insert(tuple(7), flow(7));
+  EXPECT(not res.second);
+  EXPECT((*res.first)->id == 7);
+  EXPECT(table.size() == (size_t) N);
+
+  for (int i = 0; i < N; i++) {
+    auto* f = table.find(tuple(i));
+    EXPECT(f != nullptr);
+    EXPECT(f->id == i);
+  }
+
+  // erasing every other keeps the rest reachable
+  for (int i = 0; i < N; i += 2)
+    EXPECT(table.erase(tuple(i)) == 1u);
+  EXPECT(table.erase(tuple(0)) == 0u);
+  EXPECT(table.size() == (size_t) N / 2);
+  for (int i = 0; i < N; i++)
+    EXPECT((table.find(tuple(i)) != nullptr) == (i % 2 == 1));
+
+  // the owning pointer is handed out as well
+  auto* shared = table.find_shared(tuple(1));
+  EXPECT(shared != nullptr);
+  EXPECT(shared->use_count() == 1);
+
+  int count = 0;
+  long sum  = 0;
+  for (auto& f : table) {
+    count++;
+    sum += f->id;
+  }
+  EXPECT(count == N / 2);
+  EXPECT(sum == (long) (N / 2) * (N / 2));
+}
+
+CASE("Demux table keeps the entries it shifts back on erase")
+{
+  // a table too small to grow away from collisions
+  Table table {0, 64};
+  std::vector<int> ids;
+  for (int i = 0; ids.size() < 20; i++)
+    if ((table.hash(tuple(i)) & 63) < 4) ids.push_back(i);
+
+  for (int id : ids)
+    table.insert(tuple(id), flow(id));
+  for (size_t n = 0; n < ids.size(); n++)
+  {
+    table.erase(tuple(ids[n]));
+    for (size_t m = n + 1; m < ids.size(); m++)
+      EXPECT(table.find(tuple(ids[m])) != nullptr);
+  }
+  EXPECT(table.empty());
+}
+
+CASE("Demux rate with 500k established connections")
+{
+  using namespace std::chrono;
+  static const int CONNECTIONS = 500000;
+  static const int LOOKUPS     = 4000000;
+
+  Table table {0x5eed};
+  std::unordered_map<Table::Tuple, std::shared_ptr<Flow>> map;
+  std::vector<Table::Tuple> tuples;
+  tuples.reserve(CONNECTIONS);
+  for (int i = 0; i < CONNECTIONS; i++)
+  {
+    tuples.push_back(tuple(i));
+    auto f = flow(i);
+    table.insert(tuples.back(), f);
+    map.emplace(tuples.back(), f);
+  }
+  EXPECT(table.size() == (size_t) CONNECTIONS);
+
+  // segments arrive for connections in no particular order
+  std::vector<int> order(LOOKUPS);
+  uint32_t seed = 1;
+  for (auto& idx : order) {
+    seed = seed * 1103515245 + 12345;
+    idx = (seed >> 8) % CONNECTIONS;
+  }
+
+  long sum = 0;
+  auto t0 = high_resolution_clock::now();
+  for (int idx : order)
+    sum += table.find(tuples[idx])->id;
+  auto t1 = high_resolution_clock::now();
+  const double table_secs = duration_cast<nanoseconds>(t1 - t0).count() / 1e9;
+
+  long map_sum = 0;
+  t0 = high_resolution_clock::now();
+  for (int idx : order)
+    map_sum += map.find(tuples[idx])->second->id;
+  t1 = high_resolution_clock::now();
+  const double map_secs = duration_cast<nanoseconds>(t1 - t0).count() / 1e9;
+
+  EXPECT(sum == map_sum);
+  printf("Demux of %d segments over %d connections: %.1f M/sec (unordered_map: %.1f M/sec)\n",
+         LOOKUPS, CONNECTIONS, LOOKUPS / table_secs / 1e6, LOOKUPS / map_secs / 1e6);
+}
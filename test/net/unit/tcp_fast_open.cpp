@@ -0,0 +1,169 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <net/tcp/fast_open_cache.hpp>
+#include <net/tcp/syn_cookies.hpp>
+#include <net/inet>
+#include <net/interfaces>
+#include <hw/async_device.hpp>
+
+using namespace net;
+using namespace net::tcp;
+
+static const Socket server_sock {ip4::Addr{10,0,0,42}, 80};
+
+CASE("Fast Open cookies are bound to the client address")
+{
+  Syn_cookies cookies {0x0123456789abcdef, 0xfedcba9876543210};
+  const Address client {ip4::Addr{10,0,0,43}};
+
+  const auto cookie = cookies.fast_open(client, 100);
+  EXPECT(cookies.fast_open(client, 100) == cookie);
+  EXPECT(cookies.fast_open(Address{ip4::Addr{10,0,0,44}}, 100) != cookie);
+  EXPECT(cookies.check_fast_open(client, cookie, 100));
+  EXPECT(not cookies.check_fast_open(Address{ip4::Addr{10,0,0,44}}, cookie, 100));
+
+  // valid in the period it was made and the next one
+  EXPECT(cookies.check_fast_open(client, cookie, 101));
+  EXPECT(not cookies.check_fast_open(client, cookie, 102));
+  EXPECT(not cookies.check_fast_open(client, cookie, 99));
+
+  // another secret
+  Syn_cookies other {1, 2};
+  EXPECT(other.fast_open(client, 100) != cookie);
+  EXPECT(not other.check_fast_open(client, cookie, 100));
+}
+
+CASE("Fast Open cookie cache")
+{
+  Fast_open_cache cache {2};
+  const uint8_t cookie[8] {1, 2, 3, 4, 5, 6, 7, 8};
+  const Address server {server_sock.address()};
+  const Address other {ip4::Addr{10,0,0,44}};
+
+  EXPECT(cache.get(server) == nullptr);
+  EXPECT(not cache.usable(server));
+
+  EXPECT(cache.put(server, cookie, sizeof(cookie), 1460));
+  const auto* entry = cache.get(server);
+  EXPECT(entry != nullptr);
+  EXPECT(entry->length == sizeof(cookie));
+  EXPECT(entry->mss == 1460);
+  EXPECT(std::memcmp(entry->cookie.data(), cookie, sizeof(cookie)) == 0);
+  EXPECT(cache.usable(server));
+
+  // too large to go in a SYN with the other options
+  const uint8_t large[16] {};
+  EXPECT(not cache.put(other, large, sizeof(large), 1460));
+  EXPECT(cache.get(other) == nullptr);
+
+  // no more data in the SYN where it has been lost, even with a new cookie
+  cache.syn_lost(server);
+  EXPECT(not cache.usable(server));
+  cache.put(server, cookie, 4, 1460);
+  EXPECT(cache.get(server)->length == 4);
+  EXPECT(not cache.usable(server));
+
+  // an entry makes room for a new one when full
+  cache.put(other, cookie, sizeof(cookie), 1460);
+  cache.put(Address{ip4::Addr{10,0,0,45}}, cookie, sizeof(cookie), 1460);
+  EXPECT(cache.size() == 2u);
+
+  cache.set_limit(1);
+  EXPECT(cache.size() == 1u);
+  cache.clear();
+  EXPECT(cache.size() == 0u);
+}
+
+static std::unique_ptr<hw::Async_device<UserNet>> dev1 = nullptr;
+static std::unique_ptr<hw::Async_device<UserNet>> dev2 = nullptr;
+
+static void setup_inet()
+{
+  dev1 = std::make_unique<hw::Async_device<UserNet>>(UserNet::create(1500));
+  dev2 = std::make_unique<hw::Async_device<UserNet>>(UserNet::create(1500));
+  dev1->connect(*dev2);
+  dev2->connect(*dev1);
+
+  auto& inet_server = net::Interfaces::get(0);
+  inet_server.network_config({10,0,0,42}, {255,255,255,0}, {10,0,0,1});
+  auto& inet_client = net::Interfaces::get(1);
+  inet_client.network_config({10,0,0,43}, {255,255,255,0}, {10,0,0,1});
+}
+
+CASE("A repeat client has its request in the SYN")
+{
+  setup_inet();
+  auto& server = net::Interfaces::get(0).tcp();
+  auto& client = net::Interfaces::get(1).tcp();
+  server.set_fast_open(true);
+  client.set_fast_open(true);
+
+  static const std::string request {"GET / HTTP/1.1\r\n\r\n"};
+  static const std::string reply   {"HTTP/1.1 200 OK\r\n\r\n"};
+  int requests = 0;
+  int early    = 0;
+  server.listen(80,
+    [&requests, &early] (Connection_ptr conn) {
+      if (not conn) return;
+      // handed over before the handshake is complete
+      if (not conn->is_connected()) early++;
+      conn->on_read(1024, [&requests, conn] (buffer_t buf) {
+        if (std::string((const char*) buf->data(), buf->size()) == request)
+          requests++;
+        conn->write(reply);
+      });
+    });
+
+  std::string replies;
+  auto connect = [&client, &replies] {
+    client.connect(server_sock,
+      tcp::construct_buffer(request.begin(), request.end()),
+      [&replies] (Connection_ptr conn) {
+        if (conn == nullptr) return;
+        conn->on_read(1024, [&replies] (buffer_t buf) {
+          replies.append((const char*) buf->data(), buf->size());
+        });
+      });
+  };
+
+  // the first connection gets a cookie, and sends after the handshake
+  connect();
+  for (int round = 0; requests < 1 and round < 100000; round++)
+    Events::get().process_events();
+  EXPECT(requests == 1);
+  EXPECT(early == 0);
+  // for the server, whatever the port
+  EXPECT(client.fast_open_cache().usable(server_sock.address()));
+
+  // the next one has the data in the SYN
+  connect();
+  for (int round = 0; replies.size() < 2 * reply.size() and round < 100000; round++)
+    Events::get().process_events();
+  EXPECT(requests == 2);
+  EXPECT(early == 1);
+  EXPECT(replies == reply + reply);
+
+  // with no room for more pending, the data goes after the handshake
+  server.set_max_fast_open_pending(0);
+  connect();
+  for (int round = 0; replies.size() < 3 * reply.size() and round < 100000; round++)
+    Events::get().process_events();
+  EXPECT(requests == 3);
+  EXPECT(early == 1);
+  EXPECT(replies == reply + reply + reply);
+}
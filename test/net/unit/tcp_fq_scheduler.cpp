@@ -0,0 +1,214 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <net/tcp/fq_scheduler.hpp>
+#include <net/inet>
+#include <net/interfaces>
+#include <hw/async_device.hpp>
+#include <kernel/timers.hpp>
+#include <statman>
+#include <vector>
+
+using namespace net::tcp;
+
+// Stands in for a Connection with packets to send
+struct Flow {
+  int    id;
+  size_t backlog;
+  size_t sent = 0;
+
+  Flow(int i, size_t b) : id{i}, backlog{b} {}
+};
+
+using Scheduler = Fq_scheduler<Flow>;
+
+// serve @packets the way TCP::process_writeq does
+static void serve(Scheduler& fq, size_t packets, const size_t quantum, const uint64_t now,
+                  std::vector<uint64_t>* delays = nullptr)
+{
+  fq.release(now);
+  while (packets and not fq.empty())
+  {
+    auto entry = fq.dequeue();
+    if (delays) delays->push_back(now - entry.since);
+    const auto n = std::min({packets, quantum, entry.flow->backlog});
+    entry.flow->backlog -= n;
+    entry.flow->sent    += n;
+    packets -= n;
+    if (entry.flow->backlog > 0)
+      fq.enqueue(std::move(entry.flow), false, now);
+  }
+}
+
+// Jain's fairness index, 1 when every flow got the same
+static double fairness(const std::vector<std::shared_ptr<Flow>>& flows)
+{
+  double sum = 0, sum_sq = 0;
+  for (auto& f : flows) {
+    sum    += f->sent;
+    sum_sq += (double) f->sent * f->sent;
+  }
+  return (sum * sum) / (flows.size() * sum_sq);
+}
+
+CASE("Bulk flows share the packets evenly")
+{
+  Scheduler fq;
+  std::vector<std::shared_ptr<Flow>> flows;
+  // one flow queued with far more than the rest
+  flows.push_back(std::make_shared<Flow>(0, 100000));
+  for (int i = 1; i < 8; i++)
+    flows.push_back(std::make_shared<Flow>(i, 1000));
+  for (auto& f : flows)
+    fq.enqueue(f, false, 0);
+  EXPECT(fq.size() == 8u);
+
+  for (uint64_t t = 1; t <= 100; t++)
+    serve(fq, 32, 2, t);
+  for (auto& f : flows)
+    EXPECT(f->sent == 400u);
+  EXPECT(fairness(flows) > 0.99);
+}
+
+CASE("A sparse flow goes ahead of the bulk flows")
+{
+  Scheduler fq;
+  std::vector<std::shared_ptr<Flow>> bulk;
+  for (int i = 0; i < 100; i++) {
+    bulk.push_back(std::make_shared<Flow>(i, 1000000));
+    fq.enqueue(bulk.back(), false, 0);
+  }
+  serve(fq, 64, 2, 1);
+
+  // with 100 bulk flows ahead, it is served first
+  auto interactive = std::make_shared<Flow>(100, 1);
+  fq.enqueue(interactive, true, 2);
+  serve(fq, 1, 2, 2);
+  EXPECT(interactive->sent == 1u);
+  EXPECT(fq.size() == 100u);
+}
+
+CASE("Paced flows are held back until their time")
+{
+  Scheduler fq;
+  auto a = std::make_shared<Flow>(1, 10);
+  auto b = std::make_shared<Flow>(2, 10);
+  auto c = std::make_shared<Flow>(3, 10);
+  EXPECT(fq.next_release() == 0u);
+  fq.throttle(c, 300);
+  fq.throttle(a, 100);
+  fq.throttle(b, 200);
+  EXPECT(fq.throttled() == 3u);
+  EXPECT(fq.empty());
+  EXPECT(fq.next_release() == 100u);
+
+  EXPECT(fq.release(99) == 100u);
+  EXPECT(fq.empty());
+  EXPECT(fq.release(250) == 300u);
+  EXPECT(fq.size() == 2u);
+  EXPECT(fq.dequeue().flow == a);
+  EXPECT(fq.dequeue().flow == b);
+  EXPECT(fq.release(300) == 0u);
+  auto entry = fq.dequeue();
+  EXPECT(entry.flow == c);
+  EXPECT(entry.since == 300u);
+  EXPECT(not entry.sparse);
+}
+
+static uint64_t current_time = 0;
+extern delegate<uint64_t()> systime_override;
+
+static std::unique_ptr<hw::Async_device<UserNet>> dev1 = nullptr;
+static std::unique_ptr<hw::Async_device<UserNet>> dev2 = nullptr;
+
+static void setup_inet()
+{
+  systime_override = [] () -> uint64_t { return current_time; };
+  Timers::init(
+    [] (Timers::duration_t) {},
+    [] () {}
+  );
+  dev1 = std::make_unique<hw::Async_device<UserNet>>(UserNet::create(1500));
+  dev2 = std::make_unique<hw::Async_device<UserNet>>(UserNet::create(1500));
+  dev1->connect(*dev2);
+  dev2->connect(*dev1);
+
+  auto& inet_server = net::Interfaces::get(0);
+  inet_server.network_config({10,0,0,42}, {255,255,255,0}, {10,0,0,1});
+  auto& inet_client = net::Interfaces::get(1);
+  inet_client.network_config({10,0,0,43}, {255,255,255,0}, {10,0,0,1});
+}
+
+static void process_events()
+{
+  for (int round = 0; round < 1000; round++)
+    Events::get().process_events();
+}
+
+CASE("TCP holds a paced connection back and lets the timer release it")
+{
+  using namespace std::chrono;
+  static const size_t TOTAL = 100 * 1000;
+  static const uint64_t RATE = 1000 * 1000; // bytes per second
+  setup_inet();
+  auto& inet_server = net::Interfaces::get(0);
+  auto& inet_client = net::Interfaces::get(1);
+  EXPECT(inet_client.tcp().uses_pacing());
+
+  size_t received = 0;
+  inet_server.tcp().listen(80,
+    [&received] (net::tcp::Connection_ptr conn) {
+      conn->on_read(64 * 1024, [&received] (net::tcp::buffer_t buf) {
+        received += buf->size();
+      });
+    });
+  net::tcp::Connection_ptr client;
+  inet_client.tcp().connect({net::ip4::Addr{10,0,0,42}, 80},
+    [&client] (net::tcp::Connection_ptr conn) { client = conn; });
+  process_events();
+  EXPECT(client != nullptr);
+  client->set_max_pacing_rate(RATE);
+  EXPECT(client->pacing_rate() == RATE);
+
+  // with the clock standing still, only the slack goes out
+  client->write(net::tcp::construct_buffer(TOTAL));
+  process_events();
+  const auto prefix = inet_client.ifname() + ".tcp.";
+  auto& throttled = Statman::get().get_by_name((prefix + "fq_throttled").c_str());
+  EXPECT(throttled.value() > 0u);
+  const auto sent = TOTAL - client->sendq_remaining();
+  EXPECT(sent > 0u);
+  EXPECT(sent < TOTAL / 10);
+
+  // the pacing timer lets it through at the rate
+  const uint64_t start = current_time;
+  while (received < TOTAL and current_time - start < 1000000000ull)
+  {
+    current_time += 100 * 1000;
+    Timers::timers_handler();
+    process_events();
+  }
+  EXPECT(received == TOTAL);
+  const auto elapsed_us = (current_time - start) / 1000;
+  const auto expected_us = TOTAL * 1000000ull / RATE;
+  EXPECT(elapsed_us > expected_us * 9 / 10);
+  EXPECT(elapsed_us < expected_us * 12 / 10);
+
+  // the queueing delays are measured forwards in time
+  auto& delay = Statman::get().get_by_name((prefix + "fq_delay_us").c_str());
+  EXPECT(delay.get_histogram().max() <= elapsed_us);
+}
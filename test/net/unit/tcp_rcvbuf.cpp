@@ -0,0 +1,128 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <net/tcp/rcvbuf_tuner.hpp>
+#include <net/tcp/read_request.hpp>
+#include <net/tcp/write_queue.hpp>
+
+using namespace net;
+using namespace net::tcp;
+
+CASE("Receive buffer grows with the drain rate and shrinks when idle")
+{
+  const size_t MIN = 4096;
+  const size_t MAX = 65536;
+  const uint64_t RTT = 10000;
+  Rcvbuf_tuner tuner {MIN, MAX};
+  EXPECT(tuner.space() == MIN);
+  EXPECT(not tuner.grown());
+
+  uint64_t now = 1000000;
+  tuner.rtt_sample(RTT, now);
+  EXPECT(tuner.rtt() == RTT);
+
+  // a trickle does not need more than the minimum
+  for (int i = 0; i < 10; i++) {
+    now += RTT;
+    EXPECT(not tuner.on_drain(1000, now));
+  }
+  EXPECT(tuner.space() == MIN);
+
+  // 8000 bytes per round trip wants twice that
+  now += RTT;
+  tuner.on_drain(0, now);
+  for (int i = 0; i < 8; i++) {
+    now += RTT / 8;
+    tuner.on_drain(1000, now);
+  }
+  EXPECT(tuner.space() == 16384u);
+  EXPECT(tuner.grown());
+
+  // and never above the maximum
+  for (int i = 0; i < 4; i++) {
+    now += RTT;
+    tuner.on_drain(1000000, now);
+  }
+  EXPECT(tuner.space() == MAX);
+
+  // samples while the sender has been quiet are left out
+  now += 100 * RTT;
+  tuner.rtt_sample(100 * RTT, now);
+  EXPECT(tuner.rtt() == RTT);
+
+  EXPECT(tuner.idle(now, 50 * RTT));
+  tuner.shrink(now);
+  EXPECT(tuner.space() == MIN);
+  EXPECT(not tuner.grown());
+}
+
+CASE("Read request gives its memory back when empty")
+{
+  const size_t BUFSZ = 4096;
+  const seq_t SEQ = 1000;
+  uint8_t data[1460] {};
+  size_t delivered = 0;
+
+  Read_request req {SEQ, BUFSZ, BUFSZ};
+  req.on_read_callback = [&delivered] (buffer_t buf) { delivered += buf->size(); };
+  EXPECT(req.window(SEQ) == BUFSZ * Read_request::buffer_limit);
+
+  req.release();
+  const auto idle = req.memory_usage();
+  EXPECT(req.front().memory_usage() == 0u);
+
+  // taken again on data, and given back once delivered
+  EXPECT(req.insert(SEQ, data, 100) == 100u);
+  EXPECT(req.memory_usage() > idle);
+  EXPECT(req.window(SEQ + 100) == BUFSZ * Read_request::buffer_limit - 100);
+  EXPECT(req.insert(SEQ + 100, data, 100, true) == 100u);
+  EXPECT(delivered == 200u);
+  req.release();
+  EXPECT(req.memory_usage() == idle);
+
+  // the buffers to come are of the tuned size
+  req.set_bufsize(4 * BUFSZ);
+  seq_t seq = SEQ + 200;
+  while (delivered < 200 + BUFSZ)
+    seq += req.insert(seq, data, sizeof(data));
+  EXPECT(req.front().capacity() == 4 * BUFSZ);
+  EXPECT(req.window(seq) == req.front().capacity() - req.front().size() + 4 * BUFSZ);
+}
+
+CASE("Write queue releases acknowledged buffers")
+{
+  Write_queue wq;
+  const auto empty = wq.memory_usage();
+
+  for (int i = 0; i < 100; i++)
+    wq.push_back(tcp::construct_buffer(1000));
+  EXPECT(wq.memory_usage() >= 100 * 1000u);
+
+  for (int i = 0; i < 100; i++)
+    wq.advance(1000);
+  // the front is released as it is acknowledged
+  wq.acknowledge(50 * 1000);
+  EXPECT(wq.size() == 50u);
+  EXPECT(wq.bytes_unacknowledged() == 50 * 1000u);
+  EXPECT(wq.memory_usage() < 60 * 1000u);
+  EXPECT(wq.data_at(0).second == 1000u);
+
+  wq.acknowledge(50 * 1000);
+  EXPECT(wq.empty());
+  wq.reset();
+  EXPECT(wq.memory_usage() == empty);
+}
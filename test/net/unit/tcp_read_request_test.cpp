@@ -85,3 +85,48 @@ CASE("Operating with out of order data")
 
   EXPECT(seq == (uint32_t)(SEQ_START + SEGSZ*5));
 }
+
+CASE("Data without PUSH is handed over when the request is reset at FIN")
+{
+  using namespace net::tcp;
+  const size_t BUFSZ = 4096;
+  uint8_t data[100] {};
+  size_t received = 0;
+
+  Read_request req {0, BUFSZ, BUFSZ};
+  req.on_read_callback = [&received] (auto buf) { received += buf->size(); };
+  EXPECT(req.insert(0, data, sizeof(data)) == sizeof(data));
+  EXPECT(received == 0u);
+  EXPECT(req.size() == sizeof(data));
+
+  // the FIN follows the data
+  req.reset(sizeof(data) + 1);
+  EXPECT(received == sizeof(data));
+  EXPECT(req.size() == 0u);
+}
+
+CASE("Out of order data may run on from one buffer into the next")
+{
+  using namespace net::tcp;
+  const size_t BUFSZ = 4096;
+  const size_t SEGSZ = 1448;
+  uint8_t data[SEGSZ] {};
+  size_t received = 0;
+
+  Read_request req {0, BUFSZ, BUFSZ};
+  req.on_read_callback = [&received] (auto buf) { received += buf->size(); };
+
+  // the second buffer is counted before it is created
+  EXPECT(req.window(0) == BUFSZ * Read_request::buffer_limit);
+  // the third segment crosses into it
+  const seq_t seq = 2 * SEGSZ;
+  EXPECT(req.fits(seq) < SEGSZ);
+  EXPECT(req.window(seq) == BUFSZ * Read_request::buffer_limit - seq);
+  EXPECT(req.insert(seq, data, SEGSZ) == SEGSZ);
+  // past the end of what the buffers can take there is no room
+  EXPECT(req.window(BUFSZ * Read_request::buffer_limit) == 0u);
+
+  // filling the hole hands over the first buffer
+  EXPECT(req.insert(0, data, 2 * SEGSZ, true) == 2 * SEGSZ);
+  EXPECT(received == BUFSZ);
+}
@@ -0,0 +1,246 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <net/tcp/rack.hpp>
+#include <net/inet>
+#include <net/interfaces>
+#include <hw/async_device.hpp>
+#include <kernel/timers.hpp>
+#include <statman>
+#include <chrono>
+
+using namespace net;
+using namespace net::tcp;
+
+CASE("Sender scoreboard merges repeated SACK blocks and tells what is lost")
+{
+  using Sack_scoreboard = sack::Scoreboard<sack::Scoreboard_list<32>>;
+  const uint32_t smss = 1000;
+  const seq_t una = 1000;
+  Sack_scoreboard scoreboard;
+
+  // the receiver reports the same block growing
+  scoreboard.recv_sack(una, 2000, 3000);
+  scoreboard.recv_sack(una, 2000, 4000);
+  scoreboard.recv_sack(una, 2500, 4000);
+  EXPECT(scoreboard.size() == 1u);
+  EXPECT(scoreboard.sacked_bytes() == 2000u);
+  // 2 * SMSS is not more than (DupThresh - 1) * SMSS
+  EXPECT(not scoreboard.is_lost(una, smss));
+
+  scoreboard.recv_sack(una, 4000, 4500);
+  EXPECT(scoreboard.size() == 1u);
+  EXPECT(scoreboard.is_lost(una, smss));
+  EXPECT(not scoreboard.is_lost(3000, smss));
+
+  // three discontiguous blocks above
+  scoreboard.clear();
+  scoreboard.recv_sack(una, 2000, 2100);
+  scoreboard.recv_sack(una, 3000, 3100);
+  EXPECT(not scoreboard.is_lost(una, smss));
+  scoreboard.recv_sack(una, 4000, 4100);
+  EXPECT(scoreboard.is_lost(una, smss));
+  EXPECT(not scoreboard.is_lost(2100, smss));
+
+  // across sequence number wrap
+  scoreboard.clear();
+  const seq_t wrap = 0xfffffc00;
+  scoreboard.recv_sack(wrap, 0xfffffe00, 0x200);
+  scoreboard.recv_sack(wrap, 0x100, 0x400);
+  EXPECT(scoreboard.size() == 1u);
+  EXPECT(scoreboard.sacked_bytes() == 0x600u);
+  scoreboard.new_valid_ack(0x400);
+  EXPECT(scoreboard.size() == 0u);
+}
+
+CASE("RACK marks segments lost by when they were sent")
+{
+  Rack rack;
+  const uint32_t mss = 1000;
+  // five segments, 20 us apart
+  for (seq_t i = 0; i < 5; i++)
+    rack.on_transmit(i * mss, (i + 1) * mss, 1000 + i * 20);
+  EXPECT(rack.size() == 5u);
+  EXPECT(rack.pipe() == 5 * mss);
+  EXPECT(rack.detect_loss(2000, false) == 0u);
+
+  // the first is acked after 100 us, and the last is SACKed
+  rack.on_ack(mss, 1100);
+  rack.on_sack({4 * mss, 5 * mss}, 1180);
+  EXPECT(rack.rtt() == 100u);
+  EXPECT(rack.min_rtt() == 100u);
+  EXPECT(rack.pipe() == 3 * mss);
+
+  // the second and third were sent long enough before the last,
+  // the reordering window (min RTT / 4) has not passed for the fourth
+  EXPECT(rack.detect_loss(1180, false) == 5u);
+  EXPECT(rack.next_lost() != nullptr);
+  EXPECT(rack.next_lost()->start == mss);
+  EXPECT(rack.pipe() == mss);
+  EXPECT(rack.detect_loss(1185, false) == 0u);
+  EXPECT(rack.pipe() == 0u);
+
+  // retransmitting takes it out of the lost ones, back into the pipe
+  rack.on_transmit(mss, 2 * mss, 1200);
+  EXPECT(rack.next_lost()->start == 2 * mss);
+  EXPECT(rack.pipe() == mss);
+
+  // a timeout takes everything not SACKed as lost
+  rack.mark_all_lost();
+  EXPECT(rack.pipe() == 0u);
+  // those never retransmitted were only late after all
+  rack.on_ack(5 * mss, 1300);
+  EXPECT(rack.empty());
+  EXPECT(rack.reordering_seen());
+}
+
+CASE("RACK keeps the rest of a partly retransmitted segment lost")
+{
+  Rack rack;
+  rack.on_transmit(0, 1500, 1000);
+  rack.on_transmit(1500, 3000, 1010);
+  rack.mark_all_lost();
+
+  // the SMSS went down, only the first 1000 bytes go out again
+  rack.on_transmit(0, 1000, 1100);
+  EXPECT(rack.size() == 3u);
+  EXPECT(rack.pipe() == 1000u);
+  EXPECT(rack.next_lost() != nullptr);
+  EXPECT(rack.next_lost()->start == 1000u);
+  EXPECT(rack.next_lost()->end == 1500u);
+
+  rack.on_transmit(1000, 1500, 1110);
+  EXPECT(rack.next_lost()->start == 1500u);
+  EXPECT(rack.pipe() == 1500u);
+}
+
+extern delegate<uint64_t()> systime_override;
+
+static std::unique_ptr<hw::Async_device<UserNet>> dev1 = nullptr;
+static std::unique_ptr<hw::Async_device<UserNet>> dev2 = nullptr;
+
+// Loss injection: every data frame from the client is dropped with
+// probability loss_rate, and a burst of frames is dropped once
+// burst_after data frames have gone through, when the window is open
+static double   loss_rate   = 0.0;
+static int      loss_burst  = 0;
+static int      burst_after = 0;
+static uint32_t loss_seed   = 1;
+static int      dropped     = 0;
+
+static bool should_drop(const net::Packet& pckt)
+{
+  // leave the handshake and the pure ACKs alone
+  if (pckt.size() < 1000) return false;
+  if (loss_burst > 0 and burst_after-- <= 0) {
+    loss_burst--;
+    return true;
+  }
+  loss_seed = loss_seed * 1103515245 + 12345;
+  return (loss_seed >> 16) % 10000 < loss_rate * 10000;
+}
+
+static void setup_inet()
+{
+  // the timers, RACK and the RTO all run on a real clock
+  systime_override = [] () -> uint64_t {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+  };
+  Timers::init(
+    [] (Timers::duration_t) {},
+    [] () {}
+  );
+  dev1 = std::make_unique<hw::Async_device<UserNet>>(UserNet::create(1500));
+  dev2 = std::make_unique<hw::Async_device<UserNet>>(UserNet::create(1500));
+  dev1->connect(*dev2);
+  dev2->set_transmit(
+    [] (net::Packet_ptr pckt) {
+      if (should_drop(*pckt)) {
+        dropped++;
+        return;
+      }
+      dev1->receive(std::move(pckt));
+    });
+
+  auto& inet_server = net::Interfaces::get(0);
+  inet_server.network_config({10,0,0,42}, {255,255,255,0}, {10,0,0,1});
+  auto& inet_client = net::Interfaces::get(1);
+  inet_client.network_config({10,0,0,43}, {255,255,255,0}, {10,0,0,1});
+}
+
+static double transfer(lest::env& lest_env, const uint16_t port, const size_t total)
+{
+  using namespace std::chrono;
+  auto& inet_server = net::Interfaces::get(0);
+  auto& inet_client = net::Interfaces::get(1);
+  static size_t received;
+  static bool   intact;
+  received = 0;
+  intact   = true;
+
+  inet_server.tcp().listen(port,
+    [] (Connection_ptr conn) {
+      conn->on_read(64 * 1024, [] (buffer_t buf) {
+        for (size_t i = 0; i < buf->size(); i++)
+          intact = intact and buf->at(i) == (uint8_t) (received + i);
+        received += buf->size();
+      });
+    });
+
+  auto buf = tcp::construct_buffer(total);
+  for (size_t i = 0; i < total; i++)
+    buf->at(i) = (uint8_t) i;
+
+  const auto t0 = steady_clock::now();
+  inet_client.tcp().connect({ip4::Addr{10,0,0,42}, port},
+    [buf] (Connection_ptr conn) {
+      if (conn) conn->write(buf);
+    });
+  while (received < total and steady_clock::now() - t0 < seconds{30})
+  {
+    Events::get().process_events();
+    Timers::timers_handler();
+  }
+  const auto t1 = steady_clock::now();
+  EXPECT(received == total);
+  EXPECT(intact);
+  return duration_cast<nanoseconds>(t1 - t0).count() / 1e9;
+}
+
+CASE("TCP recovers from multiple losses per window")
+{
+  static const size_t TOTAL = 4 * 1024 * 1024;
+  setup_inet();
+  const auto stat = net::Interfaces::get(1).ifname() + ".tcp.rto_timeouts";
+  auto& rto_timeouts = Statman::get().get_by_name(stat.c_str());
+
+  const double clean = transfer(lest_env, 80, TOTAL);
+  EXPECT(dropped == 0);
+
+  // random losses, and a burst in the middle of a full window
+  loss_rate   = 0.02;
+  loss_burst  = 3;
+  burst_after = 200;
+  const double lossy = transfer(lest_env, 81, TOTAL);
+  EXPECT(dropped > 3);
+  // every loss was found from the SACKs, or by RACK, not by the RTO
+  EXPECT(rto_timeouts.value() == 0u);
+
+  printf("TCP over a lossy link: %d of the frames dropped, %.1f Mbps (%.1f Mbps without loss)\n",
+         dropped, TOTAL * 8 / lossy / 1e6, TOTAL * 8 / clean / 1e6);
+}
@@ -0,0 +1,154 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <net/tcp/syn_cookies.hpp>
+#include <net/inet>
+#include <net/interfaces>
+#include <hw/async_device.hpp>
+#include <statman>
+#include <chrono>
+
+using namespace net;
+using namespace net::tcp;
+
+static const Socket local  {ip4::Addr{10,0,0,42}, 80};
+static const Socket remote {ip4::Addr{10,0,0,43}, 40000};
+
+CASE("SYN cookies carry the options of the SYN")
+{
+  Syn_cookies cookies {0x0123456789abcdef, 0xfedcba9876543210};
+  Syn_cookies::Params params;
+  params.mss    = 1460;
+  params.wscale = 7;
+  params.sack   = true;
+
+  const seq_t irs = 1000;
+  const auto cookie = cookies.make(local, remote, irs, params, 100);
+  auto res = cookies.check(local, remote, irs, cookie, 100);
+  EXPECT(res.has_value());
+  EXPECT(res->mss == 1460);
+  EXPECT(res->wscale == 7);
+  EXPECT(res->sack == true);
+
+  // the MSS is rounded down to the table
+  params.mss    = 1459;
+  params.wscale = Syn_cookies::NO_WSCALE;
+  params.sack   = false;
+  res = cookies.check(local, remote, irs,
+                      cookies.make(local, remote, irs, params, 100), 100);
+  EXPECT(res.has_value());
+  EXPECT(res->mss == 1440);
+  EXPECT(res->wscale == Syn_cookies::NO_WSCALE);
+  EXPECT(res->sack == false);
+
+  EXPECT(Syn_cookies::mss_index(100) == 0);
+  EXPECT(Syn_cookies::mss_index(65535) == (int) Syn_cookies::mss_table.size() - 1);
+}
+
+CASE("SYN cookies are bound to the flow, the SYN and the time")
+{
+  Syn_cookies cookies {1, 2};
+  const seq_t irs = 0xfffffff0;
+  const auto cookie = cookies.make(local, remote, irs, {}, 7);
+
+  // valid in the slot it was made and the next one
+  EXPECT(cookies.check(local, remote, irs, cookie, 7).has_value());
+  EXPECT(cookies.check(local, remote, irs, cookie, 8).has_value());
+  EXPECT(not cookies.check(local, remote, irs, cookie, 9).has_value());
+  EXPECT(not cookies.check(local, remote, irs, cookie, 6).has_value());
+
+  EXPECT(not cookies.check(local, remote, irs + 1, cookie, 7).has_value());
+  EXPECT(not cookies.check(local, {ip4::Addr{10,0,0,43}, 40001}, irs, cookie, 7).has_value());
+  EXPECT(not cookies.check({ip4::Addr{10,0,0,44}, 80}, remote, irs, cookie, 7).has_value());
+  EXPECT(not cookies.check(local, remote, irs, cookie ^ 1, 7).has_value());
+  // changing the options breaks the MAC
+  EXPECT(not cookies.check(local, remote, irs, cookie ^ (1u << 27), 7).has_value());
+
+  // another secret
+  Syn_cookies other {3, 4};
+  EXPECT(not other.check(local, remote, irs, cookie, 7).has_value());
+}
+
+static std::unique_ptr<hw::Async_device<UserNet>> dev1 = nullptr;
+static std::unique_ptr<hw::Async_device<UserNet>> dev2 = nullptr;
+
+static void setup_inet()
+{
+  dev1 = std::make_unique<hw::Async_device<UserNet>>(UserNet::create(1500));
+  dev2 = std::make_unique<hw::Async_device<UserNet>>(UserNet::create(1500));
+  dev1->connect(*dev2);
+  dev2->connect(*dev1);
+
+  auto& inet_server = net::Interfaces::get(0);
+  inet_server.network_config({10,0,0,42}, {255,255,255,0}, {10,0,0,1});
+  auto& inet_client = net::Interfaces::get(1);
+  inet_client.network_config({10,0,0,43}, {255,255,255,0}, {10,0,0,1});
+}
+
+CASE("TCP connection storm through a small SYN backlog")
+{
+  using namespace std::chrono;
+  static const int CONNECTIONS = 200;
+  setup_inet();
+  auto& inet_server = net::Interfaces::get(0);
+  auto& inet_client = net::Interfaces::get(1);
+
+  // most of the handshakes overflow the backlog and are answered with cookies
+  inet_server.tcp().set_max_syn_backlog(8);
+  int accepted  = 0;
+  int connected = 0;
+  inet_server.tcp().listen(80,
+    [&accepted] (Connection_ptr conn) {
+      if (conn) accepted++;
+    });
+
+  // one connection first, so the storm isn't queued behind ARP
+  inet_client.tcp().connect({ip4::Addr{10,0,0,42}, 80},
+    [&connected] (Connection_ptr conn) {
+      if (conn) connected++;
+    });
+  for (int round = 0; accepted < 1 and round < 100000; round++)
+  {
+    Events::get().process_events();
+  }
+  EXPECT(accepted == 1);
+  accepted  = 0;
+  connected = 0;
+
+  const auto t0 = high_resolution_clock::now();
+  for (int i = 0; i < CONNECTIONS; i++)
+  {
+    inet_client.tcp().connect({ip4::Addr{10,0,0,42}, 80},
+      [&connected] (Connection_ptr conn) {
+        if (conn) connected++;
+      });
+  }
+  for (int round = 0; accepted < CONNECTIONS and round < 1000000; round++)
+  {
+    Events::get().process_events();
+  }
+  const auto t1 = high_resolution_clock::now();
+  const double secs = duration_cast<nanoseconds>(t1 - t0).count() / 1e9;
+  printf("TCP connection storm: %d connections accepted in %.3f sec - %.0f conn/sec\n",
+         accepted, secs, accepted / secs);
+
+  EXPECT(accepted == CONNECTIONS);
+  EXPECT(connected == CONNECTIONS);
+  const auto ifname = inet_server.ifname();
+  EXPECT(Statman::get().get_by_name((ifname + ".tcp.syn_cookies_sent").c_str()).value() > 0u);
+  EXPECT(Statman::get().get_by_name((ifname + ".tcp.syn_cookies_accepted").c_str()).value() > 0u);
+}
@@ -0,0 +1,96 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <net/tcp/time_wait.hpp>
+#include <vector>
+
+using namespace net;
+using namespace net::tcp;
+
+static Time_wait_table::Tuple flow(uint16_t port)
+{
+  return {{ip4::Addr{10,0,0,42}, port}, {ip4::Addr{10,0,0,43}, 80}};
+}
+
+static Time_wait record(uint64_t expires)
+{
+  Time_wait tw;
+  tw.snd_nxt = 1000;
+  tw.rcv_nxt = 2000;
+  tw.expires = expires;
+  return tw;
+}
+
+CASE("TIME-WAIT records expire in order and are released")
+{
+  Time_wait_table table;
+  std::vector<uint16_t> released;
+  table.on_release(
+    [&released] (const Time_wait_table::Tuple& tuple) {
+      released.push_back(tuple.first.port());
+    });
+
+  EXPECT(table.expire(0) == 0u);
+  table.insert(flow(1), record(100));
+  table.insert(flow(2), record(200));
+  table.insert(flow(3), record(300));
+  EXPECT(table.size() == 3u);
+  EXPECT(table.find(flow(2)) != nullptr);
+  EXPECT(table.find(flow(2))->rcv_nxt == 2000u);
+  EXPECT(table.find(flow(4)) == nullptr);
+
+  EXPECT(table.expire(99) == 100u);
+  EXPECT(released.empty());
+  EXPECT(table.expire(200) == 300u);
+  EXPECT(released == std::vector<uint16_t>({1, 2}));
+  EXPECT(table.find(flow(1)) == nullptr);
+
+  // refreshing moves the expiry forward
+  table.find(flow(3))->expires = 500;
+  EXPECT(table.expire(300) == 500u);
+  EXPECT(table.find(flow(3)) != nullptr);
+
+  table.erase(flow(3));
+  EXPECT(released == std::vector<uint16_t>({1, 2, 3}));
+  EXPECT(table.empty());
+  // erasing what's gone does nothing
+  table.erase(flow(3));
+  EXPECT(released.size() == 3u);
+  EXPECT(table.expire(1000) == 0u);
+  EXPECT(released.size() == 3u);
+}
+
+CASE("TIME-WAIT can be taken over early by a newer SYN")
+{
+  Time_wait tw = record(0);
+  // by sequence number, also when wrapping
+  EXPECT(tw.acceptable_syn(2001, nullptr));
+  EXPECT(not tw.acceptable_syn(2000, nullptr));
+  EXPECT(not tw.acceptable_syn(1999, nullptr));
+  tw.rcv_nxt = 0xfffffff0;
+  EXPECT(tw.acceptable_syn(0x10, nullptr));
+
+  // by timestamp when both ends use them [RFC 6191]
+  tw.ts_ok     = true;
+  tw.ts_recent = 5000;
+  uint32_t ts_val = 5001;
+  EXPECT(tw.acceptable_syn(0, &ts_val));
+  ts_val = 5000;
+  EXPECT(not tw.acceptable_syn(0x10, &ts_val));
+  // a SYN without timestamps falls back to the sequence number
+  EXPECT(tw.acceptable_syn(0x10, nullptr));
+}
@@ -0,0 +1,250 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <net/inet>
+#include <net/interfaces>
+#include <hw/async_device.hpp>
+
+using namespace net;
+
+static const ip4::Addr server_addr {10,0,0,42};
+static const ip4::Addr client_addr {10,0,0,43};
+
+static std::unique_ptr<hw::Async_device<UserNet>> dev1 = nullptr;
+static std::unique_ptr<hw::Async_device<UserNet>> dev2 = nullptr;
+
+static void setup_inet()
+{
+  if (dev1 != nullptr) return;
+  dev1 = std::make_unique<hw::Async_device<UserNet>>(UserNet::create(1500));
+  dev2 = std::make_unique<hw::Async_device<UserNet>>(UserNet::create(1500));
+  dev1->connect(*dev2);
+  dev2->connect(*dev1);
+
+  auto& inet_server = net::Interfaces::get(0);
+  inet_server.network_config(server_addr, {255,255,255,0}, {10,0,0,1});
+  auto& inet_client = net::Interfaces::get(1);
+  inet_client.network_config(client_addr, {255,255,255,0}, {10,0,0,1});
+}
+
+static void process_events(const std::function<bool()>& done)
+{
+  for (int round = 0; not done() and round < 100000; round++)
+    Events::get().process_events();
+}
+
+// send one through, so the address of the server is resolved
+static void resolve(udp::Socket& sock, UDP::port_t port)
+{
+  static bool resolved = false;
+  if (resolved) return;
+  auto& listener = net::Interfaces::get(0).udp().bind(port);
+  listener.on_read(
+    [] (UDP::addr_t, UDP::port_t, const char*, size_t) { resolved = true; });
+  sock.sendto(server_addr, port, "hello", 5);
+  process_events([] { return resolved; });
+  listener.close();
+}
+
+CASE("Datagrams find their socket among many")
+{
+  setup_inet();
+  auto& server = net::Interfaces::get(0).udp();
+  auto& client = net::Interfaces::get(1).udp();
+
+  const int PORTS = 500;
+  std::vector<int> received(PORTS);
+  for (int i = 0; i < PORTS; i++)
+  {
+    auto& sock = server.bind(2000 + i);
+    sock.on_read(
+      [&received, i] (UDP::addr_t addr, UDP::port_t, const char* data, size_t len) {
+        if (addr == client_addr and std::string(data, len) == std::to_string(i))
+          received[i]++;
+      });
+  }
+
+  auto& sock = client.bind();
+  resolve(sock, 2000 + PORTS);
+  // a few at a time, in no particular order
+  for (int i = 0; i < PORTS; i++)
+  {
+    const int port = (i * 7) % PORTS;
+    const auto msg = std::to_string(port);
+    sock.sendto(server_addr, 2000 + port, msg.data(), msg.size());
+    if (i % 50 == 49)
+      process_events([] { return false; });
+  }
+  process_events([&received] {
+    return std::all_of(received.begin(), received.end(), [] (int n) { return n > 0; });
+  });
+  EXPECT(std::all_of(received.begin(), received.end(), [] (int n) { return n == 1; }));
+
+  for (int i = 0; i < PORTS; i++)
+    server.close({server_addr, UDP::port_t(2000 + i)});
+  EXPECT(not server.is_bound(2000));
+  sock.close();
+}
+
+CASE("Datagrams in a round are handed over in batches per socket")
+{
+  setup_inet();
+  auto& server = net::Interfaces::get(0).udp();
+  auto& client = net::Interfaces::get(1).udp();
+
+  std::vector<std::pair<int, std::string>> batches;
+  int singles = 0;
+  auto& first  = server.bind(3000);
+  auto& second = server.bind(3001);
+  auto& third  = server.bind(3002);
+  auto on_batch = [&lest_env, &batches] (int port) {
+    return [&lest_env, &batches, port] (const udp::Datagram* dgrams, size_t count) {
+      std::string data;
+      for (size_t i = 0; i < count; i++) {
+        EXPECT(dgrams[i].addr == client_addr);
+        data.append(dgrams[i].data, dgrams[i].length);
+      }
+      batches.emplace_back(port, data);
+    };
+  };
+  first.on_read_batch(on_batch(3000));
+  second.on_read_batch(on_batch(3001));
+  // one reading a datagram at a time gets it right away
+  third.on_read([&lest_env, &singles, &batches] (UDP::addr_t, UDP::port_t, const char*, size_t) {
+    EXPECT(batches.empty());
+    singles++;
+  });
+
+  auto& sock = client.bind();
+  resolve(sock, 3003);
+  const udp::Datagram dgrams[] {
+    {server_addr, 3000, "a", 1},
+    {server_addr, 3000, "b", 1},
+    {server_addr, 3002, "-", 1},
+    {server_addr, 3000, "c", 1},
+    {server_addr, 3001, "d", 1},
+    {server_addr, 3001, "e", 1},
+    {server_addr, 3000, "f", 1},
+  };
+  const size_t count = sizeof(dgrams) / sizeof(dgrams[0]);
+  EXPECT(sock.sendmmsg(dgrams, count) == count);
+  process_events([&batches] { return batches.size() >= 3; });
+
+  // the datagrams in a row for the same socket go together
+  EXPECT(singles == 1);
+  EXPECT(batches.size() == 3u);
+  EXPECT(batches.at(0) == std::make_pair(3000, std::string{"abc"}));
+  EXPECT(batches.at(1) == std::make_pair(3001, std::string{"de"}));
+  EXPECT(batches.at(2) == std::make_pair(3000, std::string{"f"}));
+
+  // a socket closed by the handler of another gets no more
+  batches.clear();
+  first.on_read_batch(
+    [&batches, &second] (const udp::Datagram*, size_t count) {
+      batches.emplace_back(3000, std::to_string(count));
+      if (batches.size() == 1) second.close();
+    });
+  EXPECT(sock.sendmmsg(dgrams, count) == count);
+  process_events([&batches] { return batches.size() >= 2; });
+  EXPECT(batches.size() == 2u);
+  EXPECT(batches.at(0) == std::make_pair(3000, std::string{"3"}));
+  EXPECT(batches.at(1) == std::make_pair(3000, std::string{"1"}));
+  EXPECT(not server.is_bound(3001));
+
+  first.close();
+  third.close();
+  sock.close();
+}
+
+CASE("sendmmsg sends what the transmit queue has room for and queues the rest")
+{
+  setup_inet();
+  auto& server = net::Interfaces::get(0).udp();
+  auto& client = net::Interfaces::get(1).udp();
+
+  size_t received = 0;
+  auto& sink = server.bind(4000);
+  sink.on_read_batch(
+    [&received] (const udp::Datagram*, size_t count) {
+      received += count;
+    });
+
+  auto& sock = client.bind();
+  resolve(sock, 4001);
+  // every datagram is sent from the buffers given
+  std::vector<std::string> msgs;
+  const size_t room  = dev2->nic().transmit_queue_available();
+  const size_t count = room + 16;
+  for (size_t i = 0; i < count; i++)
+    msgs.push_back(std::to_string(i));
+  std::vector<udp::Datagram> dgrams;
+  for (const auto& msg : msgs)
+    dgrams.push_back({server_addr, 4000, msg.data(), msg.size()});
+
+  bool sent = false;
+  EXPECT(sock.sendmmsg(dgrams.data(), dgrams.size(), [&sent] { sent = true; }) == room);
+  // called when the last one is sent, not when it is queued
+  EXPECT(not sent);
+
+  process_events([&received, room] { return received >= room; });
+  EXPECT(received == room);
+  EXPECT(not sent);
+  // the driver has room again
+  dev2->nic().signal_tqa();
+  EXPECT(sent);
+  process_events([&received, count] { return received >= count; });
+  EXPECT(received == count);
+
+  // all sent right away, and called right away
+  sent = false;
+  EXPECT(sock.sendmmsg(dgrams.data(), 4, [&sent] { sent = true; }) == 4u);
+  EXPECT(sent);
+  process_events([&received, count] { return received >= count + 4; });
+  EXPECT(received == count + 4);
+
+  sink.close();
+  sock.close();
+}
+
+CASE("A broadcast receiver may bind sockets from its handler")
+{
+  setup_inet();
+  auto& server = net::Interfaces::get(0).udp();
+  auto& client = net::Interfaces::get(1).udp();
+
+  const int PORTS = 200;
+  int received = 0;
+  auto& receiver = server.bind({server_addr, 5000});
+  receiver.on_read(
+    [&server, &received] (UDP::addr_t, UDP::port_t, const char*, size_t) {
+      received++;
+      // enough to make the sockets table grow
+      for (int i = 1; i <= PORTS; i++)
+        server.bind({server_addr, UDP::port_t(5000 + i)});
+    });
+
+  auto& sock = client.bind();
+  resolve(sock, 5000 + PORTS + 1);
+  sock.sendto(IP4::ADDR_BCAST, 5000, "bcast", 5);
+  process_events([&received] { return received > 0; });
+  EXPECT(received == 1);
+  EXPECT(server.is_bound({server_addr, 5000 + PORTS}));
+
+  for (int i = 0; i <= PORTS; i++)
+    server.close({server_addr, UDP::port_t(5000 + i)});
+  sock.close();
+}
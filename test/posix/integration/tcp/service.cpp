@@ -23,11 +23,82 @@
 #include <cassert>
 #include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <vector>
 #include <net/interfaces>
+#include <os>
 
 const uint16_t PORT = 1042;
 const uint16_t OUT_PORT = 4242;
 const uint16_t BUFSIZE = 2048;
+const uint16_t ECHO_PORT = 1043;
+// must match test.py
+const size_t   ECHO_ROUNDS = 2000;
+const size_t   ECHO_SIZE   = 64;
+
+// syscall-heavy echo server: one recv and one send per message, every
+// call going through the descriptor table
+static void echo_benchmark()
+{
+  // keep a crowd of descriptors open so lookups are not trivially cheap
+  std::vector<int> idle;
+  for (int i = 0; i < 500; i++)
+    idle.push_back(socket(AF_INET, SOCK_DGRAM, 0));
+
+  int lfd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset((char *)&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(ECHO_PORT);
+  int res = bind(lfd, (struct sockaddr *)&addr, sizeof(addr));
+  CHECKSERT(res == 0, "Echo socket bound to port %u", ECHO_PORT);
+  res = listen(lfd, 5);
+  CHECKSERT(res == 0, "Echo listen OK");
+
+  INFO("TCP Socket", "Echo server ready");
+  int cfd = accept(lfd, NULL, NULL);
+  CHECKSERT(cfd > 0, "Echo client accepted");
+
+  char buf[BUFSIZE];
+  size_t bytes = 0;
+  size_t calls = 0;
+  const auto t0 = os::nanos_since_boot();
+  while (true)
+  {
+    ssize_t n = recv(cfd, buf, sizeof(buf), 0);
+    calls++;
+    if (n <= 0) break;
+    send(cfd, buf, n, 0);
+    calls++;
+    bytes += n;
+  }
+  const auto elapsed = os::nanos_since_boot() - t0;
+
+  printf("Echo: %zu bytes, %zu syscalls in %lu us (%lu ns per syscall)\n",
+         bytes, calls, elapsed / 1000, elapsed / calls);
+  CHECKSERT(bytes == ECHO_ROUNDS * ECHO_SIZE, "Echoed %zu bytes", bytes);
+
+  // lowest free descriptor is handed out again
+  const int reuse = idle[100];
+  close(idle[100]);
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  CHECKSERT(fd == reuse, "Lowest free descriptor reused (%d)", fd);
+  close(fd);
+
+  const auto t1 = os::nanos_since_boot();
+  for (int round = 0; round < 100; round++)
+    for (int i = 0; i < (int) idle.size(); i++)
+      if (i != 100) fcntl(idle[i], F_GETFL);
+  const auto lookup = (os::nanos_since_boot() - t1) / (100 * (idle.size() - 1));
+  printf("Echo: fcntl(F_GETFL) %lu ns per call with %zu open descriptors\n",
+         lookup, idle.size() + 2);
+
+  for (int i = 0; i < (int) idle.size(); i++)
+    if (i != 100) close(idle[i]);
+  close(cfd);
+  close(lfd);
+}
 
 int main()
 {
@@ -119,6 +190,9 @@ int main()
   res = close(cfd);
   CHECKSERT(res == 0, "Closed client connection");
 
+  INFO("TCP Socket", "echo benchmark");
+  echo_benchmark();
+
   return 0;
 }
 
@@ -63,16 +63,41 @@ def TCP_recv(trigger_line):
   conn.close()
   return verify_recv(RECEIVED)
 
+ECHO_PORT = 1043
+ECHO_ROUNDS = 2000
+ECHO_MESSAGE = b'x' * 64
+
+def TCP_echo():
+  sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+  sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+  sock.connect((HOST, ECHO_PORT))
+  for i in range(ECHO_ROUNDS):
+    sock.sendall(ECHO_MESSAGE)
+    received = b''
+    while len(received) < len(ECHO_MESSAGE):
+      data = sock.recv(len(ECHO_MESSAGE) - len(received))
+      if not data:
+        break
+      received += data
+    if received != ECHO_MESSAGE:
+      print("Echo mismatch in round", i)
+      break
+  sock.close()
+
 import _thread
 def TCP_connect_thread(trigger_line):
   _thread.start_new_thread(TCP_connect, ())
 
+def TCP_echo_thread(trigger_line):
+  _thread.start_new_thread(TCP_echo, ())
+
 # Add custom event-handler
 vm.on_output("accept()", TCP_connect_thread)
 vm.on_output("Trigger TCP_recv", TCP_recv)
+vm.on_output("Echo server ready", TCP_echo_thread)
 
 # Boot the VM, taking a timeout as parameter
 if len(sys.argv) > 1:
     vm.boot(image_name=str(sys.argv[1]))
 else:
-    vm.cmake().boot(20,image_name='posix_tcp').clean()
+    vm.cmake().boot(40,image_name='posix_tcp').clean()
@@ -0,0 +1,216 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <posix/epoll_fd.hpp>
+#include <posix/fd_map.hpp>
+
+using namespace std::chrono;
+
+// descriptor with readiness controlled by the test
+class Ready_fd : public FD {
+public:
+  Ready_fd(const int id) : FD(id) {}
+
+  short poll_events() override
+  { return events; }
+
+  void set(short ev)
+  {
+    events = ev;
+    notify_ready();
+  }
+
+  int close() override
+  { return 0; }
+
+  short events = 0;
+};
+
+CASE("FD watchers are notified on readiness and close")
+{
+  auto& fd = FD_map::_open<Ready_fd>();
+  const auto id = fd.get_id();
+  int notified = 0;
+  bool closed = false;
+  fd.add_watcher(&notified, [&notified, &closed] (FD&, bool closing) {
+      if (closing) closed = true;
+      else notified++;
+    });
+  fd.set(POLLIN);
+  fd.set(0);
+  EXPECT(notified == 2);
+
+  // wait_ready returns immediately with zero timeout
+  EXPECT_NOT(FD::wait_ready([&fd] { return fd.poll_events() != 0; }, 0ns));
+  fd.set(POLLOUT);
+  EXPECT(FD::wait_ready([&fd] { return fd.poll_events() != 0; }, 0ns));
+
+  FD_map::close(id);
+  EXPECT(closed);
+  EXPECT(notified == 3);
+}
+
+CASE("Epoll reports level-triggered events")
+{
+  auto& ep = FD_map::_open<Epoll_FD>();
+  auto& fd = FD_map::_open<Ready_fd>();
+  EXPECT(ep.is_epoll());
+  EXPECT_NOT(fd.is_epoll());
+
+  epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.fd = fd.get_id();
+  EXPECT(ep.ctl(EPOLL_CTL_ADD, fd, &ev) == 0);
+  EXPECT(ep.ctl(EPOLL_CTL_ADD, fd, &ev) == -EEXIST);
+  EXPECT(ep.ctl(EPOLL_CTL_ADD, ep, &ev) == -EINVAL);
+  EXPECT(ep.size() == 1u);
+
+  epoll_event out[4];
+  EXPECT(ep.wait(out, 4, 0ns) == 0);
+  EXPECT(ep.wait(out, 0, 0ns) == -EINVAL);
+
+  // only requested events are reported
+  fd.set(POLLOUT);
+  EXPECT(ep.wait(out, 4, 0ns) == 0);
+
+  fd.set(POLLIN | POLLOUT);
+  EXPECT(ep.poll_events() == POLLIN);
+  EXPECT(ep.wait(out, 4, 0ns) == 1);
+  EXPECT(out[0].events == EPOLLIN);
+  EXPECT(out[0].data.fd == fd.get_id());
+  // still ready, reported again
+  EXPECT(ep.wait(out, 4, 0ns) == 1);
+
+  fd.events = 0;
+  EXPECT(ep.wait(out, 4, 0ns) == 0);
+
+  // errors are always reported
+  fd.set(POLLERR);
+  EXPECT(ep.wait(out, 4, 0ns) == 1);
+  EXPECT(out[0].events == EPOLLERR);
+
+  EXPECT(ep.ctl(EPOLL_CTL_DEL, fd, nullptr) == 0);
+  EXPECT(ep.ctl(EPOLL_CTL_DEL, fd, nullptr) == -ENOENT);
+  EXPECT(ep.wait(out, 4, 0ns) == 0);
+
+  FD_map::close(fd.get_id());
+  FD_map::close(ep.get_id());
+}
+
+CASE("Epoll edge-triggered and oneshot events")
+{
+  auto& ep = FD_map::_open<Epoll_FD>();
+  auto& et = FD_map::_open<Ready_fd>();
+  auto& os = FD_map::_open<Ready_fd>();
+
+  epoll_event ev{};
+  ev.events = EPOLLIN | EPOLLET;
+  ev.data.u32 = 1;
+  EXPECT(ep.ctl(EPOLL_CTL_ADD, et, &ev) == 0);
+  ev.events = EPOLLIN | EPOLLONESHOT;
+  ev.data.u32 = 2;
+  EXPECT(ep.ctl(EPOLL_CTL_ADD, os, &ev) == 0);
+
+  et.set(POLLIN);
+  os.set(POLLIN);
+  epoll_event out[4];
+  EXPECT(ep.wait(out, 4, 0ns) == 2);
+  // nothing new happened
+  EXPECT(ep.wait(out, 4, 0ns) == 0);
+
+  // edge-triggered fires again on a new notification
+  et.set(POLLIN);
+  os.set(POLLIN);
+  EXPECT(ep.wait(out, 4, 0ns) == 1);
+  EXPECT(out[0].data.u32 == 1u);
+
+  // oneshot is re-armed with EPOLL_CTL_MOD
+  EXPECT(ep.ctl(EPOLL_CTL_MOD, os, &ev) == 0);
+  EXPECT(ep.wait(out, 4, 0ns) == 1);
+  EXPECT(out[0].data.u32 == 2u);
+
+  // maxevents is respected
+  et.set(POLLIN);
+  EXPECT(ep.ctl(EPOLL_CTL_MOD, os, &ev) == 0);
+  EXPECT(ep.wait(out, 1, 0ns) == 1);
+  EXPECT(ep.wait(out, 1, 0ns) == 1);
+  EXPECT(ep.wait(out, 1, 0ns) == 0);
+
+  // closing a descriptor removes it from the interest list
+  FD_map::close(et.get_id());
+  EXPECT(ep.size() == 1u);
+  FD_map::close(os.get_id());
+  EXPECT(ep.size() == 0u);
+  FD_map::close(ep.get_id());
+}
+
+CASE("Epoll instances can be nested")
+{
+  auto& outer = FD_map::_open<Epoll_FD>();
+  auto& inner = FD_map::_open<Epoll_FD>();
+  auto& fd = FD_map::_open<Ready_fd>();
+
+  epoll_event ev{};
+  ev.events = EPOLLIN;
+  EXPECT(inner.ctl(EPOLL_CTL_ADD, fd, &ev) == 0);
+  EXPECT(outer.ctl(EPOLL_CTL_ADD, inner, &ev) == 0);
+
+  epoll_event out[2];
+  EXPECT(outer.wait(out, 2, 0ns) == 0);
+  fd.set(POLLIN);
+  EXPECT(outer.wait(out, 2, 0ns) == 1);
+  EXPECT(inner.wait(out, 2, 0ns) == 1);
+
+  // closing the inner instance unregisters it everywhere
+  FD_map::close(inner.get_id());
+  EXPECT(outer.size() == 0u);
+  fd.set(POLLIN);
+  FD_map::close(fd.get_id());
+  FD_map::close(outer.get_id());
+}
+
+CASE("Epoll instances may not watch each other")
+{
+  auto& a = FD_map::_open<Epoll_FD>();
+  auto& b = FD_map::_open<Epoll_FD>();
+  auto& c = FD_map::_open<Epoll_FD>();
+  auto& fd = FD_map::_open<Ready_fd>();
+
+  epoll_event ev{};
+  ev.events = EPOLLIN;
+  EXPECT(a.ctl(EPOLL_CTL_ADD, b, &ev) == 0);
+  EXPECT(b.ctl(EPOLL_CTL_ADD, a, &ev) == -ELOOP);
+  EXPECT(b.ctl(EPOLL_CTL_ADD, c, &ev) == 0);
+  EXPECT(c.ctl(EPOLL_CTL_ADD, a, &ev) == -ELOOP);
+  EXPECT(c.ctl(EPOLL_CTL_ADD, fd, &ev) == 0);
+
+  // a watcher is only told when something new is queued
+  epoll_event out[1];
+  EXPECT(a.wait(out, 1, 0ns) == 0);
+  int notified = 0;
+  a.add_watcher(&notified, [&notified] (FD&, bool) { notified++; });
+  fd.set(POLLIN);
+  fd.set(POLLIN);
+  EXPECT(notified == 1);
+  EXPECT(a.wait(out, 1, 0ns) == 1);
+  a.remove_watcher(&notified);
+
+  FD_map::close(fd.get_id());
+  FD_map::close(c.get_id());
+  FD_map::close(b.get_id());
+  FD_map::close(a.get_id());
+}
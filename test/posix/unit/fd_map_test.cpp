@@ -69,3 +69,39 @@ CASE("Adding a implemented FD descriptor in FD_map")
   const int bet = 322; // this used to be a throw
   EXPECT(FD_map::_get(bet) == nullptr);
 }
+
+CASE("FD_map hands out the lowest free descriptor")
+{
+  auto& map = FD_map::instance();
+  const auto before = map.size();
+
+  std::vector<FD_map::id_t> ids;
+  for (int i = 0; i < 200; i++)
+    ids.push_back(FD_map::_open<Test_fd>().get_id());
+  EXPECT(map.size() == before + 200);
+
+  // holes are filled first, so the table stays dense
+  for (size_t i = 1; i < ids.size(); i++)
+    EXPECT(ids[i] > ids[i-1]);
+  EXPECT(ids.front() >= FD_map::FIRST_ID);
+  EXPECT(ids.back() == FD_map::FIRST_ID + (int) map.size() - 1);
+
+  // closed slots are reused lowest first
+  FD_map::close(ids[150]);
+  FD_map::close(ids[70]);
+  FD_map::close(ids[3]);
+  EXPECT(FD_map::_get(ids[70]) == nullptr);
+  EXPECT(FD_map::_open<Test_fd>().get_id() == ids[3]);
+  EXPECT(FD_map::_open<Hest_fd>("neigh").get_id() == ids[70]);
+  EXPECT(FD_map::_open<Test_fd>().get_id() == ids[150]);
+  EXPECT(FD_map::_open<Test_fd>().get_id() == ids.back() + 1);
+
+  // reserved and negative ids are never found
+  EXPECT(FD_map::_get(-1) == nullptr);
+  EXPECT(FD_map::_get(0) == nullptr);
+
+  for (auto id : ids)
+    FD_map::close(id);
+  FD_map::close(ids.back() + 1);
+  EXPECT(map.size() == before);
+}
@@ -0,0 +1,100 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <posix/epoll_fd.hpp>
+#include <posix/fd_map.hpp>
+#include <posix/tcp_fd.hpp>
+#include <net/inet>
+#include <net/interfaces>
+#include <hw/async_device.hpp>
+#include <netinet/in.h>
+
+using namespace std::chrono;
+
+static std::unique_ptr<hw::Async_device<UserNet>> dev1 = nullptr;
+static std::unique_ptr<hw::Async_device<UserNet>> dev2 = nullptr;
+
+static void setup_inet()
+{
+  dev1 = std::make_unique<hw::Async_device<UserNet>>(UserNet::create(1500));
+  dev2 = std::make_unique<hw::Async_device<UserNet>>(UserNet::create(1500));
+  dev1->connect(*dev2);
+  dev2->connect(*dev1);
+
+  // sockets use the first interface
+  auto& inet_client = net::Interfaces::get(0);
+  inet_client.network_config({10,0,0,43}, {255,255,255,0}, {10,0,0,1});
+  auto& inet_server = net::Interfaces::get(1);
+  inet_server.network_config({10,0,0,42}, {255,255,255,0}, {10,0,0,1});
+}
+
+static int set_flags(FD& fd, int cmd, ...)
+{
+  va_list list;
+  va_start(list, cmd);
+  const int res = fd.fcntl(cmd, list);
+  va_end(list);
+  return res;
+}
+
+CASE("Non-blocking connect is writable once the handshake completes")
+{
+  setup_inet();
+  int accepted = 0;
+  net::Interfaces::get(1).tcp().listen(80,
+    [&accepted] (net::tcp::Connection_ptr conn) {
+      if (conn) accepted++;
+    });
+
+  auto& sock = FD_map::_open<TCP_FD>();
+  EXPECT(sock.is_blocking());
+  EXPECT(set_flags(sock, F_SETFL, O_NONBLOCK) == 0);
+  EXPECT_NOT(sock.is_blocking());
+
+  auto& ep = FD_map::_open<Epoll_FD>();
+  epoll_event ev{};
+  ev.events = EPOLLOUT;
+  ev.data.fd = sock.get_id();
+  EXPECT(ep.ctl(EPOLL_CTL_ADD, sock, &ev) == 0);
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(80);
+  addr.sin_addr.s_addr = htonl(0x0A00002A); // 10.0.0.42
+  EXPECT(sock.connect((const sockaddr*) &addr, sizeof(addr)) == -EINPROGRESS);
+  EXPECT(sock.connect((const sockaddr*) &addr, sizeof(addr)) == -EALREADY);
+
+  // in SYN-SENT nothing can be sent yet
+  epoll_event out[2];
+  EXPECT((sock.poll_events() & POLLOUT) == 0);
+  EXPECT(ep.wait(out, 2, 0ns) == 0);
+  const char data[] = "hello";
+  EXPECT(sock.send(data, sizeof(data), 0) == -ENOTCONN);
+
+  for (int round = 0; ep.wait(out, 2, 0ns) == 0 and round < 100000; round++)
+    Events::get().process_events();
+  EXPECT(accepted == 1);
+  EXPECT(ep.wait(out, 2, 0ns) == 1);
+  EXPECT(out[0].events == EPOLLOUT);
+  EXPECT(out[0].data.fd == sock.get_id());
+  EXPECT((sock.poll_events() & (POLLOUT | POLLERR)) == POLLOUT);
+  EXPECT(sock.connect((const sockaddr*) &addr, sizeof(addr)) == -EISCONN);
+  EXPECT(sock.send(data, sizeof(data), 0) == (ssize_t) sizeof(data));
+
+  FD_map::close(ep.get_id());
+  FD_map::close(sock.get_id());
+}
@@ -25,6 +25,7 @@
 #include <os>
 #include <iostream>
 #include <experimental/coroutine>
+#include <kernel/coroutine.hpp>
 #include <smp>
 #include <vector>
 
@@ -186,6 +187,26 @@ smp_future<int> reduce1 () {
   co_return co_await answer(1);
 }
 
+// frames for twice() and arena_test() come from the arena
+coro::Task<int> twice(coro::Arena&, int i) {
+  using namespace std::chrono;
+  co_await coro::sleep(milliseconds(1));
+  co_return i * 2;
+}
+
+coro::Task<> arena_test(coro::Arena& arena) {
+  int sum = 0;
+  for (int i = 0; i < 100; i++) {
+    sum += co_await twice(arena, i);
+  }
+  std::cout << "Sum of awaited tasks: " << sum << std::endl;
+  Expects(sum == 9900);
+  Expects(arena.heap_allocs() == 0);
+  exit(0);
+}
+
+static coro::Static_arena<4096> arena;
+
 void Service::start(const std::string&)
 {
 
@@ -193,5 +214,5 @@ void Service::start(const std::string&)
   auto sum = reduce().get();
   std::cout << "Sum of coroutine results: " << sum << std::endl;
   Expects(sum == 60);
-  exit(0);
+  coro::spawn(arena_test(arena));
 }
@@ -170,10 +170,10 @@ void Service::start(const std::string&)
            "eth0.sendq_dropped: %zu, eth0.rx_refill_dropped: %zu \n",
            Statman::get().get_by_name("eth0.sendq_max").get_uint64(),
            Statman::get().get_by_name("eth0.sendq_now").get_uint64(),
-           Statman::get().get_by_name("eth0.stat_rx_total_packets").get_uint64(),
-           Statman::get().get_by_name("eth0.stat_tx_total_packets").get_uint64(),
-           Statman::get().get_by_name("eth0.stat_rx_total_bytes").get_uint64(),
-           Statman::get().get_by_name("eth0.stat_tx_total_bytes").get_uint64(),
+           Statman::get().get_by_name("eth0.stat_rx_total_packets").value(),
+           Statman::get().get_by_name("eth0.stat_tx_total_packets").value(),
+           Statman::get().get_by_name("eth0.stat_rx_total_bytes").value(),
+           Statman::get().get_by_name("eth0.stat_tx_total_bytes").value(),
            Statman::get().get_by_name("eth0.sendq_dropped").get_uint64(),
            Statman::get().get_by_name("eth0.rx_refill_dropped").get_uint64()
       );
@@ -40,3 +40,19 @@ CASE("Various text strings with known CRC32 matches")
   EXPECT(crc32_fast(q2.c_str(), q2.size()) == crc32c(q2.c_str(), q2.size()));
   
 }
+
+CASE("CRC32-C of chunks can be combined")
+{
+  std::vector<char> data(100000);
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = (i * 7 + (i >> 5)) & 0xff;
+
+  const uint32_t whole = crc32c(data.data(), data.size());
+  for (size_t split : {0ul, 1ul, 15ul, 4096ul, 65537ul, data.size()})
+  {
+    const uint32_t a = crc32c(data.data(), split);
+    const uint32_t b = crc32c(data.data() + split, data.size() - split);
+    EXPECT(crc32c_combine(a, b, data.size() - split) == whole);
+  }
+  EXPECT(crc32c_combine(1234, 5678, 0) == 1234u);
+}
@@ -0,0 +1,211 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <util/alloc_buddy.hpp>
+#include <util/alloc_slab.hpp>
+#include <chrono>
+#include <random>
+
+using Buddy = os::mem::buddy::Alloc<false>;
+using Slab  = os::mem::slab::Alloc<Buddy>;
+
+struct Pool {
+  Pool(size_t s) {
+    auto sz  = Buddy::max_bufsize(s);
+    auto res = posix_memalign(&addr, Buddy::min_size, sz);
+    Expects(res == 0);
+    buddy = Buddy::create(addr, sz);
+  }
+
+  ~Pool() {
+    free(addr);
+  }
+
+  Buddy* buddy = nullptr;
+  void* addr = nullptr;
+};
+
+CASE("mem::slab size classes")
+{
+  EXPECT(Slab::size_class(0) == 0);
+  EXPECT(Slab::size_class(1) == 0);
+  EXPECT(Slab::size_class(16) == 0);
+  EXPECT(Slab::size_class(17) == 1);
+  EXPECT(Slab::size_class(64) == 3);
+  EXPECT(Slab::size_class(65) == 4);
+  EXPECT(Slab::size_class(2048) == Slab::class_count - 1);
+  EXPECT(Slab::size_class(2049) == -1);
+
+  // every size fits its class, and not the one below
+  for (size_t sz = 1; sz <= Slab::max_size; sz++)
+  {
+    const int cls = Slab::size_class(sz);
+    EXPECT(Slab::class_sizes[cls] >= sz);
+    if (cls > 0) EXPECT(Slab::class_sizes[cls - 1] < sz);
+  }
+}
+
+CASE("mem::slab allocation and deallocation")
+{
+  using namespace util;
+  Pool pool(4_MiB);
+  Slab slab(*pool.buddy);
+
+  std::vector<std::pair<char*, size_t>> allocs;
+  for (size_t sz = 1; sz <= Slab::max_size; sz += 7)
+  {
+    auto* ptr = (char*) slab.allocate(sz);
+    EXPECT(ptr != nullptr);
+    EXPECT(pool.buddy->in_range(ptr));
+    memset(ptr, sz & 0xff, sz);
+    allocs.emplace_back(ptr, sz);
+  }
+  // nothing was overwritten by a neighbour
+  for (auto& a : allocs)
+  {
+    for (size_t i = 0; i < a.second; i++)
+      EXPECT((uint8_t) a.first[i] == (a.second & 0xff));
+  }
+  EXPECT(slab.bytes_reserved() == pool.buddy->bytes_used());
+  const auto peak = slab.bytes_reserved();
+
+  for (auto& a : allocs) slab.deallocate(a.first, a.second);
+  EXPECT(slab.bytes_requested() == 0);
+  EXPECT(slab.bytes_reserved() == pool.buddy->bytes_used());
+
+  // freed objects are reused before new slabs are taken
+  for (auto& a : allocs) a.first = (char*) slab.allocate(a.second);
+  EXPECT(slab.bytes_reserved() <= peak);
+  for (auto& a : allocs) slab.deallocate(a.first, a.second);
+
+  EXPECT(slab.allocate(Slab::max_size + 1) == nullptr);
+}
+
+CASE("mem::slab statistics and fragmentation")
+{
+  using namespace util;
+  Pool pool(1_MiB);
+  Slab slab(*pool.buddy);
+
+  std::vector<void*> objs;
+  for (int i = 0; i < 100; i++) objs.push_back(slab.allocate(40));
+
+  const int cls = Slab::size_class(40);
+  auto st = slab.stats(cls);
+  EXPECT(st.size == 48u);
+  EXPECT(st.allocs == 100u);
+  EXPECT(st.in_use() == 100u);
+  EXPECT(st.slabs == 2u);
+  EXPECT(st.slab_bytes == 8_KiB);
+  EXPECT(st.requested == 4000u);
+  EXPECT(st.wasted() == 8_KiB - 4000);
+  EXPECT(st.fragmentation() > 0.5);
+  // refills at the 1st, 33rd, 65th and 86th, when the first slab ran out
+  EXPECT(st.cache_hits == 96u);
+
+  for (auto* ptr : objs) slab.deallocate(ptr, 40);
+  st = slab.stats(cls);
+  EXPECT(st.in_use() == 0u);
+  EXPECT(st.requested == 0u);
+  EXPECT(st.fragmentation() == 1.0);
+}
+
+CASE("mem::slab gives idle slabs back to the backend")
+{
+  using namespace util;
+  Pool pool(1_MiB);
+  Slab slab(*pool.buddy);
+  const int cls = Slab::size_class(64);
+
+  std::vector<void*> objs;
+  for (int i = 0; i < 1000; i++) {
+    objs.push_back(slab.allocate(64));
+    memset(objs.back(), 0xff, 64);
+  }
+  auto st = slab.stats(cls);
+  const auto slabs = st.slabs;
+  EXPECT(slabs == (1000 + Slab::slab_objects(cls) - 1) / Slab::slab_objects(cls));
+  EXPECT(st.slabs_freed == 0u);
+
+  // in the order they were allocated, so slabs go idle one after another
+  for (auto* ptr : objs) slab.deallocate(ptr, 64);
+  st = slab.stats(cls);
+  EXPECT(st.slabs_freed > 0u);
+  EXPECT(st.slabs + st.slabs_freed == slabs);
+  // what the CPU cache holds, and one kept for the next time
+  EXPECT(st.slabs * Slab::slab_objects(cls) <= Slab::cache_max + 2 * Slab::slab_objects(cls));
+  EXPECT(slab.bytes_reserved() == pool.buddy->bytes_used());
+
+  // and taken again when needed
+  for (auto& ptr : objs) {
+    ptr = slab.allocate(64);
+    EXPECT(ptr != nullptr);
+    memset(ptr, 0, 64);
+  }
+  EXPECT(slab.stats(cls).slabs == slabs);
+  for (auto* ptr : objs) slab.deallocate(ptr, 64);
+}
+
+CASE("mem::slab runs out of backend memory")
+{
+  using namespace util;
+  Pool pool(64_KiB);
+  Slab slab(*pool.buddy);
+
+  size_t count = 0;
+  while (slab.allocate(Slab::max_size)) count++;
+  EXPECT(count > 0u);
+  EXPECT(slab.stats(Slab::class_count - 1).in_use() == count);
+}
+
+CASE("mem::slab malloc benchmark")
+{
+  using namespace util;
+  using namespace std::chrono;
+  Pool pool_a(64_MiB);
+  Pool pool_b(64_MiB);
+  Slab slab(*pool_b.buddy);
+
+  // a mix of small sizes, as from delegates, shared_ptrs and packets
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<size_t> dist(8, 512);
+  std::vector<size_t> sizes(4096);
+  for (auto& sz : sizes) sz = dist(rng);
+  std::vector<void*> ptrs(sizes.size());
+  const int rounds = 20;
+
+  auto bench = [&] (auto& alloc) {
+    const auto t0 = high_resolution_clock::now();
+    for (int r = 0; r < rounds; r++)
+    {
+      for (size_t i = 0; i < sizes.size(); i++) ptrs[i] = alloc.allocate(sizes[i]);
+      for (size_t i = 0; i < sizes.size(); i++) alloc.deallocate(ptrs[i], sizes[i]);
+    }
+    const auto t1 = high_resolution_clock::now();
+    return duration_cast<nanoseconds>(t1 - t0).count() / double(rounds * sizes.size());
+  };
+
+  const double buddy_ns = bench(*pool_a.buddy);
+  const double slab_ns  = bench(slab);
+  printf("mem::slab benchmark: buddy %.1f ns, slab %.1f ns per alloc/free pair\n",
+         buddy_ns, slab_ns);
+
+  // buddy takes a page per object
+  EXPECT(pool_a.buddy->bytes_used() == 0u);
+  EXPECT(slab.bytes_requested() == 0u);
+  EXPECT(slab.bytes_reserved() < sizes.size() * Buddy::min_size);
+}
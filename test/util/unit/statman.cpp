@@ -17,9 +17,13 @@
 
 #include <common.cxx>
 #include <util/statman.hpp>
+#include <kernel/timers.hpp>
+#include <map>
 
 using namespace std;
 
+extern delegate<uint64_t()> systime_override;
+
 CASE( "Creating Statman objects" )
 {
   GIVEN( "A fixed range of memory and its start position" )
@@ -257,3 +261,175 @@ CASE("Various stat to_string()")
   EXPECT(stat2.to_string() == std::to_string(1ul));
   EXPECT(stat3.to_string() == std::to_string(1.0f));
 }
+
+CASE("get_by_name finds stats through the index, also after free")
+{
+  Statman statman_;
+  Stat& stat1 = statman_.create(Stat::UINT32, "a.stat");
+  Stat& stat2 = statman_.create(Stat::UINT64, "b.stat");
+  EXPECT(&statman_.get_by_name("a.stat") == &stat1);
+  EXPECT(&statman_.get_by_name("b.stat") == &stat2);
+  EXPECT_THROWS(statman_.get_by_name("c.stat"));
+
+  statman_.free(&stat1);
+  EXPECT_THROWS(statman_.get_by_name("a.stat"));
+  // reuses the free slot
+  Stat& stat3 = statman_.create(Stat::FLOAT, "c.stat");
+  EXPECT(&stat3 == &stat1);
+  EXPECT(&statman_.get_by_name("c.stat") == &stat3);
+  EXPECT(&statman_.get_or_create(Stat::UINT64, "b.stat") == &stat2);
+
+  statman_.clear();
+  EXPECT_THROWS(statman_.get_by_name("b.stat"));
+  EXPECT_NO_THROW(statman_.get_by_name("statman.unused_stats"));
+}
+
+CASE("Sharded counter, rate and histogram stats")
+{
+  Statman statman_;
+  Stat& counter = statman_.create(Stat::COUNTER, "net.rx");
+  EXPECT(counter.is_sharded());
+  EXPECT_THROWS(counter.get_uint64());
+  ++counter;
+  counter.get_counter() += 9;
+  EXPECT(counter.get_counter().value() == 10u);
+  EXPECT(counter.to_string() == "10");
+
+  Stat& rate = statman_.create(Stat::RATE, "net.rx_rate");
+  rate.get_counter() += 100;
+  EXPECT(rate.get_rate().sample(1000000000) == 0.0);
+  rate.get_rate() += 500;
+  statman_.sample_rates(1500000000);
+  EXPECT(rate.get_rate().per_second() == 1000.0);
+  EXPECT(rate.value() == 600u);
+
+  Stat& histo_stat = statman_.create(Stat::HISTOGRAM, "net.latency");
+  EXPECT_THROWS(++histo_stat);
+  auto& histo = histo_stat.get_histogram();
+  EXPECT(histo.percentile(0.5) == 0u);
+  for (uint64_t i = 1; i <= 100; i++) histo.record(i);
+  EXPECT(histo.count() == 100u);
+  EXPECT(histo.sum() == 5050u);
+  EXPECT(histo.max() == 100u);
+  EXPECT(Stat_histogram::bucket_of(0) == 0);
+  EXPECT(Stat_histogram::bucket_of(1) == 1);
+  EXPECT(Stat_histogram::bucket_of(7) == 7);
+  EXPECT(Stat_histogram::bucket_of(64) == 32);
+  EXPECT(Stat_histogram::bucket_of(UINT64_MAX) == Stat_histogram::BUCKETS - 1);
+  // 50 is in [48, 51]
+  EXPECT(histo.percentile(0.5) == 51u);
+  EXPECT(histo.percentile(1.0) == 100u);
+
+  // the shards go with the stat
+  statman_.free(&histo_stat);
+  EXPECT(statman_.create(Stat::UINT32, "reused").get_uint32() == 0u);
+}
+
+CASE("The rates of the system stats are sampled by a timer")
+{
+  static uint64_t current_time = 0;
+  systime_override = [] () -> uint64_t { return current_time; };
+  Timers::init([] (Timers::duration_t) {}, [] () {});
+  Timers::ready();
+
+  Stat& rate = Statman::get().create(Stat::RATE, "test.rx_rate");
+  EXPECT(Timers::active() == 1u);
+  rate.get_rate() += 100;
+  current_time = chrono::nanoseconds(Statman::RATE_INTERVAL).count();
+  Timers::timers_handler();
+  rate.get_rate() += 300;
+  current_time *= 2;
+  Timers::timers_handler();
+  EXPECT(rate.get_rate().per_second() == 300.0);
+
+  // more rates share the one timer
+  Statman::get().create(Stat::RATE, "test.tx_rate");
+  EXPECT(Timers::active() == 1u);
+}
+
+CASE("Histogram buckets are log-linear, within 1/8 of the value")
+{
+  for (int i = 0; i < Stat_histogram::BUCKETS; i++)
+  {
+    EXPECT(Stat_histogram::bucket_of(Stat_histogram::bucket_low(i)) == i);
+    EXPECT(Stat_histogram::bucket_of(Stat_histogram::bucket_limit(i)) == i);
+    if (i > 0)
+        EXPECT(Stat_histogram::bucket_low(i) == Stat_histogram::bucket_limit(i - 1) + 1);
+  }
+  for (uint64_t v = 1; v < (1ull << 62); v = v * 3 + 1)
+  {
+    const auto limit = Stat_histogram::bucket_limit(Stat_histogram::bucket_of(v));
+    EXPECT(limit >= v);
+    EXPECT(double(limit - v) / v <= 1.0 / Stat_histogram::SUB_BUCKETS);
+  }
+  EXPECT(Stat_histogram::bucket_limit(Stat_histogram::BUCKETS - 1) == UINT64_MAX);
+}
+
+CASE("Statman snapshots can be exported and parsed back")
+{
+  Statman statman_;
+  statman_.create(Stat::UINT32, "a.uint32").get_uint32() = 32;
+  statman_.create(Stat::UINT64, "a.uint64").get_uint64() = 64;
+  statman_.create(Stat::FLOAT, "a.float").get_float() = 1.5f;
+  auto& gauge = statman_.create(Stat::UINT64, "a.gauge");
+  gauge.make_gauge();
+  statman_.create(Stat::COUNTER, "a.counter").get_counter() += 7;
+  statman_.create(Stat::HISTOGRAM, "a.histogram").get_histogram().record(1000);
+  auto& unused = statman_.create(Stat::UINT32, "a.freed");
+  statman_.free(&unused);
+
+  const auto snap = statman_.snapshot(12345);
+  uint64_t ts = 0;
+  const auto entries = Statman::parse_snapshot(snap.data(), snap.size(), &ts);
+  EXPECT(ts == 12345u);
+  EXPECT(entries.size() == statman_.size());
+
+  std::map<std::string, Stat_entry> by_name;
+  for (auto& e : entries) by_name[e.name] = e;
+  EXPECT(by_name.count("a.freed") == 0u);
+  EXPECT(by_name["a.uint32"].value == 32u);
+  EXPECT(by_name["a.uint64"].value == 64u);
+  EXPECT(by_name["a.float"].fvalue == 1.5f);
+  EXPECT(by_name["a.gauge"].gauge);
+  EXPECT(by_name["a.counter"].type == Stat::COUNTER);
+  EXPECT(by_name["a.counter"].value == 7u);
+  const auto& histo = by_name["a.histogram"];
+  EXPECT(histo.count == 1u);
+  EXPECT(histo.max == 1000u);
+  EXPECT(histo.buckets.size() == 1u);
+  EXPECT(histo.buckets.at(0).first == Stat_histogram::bucket_of(1000));
+
+  // truncated or foreign data throws
+  EXPECT_THROWS_AS(Statman::parse_snapshot(snap.data(), snap.size() - 1), Stats_exception);
+  const uint8_t junk[24] {};
+  EXPECT_THROWS_AS(Statman::parse_snapshot(junk, sizeof(junk)), Stats_exception);
+}
+
+CASE("Copies of sharded stats have shards of their own")
+{
+  Stat counter(Stat::COUNTER, "a.counter");
+  counter.get_counter() += 3;
+  Stat histo(Stat::HISTOGRAM, "a.histogram");
+  histo.get_histogram().record(10);
+
+  Stat counter_copy(counter);
+  ++counter;
+  EXPECT(counter.value() == 4u);
+  EXPECT(counter_copy.value() == 3u);
+  EXPECT(&counter_copy.get_counter() != &counter.get_counter());
+
+  Stat histo_copy(Stat::UINT32, "b.uint32");
+  histo_copy = histo;
+  histo.get_histogram().record(20);
+  EXPECT(histo_copy.type() == Stat::HISTOGRAM);
+  EXPECT(histo_copy.get_histogram().count() == 1u);
+  EXPECT(histo_copy.get_histogram().max() == 10u);
+  EXPECT(histo.get_histogram().count() == 2u);
+
+  // a sharded stat turned into a plain one frees its shards
+  counter_copy = Stat(Stat::UINT64, "a.counter");
+  EXPECT(counter_copy.get_uint64() == 0u);
+  const Stat& same = histo_copy;
+  histo_copy = same;
+  EXPECT(histo_copy.get_histogram().count() == 1u);
+}
@@ -0,0 +1,114 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <util/work_deque.hpp>
+#include <util/mpsc_ring.hpp>
+#include <thread>
+#include <vector>
+
+CASE("Work_deque pops LIFO and steals FIFO")
+{
+  util::Work_deque<intptr_t, 8> deque;
+  EXPECT(deque.empty());
+  EXPECT(deque.capacity() == 8u);
+  for (intptr_t i = 0; i < 8; i++) EXPECT(deque.push(i));
+  EXPECT(deque.push(8) == false);
+  EXPECT(deque.size() == 8u);
+
+  intptr_t value;
+  EXPECT(deque.pop(value));
+  EXPECT(value == 7);
+  EXPECT(deque.steal(value));
+  EXPECT(value == 0);
+  EXPECT(deque.size() == 6u);
+  // wraps around
+  EXPECT(deque.push(8));
+  EXPECT(deque.push(9));
+  for (intptr_t expected : {9, 8, 6, 5, 4, 3, 2, 1}) {
+    EXPECT(deque.pop(value));
+    EXPECT(value == expected);
+  }
+  EXPECT(deque.pop(value) == false);
+  EXPECT(deque.steal(value) == false);
+  EXPECT(deque.empty());
+}
+
+CASE("Work_deque hands out each item once with concurrent thieves")
+{
+  static const int ITEMS = 200000;
+  static util::Work_deque<intptr_t, 1024> deque;
+  static std::vector<std::atomic<int>> taken(ITEMS);
+  static std::atomic<bool> done {false};
+
+  auto thief = [] {
+    intptr_t value;
+    while (done == false || not deque.empty())
+      if (deque.steal(value)) taken[value]++;
+  };
+  std::thread t1(thief), t2(thief);
+
+  intptr_t value;
+  for (intptr_t i = 0; i < ITEMS; i++) {
+    while (deque.push(i) == false)
+      if (deque.pop(value)) taken[value]++;
+    if (i % 3 == 0 && deque.pop(value)) taken[value]++;
+  }
+  while (deque.pop(value)) taken[value]++;
+  done = true;
+  t1.join(); t2.join();
+
+  int wrong = 0;
+  for (auto& count : taken) wrong += (count != 1);
+  EXPECT(wrong == 0);
+}
+
+CASE("MPSC_ring keeps order and accepts concurrent producers")
+{
+  util::MPSC_ring<int, 4> small;
+  for (int i = 0; i < 4; i++) EXPECT(small.try_push(int(i)));
+  EXPECT(small.try_push(4) == false);
+  int value;
+  for (int i = 0; i < 4; i++) {
+    EXPECT(small.try_pop(value));
+    EXPECT(value == i);
+  }
+  EXPECT(small.try_pop(value) == false);
+
+  static const int PER_PRODUCER = 100000;
+  static util::MPSC_ring<int, 256> ring;
+  auto producer = [] (int id) {
+    for (int i = 0; i < PER_PRODUCER; i++)
+      while (ring.try_push(id * PER_PRODUCER + i) == false);
+  };
+  std::thread p1(producer, 0), p2(producer, 1);
+
+  // each producer's items must arrive in the order they were pushed
+  int last[2] = {-1, -1};
+  int received = 0;
+  bool ordered = true;
+  while (received < 2 * PER_PRODUCER) {
+    if (ring.try_pop(value)) {
+      const int id = value / PER_PRODUCER;
+      ordered = ordered && (value % PER_PRODUCER) > last[id];
+      last[id] = value % PER_PRODUCER;
+      received++;
+    }
+  }
+  p1.join(); p2.join();
+  EXPECT(ordered);
+  EXPECT(ring.empty());
+}